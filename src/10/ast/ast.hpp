@@ -14,7 +14,7 @@
 namespace ast
 {
 
-    std::string Join(std::vector<std::string> vStr, std::string dlim)
+    inline std::string Join(std::vector<std::string> vStr, std::string dlim)
     {
         std::stringstream oss;
 
@@ -56,6 +56,11 @@ namespace ast
         IfExpression,        // If表达式
         FunctionLiteral,     // 函数定义
         CallExpression,      // 调用
+        WhileStatement,      // While循环
+        AssignStatement,     // 赋值语句
+        ForStatement,        // 整数区间For循环
+        MatchExpression,     // match表达式
+        SliceExpression,     // 切片表达式
 
         Program // 程序
     };
@@ -213,6 +218,81 @@ namespace ast
         virtual NodeType GetNodeType() { return ast::NodeType::BlockStatement; }
     };
 
+    struct WhileStatement : Statement
+    {
+        token::Token Token; // the 'while' token
+        std::shared_ptr<Expression> pCondition;
+        std::shared_ptr<BlockStatement> pBody;
+
+        WhileStatement(token::Token tok) : Token(tok) {}
+        virtual ~WhileStatement() {}
+
+        virtual void StatementNode() {}
+
+        virtual std::string TokenLiteral() { return Token.Literal; }
+        virtual std::string String()
+        {
+            std::stringstream oss;
+            oss << "while" << pCondition->String() << " " << pBody->String();
+            return oss.str();
+        }
+
+        virtual NodeType GetNodeType() { return ast::NodeType::WhileStatement; }
+    };
+
+    // for (i in a..b) { ... }: i依次取a, a+1, ..., b-1
+    struct ForStatement : Statement
+    {
+        token::Token Token; // the 'for' token
+        std::shared_ptr<Identifier> pVariable;
+        std::shared_ptr<Expression> pStart;
+        std::shared_ptr<Expression> pEnd;
+        std::shared_ptr<BlockStatement> pBody;
+
+        ForStatement(token::Token tok) : Token(tok) {}
+        virtual ~ForStatement() {}
+
+        virtual void StatementNode() {}
+
+        virtual std::string TokenLiteral() { return Token.Literal; }
+        virtual std::string String()
+        {
+            std::stringstream oss;
+            oss << "for(" << pVariable->String() << " in " << pStart->String() << ".." << pEnd->String() << ") " << pBody->String();
+            return oss.str();
+        }
+
+        virtual NodeType GetNodeType() { return ast::NodeType::ForStatement; }
+    };
+
+    // 给已经定义的变量重新赋值: x = expr;
+    struct AssignStatement : Statement
+    {
+        token::Token Token; // the '=' token
+        std::shared_ptr<Identifier> pName;
+        std::shared_ptr<Expression> pValue;
+
+        AssignStatement(token::Token tok, std::shared_ptr<Identifier> name) : Token(tok), pName(name) {}
+        virtual ~AssignStatement() {}
+
+        virtual void StatementNode() {}
+
+        virtual std::string TokenLiteral() { return Token.Literal; }
+        virtual std::string String()
+        {
+            std::stringstream oss;
+            oss << pName->String() << " = ";
+            if (pValue != nullptr)
+            {
+                oss << pValue->String();
+            }
+            oss << ";";
+            return oss.str();
+        }
+
+        virtual NodeType GetNodeType() { return ast::NodeType::AssignStatement; }
+    };
+
     // ======== Expressions ============
 
     struct Boolean : Expression
@@ -323,6 +403,37 @@ namespace ast
         virtual NodeType GetNodeType() { return ast::NodeType::IndexExpression; }
     };
 
+    // arr[start:end], 省略的一端为nullptr
+    struct SliceExpression : Expression
+    {
+        token::Token Token; // '[' Token
+        std::shared_ptr<Expression> Left;
+        std::shared_ptr<Expression> pStart;
+        std::shared_ptr<Expression> pEnd;
+
+        SliceExpression(token::Token tok, std::shared_ptr<Expression> left) : Token(tok), Left(left) {}
+        virtual ~SliceExpression() {}
+
+        virtual void ExpressionNode() {}
+        virtual std::string TokenLiteral() { return Token.Literal; }
+        virtual std::string String() { 
+            std::stringstream oss;
+            oss << "(" << Left->String() << "[";
+            if (pStart != nullptr)
+            {
+                oss << pStart->String();
+            }
+            oss << ":";
+            if (pEnd != nullptr)
+            {
+                oss << pEnd->String();
+            }
+            oss << "])";
+            return oss.str();
+        }
+        virtual NodeType GetNodeType() { return ast::NodeType::SliceExpression; }
+    };
+
     struct PrefixExpression : Expression
     {
         token::Token Token; // The prefix token, e.g. !
@@ -391,6 +502,39 @@ namespace ast
         virtual NodeType GetNodeType() { return ast::NodeType::IfExpression; }
     };
 
+    // match的一个分支: pPattern是整数或字符串字面量, 为nullptr时是默认分支_
+    struct MatchArm
+    {
+        std::shared_ptr<Expression> pPattern;
+        std::shared_ptr<Expression> pBody;
+    };
+
+    struct MatchExpression : Expression
+    {
+        token::Token Token; // The 'match' token
+        std::shared_ptr<Expression> pSubject;
+        std::vector<MatchArm> Arms;
+
+        MatchExpression(token::Token tok) : Token(tok) {}
+        virtual ~MatchExpression() {}
+
+        virtual void ExpressionNode() {}
+        virtual std::string TokenLiteral() { return Token.Literal; }
+        virtual std::string String()
+        {
+            std::vector<std::string> arms{};
+            for (auto &arm : Arms)
+            {
+                arms.push_back((arm.pPattern ? arm.pPattern->String() : "_") + " => " + arm.pBody->String());
+            }
+
+            std::stringstream oss;
+            oss << "match(" << pSubject->String() << ") {" << Join(arms, ", ") << "}";
+            return oss.str();
+        }
+        virtual NodeType GetNodeType() { return ast::NodeType::MatchExpression; }
+    };
+
     struct FunctionLiteral : Expression
     {
         token::Token Token; // The 'fn' token
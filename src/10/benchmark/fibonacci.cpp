@@ -15,6 +15,8 @@
 #include "evaluator/evaluator.hpp"
 #include "compiler/compiler.hpp"
 #include "vm/vm.hpp"
+#include "compiler/register_compiler.hpp"
+#include "vm/register_vm.hpp"
 
 std::string input = R""(
 let fibonacci = fn(x){
@@ -34,8 +36,9 @@ fibonacci(35);
 
 std::string input2 = "fibonacci(35);";
 
-DEFINE_string(engine, ":)", "use 'vm' or 'eval'");
+DEFINE_string(engine, ":)", "use 'vm', 'regvm' or 'eval'");
 DEFINE_bool(builtin, false, "use builtin fibonacci function");
+DEFINE_bool(memo, false, "vm: memoize calls of pure functions");
 
 int main(int argc, char **argv)
 {
@@ -68,6 +71,7 @@ int main(int argc, char **argv)
         }
 
         auto machine = vm::New(comp->Bytecode());
+        machine->memoizePure = FLAGS_memo;
 
         start = std::chrono::system_clock::now();
 
@@ -81,6 +85,29 @@ int main(int argc, char **argv)
         end = std::chrono::system_clock::now();
 
         result = machine->LastPoppedStackElem();
+    } else if(FLAGS_engine == "regvm") {
+        auto comp = compiler::NewRegisterCompiler();
+        auto error = comp->Compile(astNode);
+        if(objects::isError(error))
+        {
+            std::cout << "compiler error: " << error->Inspect() << std::endl;
+            return -1;
+        }
+
+        auto machine = vm::NewRegisterVM(comp->Bytecode());
+
+        start = std::chrono::system_clock::now();
+
+        result = machine->Run();
+        if(objects::isError(result))
+        {
+            std::cout << "regvm error: " << result->Inspect() << std::endl;
+            return -1;
+        }
+
+        end = std::chrono::system_clock::now();
+
+        result = machine->LastResult();
     } else if(FLAGS_engine == "eval") {
         auto env = objects::NewEnvironment();
 
@@ -90,7 +117,7 @@ int main(int argc, char **argv)
 
         end = std::chrono::system_clock::now();
     } else {
-        std::cout << "usage: fibonacci -engine vm|eval [-builtin]" << std::endl;
+        std::cout << "usage: fibonacci -engine vm|regvm|eval [-builtin] [-memo]" << std::endl;
         return -1;
     }
 
@@ -19,7 +19,7 @@ namespace bytecode
         BIGENDIAN,
     };
 
-    BinaryEndianType BinaryEndian()
+    inline BinaryEndianType BinaryEndian()
     {
         int iVal = 0xFFFE; // 65534
         unsigned char *p = (unsigned char *)(&iVal);
@@ -76,9 +76,30 @@ namespace bytecode
         OpClosure,
         OpGetFree,
         OpCurrentClosure,
+
+        // 根据类型反馈生成的推测优化指令, 操作数类型不符时去优化回通用指令
+        OpAddInt,
+        OpSubInt,
+        OpMulInt,
+        OpEqualInt,
+        OpNotEqualInt,
+        OpGreaterThanInt,
+
+        OpImport, // 执行操作数指定的已链接模块的顶层代码(每个运行时一次), 压入导出表
+
+        OpForPrep, // 弹出上界和下界(整数), 压入不装箱的循环计数器
+        OpForIter, // 计数器未到上界时压入当前值并加一, 否则弹出计数器跳到操作数处
+
+        OpJumpTruthy, // 弹出栈顶, 为真时跳转: 用于||短路
+
+        // match分派: 弹出被匹配的值, 算出分支号k后执行紧跟其后的第k条OpJump; 没有命中时执行最后一条(默认分支)
+        OpJumpTable, // 操作数: 最小值的常量下标, 表项数; 值减最小值就是分支号, 用于稠密的整数分支
+        OpJumpMap,   // 操作数: 哈希表常量下标(值 -> 分支号), 表项数; 用于字符串和稀疏的整数分支
+
+        OpSlice, // 弹出结束下标, 起始下标(省略时为null)和数组, 压入共享存储的切片
     };
 
-    std::string OpcodeTypeStr(OpcodeType op)
+    inline std::string OpcodeTypeStr(OpcodeType op)
     {
         switch(op)
         {
@@ -142,6 +163,32 @@ namespace bytecode
                 return "OpGetFree";
             case OpcodeType::OpCurrentClosure:
                 return "OpCurrentClosure";
+            case OpcodeType::OpAddInt:
+                return "OpAddInt";
+            case OpcodeType::OpSubInt:
+                return "OpSubInt";
+            case OpcodeType::OpMulInt:
+                return "OpMulInt";
+            case OpcodeType::OpEqualInt:
+                return "OpEqualInt";
+            case OpcodeType::OpNotEqualInt:
+                return "OpNotEqualInt";
+            case OpcodeType::OpGreaterThanInt:
+                return "OpGreaterThanInt";
+            case OpcodeType::OpImport:
+                return "OpImport";
+            case OpcodeType::OpForPrep:
+                return "OpForPrep";
+            case OpcodeType::OpForIter:
+                return "OpForIter";
+            case OpcodeType::OpJumpTruthy:
+                return "OpJumpTruthy";
+            case OpcodeType::OpJumpTable:
+                return "OpJumpTable";
+            case OpcodeType::OpJumpMap:
+                return "OpJumpMap";
+            case OpcodeType::OpSlice:
+                return "OpSlice";
             default:
                 return std::to_string(static_cast<int>(op));
         }
@@ -164,7 +211,7 @@ namespace bytecode
         ~Definition() { OperandWidths.clear(); }
     };
 
-    static const std::map<OpcodeType, std::shared_ptr<Definition>> definitions{
+    inline const std::map<OpcodeType, std::shared_ptr<Definition>> definitions{
         {OpcodeType::OpConstant, std::make_shared<Definition>("OpConstant", 2)},
         {OpcodeType::OpPop, std::make_shared<Definition>("OpPop")},
 
@@ -208,9 +255,25 @@ namespace bytecode
         {OpcodeType::OpClosure, std::make_shared<Definition>("OpClosure", std::vector<int>{2, 1})},
         {OpcodeType::OpGetFree, std::make_shared<Definition>("OpGetFree", 1)},
         {OpcodeType::OpCurrentClosure, std::make_shared<Definition>("OpCurrentClosure")},
+
+        {OpcodeType::OpAddInt, std::make_shared<Definition>("OpAddInt")},
+        {OpcodeType::OpSubInt, std::make_shared<Definition>("OpSubInt")},
+        {OpcodeType::OpMulInt, std::make_shared<Definition>("OpMulInt")},
+        {OpcodeType::OpEqualInt, std::make_shared<Definition>("OpEqualInt")},
+        {OpcodeType::OpNotEqualInt, std::make_shared<Definition>("OpNotEqualInt")},
+        {OpcodeType::OpGreaterThanInt, std::make_shared<Definition>("OpGreaterThanInt")},
+
+        {OpcodeType::OpImport, std::make_shared<Definition>("OpImport", 2)},
+
+        {OpcodeType::OpForPrep, std::make_shared<Definition>("OpForPrep")},
+        {OpcodeType::OpForIter, std::make_shared<Definition>("OpForIter", 2)},
+        {OpcodeType::OpJumpTruthy, std::make_shared<Definition>("OpJumpTruthy", 2)},
+        {OpcodeType::OpJumpTable, std::make_shared<Definition>("OpJumpTable", std::vector<int>{2, 2})},
+        {OpcodeType::OpJumpMap, std::make_shared<Definition>("OpJumpMap", std::vector<int>{2, 2})},
+        {OpcodeType::OpSlice, std::make_shared<Definition>("OpSlice")},
     };
 
-    std::shared_ptr<Definition> Lookup(OpcodeType op){
+    inline std::shared_ptr<Definition> Lookup(OpcodeType op){
         auto fit = definitions.find(op);
         if(fit == definitions.end())
         {
@@ -219,12 +282,12 @@ namespace bytecode
         return fit->second;
     }
 
-    void ReadUint8(Instructions &ins, int offset, uint8_t& uint8Value)
+    inline void ReadUint8(Instructions &ins, int offset, uint8_t& uint8Value)
     {
         memcpy(&uint8Value, (unsigned char*)(&ins[offset]), sizeof(uint8Value));
     }
 
-    void ReadUint16(Instructions &ins, int offset, uint16_t& uint16Value)
+    inline void ReadUint16(Instructions &ins, int offset, uint16_t& uint16Value)
     {
         memcpy(&uint16Value, (unsigned char*)(&ins[offset]), sizeof(uint16Value));
 
@@ -237,7 +300,7 @@ namespace bytecode
         }
     }
 
-    void WriteUint16(Instructions &ins, int offset, uint16_t& uint16Value)
+    inline void WriteUint16(Instructions &ins, int offset, uint16_t& uint16Value)
     {
         if(bytecode::BinaryEndian() == bytecode::BinaryEndianType::SMALLENDIAN) // to BIGENDIAN
         {
@@ -249,7 +312,7 @@ namespace bytecode
         memcpy(&ins[offset], (unsigned char *)(&uint16Value), sizeof(uint16Value));
     }
 
-    std::vector<Opcode> Make(OpcodeType op, std::vector<int> operands)
+    inline std::vector<Opcode> Make(OpcodeType op, std::vector<int> operands)
     {
         auto def = Lookup(op);
         if(def == nullptr)
@@ -290,12 +353,12 @@ namespace bytecode
         return instruction;
     }
 
-    std::vector<Opcode> Make(OpcodeType op)
+    inline std::vector<Opcode> Make(OpcodeType op)
     {
         return Make(op, {});
     }
 
-    std::pair<std::vector<int>, int> ReadOperands(std::shared_ptr<Definition> def, Instructions &ins, int pos)
+    inline std::pair<std::vector<int>, int> ReadOperands(std::shared_ptr<Definition> def, Instructions &ins, int pos)
     {
         int size = def->OperandWidths.size();
         std::vector<int> operands(size);
@@ -328,7 +391,7 @@ namespace bytecode
         return std::make_pair(operands, offset);
     }
 
-    std::string fmtInstruction(std::shared_ptr<Definition> def, std::vector<int> operands)
+    inline std::string fmtInstruction(std::shared_ptr<Definition> def, std::vector<int> operands)
     {
         std::stringstream oss;
 
@@ -362,7 +425,7 @@ namespace bytecode
         return oss.str();
     }
 
-    std::string InstructionsString(Instructions& ins)
+    inline std::string InstructionsString(Instructions& ins)
     {
         std::stringstream oss;
 
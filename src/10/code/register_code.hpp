@@ -0,0 +1,220 @@
+#ifndef H_REGISTER_CODE_H
+#define H_REGISTER_CODE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <iomanip>
+
+#include "code/code.hpp"
+
+namespace bytecode
+{
+    // 寄存器指令: 三地址码, 寄存器操作数占1个字节, 常量/全局变量/跳转地址占2个字节
+    enum class RegisterOpcodeType : Opcode
+    {
+        OpLoadConstant = 0, // dst, constIndex
+        OpLoadTrue,         // dst
+        OpLoadFalse,        // dst
+        OpLoadNull,         // dst
+        OpMove,             // dst, src
+
+        OpAdd, // dst, left, right
+        OpSub,
+        OpMul,
+        OpDiv,
+
+        OpEqual, // dst, left, right
+        OpNotEqual,
+        OpGreaterThan,
+
+        OpMinus, // dst, src
+        OpBang,  // dst, src
+
+        OpJump,          // pos
+        OpJumpNotTruthy, // cond, pos
+
+        OpGetGlobal, // dst, globalIndex
+        OpSetGlobal, // globalIndex, src
+
+        OpArray, // dst, start, count
+        OpHash,  // dst, start, count
+        OpIndex, // dst, left, index
+
+        OpCall,        // dst, fn, argStart, numArgs
+        OpReturnValue, // src
+        OpReturn,      // return null
+
+        OpGetBuiltin,     // dst, builtinIndex
+        OpClosure,        // dst, constIndex, freeStart, numFree
+        OpGetFree,        // dst, freeIndex
+        OpCurrentClosure, // dst
+
+        OpResult, // src, 记录顶层表达式语句的值
+    };
+
+    inline const std::map<RegisterOpcodeType, std::shared_ptr<Definition>> registerDefinitions{
+        {RegisterOpcodeType::OpLoadConstant, std::make_shared<Definition>("OpLoadConstant", std::vector<int>{1, 2})},
+        {RegisterOpcodeType::OpLoadTrue, std::make_shared<Definition>("OpLoadTrue", 1)},
+        {RegisterOpcodeType::OpLoadFalse, std::make_shared<Definition>("OpLoadFalse", 1)},
+        {RegisterOpcodeType::OpLoadNull, std::make_shared<Definition>("OpLoadNull", 1)},
+        {RegisterOpcodeType::OpMove, std::make_shared<Definition>("OpMove", std::vector<int>{1, 1})},
+
+        {RegisterOpcodeType::OpAdd, std::make_shared<Definition>("OpAdd", std::vector<int>{1, 1, 1})},
+        {RegisterOpcodeType::OpSub, std::make_shared<Definition>("OpSub", std::vector<int>{1, 1, 1})},
+        {RegisterOpcodeType::OpMul, std::make_shared<Definition>("OpMul", std::vector<int>{1, 1, 1})},
+        {RegisterOpcodeType::OpDiv, std::make_shared<Definition>("OpDiv", std::vector<int>{1, 1, 1})},
+
+        {RegisterOpcodeType::OpEqual, std::make_shared<Definition>("OpEqual", std::vector<int>{1, 1, 1})},
+        {RegisterOpcodeType::OpNotEqual, std::make_shared<Definition>("OpNotEqual", std::vector<int>{1, 1, 1})},
+        {RegisterOpcodeType::OpGreaterThan, std::make_shared<Definition>("OpGreaterThan", std::vector<int>{1, 1, 1})},
+
+        {RegisterOpcodeType::OpMinus, std::make_shared<Definition>("OpMinus", std::vector<int>{1, 1})},
+        {RegisterOpcodeType::OpBang, std::make_shared<Definition>("OpBang", std::vector<int>{1, 1})},
+
+        {RegisterOpcodeType::OpJump, std::make_shared<Definition>("OpJump", 2)},
+        {RegisterOpcodeType::OpJumpNotTruthy, std::make_shared<Definition>("OpJumpNotTruthy", std::vector<int>{1, 2})},
+
+        {RegisterOpcodeType::OpGetGlobal, std::make_shared<Definition>("OpGetGlobal", std::vector<int>{1, 2})},
+        {RegisterOpcodeType::OpSetGlobal, std::make_shared<Definition>("OpSetGlobal", std::vector<int>{2, 1})},
+
+        {RegisterOpcodeType::OpArray, std::make_shared<Definition>("OpArray", std::vector<int>{1, 1, 1})},
+        {RegisterOpcodeType::OpHash, std::make_shared<Definition>("OpHash", std::vector<int>{1, 1, 1})},
+        {RegisterOpcodeType::OpIndex, std::make_shared<Definition>("OpIndex", std::vector<int>{1, 1, 1})},
+
+        {RegisterOpcodeType::OpCall, std::make_shared<Definition>("OpCall", std::vector<int>{1, 1, 1, 1})},
+        {RegisterOpcodeType::OpReturnValue, std::make_shared<Definition>("OpReturnValue", 1)},
+        {RegisterOpcodeType::OpReturn, std::make_shared<Definition>("OpReturn")},
+
+        {RegisterOpcodeType::OpGetBuiltin, std::make_shared<Definition>("OpGetBuiltin", std::vector<int>{1, 1})},
+        {RegisterOpcodeType::OpClosure, std::make_shared<Definition>("OpClosure", std::vector<int>{1, 2, 1, 1})},
+        {RegisterOpcodeType::OpGetFree, std::make_shared<Definition>("OpGetFree", std::vector<int>{1, 1})},
+        {RegisterOpcodeType::OpCurrentClosure, std::make_shared<Definition>("OpCurrentClosure", 1)},
+
+        {RegisterOpcodeType::OpResult, std::make_shared<Definition>("OpResult", 1)},
+    };
+
+    inline std::shared_ptr<Definition> LookupRegister(RegisterOpcodeType op)
+    {
+        auto fit = registerDefinitions.find(op);
+        if(fit == registerDefinitions.end())
+        {
+            return nullptr;
+        }
+        return fit->second;
+    }
+
+    inline std::vector<Opcode> MakeRegister(RegisterOpcodeType op, std::vector<int> operands)
+    {
+        auto def = LookupRegister(op);
+        if(def == nullptr)
+        {
+            return std::vector<Opcode>{};
+        }
+
+        int instructionLen = 1;
+        for(auto &w: def->OperandWidths)
+        {
+            instructionLen += w;
+        }
+
+        std::vector<Opcode> instruction = std::vector<Opcode>(instructionLen);
+        instruction[0] = static_cast<Opcode>(op);
+
+        int offset = 1;
+        for(unsigned long i=0; i < operands.size(); i++)
+        {
+            auto width = def->OperandWidths[i];
+            switch(width)
+            {
+                case 2:
+                    {
+                        uint16_t uint16Value = static_cast<uint16_t>(operands[i]);
+                        WriteUint16(instruction, offset, uint16Value);
+                    }
+                    break;
+                case 1:
+                    {
+                        instruction[offset] = static_cast<Opcode>(operands[i]);
+                    }
+                    break;
+            }
+            offset += width;
+        }
+
+        return instruction;
+    }
+
+    inline std::vector<Opcode> MakeRegister(RegisterOpcodeType op)
+    {
+        return MakeRegister(op, {});
+    }
+
+    inline std::pair<std::vector<int>, int> ReadRegisterOperands(std::shared_ptr<Definition> def, Instructions &ins, int pos)
+    {
+        int size = def->OperandWidths.size();
+        std::vector<int> operands(size);
+        int offset = 0;
+
+        for (int i = 0; i < size; i++)
+        {
+            auto width = def->OperandWidths[i];
+            switch(width)
+            {
+                case 2:
+                    {
+                        uint16_t uint16Value;
+                        ReadUint16(ins, pos + offset, uint16Value);
+                        operands[i] = static_cast<int>(uint16Value);
+                    }
+                    break;
+                case 1:
+                    {
+                        uint8_t uint8Value;
+                        ReadUint8(ins, pos + offset, uint8Value);
+                        operands[i] = static_cast<int>(uint8Value);
+                    }
+                    break;
+            }
+
+            offset += width;
+        }
+
+        return std::make_pair(operands, offset);
+    }
+
+    inline std::string RegisterInstructionsString(Instructions& ins)
+    {
+        std::stringstream oss;
+
+        int i = 0, size = ins.size();
+        while(i < size)
+        {
+            auto def = LookupRegister(static_cast<RegisterOpcodeType>(ins[i]));
+            if(def == nullptr)
+            {
+                std::cout << "ERROR: can not Lookup this: " << unsigned(ins[i]) << std::endl;
+                i += 1;
+                continue;
+            }
+
+            auto operands = ReadRegisterOperands(def, ins, i+1);
+
+            oss << std::setw(4) << std::setfill('0') << i << " " << def->Name;
+            for(auto &operand: operands.first)
+            {
+                oss << " " << operand;
+            }
+            oss << "\n";
+
+            i += (1 + operands.second);
+        }
+
+        return oss.str();
+    }
+}
+
+#endif // H_REGISTER_CODE_H
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <set>
 #include <memory>
 #include <algorithm>
 
@@ -13,10 +14,17 @@
 //#include "evaluator/evaluator.hpp"
 //#include "objects/environment.hpp"
 #include "compiler/symbol_table.hpp"
+#include "compiler/folding.hpp"
 #include "objects/builtins.hpp"
 
 namespace compiler
 {
+    // 模块缓存见 compiler/module.hpp
+    struct ModuleCache;
+    inline std::shared_ptr<ModuleCache> DefaultModuleCache();
+    inline std::shared_ptr<objects::Module> LoadModule(std::shared_ptr<ModuleCache> cache, const std::string &path, std::string &error);
+    inline std::shared_ptr<objects::Module> LinkModule(std::shared_ptr<objects::Module> module, const int &constBase, const std::vector<int> &globalMap, std::vector<std::shared_ptr<objects::Object>> &constants);
+
     struct ByteCode {
         bytecode::Instructions Instructions;
         std::vector<std::shared_ptr<objects::Object>> Constants;
@@ -40,6 +48,8 @@ namespace compiler
         bytecode::Instructions instructions;
         EmittedInstruction lastInstruction;
         EmittedInstruction prevInstruction;
+        bool pure = true; // 函数体中没有出现可能有副作用的调用
+        std::set<int> globalReads; // 函数体中读取的全局变量, 这些变量被重新赋值时函数不再是纯函数
     };
 
     struct Compiler
@@ -50,6 +60,15 @@ namespace compiler
         std::vector<std::shared_ptr<CompilationScope>> scopes;
         int scopeIndex;
 
+        std::set<int> pureGlobals; // 绑定到纯函数的全局变量下标
+        std::set<int> assignedGlobals; // 被重新赋值过的全局变量
+        std::map<int, std::vector<std::shared_ptr<objects::CompiledFunction>>> globalReaders; // 全局变量 -> 读取它的函数
+        std::map<int, std::shared_ptr<objects::CompiledFunction>> pureBindings; // 纯全局变量 -> 定义时绑定的函数
+
+        std::shared_ptr<ModuleCache> modules; // 为空时使用进程共享的模块缓存
+        std::string moduleDir;                // 编译模块时为模块所在目录, import的相对路径相对于它
+        std::map<std::string, int> linked;    // 已经链接进来的模块(包括间接导入的): 路径 -> 常量下标
+
         Compiler(){
             symbolTable = compiler::NewSymbolTable();
 
@@ -99,6 +118,40 @@ namespace compiler
             {
                 std::shared_ptr<ast::InfixExpression> infixObj = std::dynamic_pointer_cast<ast::InfixExpression>(node);
 
+                // 短路: 左边已能决定结果时跳过右边, 结果统一为true/false
+                // a && b => a; OpJumpNotTruthy F; b; OpJumpNotTruthy F; OpTrue; OpJump E; F: OpFalse; E:
+                // a || b => a; OpJumpTruthy T; b; OpJumpTruthy T; OpFalse; OpJump E; T: OpTrue; E:
+                if (infixObj->Operator == "&&" || infixObj->Operator == "||")
+                {
+                    auto isAnd = (infixObj->Operator == "&&");
+                    auto jumpOp = (isAnd ? bytecode::OpcodeType::OpJumpNotTruthy : bytecode::OpcodeType::OpJumpTruthy);
+
+                    auto resultObj = Compile(infixObj->pLeft);
+                    if (objects::isError(resultObj))
+                    {
+                        return resultObj;
+                    }
+                    auto leftJumpPos = emit(jumpOp, {9999});
+
+                    resultObj = Compile(infixObj->pRight);
+                    if (objects::isError(resultObj))
+                    {
+                        return resultObj;
+                    }
+                    auto rightJumpPos = emit(jumpOp, {9999});
+
+                    emit(isAnd ? bytecode::OpcodeType::OpTrue : bytecode::OpcodeType::OpFalse);
+                    auto jumpPos = emit(bytecode::OpcodeType::OpJump, {9999});
+
+                    auto shortCircuitPos = scopes[scopeIndex]->instructions.size();
+                    changeOperand(leftJumpPos, shortCircuitPos);
+                    changeOperand(rightJumpPos, shortCircuitPos);
+                    emit(isAnd ? bytecode::OpcodeType::OpFalse : bytecode::OpcodeType::OpTrue);
+
+                    changeOperand(jumpPos, scopes[scopeIndex]->instructions.size());
+                    return nullptr;
+                }
+
                 if (infixObj->Operator == "<")
                 {
                     auto resultObj = Compile(infixObj->pRight);
@@ -207,6 +260,10 @@ namespace compiler
                 {
                     removeLastPop();
                 }
+                else if(!leavesValue(ifObj->pConsequence))
+                {
+                    emit(bytecode::OpcodeType::OpNull, {});
+                }
 
                 auto jumpPos = emit(bytecode::OpcodeType::OpJump, {9999});
 
@@ -229,11 +286,19 @@ namespace compiler
                     {
                         removeLastPop();
                     }
+                    else if(!leavesValue(ifObj->pAlternative))
+                    {
+                        emit(bytecode::OpcodeType::OpNull, {});
+                    }
                 }
 
                 afterConsequencePos = scopes[scopeIndex]->instructions.size();
                 changeOperand(jumpPos, afterConsequencePos);
             }
+            else if(node->GetNodeType() == ast::NodeType::MatchExpression)
+            {
+                return compileMatch(std::dynamic_pointer_cast<ast::MatchExpression>(node));
+            }
             else if(node->GetNodeType() == ast::NodeType::LetStatement)
             {
                 std::shared_ptr<ast::LetStatement> letObj = std::dynamic_pointer_cast<ast::LetStatement>(node);
@@ -250,6 +315,119 @@ namespace compiler
 
                 if(symbol->Scope == compiler::SymbolScopeType::GlobalScope)
                 {
+                    if(letObj->pValue->GetNodeType() == ast::NodeType::FunctionLiteral)
+                    {
+                        auto fn = std::dynamic_pointer_cast<objects::CompiledFunction>(constants.back());
+                        if(fn != nullptr && fn->Pure)
+                        {
+                            pureGlobals.insert(symbol->Index);
+                            pureBindings[symbol->Index] = fn;
+                        }
+                    }
+
+                    emit(bytecode::OpcodeType::OpSetGlobal, {symbol->Index});
+                } else {
+                    emit(bytecode::OpcodeType::OpSetLocal, {symbol->Index});
+                }
+            }
+            else if(node->GetNodeType() == ast::NodeType::WhileStatement)
+            {
+                std::shared_ptr<ast::WhileStatement> whileObj = std::dynamic_pointer_cast<ast::WhileStatement>(node);
+
+                int loopStart = scopes[scopeIndex]->instructions.size();
+                auto resultObj = Compile(whileObj->pCondition);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                auto jumpNotTruthyPos = emit(bytecode::OpcodeType::OpJumpNotTruthy, {9999});
+
+                // 循环体的每条表达式语句自己弹出结果, 循环不留下值
+                resultObj = Compile(whileObj->pBody);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                // 回边: 虚拟机在这里给热循环计数
+                emit(bytecode::OpcodeType::OpJump, {loopStart});
+
+                changeOperand(jumpNotTruthyPos, scopes[scopeIndex]->instructions.size());
+            }
+            else if(node->GetNodeType() == ast::NodeType::ForStatement)
+            {
+                std::shared_ptr<ast::ForStatement> forObj = std::dynamic_pointer_cast<ast::ForStatement>(node);
+
+                auto resultObj = Compile(forObj->pStart);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                resultObj = Compile(forObj->pEnd);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                emit(bytecode::OpcodeType::OpForPrep);
+
+                // 循环变量在区间求值之后定义; 先置为null, 区间为空时循环之后读到null
+                auto symbol = symbolTable->Define(forObj->pVariable->Value);
+                if(symbol->Scope == compiler::SymbolScopeType::GlobalScope)
+                {
+                    assignedGlobals.insert(symbol->Index);
+                }
+                emit(bytecode::OpcodeType::OpNull);
+                emitStore(symbol);
+
+                int loopStart = scopes[scopeIndex]->instructions.size();
+                auto forIterPos = emit(bytecode::OpcodeType::OpForIter, {9999});
+                emitStore(symbol);
+
+                resultObj = Compile(forObj->pBody);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                emit(bytecode::OpcodeType::OpJump, {loopStart});
+
+                changeOperand(forIterPos, scopes[scopeIndex]->instructions.size());
+            }
+            else if(node->GetNodeType() == ast::NodeType::AssignStatement)
+            {
+                std::shared_ptr<ast::AssignStatement> assignObj = std::dynamic_pointer_cast<ast::AssignStatement>(node);
+
+                auto name = assignObj->pName->Value;
+                auto symbol = symbolTable->Resolve(name);
+                if(symbol == nullptr)
+                {
+                    return objects::newError("undefined variable " + name);
+                }
+                if(symbol->Scope == compiler::SymbolScopeType::FreeScope)
+                {
+                    return objects::newError("can not assign to captured variable " + name);
+                }
+                if(symbol->Scope != compiler::SymbolScopeType::GlobalScope && symbol->Scope != compiler::SymbolScopeType::LocalScope)
+                {
+                    return objects::newError("can not assign to " + name);
+                }
+
+                auto resultObj = Compile(assignObj->pValue);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                if(symbol->Scope == compiler::SymbolScopeType::GlobalScope)
+                {
+                    // 写全局变量是副作用; 之前读取它的函数的结果不再只取决于参数
+                    scopes[scopeIndex]->pure = false;
+                    assignedGlobals.insert(symbol->Index);
+                    invalidateGlobal(symbol->Index);
+
                     emit(bytecode::OpcodeType::OpSetGlobal, {symbol->Index});
                 } else {
                     emit(bytecode::OpcodeType::OpSetLocal, {symbol->Index});
@@ -351,6 +529,33 @@ namespace compiler
 
                 emit(bytecode::OpcodeType::OpIndex);
             }
+            else if(node->GetNodeType() == ast::NodeType::SliceExpression)
+            {
+                std::shared_ptr<ast::SliceExpression> sliceObj = std::dynamic_pointer_cast<ast::SliceExpression>(node);
+
+                auto resultObj = Compile(sliceObj->Left);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                for(auto &bound: {sliceObj->pStart, sliceObj->pEnd})
+                {
+                    if(bound == nullptr)
+                    {
+                        emit(bytecode::OpcodeType::OpNull);
+                        continue;
+                    }
+
+                    resultObj = Compile(bound);
+                    if (objects::isError(resultObj))
+                    {
+                        return resultObj;
+                    }
+                }
+
+                emit(bytecode::OpcodeType::OpSlice);
+            }
             else if(node->GetNodeType() == ast::NodeType::FunctionLiteral)
             {
                 std::shared_ptr<ast::FunctionLiteral> funcObj = std::dynamic_pointer_cast<ast::FunctionLiteral>(node);
@@ -386,6 +591,8 @@ namespace compiler
                 auto freeSymbols = symbolTable->FreeSymbols;
                 auto numLocals = symbolTable->numDefinitions;
                 auto numParameters = funcObj->v_pParameters.size();
+                auto pure = scopes[scopeIndex]->pure;
+                auto globalReads = scopes[scopeIndex]->globalReads;
                 auto ins = leaveScope();
 
                 for(auto &sym: freeSymbols)
@@ -394,6 +601,11 @@ namespace compiler
                 }
 
                 auto compiledFn = std::make_shared<objects::CompiledFunction>(ins, numLocals, numParameters);
+                compiledFn->Pure = pure;
+                for(auto &index: globalReads)
+                {
+                    globalReaders[index].push_back(compiledFn);
+                }
                 auto pos = addConstant(compiledFn);
 
                 //emit(bytecode::OpcodeType::OpConstant, {pos});
@@ -415,6 +627,22 @@ namespace compiler
             {
                 std::shared_ptr<ast::CallExpression> callObj = std::dynamic_pointer_cast<ast::CallExpression>(node);
 
+                if(isImport(callObj))
+                {
+                    return compileImport(callObj);
+                }
+
+                if(auto folded = compiler::FoldBuiltinCall(callObj, symbolTable); folded != nullptr)
+                {
+                    emitObject(folded);
+                    return nullptr;
+                }
+
+                if(!isPureCallee(callObj->pFunction))
+                {
+                    scopes[scopeIndex]->pure = false;
+                }
+
                 auto resultObj = Compile(callObj->pFunction);
                 if (objects::isError(resultObj))
                 {
@@ -458,10 +686,169 @@ namespace compiler
             return emit(op, {});
         }
 
+        // 编译期得到的值: true/false/null使用专用指令, 其它对象放入常量池
+        void emitObject(std::shared_ptr<objects::Object> obj)
+        {
+            if(obj == objects::NULL_OBJ)
+            {
+                emit(bytecode::OpcodeType::OpNull);
+            }
+            else if(obj->Type() == objects::ObjectType::BOOLEAN)
+            {
+                if(std::dynamic_pointer_cast<objects::Boolean>(obj)->Value)
+                {
+                    emit(bytecode::OpcodeType::OpTrue);
+                } else {
+                    emit(bytecode::OpcodeType::OpFalse);
+                }
+            }
+            else
+            {
+                auto pos = addConstant(obj);
+                emit(bytecode::OpcodeType::OpConstant, {pos});
+            }
+        }
+
+        // 被匹配的值; OpJumpTable/OpJumpMap; 每个表项一条OpJump加上默认分支的OpJump; 各分支代码(结尾跳到出口); 默认分支代码
+        // 整数分支的取值范围不超过分支数的两倍时用按下标跳转的OpJumpTable, 否则用按哈希查找的OpJumpMap
+        std::shared_ptr<objects::Error> compileMatch(std::shared_ptr<ast::MatchExpression> matchObj)
+        {
+            auto resultObj = Compile(matchObj->pSubject);
+            if (objects::isError(resultObj))
+            {
+                return resultObj;
+            }
+
+            std::vector<std::shared_ptr<objects::Object>> keys;
+            std::vector<std::shared_ptr<ast::Expression>> bodies;
+            std::shared_ptr<ast::Expression> defaultBody = nullptr;
+            bool allIntegers = true;
+            int64_t lo = 0, hi = 0;
+            for(auto &arm : matchObj->Arms)
+            {
+                if(arm.pPattern == nullptr)
+                {
+                    defaultBody = arm.pBody;
+                    continue;
+                }
+
+                std::shared_ptr<objects::Object> key;
+                if(arm.pPattern->GetNodeType() == ast::NodeType::IntegerLiteral)
+                {
+                    auto value = std::static_pointer_cast<ast::IntegerLiteral>(arm.pPattern)->Value;
+                    lo = (keys.empty() || value < lo ? value : lo);
+                    hi = (keys.empty() || value > hi ? value : hi);
+                    key = std::make_shared<objects::Integer>(value);
+                }
+                else
+                {
+                    allIntegers = false;
+                    key = std::make_shared<objects::String>(std::static_pointer_cast<ast::StringLiteral>(arm.pPattern)->Value);
+                }
+
+                keys.push_back(key);
+                bodies.push_back(arm.pBody);
+            }
+
+            int cases = keys.size();
+            // 取值范围按无符号数计算, 两端相距超过INT64_MAX时也不会溢出
+            uint64_t span = static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo);
+            bool dense = (cases > 0 && allIntegers && span < 2 * static_cast<uint64_t>(cases));
+
+            // 表项k跳到第slots[k]个分支, -1表示默认分支
+            std::vector<int> slots;
+            if(dense)
+            {
+                slots.assign(span + 1, -1);
+                for(int k = 0; k < cases; k++)
+                {
+                    slots[static_cast<uint64_t>(std::static_pointer_cast<objects::Integer>(keys[k])->Value) - static_cast<uint64_t>(lo)] = k;
+                }
+                emit(bytecode::OpcodeType::OpJumpTable, {addConstant(std::make_shared<objects::Integer>(lo)), static_cast<int>(slots.size())});
+            }
+            else
+            {
+                std::map<objects::HashKey, std::shared_ptr<objects::HashPair>> pairs;
+                for(int k = 0; k < cases; k++)
+                {
+                    pairs[keys[k]->GetHashKey()] = std::make_shared<objects::HashPair>(keys[k], std::make_shared<objects::Integer>(k));
+                    slots.push_back(k);
+                }
+                emit(bytecode::OpcodeType::OpJumpMap, {addConstant(std::make_shared<objects::Hash>(pairs)), cases});
+            }
+
+            if(slots.size() > 0xFFFF)
+            {
+                return objects::newError("too many match arms");
+            }
+
+            std::vector<int> entries;
+            for(unsigned long k = 0; k <= slots.size(); k++)
+            {
+                entries.push_back(emit(bytecode::OpcodeType::OpJump, {9999}));
+            }
+
+            std::vector<int> starts, exits;
+            for(auto &body : bodies)
+            {
+                starts.push_back(scopes[scopeIndex]->instructions.size());
+                resultObj = Compile(body);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+                exits.push_back(emit(bytecode::OpcodeType::OpJump, {9999}));
+            }
+
+            int defaultPos = scopes[scopeIndex]->instructions.size();
+            if(defaultBody == nullptr)
+            {
+                emit(bytecode::OpcodeType::OpNull, {});
+            }
+            else
+            {
+                resultObj = Compile(defaultBody);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+            }
+
+            for(unsigned long k = 0; k < slots.size(); k++)
+            {
+                changeOperand(entries[k], slots[k] < 0 ? defaultPos : starts[slots[k]]);
+            }
+            changeOperand(entries.back(), defaultPos);
+
+            for(auto &pos : exits)
+            {
+                changeOperand(pos, scopes[scopeIndex]->instructions.size());
+            }
+            return nullptr;
+        }
+
+        void emitStore(std::shared_ptr<compiler::Symbol> symbol)
+        {
+            if(symbol->Scope == compiler::SymbolScopeType::GlobalScope)
+            {
+                emit(bytecode::OpcodeType::OpSetGlobal, {symbol->Index});
+            } else {
+                emit(bytecode::OpcodeType::OpSetLocal, {symbol->Index});
+            }
+        }
+
         void loadSymbol(std::shared_ptr<compiler::Symbol> symbol)
         {
             if (symbol->Scope == compiler::SymbolScopeType::GlobalScope)
             {
+                if(scopeIndex > 0)
+                {
+                    scopes[scopeIndex]->globalReads.insert(symbol->Index);
+                    if(assignedGlobals.count(symbol->Index) > 0)
+                    {
+                        scopes[scopeIndex]->pure = false;
+                    }
+                }
                 emit(bytecode::OpcodeType::OpGetGlobal, {symbol->Index});
             }
             else if(symbol->Scope == compiler::SymbolScopeType::LocalScope)
@@ -470,6 +857,10 @@ namespace compiler
             }
             else if(symbol->Scope == compiler::SymbolScopeType::BuiltinScope)
             {
+                if(!objects::Builtins[symbol->Index]->Pure)
+                {
+                    scopes[scopeIndex]->pure = false;
+                }
                 emit(bytecode::OpcodeType::OpGetBuiltin, {symbol->Index});
             }
             else if(symbol->Scope == compiler::SymbolScopeType::FreeScope)
@@ -482,6 +873,208 @@ namespace compiler
             }
         }
 
+        // import 不是内置函数, 没有被用户定义覆盖时由编译器处理
+        bool isImport(std::shared_ptr<ast::CallExpression> callObj)
+        {
+            if(callObj->pFunction->GetNodeType() != ast::NodeType::Identifier)
+            {
+                return false;
+            }
+
+            auto name = std::dynamic_pointer_cast<ast::Identifier>(callObj->pFunction)->Value;
+            return (name == "import" && symbolTable->Resolve(name) == nullptr);
+        }
+
+        // import("path"): 编译期从模块缓存取得模块并链接进当前程序: 模块的常量追加到常量池, 全局变量分配在当前全局变量之后,
+        // 导出的名字直接成为当前程序的全局变量, 调用导入的函数和调用本地全局函数一样是OpGetGlobal.
+        // 运行时OpImport执行模块的顶层代码(每个运行时一次), 表达式的值是 导出名 -> 值 的哈希表
+        std::shared_ptr<objects::Error> compileImport(std::shared_ptr<ast::CallExpression> callObj)
+        {
+            if(scopeIndex != 0 || symbolTable->Outer != nullptr)
+            {
+                return objects::newError("import is only allowed at the top level");
+            }
+
+            if(callObj->pArguments.size() != 1 || callObj->pArguments[0]->GetNodeType() != ast::NodeType::StringLiteral)
+            {
+                return objects::newError("import path must be a string literal");
+            }
+
+            auto path = std::dynamic_pointer_cast<ast::StringLiteral>(callObj->pArguments[0])->Value;
+            auto resolved = path;
+            if(!moduleDir.empty() && !path.empty() && path[0] != '/')
+            {
+                resolved = moduleDir + "/" + path;
+            }
+
+            std::string error;
+            auto cached = compiler::LoadModule(modules != nullptr ? modules : compiler::DefaultModuleCache(), resolved, error);
+            if(cached == nullptr)
+            {
+                return objects::newError("import " + path + ": " + error);
+            }
+
+            // 同一个模块只链接一次, 再次导入时复用已经分配的全局变量
+            auto module = linkedModule(cached->Path, cached);
+            int constIndex = (module == nullptr ? -1 : linked[cached->Path]);
+            if(module == nullptr)
+            {
+                int globalBase = symbolTable->numDefinitions;
+                std::vector<int> globalMap(cached->NumGlobals);
+                for(int i = 0; i < cached->NumGlobals; i++)
+                {
+                    globalMap[i] = globalBase + i;
+                }
+
+                // 间接导入的模块已经链接进来时(菱形依赖)共用同一份全局变量, 只初始化一次
+                for(auto &obj : cached->Constants)
+                {
+                    if(obj->Type() != objects::ObjectType::MODULE)
+                    {
+                        continue;
+                    }
+
+                    auto nested = std::static_pointer_cast<objects::Module>(obj);
+                    if(auto existing = linkedModule(nested->Path, nested); existing != nullptr)
+                    {
+                        for(int i = 0; i < nested->NumGlobals; i++)
+                        {
+                            globalMap[nested->GlobalBase + i] = existing->GlobalBase + i;
+                        }
+                    }
+                }
+
+                symbolTable->numDefinitions += cached->NumGlobals;
+
+                int constBase = constants.size();
+                std::vector<std::shared_ptr<objects::Object>> linkedConstants;
+                module = compiler::LinkModule(cached, constBase, globalMap, linkedConstants);
+                module->GlobalBase = globalBase;
+
+                for(unsigned long i = 0; i < linkedConstants.size(); i++)
+                {
+                    if(linkedConstants[i]->Type() == objects::ObjectType::MODULE)
+                    {
+                        auto nested = std::static_pointer_cast<objects::Module>(linkedConstants[i]);
+                        if(auto existing = linkedModule(nested->Path, nested); existing != nullptr)
+                        {
+                            linkedConstants[i] = existing;
+                        }
+                        else
+                        {
+                            linked[nested->Path] = constBase + i;
+                        }
+                    }
+                    constants.push_back(linkedConstants[i]);
+                }
+
+                constIndex = addConstant(module);
+                linked[module->Path] = constIndex;
+            }
+
+            for(unsigned long i = 0; i < module->Exports.size(); i++)
+            {
+                auto &[name, index] = module->Exports[i];
+                auto symbol = std::make_shared<compiler::Symbol>(name, compiler::SymbolScopeType::GlobalScope, module->GlobalBase + index);
+                symbolTable->store[name] = symbol;
+                if(module->PureExports.count(i) > 0)
+                {
+                    pureGlobals.insert(symbol->Index);
+                }
+                else
+                {
+                    pureGlobals.erase(symbol->Index);
+                }
+            }
+
+            scopes[scopeIndex]->pure = false;
+            emit(bytecode::OpcodeType::OpImport, {constIndex});
+            return nullptr;
+        }
+
+        // path对应的模块已经链接进来, 并且和module来自同一次编译时返回链接后的模块
+        std::shared_ptr<objects::Module> linkedModule(const std::string &path, std::shared_ptr<objects::Module> module)
+        {
+            auto fit = linked.find(path);
+            if(fit == linked.end())
+            {
+                return nullptr;
+            }
+
+            auto existing = std::static_pointer_cast<objects::Module>(constants[fit->second]);
+            if(existing->MTime != module->MTime || existing->NumGlobals != module->NumGlobals)
+            {
+                return nullptr;
+            }
+            return existing;
+        }
+
+        // 被重新赋值的全局变量: 读取它的函数不再是纯函数, 这些函数绑定的全局变量也随之失效
+        void invalidateGlobal(const int &index)
+        {
+            pureGlobals.erase(index);
+
+            auto readers = globalReaders[index];
+            for(auto &fn: readers)
+            {
+                if(!fn->Pure)
+                {
+                    continue;
+                }
+
+                fn->Pure = false;
+                for(auto &[global, bound]: pureBindings)
+                {
+                    if(bound == fn)
+                    {
+                        invalidateGlobal(global);
+                    }
+                }
+            }
+        }
+
+        // if的分支以let/赋值/循环语句结束(或为空)时没有值, 需要补一个null
+        bool leavesValue(std::shared_ptr<ast::BlockStatement> block)
+        {
+            if(block->v_pStatements.empty())
+            {
+                return false;
+            }
+
+            auto last = block->v_pStatements.back()->GetNodeType();
+            return (last == ast::NodeType::ExpressionStatement || last == ast::NodeType::ReturnStatement);
+        }
+
+        // 只有调用自身、纯内置函数或绑定到纯函数的全局变量时才能确定被调用者没有副作用
+        bool isPureCallee(std::shared_ptr<ast::Expression> callee)
+        {
+            if(callee->GetNodeType() != ast::NodeType::Identifier)
+            {
+                return false;
+            }
+
+            auto symbol = symbolTable->Resolve(std::dynamic_pointer_cast<ast::Identifier>(callee)->Value);
+            if(symbol == nullptr)
+            {
+                return false;
+            }
+
+            if(symbol->Scope == compiler::SymbolScopeType::FunctionScope)
+            {
+                return true;
+            }
+            else if(symbol->Scope == compiler::SymbolScopeType::BuiltinScope)
+            {
+                return objects::Builtins[symbol->Index]->Pure;
+            }
+            else if(symbol->Scope == compiler::SymbolScopeType::GlobalScope)
+            {
+                return (pureGlobals.count(symbol->Index) > 0);
+            }
+
+            return false;
+        }
+
         int addInstruction(bytecode::Instructions ins)
         {
             auto instructions = currentInstructions();
@@ -579,7 +1172,7 @@ namespace compiler
         }
     };
 
-    std::shared_ptr<Compiler> New()
+    inline std::shared_ptr<Compiler> New()
     {
         auto symbolTable = NewSymbolTable();
 
@@ -596,14 +1189,25 @@ namespace compiler
         return compiler;
     }
 
-    std::shared_ptr<Compiler> NewWithState(std::shared_ptr<compiler::SymbolTable> symbolTable,
+    inline std::shared_ptr<Compiler> NewWithState(std::shared_ptr<compiler::SymbolTable> symbolTable,
                                            std::vector<std::shared_ptr<objects::Object>>& constants)
     {
         std::shared_ptr<Compiler> compiler = New();
         compiler->symbolTable = symbolTable;
         compiler->constants = constants;
+
+        // 沿用的常量池中已经链接过的模块
+        for(unsigned long i = 0; i < constants.size(); i++)
+        {
+            if(constants[i]->Type() == objects::ObjectType::MODULE)
+            {
+                compiler->linked[std::static_pointer_cast<objects::Module>(constants[i])->Path] = i;
+            }
+        }
         return compiler;
     }
 }
 
+#include "compiler/module.hpp"
+
 #endif // H_COMPILER_H
\ No newline at end of file
@@ -0,0 +1,113 @@
+#ifndef H_FOLDING_H
+#define H_FOLDING_H
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <memory>
+
+#include "ast/ast.hpp"
+#include "objects/objects.hpp"
+#include "compiler/symbol_table.hpp"
+#include "objects/builtins.hpp"
+
+namespace compiler
+{
+    std::shared_ptr<objects::Object> FoldBuiltinCall(std::shared_ptr<ast::CallExpression> callObj, std::shared_ptr<compiler::SymbolTable> symbolTable);
+
+    // 字面量表达式(整数/字符串/布尔值/负整数/元素都是字面量的数组/可折叠的内置函数调用)直接转换为对象, 否则返回nullptr
+    inline std::shared_ptr<objects::Object> LiteralValue(std::shared_ptr<ast::Expression> node, std::shared_ptr<compiler::SymbolTable> symbolTable)
+    {
+        if(node->GetNodeType() == ast::NodeType::IntegerLiteral)
+        {
+            return std::make_shared<objects::Integer>(std::dynamic_pointer_cast<ast::IntegerLiteral>(node)->Value);
+        }
+        else if(node->GetNodeType() == ast::NodeType::StringLiteral)
+        {
+            return std::make_shared<objects::String>(std::dynamic_pointer_cast<ast::StringLiteral>(node)->Value);
+        }
+        else if(node->GetNodeType() == ast::NodeType::Boolean)
+        {
+            return objects::nativeBoolToBooleanObject(std::dynamic_pointer_cast<ast::Boolean>(node)->Value);
+        }
+        else if(node->GetNodeType() == ast::NodeType::PrefixExpression)
+        {
+            std::shared_ptr<ast::PrefixExpression> prefixObj = std::dynamic_pointer_cast<ast::PrefixExpression>(node);
+            if(prefixObj->Operator == "-" && prefixObj->pRight->GetNodeType() == ast::NodeType::IntegerLiteral)
+            {
+                return std::make_shared<objects::Integer>(-std::dynamic_pointer_cast<ast::IntegerLiteral>(prefixObj->pRight)->Value);
+            }
+        }
+        else if(node->GetNodeType() == ast::NodeType::ArrayLiteral)
+        {
+            std::vector<std::shared_ptr<objects::Object>> elements;
+            for(auto &element: std::dynamic_pointer_cast<ast::ArrayLiteral>(node)->Elements)
+            {
+                auto value = LiteralValue(element, symbolTable);
+                if(value == nullptr)
+                {
+                    return nullptr;
+                }
+                elements.push_back(value);
+            }
+            if(auto packed = objects::PackIntegers(elements); packed != nullptr)
+            {
+                return packed;
+            }
+            return std::make_shared<objects::Array>(elements);
+        }
+        else if(node->GetNodeType() == ast::NodeType::CallExpression)
+        {
+            return FoldBuiltinCall(std::dynamic_pointer_cast<ast::CallExpression>(node), symbolTable);
+        }
+
+        return nullptr;
+    }
+
+    // 参数都是字面量的可折叠内置函数调用在编译期求值, 返回null时为NULL_OBJ;
+    // 不能折叠或者求值出错时返回nullptr, 照常编译为运行时调用
+    inline std::shared_ptr<objects::Object> FoldBuiltinCall(std::shared_ptr<ast::CallExpression> callObj, std::shared_ptr<compiler::SymbolTable> symbolTable)
+    {
+        if(callObj->pFunction->GetNodeType() != ast::NodeType::Identifier)
+        {
+            return nullptr;
+        }
+
+        auto symbol = symbolTable->Resolve(std::dynamic_pointer_cast<ast::Identifier>(callObj->pFunction)->Value);
+        if(symbol == nullptr || symbol->Scope != compiler::SymbolScopeType::BuiltinScope)
+        {
+            return nullptr;
+        }
+
+        auto &definition = objects::Builtins[symbol->Index];
+        if(!definition->Foldable)
+        {
+            return nullptr;
+        }
+
+        std::vector<std::shared_ptr<objects::Object>> args;
+        for(auto &arg: callObj->pArguments)
+        {
+            auto value = LiteralValue(arg, symbolTable);
+            if(value == nullptr)
+            {
+                return nullptr;
+            }
+            args.push_back(value);
+        }
+
+        auto result = definition->Builtin->Call(args);
+        if(result == nullptr)
+        {
+            return objects::NULL_OBJ;
+        }
+        else if(objects::isError(result))
+        {
+            return nullptr;
+        }
+
+        return result;
+    }
+}
+
+#endif // H_FOLDING_H
@@ -0,0 +1,427 @@
+#ifndef H_LINK_H
+#define H_LINK_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <algorithm>
+
+#include "code/code.hpp"
+#include "objects/objects.hpp"
+#include "compiler/compiler.hpp"
+
+namespace compiler
+{
+    // 链接时逐条解码的指令; 跳转目标记为目标指令的标签, 增删指令后重新编码时再换算成偏移
+    struct LinkInstruction
+    {
+        bytecode::OpcodeType Op = bytecode::OpcodeType::OpNull;
+        std::vector<int> Operands;
+        int Label = 0;
+        int Target = -1;     // 跳转指令的目标标签
+        bool Marker = false; // 只占位置不占字节: 指令序列的末尾, 或被替换掉的指令留下的标签
+    };
+
+    // 链接结果: 一份只包含可达函数/常量的字节码, 全局变量和常量池都重新紧凑编号
+    struct LinkedProgram
+    {
+        std::shared_ptr<ByteCode> Bytecode;
+        int NumGlobals = 0;
+        std::map<std::string, int> Globals; // 保留下来的全局变量名 -> 新下标
+        int RemovedConstants = 0;
+        int RemovedGlobals = 0;
+    };
+
+    inline bool isJump(const bytecode::OpcodeType &op)
+    {
+        return (op == bytecode::OpcodeType::OpJump || op == bytecode::OpcodeType::OpJumpNotTruthy || op == bytecode::OpcodeType::OpForIter ||
+                op == bytecode::OpcodeType::OpJumpTruthy);
+    }
+
+    struct Linker
+    {
+        std::vector<std::shared_ptr<objects::Object>> constants;
+        int numGlobals = 0;
+        int pinnedGlobals = 0; // 下标小于它的全局变量由宿主读写, 保持原位
+
+        int nextLabel = 0;
+        std::set<objects::Module *> inlined;
+
+        std::set<int> liveConstants;
+        std::set<int> readGlobals;
+        std::set<int> usedGlobals;
+        std::map<int, std::vector<int>> definitions; // 全局变量 -> 定义它的位置(OpConstant/OpClosure + OpSetGlobal)
+        std::vector<LinkInstruction> *program = nullptr;
+
+        std::vector<LinkInstruction> decode(bytecode::Instructions &ins)
+        {
+            std::vector<LinkInstruction> result;
+            std::map<int, int> labels;
+
+            int ip = 0, size = ins.size();
+            while(ip < size)
+            {
+                auto def = bytecode::Lookup(static_cast<bytecode::OpcodeType>(ins[ip]));
+                auto operands = bytecode::ReadOperands(def, ins, ip + 1);
+
+                LinkInstruction inst;
+                inst.Op = static_cast<bytecode::OpcodeType>(ins[ip]);
+                inst.Operands = operands.first;
+                inst.Label = nextLabel++;
+                labels[ip] = inst.Label;
+                result.push_back(inst);
+
+                ip += 1 + operands.second;
+            }
+
+            LinkInstruction end;
+            end.Label = nextLabel++;
+            end.Marker = true;
+            labels[size] = end.Label;
+            result.push_back(end);
+
+            for(auto &inst : result)
+            {
+                if(!inst.Marker && isJump(inst.Op))
+                {
+                    inst.Target = labels[inst.Operands[0]];
+                }
+            }
+            return result;
+        }
+
+        bytecode::Instructions encode(const std::vector<LinkInstruction> &list)
+        {
+            std::map<int, int> offsets;
+            int offset = 0;
+            for(auto &inst : list)
+            {
+                offsets[inst.Label] = offset;
+                if(!inst.Marker)
+                {
+                    offset += 1;
+                    for(auto &width : bytecode::Lookup(inst.Op)->OperandWidths)
+                    {
+                        offset += width;
+                    }
+                }
+            }
+
+            bytecode::Instructions result;
+            for(auto &inst : list)
+            {
+                if(inst.Marker)
+                {
+                    continue;
+                }
+
+                auto operands = inst.Operands;
+                if(isJump(inst.Op))
+                {
+                    operands[0] = offsets[inst.Target];
+                }
+
+                auto ins = bytecode::Make(inst.Op, operands);
+                result.insert(result.end(), ins.begin(), ins.end());
+            }
+            return result;
+        }
+
+        LinkInstruction marker(const int &label)
+        {
+            LinkInstruction inst;
+            inst.Label = label;
+            inst.Marker = true;
+            return inst;
+        }
+
+        LinkInstruction instruction(bytecode::OpcodeType op, std::vector<int> operands)
+        {
+            LinkInstruction inst;
+            inst.Op = op;
+            inst.Operands = operands;
+            inst.Label = nextLabel++;
+            return inst;
+        }
+
+        // 把OpImport展开成模块的顶层代码(每个模块只展开第一次), 要用到导入值时就地构造导出表
+        std::shared_ptr<objects::Error> flatten(const std::vector<LinkInstruction> &list, std::vector<LinkInstruction> &out)
+        {
+            std::map<int, int> indexes;
+            for(unsigned long i = 0; i < list.size(); i++)
+            {
+                indexes[list[i].Label] = i;
+            }
+
+            std::vector<int> imports;
+            for(unsigned long i = 0; i < list.size(); i++)
+            {
+                if(!list[i].Marker && list[i].Op == bytecode::OpcodeType::OpImport)
+                {
+                    imports.push_back(i);
+                }
+            }
+
+            // 条件分支或循环里的import不一定执行, 也不一定只执行一次, 不能展开成直线代码
+            for(unsigned long p = 0; p < list.size() && !imports.empty(); p++)
+            {
+                if(list[p].Marker || !isJump(list[p].Op))
+                {
+                    continue;
+                }
+
+                // 向前跳转跳过(p, target)之间的代码, 向后跳转重复执行[target, p)之间的代码
+                int target = indexes[list[p].Target];
+                int lo = (target < static_cast<int>(p) ? target : p + 1);
+                int hi = (target < static_cast<int>(p) ? p : target);
+                auto fit = std::lower_bound(imports.begin(), imports.end(), lo);
+                if(fit != imports.end() && *fit < hi)
+                {
+                    return objects::newError("can not link an import inside a conditional or a loop");
+                }
+            }
+
+            for(unsigned long i = 0; i < list.size(); i++)
+            {
+                if(list[i].Marker || list[i].Op != bytecode::OpcodeType::OpImport)
+                {
+                    out.push_back(list[i]);
+                    continue;
+                }
+
+                out.push_back(marker(list[i].Label));
+
+                auto module = std::static_pointer_cast<objects::Module>(constants[list[i].Operands[0]]);
+                if(inlined.insert(module.get()).second)
+                {
+                    auto body = decode(module->Instructions);
+                    auto err = flatten(body, out);
+                    if(err != nullptr)
+                    {
+                        return err;
+                    }
+                }
+
+                if(i + 1 < list.size() && !list[i + 1].Marker && list[i + 1].Op == bytecode::OpcodeType::OpPop)
+                {
+                    i += 1;
+                    out.push_back(marker(list[i].Label));
+                    continue;
+                }
+
+                for(auto &[name, index] : module->Exports)
+                {
+                    constants.push_back(std::make_shared<objects::String>(name));
+                    out.push_back(instruction(bytecode::OpcodeType::OpConstant, {static_cast<int>(constants.size()) - 1}));
+                    out.push_back(instruction(bytecode::OpcodeType::OpGetGlobal, {module->GlobalBase + index}));
+                }
+                out.push_back(instruction(bytecode::OpcodeType::OpHash, {static_cast<int>(module->Exports.size()) * 2}));
+            }
+            return nullptr;
+        }
+
+        void markConstant(const int &index)
+        {
+            if(!liveConstants.insert(index).second)
+            {
+                return;
+            }
+
+            if(constants[index]->Type() == objects::ObjectType::COMPILED_FUNCTION)
+            {
+                auto fn = std::static_pointer_cast<objects::CompiledFunction>(constants[index]);
+                RemapInstructions(fn->Optimized ? fn->Baseline : fn->Instructions,
+                    [this](int k) { markConstant(k); return k; },
+                    [this](int g) { return markGlobal(g, bytecode::OpcodeType::OpGetGlobal); });
+            }
+        }
+
+        // 函数中的OpSetGlobal保守地当作读取, 以免删掉它写入的变量的定义
+        int markGlobal(const int &index, const bytecode::OpcodeType &op)
+        {
+            usedGlobals.insert(index);
+            if(op == bytecode::OpcodeType::OpGetGlobal && readGlobals.insert(index).second)
+            {
+                for(auto &pos : definitions[index])
+                {
+                    markConstant((*program)[pos].Operands[0]);
+                }
+            }
+            return index;
+        }
+
+        void mark(const LinkInstruction &inst)
+        {
+            switch(inst.Op)
+            {
+                case bytecode::OpcodeType::OpConstant:
+                case bytecode::OpcodeType::OpClosure:
+                case bytecode::OpcodeType::OpJumpTable:
+                case bytecode::OpcodeType::OpJumpMap:
+                    markConstant(inst.Operands[0]);
+                    break;
+                case bytecode::OpcodeType::OpGetGlobal:
+                case bytecode::OpcodeType::OpSetGlobal:
+                    markGlobal(inst.Operands[0], inst.Op);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        std::shared_ptr<objects::Error> Link(std::shared_ptr<Compiler> comp, LinkedProgram &linked)
+        {
+            auto bytecode = comp->Bytecode();
+            constants = bytecode->Constants;
+            numGlobals = comp->symbolTable->numDefinitions;
+
+            std::vector<LinkInstruction> main;
+            auto err = flatten(decode(bytecode->Instructions), main);
+            if(err != nullptr)
+            {
+                return err;
+            }
+            program = &main;
+
+            // 没有副作用的全局定义: let x = <常量或不捕获变量的函数>; 位于跳转目标上的不处理
+            std::set<int> targets;
+            for(auto &inst : main)
+            {
+                if(!inst.Marker && isJump(inst.Op))
+                {
+                    targets.insert(inst.Target);
+                }
+            }
+
+            std::set<int> sites;
+            for(unsigned long i = 0; i + 1 < main.size(); i++)
+            {
+                auto &inst = main[i], &next = main[i + 1];
+                bool value = (!inst.Marker && (inst.Op == bytecode::OpcodeType::OpConstant || (inst.Op == bytecode::OpcodeType::OpClosure && inst.Operands[1] == 0)));
+                if(value && !next.Marker && next.Op == bytecode::OpcodeType::OpSetGlobal && next.Operands[0] >= pinnedGlobals &&
+                   targets.count(inst.Label) == 0 && targets.count(next.Label) == 0)
+                {
+                    definitions[next.Operands[0]].push_back(i);
+                    sites.insert(i);
+                    i += 1;
+                }
+            }
+
+            for(int g = 0; g < pinnedGlobals; g++)
+            {
+                markGlobal(g, bytecode::OpcodeType::OpGetGlobal);
+            }
+
+            for(unsigned long i = 0; i < main.size(); i++)
+            {
+                if(sites.count(i) > 0)
+                {
+                    i += 1;
+                    continue;
+                }
+
+                if(!main[i].Marker)
+                {
+                    mark(main[i]);
+                }
+            }
+
+            // 紧凑编号: 保留下来的常量和全局变量按原来的顺序重新编号
+            std::map<int, int> constMap, globalMap;
+            for(auto &k : liveConstants)
+            {
+                int next = constMap.size();
+                constMap[k] = next;
+            }
+            for(int g = 0; g < pinnedGlobals; g++)
+            {
+                globalMap[g] = g;
+            }
+            for(auto &g : usedGlobals)
+            {
+                if(g >= pinnedGlobals)
+                {
+                    int next = globalMap.size();
+                    globalMap[g] = next;
+                }
+            }
+
+            std::vector<LinkInstruction> output;
+            for(unsigned long i = 0; i < main.size(); i++)
+            {
+                if(sites.count(i) > 0 && readGlobals.count(main[i + 1].Operands[0]) == 0)
+                {
+                    i += 1;
+                    continue;
+                }
+
+                auto inst = main[i];
+                if(!inst.Marker)
+                {
+                    switch(inst.Op)
+                    {
+                        case bytecode::OpcodeType::OpConstant:
+                        case bytecode::OpcodeType::OpClosure:
+                        case bytecode::OpcodeType::OpJumpTable:
+                        case bytecode::OpcodeType::OpJumpMap:
+                            inst.Operands[0] = constMap[inst.Operands[0]];
+                            break;
+                        case bytecode::OpcodeType::OpGetGlobal:
+                        case bytecode::OpcodeType::OpSetGlobal:
+                            inst.Operands[0] = globalMap[inst.Operands[0]];
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                output.push_back(inst);
+            }
+
+            std::vector<std::shared_ptr<objects::Object>> pool;
+            for(auto &k : liveConstants)
+            {
+                auto obj = constants[k];
+                if(obj->Type() == objects::ObjectType::COMPILED_FUNCTION)
+                {
+                    auto fn = std::static_pointer_cast<objects::CompiledFunction>(obj);
+                    auto ins = RemapInstructions(fn->Optimized ? fn->Baseline : fn->Instructions,
+                        [&](int index) { return constMap[index]; },
+                        [&](int index) { return globalMap[index]; });
+                    auto clone = std::make_shared<objects::CompiledFunction>(ins, fn->NumLocals, fn->NumParameters);
+                    clone->Pure = fn->Pure;
+                    obj = clone;
+                }
+                pool.push_back(obj);
+            }
+
+            auto instructions = encode(output);
+            linked.Bytecode = std::make_shared<ByteCode>(instructions, pool);
+            linked.NumGlobals = globalMap.size();
+            linked.RemovedConstants = constants.size() - pool.size();
+            linked.RemovedGlobals = numGlobals - linked.NumGlobals;
+
+            for(auto &[name, symbol] : comp->symbolTable->store)
+            {
+                if(symbol->Scope == SymbolScopeType::GlobalScope && globalMap.count(symbol->Index) > 0)
+                {
+                    linked.Globals[name] = globalMap[symbol->Index];
+                }
+            }
+            return nullptr;
+        }
+    };
+
+    // 整个程序(包括导入的模块)链接成一份紧凑的字节码: 展开import, 从顶层代码出发沿着常量和全局变量的引用
+    // 找出可达的函数, 删掉没有被读取的全局定义和不可达的常量; pinnedGlobals 个宿主注入的全局变量保持原位
+    inline std::shared_ptr<objects::Error> Link(std::shared_ptr<Compiler> comp, LinkedProgram &linked, const int &pinnedGlobals = 0)
+    {
+        Linker linker;
+        linker.pinnedGlobals = pinnedGlobals;
+        return linker.Link(comp, linked);
+    }
+}
+
+#endif // H_LINK_H
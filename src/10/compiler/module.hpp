@@ -0,0 +1,406 @@
+#ifndef H_MODULE_H
+#define H_MODULE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <functional>
+
+#include <sys/stat.h>
+
+#include "lexer/lexer.hpp"
+#include "parser/parser.hpp"
+#include "objects/objects.hpp"
+#include "objects/serialize.hpp"
+#include "compiler/compiler.hpp"
+
+namespace compiler
+{
+    const std::string ModuleMagic = "MONKEYMOD";
+    const uint32_t ModuleVersion = 1;
+    const std::string ModuleBytecodeSuffix = ".mbc"; // 模块字节码保存在源文件旁边: lib.monkey -> lib.monkey.mbc
+
+    // 编译好的模块, 以 规范化路径 + 源文件修改时间 为键, 可以被多个编译器/线程共享;
+    // 缓存中的模块只作为模板, 导入时链接一份(LinkModule)进导入方
+    struct ModuleCache
+    {
+        std::recursive_mutex mutex; // 编译模块时会递归加载它导入的模块
+        std::map<std::string, std::shared_ptr<objects::Module>> modules;
+        std::set<std::string> loading;
+
+        bool WriteBytecode = false; // 编译后把字节码写到源文件旁边, 供之后的进程直接加载
+        int Compiled = 0;
+        int LoadedBytecode = 0;
+    };
+
+    inline std::shared_ptr<ModuleCache> NewModuleCache()
+    {
+        return std::make_shared<ModuleCache>();
+    }
+
+    inline std::shared_ptr<ModuleCache> DefaultModuleCache()
+    {
+        static std::shared_ptr<ModuleCache> shared = NewModuleCache();
+        return shared;
+    }
+
+    inline int64_t fileMTime(const struct stat &st)
+    {
+        return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    }
+
+    // 按constMap/globalMap改写指令中的常量下标和全局变量下标, 指令长度不变
+    inline bytecode::Instructions RemapInstructions(const bytecode::Instructions &ins, const std::function<int(int)> &constMap, const std::function<int(int)> &globalMap)
+    {
+        auto result = ins;
+        unsigned long ip = 0;
+        while(ip < result.size())
+        {
+            auto op = static_cast<bytecode::OpcodeType>(result[ip]);
+            auto def = bytecode::Lookup(op);
+            if(def == nullptr)
+            {
+                break;
+            }
+
+            uint16_t operand;
+            switch(op)
+            {
+                case bytecode::OpcodeType::OpConstant:
+                case bytecode::OpcodeType::OpClosure:
+                case bytecode::OpcodeType::OpImport:
+                case bytecode::OpcodeType::OpJumpTable:
+                case bytecode::OpcodeType::OpJumpMap:
+                    bytecode::ReadUint16(result, ip + 1, operand);
+                    operand = constMap(operand);
+                    bytecode::WriteUint16(result, ip + 1, operand);
+                    break;
+                case bytecode::OpcodeType::OpGetGlobal:
+                case bytecode::OpcodeType::OpSetGlobal:
+                    bytecode::ReadUint16(result, ip + 1, operand);
+                    operand = globalMap(operand);
+                    bytecode::WriteUint16(result, ip + 1, operand);
+                    break;
+                default:
+                    break;
+            }
+
+            ip += 1;
+            for(auto &width : def->OperandWidths)
+            {
+                ip += width;
+            }
+        }
+        return result;
+    }
+
+    // 模块链接进导入方时: 常量下标加上constBase, 全局变量下标按globalMap改写
+    inline bytecode::Instructions relocateInstructions(const bytecode::Instructions &ins, const int &constBase, const std::vector<int> &globalMap)
+    {
+        return RemapInstructions(ins, [&](int index) { return index + constBase; }, [&](int index) { return globalMap[index]; });
+    }
+
+    inline std::shared_ptr<objects::Module> relocateModule(std::shared_ptr<objects::Module> module, const int &constBase, const std::vector<int> &globalMap)
+    {
+        auto linked = std::make_shared<objects::Module>();
+        linked->Path = module->Path;
+        linked->MTime = module->MTime;
+        linked->Dependencies = module->Dependencies;
+        linked->Instructions = relocateInstructions(module->Instructions, constBase, globalMap);
+        linked->NumGlobals = module->NumGlobals;
+        linked->ConstantBase = module->ConstantBase + constBase;
+        linked->GlobalBase = (module->GlobalBase < static_cast<int>(globalMap.size()) ? globalMap[module->GlobalBase] : module->GlobalBase);
+        linked->Exports = module->Exports;
+        linked->PureExports = module->PureExports;
+        return linked;
+    }
+
+    // 把缓存中的模块链接进导入方: 模块的常量接在导入方常量池的constBase之后, 模块的第i个全局变量映射到globalMap[i].
+    // 返回链接后的模块(只保留顶层代码)和需要追加到导入方常量池的常量; 函数都会复制, 推测优化不会改写缓存中共享的代码
+    inline std::shared_ptr<objects::Module> LinkModule(std::shared_ptr<objects::Module> module, const int &constBase, const std::vector<int> &globalMap, std::vector<std::shared_ptr<objects::Object>> &constants)
+    {
+        for(auto &obj : module->Constants)
+        {
+            if(obj->Type() == objects::ObjectType::MODULE)
+            {
+                constants.push_back(relocateModule(std::static_pointer_cast<objects::Module>(obj), constBase, globalMap));
+            }
+            else if(obj->Type() == objects::ObjectType::COMPILED_FUNCTION)
+            {
+                auto fn = std::static_pointer_cast<objects::CompiledFunction>(obj);
+                auto ins = relocateInstructions(fn->Optimized ? fn->Baseline : fn->Instructions, constBase, globalMap);
+                auto clone = std::make_shared<objects::CompiledFunction>(ins, fn->NumLocals, fn->NumParameters);
+                clone->Pure = fn->Pure;
+                constants.push_back(clone);
+            }
+            else
+            {
+                constants.push_back(obj);
+            }
+        }
+
+        auto linked = relocateModule(module, constBase, globalMap);
+        linked->ConstantBase = constBase;
+        linked->GlobalBase = (globalMap.empty() ? 0 : globalMap[0]);
+        return linked;
+    }
+
+    inline bool SaveModuleBytecode(std::shared_ptr<objects::Module> module, const std::string &path, std::string &error)
+    {
+        objects::ObjectWriter writer;
+
+        std::vector<uint32_t> constants;
+        for (auto &obj : module->Constants)
+        {
+            constants.push_back(writer.Add(obj));
+        }
+
+        if (!writer.Error.empty())
+        {
+            error = writer.Error;
+            return false;
+        }
+
+        writer.Buffer = ModuleMagic;
+        writer.put<uint32_t>(ModuleVersion);
+        writer.putBuiltinTable();
+        writer.put<int64_t>(module->MTime);
+        writer.put<uint32_t>(module->Dependencies.size());
+        for (auto &[dep, depMTime] : module->Dependencies)
+        {
+            writer.putString(dep);
+            writer.put<int64_t>(depMTime);
+        }
+        writer.put<int32_t>(module->NumGlobals);
+
+        writer.put<uint32_t>(module->Exports.size());
+        for (auto &[name, index] : module->Exports)
+        {
+            writer.putString(name);
+            writer.put<int32_t>(index);
+        }
+
+        writer.put<uint32_t>(module->PureExports.size());
+        for (auto &index : module->PureExports)
+        {
+            writer.put<int32_t>(index);
+        }
+
+        writer.putInstructions(module->Instructions);
+        writer.putObjectTable();
+
+        writer.put<uint32_t>(constants.size());
+        for (auto &id : constants)
+        {
+            writer.put<uint32_t>(id);
+        }
+
+        return writer.WriteFile(path, error);
+    }
+
+    // 导入的模块被链接进了module, 它们中任何一个修改后module都需要重新编译
+    inline bool dependenciesChanged(std::shared_ptr<objects::Module> module)
+    {
+        for (auto &[dep, depMTime] : module->Dependencies)
+        {
+            struct stat st;
+            if (stat(dep.c_str(), &st) < 0 || fileMTime(st) != depMTime)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 字节码不存在/过期/损坏时返回nullptr, 调用方回退到编译源码
+    inline std::shared_ptr<objects::Module> loadModuleBytecode(const std::string &path, const int64_t &mtime)
+    {
+        objects::MappedFile file;
+        std::string ignored;
+        if (!file.Open(path + ModuleBytecodeSuffix, ignored))
+        {
+            return nullptr;
+        }
+
+        objects::ObjectReader reader(file.Data, file.Size);
+        if (!reader.expectMagic(ModuleMagic) || reader.get<uint32_t>() != ModuleVersion || !reader.sameBuiltinTable() || reader.get<int64_t>() != mtime)
+        {
+            return nullptr;
+        }
+
+        auto module = std::make_shared<objects::Module>();
+        module->Path = path;
+        module->MTime = mtime;
+
+        auto numDependencies = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < numDependencies && reader.Ok; i++)
+        {
+            auto dep = reader.getString();
+            module->Dependencies.push_back(std::make_pair(dep, reader.get<int64_t>()));
+        }
+
+        if (!reader.Ok || dependenciesChanged(module))
+        {
+            return nullptr;
+        }
+
+        module->NumGlobals = reader.get<int32_t>();
+
+        auto numExports = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < numExports && reader.Ok; i++)
+        {
+            auto name = reader.getString();
+            module->Exports.push_back(std::make_pair(name, reader.get<int32_t>()));
+        }
+
+        auto numPure = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < numPure && reader.Ok; i++)
+        {
+            module->PureExports.insert(reader.get<int32_t>());
+        }
+
+        auto ins = reader.getString();
+        module->Instructions.assign(ins.begin(), ins.end());
+
+        reader.readObjectTable();
+        module->Constants = reader.refs();
+        if (!reader.Ok || reader.Pos != reader.Size)
+        {
+            return nullptr;
+        }
+        return module;
+    }
+
+    inline std::shared_ptr<objects::Module> compileModule(std::shared_ptr<ModuleCache> cache, const std::string &path, const int64_t &mtime, std::string &error)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            error = "can not read " + path;
+            return nullptr;
+        }
+
+        std::stringstream source;
+        source << in.rdbuf();
+
+        auto pParser = parser::New(lexer::New(source.str()));
+        auto pProgram = pParser->ParseProgram();
+
+        auto errors = pParser->Errors();
+        if (errors.size() > 0)
+        {
+            error = "parser errors: " + ast::Join(errors, "; ");
+            return nullptr;
+        }
+
+        std::shared_ptr<ast::Node> astNode(reinterpret_cast<ast::Node *>(pProgram.release()));
+
+        auto comp = compiler::New();
+        comp->modules = cache;
+        comp->moduleDir = path.substr(0, path.find_last_of('/'));
+
+        auto resultObj = comp->Compile(astNode);
+        if (objects::isError(resultObj))
+        {
+            error = resultObj->Message;
+            return nullptr;
+        }
+
+        auto module = std::make_shared<objects::Module>();
+        module->Path = path;
+        module->MTime = mtime;
+        module->Instructions = comp->currentInstructions();
+        module->Constants = comp->constants;
+        module->NumGlobals = comp->symbolTable->numDefinitions;
+
+        for (auto &[dep, index] : comp->linked)
+        {
+            module->Dependencies.push_back(std::make_pair(dep, std::static_pointer_cast<objects::Module>(comp->constants[index])->MTime));
+        }
+
+        // 同名变量重复定义时只导出最后一个
+        for (auto &[name, symbol] : comp->symbolTable->store)
+        {
+            if (symbol->Scope == SymbolScopeType::GlobalScope)
+            {
+                module->Exports.push_back(std::make_pair(name, symbol->Index));
+            }
+        }
+        std::sort(module->Exports.begin(), module->Exports.end(), [](auto &a, auto &b) { return a.second < b.second; });
+
+        for (unsigned long i = 0; i < module->Exports.size(); i++)
+        {
+            if (comp->pureGlobals.count(module->Exports[i].second) > 0)
+            {
+                module->PureExports.insert(i);
+            }
+        }
+        return module;
+    }
+
+    // 取得path对应的已编译模块: 缓存命中且源文件未修改时直接返回, 否则优先加载磁盘上的字节码, 最后才编译源码
+    inline std::shared_ptr<objects::Module> LoadModule(std::shared_ptr<ModuleCache> cache, const std::string &path, std::string &error)
+    {
+        char buffer[PATH_MAX];
+        struct stat st;
+        if (realpath(path.c_str(), buffer) == nullptr || stat(buffer, &st) < 0)
+        {
+            error = "can not find module " + path;
+            return nullptr;
+        }
+
+        std::string canonical(buffer);
+        auto mtime = fileMTime(st);
+
+        std::lock_guard<std::recursive_mutex> lock(cache->mutex);
+        if (auto fit = cache->modules.find(canonical); fit != cache->modules.end() && fit->second->MTime == mtime && !dependenciesChanged(fit->second))
+        {
+            return fit->second;
+        }
+
+        if (cache->loading.count(canonical) > 0)
+        {
+            error = "import cycle at " + canonical;
+            return nullptr;
+        }
+
+        cache->loading.insert(canonical);
+        auto module = loadModuleBytecode(canonical, mtime);
+        if (module != nullptr)
+        {
+            cache->LoadedBytecode += 1;
+        }
+        else
+        {
+            module = compileModule(cache, canonical, mtime, error);
+            if (module != nullptr)
+            {
+                cache->Compiled += 1;
+
+                std::string ignored;
+                if (cache->WriteBytecode)
+                {
+                    SaveModuleBytecode(module, canonical + ModuleBytecodeSuffix, ignored);
+                }
+            }
+        }
+        cache->loading.erase(canonical);
+
+        if (module != nullptr)
+        {
+            cache->modules[canonical] = module;
+        }
+        return module;
+    }
+}
+
+#endif // H_MODULE_H
@@ -0,0 +1,723 @@
+#ifndef H_REGISTER_COMPILER_H
+#define H_REGISTER_COMPILER_H
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+
+#include "ast/ast.hpp"
+#include "objects/objects.hpp"
+#include "code/code.hpp"
+#include "code/register_code.hpp"
+#include "compiler/symbol_table.hpp"
+#include "compiler/folding.hpp"
+#include "objects/builtins.hpp"
+
+namespace compiler
+{
+    // 单个函数帧内最多可用的寄存器数量(寄存器操作数占1个字节)
+    const int MaxRegisters = 256;
+
+    struct RegisterByteCode {
+        bytecode::Instructions Instructions;
+        std::vector<std::shared_ptr<objects::Object>> Constants;
+        int NumRegisters;
+
+        RegisterByteCode(bytecode::Instructions &instructions,
+                         std::vector<std::shared_ptr<objects::Object>> &constants,
+                         const int &numRegisters) : Instructions(instructions),
+                                                    Constants(constants),
+                                                    NumRegisters(numRegisters)
+        {
+        }
+    };
+
+    struct RegisterScope{
+        bytecode::Instructions instructions;
+        std::map<int, int> localRegisters; // 局部变量符号索引 -> 寄存器
+        int freeRegister = 0;  // 下一个空闲的临时寄存器
+        int localsTop = 0;     // 局部变量占用的寄存器上界, 临时寄存器在语句结束后回收到这里
+        int maxRegisters = 0;  // 帧内需要的寄存器数量
+        bytecode::RegisterOpcodeType lastOpcode = bytecode::RegisterOpcodeType::OpResult;
+    };
+
+    struct RegisterCompiler
+    {
+        std::vector<std::shared_ptr<objects::Object>> constants;
+        std::shared_ptr<compiler::SymbolTable> symbolTable;
+
+        std::vector<std::shared_ptr<RegisterScope>> scopes;
+        int scopeIndex;
+
+        RegisterCompiler(){
+            symbolTable = compiler::NewSymbolTable();
+
+            auto mainScope = std::make_shared<RegisterScope>();
+            scopes.push_back(mainScope);
+            scopeIndex = 0;
+        }
+
+        std::shared_ptr<objects::Error> Compile(std::shared_ptr<ast::Node> node)
+        {
+            if(node->GetNodeType() == ast::NodeType::Program)
+            {
+                std::shared_ptr<ast::Program> program = std::dynamic_pointer_cast<ast::Program>(node);
+                for(auto &stmt: program->v_pStatements)
+                {
+                    if(stmt->GetNodeType() == ast::NodeType::ExpressionStatement)
+                    {
+                        std::shared_ptr<ast::ExpressionStatement> exprStmt = std::dynamic_pointer_cast<ast::ExpressionStatement>(stmt);
+
+                        int reg = -1;
+                        auto resultObj = compileExpression(exprStmt->pExpression, reg);
+                        if(objects::isError(resultObj))
+                        {
+                            return resultObj;
+                        }
+                        emit(bytecode::RegisterOpcodeType::OpResult, {reg});
+                    }
+                    else
+                    {
+                        auto resultObj = compileStatement(stmt);
+                        if(objects::isError(resultObj))
+                        {
+                            return resultObj;
+                        }
+                    }
+
+                    releaseTemporaries(0);
+                }
+
+                return nullptr;
+            }
+
+            return compileStatement(node);
+        }
+
+        std::shared_ptr<objects::Error> compileStatement(std::shared_ptr<ast::Node> node)
+        {
+            if(node->GetNodeType() == ast::NodeType::BlockStatement)
+            {
+                std::shared_ptr<ast::BlockStatement> blockObj = std::dynamic_pointer_cast<ast::BlockStatement>(node);
+
+                int base = scopes[scopeIndex]->freeRegister;
+                for(auto &stmt: blockObj->v_pStatements)
+                {
+                    auto resultObj = compileStatement(stmt);
+                    if(objects::isError(resultObj))
+                    {
+                        return resultObj;
+                    }
+                    releaseTemporaries(base);
+                }
+            }
+            else if(node->GetNodeType() == ast::NodeType::ExpressionStatement)
+            {
+                std::shared_ptr<ast::ExpressionStatement> exprStmt = std::dynamic_pointer_cast<ast::ExpressionStatement>(node);
+
+                int reg = -1;
+                return compileExpression(exprStmt->pExpression, reg);
+            }
+            else if(node->GetNodeType() == ast::NodeType::LetStatement)
+            {
+                std::shared_ptr<ast::LetStatement> letObj = std::dynamic_pointer_cast<ast::LetStatement>(node);
+
+                auto symbol = symbolTable->Define(letObj->pName->Value);
+
+                if(symbol->Scope == compiler::SymbolScopeType::GlobalScope)
+                {
+                    int reg = -1;
+                    auto resultObj = compileExpression(letObj->pValue, reg);
+                    if (objects::isError(resultObj))
+                    {
+                        return resultObj;
+                    }
+
+                    emit(bytecode::RegisterOpcodeType::OpSetGlobal, {symbol->Index, reg});
+                }
+                else
+                {
+                    int reg = defineLocal(symbol->Index);
+                    auto resultObj = compileExpression(letObj->pValue, reg);
+                    if (objects::isError(resultObj))
+                    {
+                        return resultObj;
+                    }
+                }
+            }
+            else if(node->GetNodeType() == ast::NodeType::ReturnStatement)
+            {
+                std::shared_ptr<ast::ReturnStatement> returnObj = std::dynamic_pointer_cast<ast::ReturnStatement>(node);
+
+                int reg = -1;
+                auto resultObj = compileExpression(returnObj->pReturnValue, reg);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                emit(bytecode::RegisterOpcodeType::OpReturnValue, {reg});
+            }
+            else
+            {
+                return objects::newError("unsupported statement for register compiler: " + node->String());
+            }
+
+            return registerOverflow();
+        }
+
+        // 编译表达式, target >= 0 时结果必须写入target, 否则由编译器选择寄存器并通过target返回
+        std::shared_ptr<objects::Error> compileExpression(std::shared_ptr<ast::Node> node, int &target)
+        {
+            if(node->GetNodeType() == ast::NodeType::InfixExpression)
+            {
+                std::shared_ptr<ast::InfixExpression> infixObj = std::dynamic_pointer_cast<ast::InfixExpression>(node);
+
+                int left = -1;
+                auto resultObj = compileExpression(infixObj->pLeft, left);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                int right = -1;
+                resultObj = compileExpression(infixObj->pRight, right);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                int dst = destination(target);
+
+                if (infixObj->Operator == "+")
+                {
+                    emit(bytecode::RegisterOpcodeType::OpAdd, {dst, left, right});
+                }
+                else if (infixObj->Operator == "-")
+                {
+                    emit(bytecode::RegisterOpcodeType::OpSub, {dst, left, right});
+                }
+                else if (infixObj->Operator == "*")
+                {
+                    emit(bytecode::RegisterOpcodeType::OpMul, {dst, left, right});
+                }
+                else if (infixObj->Operator == "/")
+                {
+                    emit(bytecode::RegisterOpcodeType::OpDiv, {dst, left, right});
+                }
+                else if (infixObj->Operator == ">")
+                {
+                    emit(bytecode::RegisterOpcodeType::OpGreaterThan, {dst, left, right});
+                }
+                else if (infixObj->Operator == "<")
+                {
+                    emit(bytecode::RegisterOpcodeType::OpGreaterThan, {dst, right, left});
+                }
+                else if (infixObj->Operator == "==")
+                {
+                    emit(bytecode::RegisterOpcodeType::OpEqual, {dst, left, right});
+                }
+                else if (infixObj->Operator == "!=")
+                {
+                    emit(bytecode::RegisterOpcodeType::OpNotEqual, {dst, left, right});
+                }
+                else {
+                    return objects::newError("unknow operator: " + infixObj->Operator);
+                }
+            }
+            else if(node->GetNodeType() == ast::NodeType::PrefixExpression)
+            {
+                std::shared_ptr<ast::PrefixExpression> prefixObj = std::dynamic_pointer_cast<ast::PrefixExpression>(node);
+
+                int src = -1;
+                auto resultObj = compileExpression(prefixObj->pRight, src);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                int dst = destination(target);
+
+                if(prefixObj->Operator == "!")
+                {
+                    emit(bytecode::RegisterOpcodeType::OpBang, {dst, src});
+                }
+                else if(prefixObj->Operator == "-")
+                {
+                    emit(bytecode::RegisterOpcodeType::OpMinus, {dst, src});
+                }
+                else{
+                    return objects::newError("unknow operator: " + prefixObj->Operator);
+                }
+            }
+            else if(node->GetNodeType() == ast::NodeType::IfExpression)
+            {
+                std::shared_ptr<ast::IfExpression> ifObj = std::dynamic_pointer_cast<ast::IfExpression>(node);
+
+                int dst = destination(target);
+
+                int cond = -1;
+                auto resultObj = compileExpression(ifObj->pCondition, cond);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                auto jumpNotTruthyPos = emit(bytecode::RegisterOpcodeType::OpJumpNotTruthy, {cond, 9999});
+
+                resultObj = compileBlockValue(ifObj->pConsequence, dst);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                auto jumpPos = emit(bytecode::RegisterOpcodeType::OpJump, {9999});
+
+                changeOperand(jumpNotTruthyPos, {cond, currentSize()});
+
+                if(ifObj->pAlternative == nullptr)
+                {
+                    emit(bytecode::RegisterOpcodeType::OpLoadNull, {dst});
+                }
+                else
+                {
+                    resultObj = compileBlockValue(ifObj->pAlternative, dst);
+                    if (objects::isError(resultObj))
+                    {
+                        return resultObj;
+                    }
+                }
+
+                changeOperand(jumpPos, {currentSize()});
+            }
+            else if(node->GetNodeType() == ast::NodeType::Identifier)
+            {
+                std::shared_ptr<ast::Identifier> identObj = std::dynamic_pointer_cast<ast::Identifier>(node);
+                auto symbol = symbolTable->Resolve(identObj->Value);
+                if(symbol == nullptr)
+                {
+                    return objects::newError("undefined variable " + identObj->Value);
+                }
+
+                loadSymbol(symbol, target);
+            }
+            else if(node->GetNodeType() == ast::NodeType::IntegerLiteral)
+            {
+                std::shared_ptr<ast::IntegerLiteral> integerLiteral = std::dynamic_pointer_cast<ast::IntegerLiteral>(node);
+                auto pos = addConstant(std::make_shared<objects::Integer>(integerLiteral->Value));
+                int dst = destination(target);
+                emit(bytecode::RegisterOpcodeType::OpLoadConstant, {dst, pos});
+            }
+            else if(node->GetNodeType() == ast::NodeType::Boolean)
+            {
+                auto boolAst = std::dynamic_pointer_cast<ast::Boolean>(node);
+                int dst = destination(target);
+                if(boolAst->Value)
+                {
+                    emit(bytecode::RegisterOpcodeType::OpLoadTrue, {dst});
+                } else {
+                    emit(bytecode::RegisterOpcodeType::OpLoadFalse, {dst});
+                }
+            }
+            else if(node->GetNodeType() == ast::NodeType::StringLiteral)
+            {
+                std::shared_ptr<ast::StringLiteral> stringLiteral = std::dynamic_pointer_cast<ast::StringLiteral>(node);
+                auto pos = addConstant(std::make_shared<objects::String>(stringLiteral->Value));
+                int dst = destination(target);
+                emit(bytecode::RegisterOpcodeType::OpLoadConstant, {dst, pos});
+            }
+            else if(node->GetNodeType() == ast::NodeType::ArrayLiteral)
+            {
+                std::shared_ptr<ast::ArrayLiteral> arrayLiteral = std::dynamic_pointer_cast<ast::ArrayLiteral>(node);
+
+                int count = arrayLiteral->Elements.size();
+                int start = allocateRange(count);
+                for(int i = 0; i < count; i++)
+                {
+                    int reg = start + i;
+                    auto resultObj = compileExpression(arrayLiteral->Elements[i], reg);
+                    if (objects::isError(resultObj))
+                    {
+                        return resultObj;
+                    }
+                }
+
+                int dst = destination(target);
+                emit(bytecode::RegisterOpcodeType::OpArray, {dst, start, count});
+            }
+            else if(node->GetNodeType() == ast::NodeType::HashLiteral)
+            {
+                std::shared_ptr<ast::HashLiteral> hashLiteral = std::dynamic_pointer_cast<ast::HashLiteral>(node);
+
+                std::vector<std::shared_ptr<ast::Expression>> keys{};
+                for(auto &pair: hashLiteral->Pairs)
+                {
+                    keys.push_back(pair.first);
+                }
+
+                std::sort(keys.begin(), keys.end(), [](const auto &lhs, const auto& rhs){ return lhs->String() < rhs->String(); });
+
+                int count = 2 * static_cast<int>(keys.size());
+                int start = allocateRange(count);
+                for(unsigned long i = 0; i < keys.size(); i++)
+                {
+                    int keyReg = start + 2 * i;
+                    auto resultObj = compileExpression(keys[i], keyReg);
+                    if (objects::isError(resultObj))
+                    {
+                        return resultObj;
+                    }
+
+                    int valueReg = keyReg + 1;
+                    resultObj = compileExpression(hashLiteral->Pairs[keys[i]], valueReg);
+                    if (objects::isError(resultObj))
+                    {
+                        return resultObj;
+                    }
+                }
+
+                int dst = destination(target);
+                emit(bytecode::RegisterOpcodeType::OpHash, {dst, start, count});
+            }
+            else if(node->GetNodeType() == ast::NodeType::IndexExpression)
+            {
+                std::shared_ptr<ast::IndexExpression> indexObj = std::dynamic_pointer_cast<ast::IndexExpression>(node);
+
+                int left = -1;
+                auto resultObj = compileExpression(indexObj->Left, left);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                int index = -1;
+                resultObj = compileExpression(indexObj->Index, index);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                int dst = destination(target);
+                emit(bytecode::RegisterOpcodeType::OpIndex, {dst, left, index});
+            }
+            else if(node->GetNodeType() == ast::NodeType::FunctionLiteral)
+            {
+                std::shared_ptr<ast::FunctionLiteral> funcObj = std::dynamic_pointer_cast<ast::FunctionLiteral>(node);
+
+                enterScope();
+
+                if(funcObj->Name != "")
+                {
+                    symbolTable->DefineFunctionName(funcObj->Name);
+                }
+
+                for(auto &args: funcObj->v_pParameters)
+                {
+                    auto symbol = symbolTable->Define(args->Value);
+                    defineLocal(symbol->Index);
+                }
+
+                auto resultObj = compileFunctionBody(funcObj->pBody);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                auto freeSymbols = symbolTable->FreeSymbols;
+                auto numRegisters = scopes[scopeIndex]->maxRegisters;
+                auto numParameters = funcObj->v_pParameters.size();
+                auto ins = leaveScope();
+
+                int numFree = freeSymbols.size();
+                int start = allocateRange(numFree);
+                for(int i = 0; i < numFree; i++)
+                {
+                    int reg = start + i;
+                    loadSymbol(freeSymbols[i], reg);
+                }
+
+                auto compiledFn = std::make_shared<objects::CompiledFunction>(ins, numRegisters, numParameters);
+                auto pos = addConstant(compiledFn);
+
+                int dst = destination(target);
+                emit(bytecode::RegisterOpcodeType::OpClosure, {dst, pos, start, numFree});
+            }
+            else if(node->GetNodeType() == ast::NodeType::CallExpression)
+            {
+                std::shared_ptr<ast::CallExpression> callObj = std::dynamic_pointer_cast<ast::CallExpression>(node);
+
+                if(auto folded = compiler::FoldBuiltinCall(callObj, symbolTable); folded != nullptr)
+                {
+                    int dst = destination(target);
+                    if(folded == objects::NULL_OBJ)
+                    {
+                        emit(bytecode::RegisterOpcodeType::OpLoadNull, {dst});
+                    }
+                    else if(folded->Type() == objects::ObjectType::BOOLEAN)
+                    {
+                        emit(std::dynamic_pointer_cast<objects::Boolean>(folded)->Value ? bytecode::RegisterOpcodeType::OpLoadTrue : bytecode::RegisterOpcodeType::OpLoadFalse, {dst});
+                    }
+                    else
+                    {
+                        emit(bytecode::RegisterOpcodeType::OpLoadConstant, {dst, addConstant(folded)});
+                    }
+                    return registerOverflow();
+                }
+
+                int fn = -1;
+                auto resultObj = compileExpression(callObj->pFunction, fn);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+
+                int argsNum = callObj->pArguments.size();
+                int start = allocateRange(argsNum);
+                for(int i = 0; i < argsNum; i++)
+                {
+                    int reg = start + i;
+                    resultObj = compileExpression(callObj->pArguments[i], reg);
+                    if (objects::isError(resultObj))
+                    {
+                        return resultObj;
+                    }
+                }
+
+                int dst = destination(target);
+                emit(bytecode::RegisterOpcodeType::OpCall, {dst, fn, start, argsNum});
+            }
+            else
+            {
+                return objects::newError("unsupported expression for register compiler: " + node->String());
+            }
+
+            return registerOverflow();
+        }
+
+        // 代码块作为表达式的值写入dst: 最后一条表达式语句的值, 否则为null
+        std::shared_ptr<objects::Error> compileBlockValue(std::shared_ptr<ast::BlockStatement> block, int dst)
+        {
+            int base = scopes[scopeIndex]->freeRegister;
+            int size = block->v_pStatements.size();
+
+            for(int i = 0; i < size; i++)
+            {
+                auto stmt = block->v_pStatements[i];
+                if(i == size - 1 && stmt->GetNodeType() == ast::NodeType::ExpressionStatement)
+                {
+                    std::shared_ptr<ast::ExpressionStatement> exprStmt = std::dynamic_pointer_cast<ast::ExpressionStatement>(stmt);
+                    int reg = dst;
+                    return compileExpression(exprStmt->pExpression, reg);
+                }
+
+                auto resultObj = compileStatement(stmt);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+                releaseTemporaries(base);
+            }
+
+            emit(bytecode::RegisterOpcodeType::OpLoadNull, {dst});
+            return nullptr;
+        }
+
+        // 函数体的最后一条表达式语句作为隐式返回值
+        std::shared_ptr<objects::Error> compileFunctionBody(std::shared_ptr<ast::BlockStatement> block)
+        {
+            int size = block->v_pStatements.size();
+
+            for(int i = 0; i < size; i++)
+            {
+                auto stmt = block->v_pStatements[i];
+                if(i == size - 1 && stmt->GetNodeType() == ast::NodeType::ExpressionStatement)
+                {
+                    std::shared_ptr<ast::ExpressionStatement> exprStmt = std::dynamic_pointer_cast<ast::ExpressionStatement>(stmt);
+                    int reg = -1;
+                    auto resultObj = compileExpression(exprStmt->pExpression, reg);
+                    if (objects::isError(resultObj))
+                    {
+                        return resultObj;
+                    }
+                    emit(bytecode::RegisterOpcodeType::OpReturnValue, {reg});
+                    return nullptr;
+                }
+
+                auto resultObj = compileStatement(stmt);
+                if (objects::isError(resultObj))
+                {
+                    return resultObj;
+                }
+                releaseTemporaries(0);
+            }
+
+            if(scopes[scopeIndex]->lastOpcode != bytecode::RegisterOpcodeType::OpReturnValue)
+            {
+                emit(bytecode::RegisterOpcodeType::OpReturn);
+            }
+
+            return nullptr;
+        }
+
+        void loadSymbol(std::shared_ptr<compiler::Symbol> symbol, int &target)
+        {
+            if(symbol->Scope == compiler::SymbolScopeType::LocalScope)
+            {
+                int reg = scopes[scopeIndex]->localRegisters[symbol->Index];
+                if(target < 0)
+                {
+                    target = reg;
+                }
+                else if(target != reg)
+                {
+                    emit(bytecode::RegisterOpcodeType::OpMove, {target, reg});
+                }
+                return;
+            }
+
+            int dst = destination(target);
+
+            if (symbol->Scope == compiler::SymbolScopeType::GlobalScope)
+            {
+                emit(bytecode::RegisterOpcodeType::OpGetGlobal, {dst, symbol->Index});
+            }
+            else if(symbol->Scope == compiler::SymbolScopeType::BuiltinScope)
+            {
+                emit(bytecode::RegisterOpcodeType::OpGetBuiltin, {dst, symbol->Index});
+            }
+            else if(symbol->Scope == compiler::SymbolScopeType::FreeScope)
+            {
+                emit(bytecode::RegisterOpcodeType::OpGetFree, {dst, symbol->Index});
+            }
+            else if(symbol->Scope == compiler::SymbolScopeType::FunctionScope)
+            {
+                emit(bytecode::RegisterOpcodeType::OpCurrentClosure, {dst});
+            }
+        }
+
+        int destination(int &target)
+        {
+            if(target < 0)
+            {
+                target = allocateRange(1);
+            }
+            return target;
+        }
+
+        int allocateRange(int count)
+        {
+            auto scope = scopes[scopeIndex];
+            int start = scope->freeRegister;
+            scope->freeRegister += count;
+            scope->maxRegisters = std::max(scope->maxRegisters, scope->freeRegister);
+            return start;
+        }
+
+        int defineLocal(int symbolIndex)
+        {
+            auto scope = scopes[scopeIndex];
+            int reg = allocateRange(1);
+            scope->localRegisters[symbolIndex] = reg;
+            scope->localsTop = scope->freeRegister;
+            return reg;
+        }
+
+        void releaseTemporaries(int base)
+        {
+            auto scope = scopes[scopeIndex];
+            scope->freeRegister = std::max(base, scope->localsTop);
+        }
+
+        std::shared_ptr<objects::Error> registerOverflow()
+        {
+            if(scopes[scopeIndex]->maxRegisters > MaxRegisters)
+            {
+                return objects::newError("too many registers: " + std::to_string(scopes[scopeIndex]->maxRegisters));
+            }
+            return nullptr;
+        }
+
+        int addConstant(std::shared_ptr<objects::Object> obj)
+        {
+            constants.push_back(obj);
+            return (constants.size() - 1);
+        }
+
+        int emit(bytecode::RegisterOpcodeType op, std::vector<int> operands)
+        {
+            auto ins = bytecode::MakeRegister(op, operands);
+            auto &instructions = scopes[scopeIndex]->instructions;
+            int pos = instructions.size();
+
+            instructions.insert(instructions.end(), ins.begin(), ins.end());
+            scopes[scopeIndex]->lastOpcode = op;
+            return pos;
+        }
+
+        int emit(bytecode::RegisterOpcodeType op)
+        {
+            return emit(op, {});
+        }
+
+        int currentSize()
+        {
+            return scopes[scopeIndex]->instructions.size();
+        }
+
+        void changeOperand(int opPos, std::vector<int> operands)
+        {
+            auto &instructions = scopes[scopeIndex]->instructions;
+            auto op = static_cast<bytecode::RegisterOpcodeType>(instructions[opPos]);
+            auto newInstruction = bytecode::MakeRegister(op, operands);
+
+            for (int i = 0, size = newInstruction.size(); i < size; i++)
+            {
+                instructions[opPos + i] = newInstruction[i];
+            }
+        }
+
+        std::shared_ptr<RegisterByteCode> Bytecode()
+        {
+            return std::make_shared<RegisterByteCode>(scopes[scopeIndex]->instructions, constants, scopes[scopeIndex]->maxRegisters);
+        }
+
+        void enterScope()
+        {
+            auto scope = std::make_shared<RegisterScope>();
+            scopes.push_back(scope);
+            scopeIndex += 1;
+            symbolTable = NewEnclosedSymbolTable(symbolTable);
+        }
+
+        bytecode::Instructions leaveScope()
+        {
+            auto ins = scopes[scopeIndex]->instructions;
+            scopes.pop_back();
+            scopeIndex -= 1;
+            symbolTable = symbolTable->Outer;
+
+            return ins;
+        }
+    };
+
+    inline std::shared_ptr<RegisterCompiler> NewRegisterCompiler()
+    {
+        auto symbolTable = NewSymbolTable();
+
+        int i = -1;
+        for(auto &fn: objects::Builtins)
+        {
+            i += 1;
+            symbolTable->DefineBuiltin(i, fn->Name);
+        }
+
+        auto compiler = std::make_shared<RegisterCompiler>();
+        compiler->symbolTable = symbolTable;
+
+        return compiler;
+    }
+}
+
+#endif // H_REGISTER_COMPILER_H
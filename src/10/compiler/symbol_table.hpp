@@ -114,12 +114,12 @@ namespace compiler
         }
     };
 
-    std::shared_ptr<SymbolTable> NewSymbolTable()
+    inline std::shared_ptr<SymbolTable> NewSymbolTable()
     {
         return std::make_shared<SymbolTable>();
     }
 
-    std::shared_ptr<SymbolTable> NewEnclosedSymbolTable(std::shared_ptr<SymbolTable> outer)
+    inline std::shared_ptr<SymbolTable> NewEnclosedSymbolTable(std::shared_ptr<SymbolTable> outer)
     {
         auto symbol = std::make_shared<SymbolTable>();
         symbol->Outer = outer;
@@ -0,0 +1,460 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+
+#include "embed/monkey.hpp"
+
+#include "lexer/lexer.hpp"
+#include "parser/parser.hpp"
+#include "objects/objects.hpp"
+#include "objects/host.hpp"
+#include "objects/plugin.hpp"
+#include "compiler/compiler.hpp"
+#include "compiler/link.hpp"
+#include "vm/vm.hpp"
+
+namespace monkey
+{
+    struct ProgramImpl
+    {
+        std::shared_ptr<compiler::ByteCode> Bytecode;
+        int NumGlobals; // 全局变量总数, 注入的全局变量占用前 Globals.size() 个下标
+    };
+
+    struct RuntimeImpl
+    {
+        RuntimeOptions Options;
+        std::shared_ptr<objects::Heap> Heap; // 设置了MemoryLimit时每个Runtime一个独立的堆; 在Machine之前声明, 比它持有的对象活得久
+        std::shared_ptr<vm::VM> Machine;
+    };
+
+    Value Value::Null()
+    {
+        return Value();
+    }
+
+    Value Value::Int(int64_t val)
+    {
+        Value value;
+        value.Type = ValueType::Integer;
+        value.Integer = val;
+        return value;
+    }
+
+    Value Value::Bool(bool val)
+    {
+        Value value;
+        value.Type = ValueType::Boolean;
+        value.Boolean = val;
+        return value;
+    }
+
+    Value Value::Str(const std::string &val)
+    {
+        Value value;
+        value.Type = ValueType::String;
+        value.String = val;
+        return value;
+    }
+
+    Value Value::List(std::vector<Value> elements)
+    {
+        Value value;
+        value.Type = ValueType::Array;
+        value.Elements = std::move(elements);
+        return value;
+    }
+
+    Value Value::Map(std::vector<Value> keys, std::vector<Value> values)
+    {
+        Value value;
+        value.Type = ValueType::Hash;
+        value.Keys = std::move(keys);
+        value.Values = std::move(values);
+        return value;
+    }
+
+    static Value hostValue(ValueType type, const void *data, size_t size)
+    {
+        Value value;
+        value.Type = type;
+        value.Data = data;
+        value.Size = size;
+        return value;
+    }
+
+    Value Value::Bytes(const uint8_t *data, size_t size)
+    {
+        return hostValue(ValueType::Bytes, data, size);
+    }
+
+    Value Value::Int64s(const int64_t *data, size_t size)
+    {
+        return hostValue(ValueType::Int64s, data, size);
+    }
+
+    Value Value::Strings(const std::string *data, size_t size)
+    {
+        return hostValue(ValueType::Strings, data, size);
+    }
+
+    std::string Value::Inspect() const
+    {
+        switch (Type)
+        {
+        case ValueType::Null:
+            return "null";
+        case ValueType::Integer:
+            return std::to_string(Integer);
+        case ValueType::Boolean:
+            return (Boolean ? "true" : "false");
+        case ValueType::String:
+            return "\"" + String + "\"";
+        case ValueType::Array:
+            {
+                std::vector<std::string> items{};
+                for (auto &item : Elements)
+                {
+                    items.push_back(item.Inspect());
+                }
+                return "[" + ast::Join(items, ", ") + "]";
+            }
+        case ValueType::Hash:
+            {
+                std::vector<std::string> items{};
+                for (unsigned long i = 0; i < Keys.size(); i++)
+                {
+                    items.push_back(Keys[i].Inspect() + ": " + Values[i].Inspect());
+                }
+                return "{" + ast::Join(items, ", ") + "}";
+            }
+        case ValueType::Bytes:
+            return "bytes(" + std::to_string(Size) + ")";
+        case ValueType::Int64s:
+            return "int64s(" + std::to_string(Size) + ")";
+        case ValueType::Strings:
+            return "strings(" + std::to_string(Size) + ")";
+        default:
+            return String;
+        }
+    }
+
+    // 宿主值转换为脚本对象, 宿主内存只包装不复制; 哈希的键不可哈希时返回错误
+    static std::shared_ptr<objects::Object> toObject(const Value &value, std::shared_ptr<objects::HostLease> lease)
+    {
+        switch (value.Type)
+        {
+        case ValueType::Bytes:
+            return std::make_shared<objects::HostBuffer>(objects::HostElement::Byte, value.Data, value.Size, lease);
+        case ValueType::Int64s:
+            return std::make_shared<objects::HostBuffer>(objects::HostElement::Int64, value.Data, value.Size, lease);
+        case ValueType::Strings:
+            return std::make_shared<objects::HostBuffer>(objects::HostElement::String, value.Data, value.Size, lease);
+        case ValueType::Integer:
+            return std::make_shared<objects::Integer>(value.Integer);
+        case ValueType::Boolean:
+            return objects::nativeBoolToBooleanObject(value.Boolean);
+        case ValueType::String:
+            return std::make_shared<objects::String>(value.String);
+        case ValueType::Array:
+            {
+                std::vector<std::shared_ptr<objects::Object>> elements;
+                for (auto &item : value.Elements)
+                {
+                    auto obj = toObject(item, lease);
+                    if (objects::isError(obj))
+                    {
+                        return obj;
+                    }
+                    elements.push_back(obj);
+                }
+                return std::make_shared<objects::Array>(elements);
+            }
+        case ValueType::Hash:
+            {
+                std::map<objects::HashKey, std::shared_ptr<objects::HashPair>> pairs;
+                for (unsigned long i = 0; i < value.Keys.size() && i < value.Values.size(); i++)
+                {
+                    auto key = toObject(value.Keys[i], lease);
+                    if (!key->Hashable())
+                    {
+                        return objects::newError("unusable as hash key: " + key->TypeStr());
+                    }
+
+                    auto val = toObject(value.Values[i], lease);
+                    if (objects::isError(val))
+                    {
+                        return val;
+                    }
+                    pairs[key->GetHashKey()] = std::make_shared<objects::HashPair>(key, val);
+                }
+                return std::make_shared<objects::Hash>(pairs);
+            }
+        case ValueType::Other:
+            return objects::newError("can not pass an opaque value to a script: " + value.String);
+        default:
+            return objects::NULL_OBJ;
+        }
+    }
+
+    static Value fromObject(std::shared_ptr<objects::Object> obj)
+    {
+        if (obj == nullptr)
+        {
+            return Value::Null();
+        }
+
+        switch (obj->Type())
+        {
+        case objects::ObjectType::Null:
+            return Value::Null();
+        case objects::ObjectType::INTEGER:
+            return Value::Int(std::dynamic_pointer_cast<objects::Integer>(obj)->Value);
+        case objects::ObjectType::BOOLEAN:
+            return Value::Bool(std::dynamic_pointer_cast<objects::Boolean>(obj)->Value);
+        case objects::ObjectType::STRING:
+            return Value::Str(std::dynamic_pointer_cast<objects::String>(obj)->Value);
+        case objects::ObjectType::ARRAY:
+            {
+                std::vector<Value> elements;
+                for (auto &item : std::dynamic_pointer_cast<objects::Array>(obj)->Elements)
+                {
+                    elements.push_back(fromObject(item));
+                }
+                return Value::List(std::move(elements));
+            }
+        case objects::ObjectType::INT_ARRAY:
+            {
+                std::vector<Value> elements;
+                for (auto &v : std::dynamic_pointer_cast<objects::IntArray>(obj)->Values)
+                {
+                    elements.push_back(Value::Int(v));
+                }
+                return Value::List(std::move(elements));
+            }
+        case objects::ObjectType::SLICE:
+            {
+                auto slice = std::dynamic_pointer_cast<objects::ArraySlice>(obj);
+                std::vector<Value> elements;
+                for (int64_t i = 0; i < slice->Length; i++)
+                {
+                    elements.push_back(fromObject(slice->At(i)));
+                }
+                return Value::List(std::move(elements));
+            }
+        case objects::ObjectType::HASH:
+            {
+                std::vector<Value> keys, values;
+                for (auto &[key, pair] : std::dynamic_pointer_cast<objects::Hash>(obj)->Pairs)
+                {
+                    [[maybe_unused]] auto x = key;
+                    keys.push_back(fromObject(pair->Key));
+                    values.push_back(fromObject(pair->Value));
+                }
+                return Value::Map(std::move(keys), std::move(values));
+            }
+        case objects::ObjectType::HOST_BUFFER:
+            {
+                // 宿主内存在Run返回后失效, 结果中的视图复制出来
+                auto buffer = std::dynamic_pointer_cast<objects::HostBuffer>(obj);
+                std::vector<Value> elements;
+                for (int64_t i = 0; i < buffer->Length; i++)
+                {
+                    elements.push_back(fromObject(buffer->At(i)));
+                }
+                return Value::List(std::move(elements));
+            }
+        default:
+            {
+                Value value;
+                value.Type = ValueType::Other;
+                value.String = obj->Inspect();
+                return value;
+            }
+        }
+    }
+
+    // 运行结束(包括出错返回)时让本次出借的宿主内存失效
+    struct leaseGuard
+    {
+        std::shared_ptr<objects::HostLease> lease = std::make_shared<objects::HostLease>();
+
+        ~leaseGuard()
+        {
+            lease->Valid = false;
+        }
+    };
+
+    static Result failure(const std::string &msg)
+    {
+        Result result;
+        result.Ok = false;
+        result.Error = msg;
+        return result;
+    }
+
+    Runtime::Runtime(const RuntimeOptions &options) : impl(std::make_unique<RuntimeImpl>())
+    {
+        impl->Options = options;
+        if (options.MemoryLimit > 0)
+        {
+            impl->Heap = objects::NewHeap(options.MemoryLimit);
+        }
+    }
+
+    Runtime::~Runtime()
+    {
+    }
+
+    std::shared_ptr<Program> Runtime::Compile(const std::string &source, const std::vector<std::string> &globals, std::string &error)
+    {
+        auto pParser = parser::New(lexer::New(source));
+        auto pProgram = pParser->ParseProgram();
+
+        auto errors = pParser->Errors();
+        if (errors.size() > 0)
+        {
+            error = "parser errors: " + ast::Join(errors, "; ");
+            return nullptr;
+        }
+
+        std::shared_ptr<ast::Node> astNode(reinterpret_cast<ast::Node *>(pProgram.release()));
+
+        auto comp = compiler::New();
+        for (auto &name : globals)
+        {
+            comp->symbolTable->Define(name);
+        }
+
+        auto resultObj = comp->Compile(astNode);
+        if (objects::isError(resultObj))
+        {
+            error = "compile error: " + resultObj->Message;
+            return nullptr;
+        }
+
+        auto program = std::make_shared<Program>();
+        program->Impl = std::make_shared<ProgramImpl>();
+        program->Impl->Bytecode = comp->Bytecode();
+        program->Impl->NumGlobals = comp->symbolTable->numDefinitions;
+
+        if (impl->Options.Link)
+        {
+            compiler::LinkedProgram linked;
+            auto err = compiler::Link(comp, linked, globals.size());
+            if (err != nullptr)
+            {
+                error = "link error: " + err->Message;
+                return nullptr;
+            }
+            program->Impl->Bytecode = linked.Bytecode;
+            program->Impl->NumGlobals = linked.NumGlobals;
+        }
+        program->Globals = globals;
+        return program;
+    }
+
+    std::shared_ptr<Program> Runtime::Compile(const std::string &source, std::string &error)
+    {
+        return Compile(source, {}, error);
+    }
+
+    Result Runtime::Run(std::shared_ptr<Program> program, const std::map<std::string, Value> &globals)
+    {
+        if (program == nullptr || program->Impl == nullptr)
+        {
+            return failure("invalid program");
+        }
+
+        if (impl->Machine == nullptr)
+        {
+            impl->Machine = vm::New(program->Impl->Bytecode);
+        }
+        impl->Machine->Reset(program->Impl->Bytecode, program->Impl->NumGlobals);
+        impl->Machine->speculation = impl->Options.Speculation;
+        impl->Machine->memoizePure = impl->Options.MemoizePure;
+        impl->Machine->heap = impl->Heap;
+        impl->Machine->deadline = {};
+        if (impl->Options.TimeLimit > 0)
+        {
+            impl->Machine->deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(impl->Options.TimeLimit);
+        }
+
+        for (auto &entry : globals)
+        {
+            if (std::find(program->Globals.begin(), program->Globals.end(), entry.first) == program->Globals.end())
+            {
+                return failure("unknown global: " + entry.first);
+            }
+        }
+
+        leaseGuard guard;
+        objects::HeapScope heapScope(impl->Heap); // 注入的全局变量也记在本Runtime的堆上
+        for (unsigned long i = 0; i < program->Globals.size(); i++)
+        {
+            auto fit = globals.find(program->Globals[i]);
+            if (fit == globals.end())
+            {
+                impl->Machine->globals[i] = objects::NULL_OBJ;
+                continue;
+            }
+
+            auto obj = toObject(fit->second, guard.lease);
+            if (objects::isError(obj))
+            {
+                return failure(std::dynamic_pointer_cast<objects::Error>(obj)->Message);
+            }
+            impl->Machine->globals[i] = obj;
+        }
+
+        auto resultObj = impl->Machine->Run();
+        if (objects::isError(resultObj))
+        {
+            return failure(std::dynamic_pointer_cast<objects::Error>(resultObj)->Message);
+        }
+
+        auto output = impl->Machine->LastPoppedStackElem();
+        if (objects::isError(output))
+        {
+            return failure(std::dynamic_pointer_cast<objects::Error>(output)->Message);
+        }
+
+        Result result;
+        result.Output = fromObject(output);
+        return result;
+    }
+
+    Result Runtime::Run(std::shared_ptr<Program> program)
+    {
+        return Run(program, {});
+    }
+
+    int64_t Runtime::HeapBytes() const
+    {
+        return (impl->Heap == nullptr ? 0 : impl->Heap->Allocated);
+    }
+
+    std::shared_ptr<Runtime> NewRuntime()
+    {
+        return NewRuntime(RuntimeOptions());
+    }
+
+    std::shared_ptr<Runtime> NewRuntime(const RuntimeOptions &options)
+    {
+        return std::make_shared<Runtime>(options);
+    }
+
+    bool LoadPlugin(const std::string &path, std::string &error)
+    {
+        return objects::LoadPlugin(path, error);
+    }
+
+    int Version()
+    {
+        return MONKEY_EMBED_API_VERSION;
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef H_EMBED_MONKEY_H
+#define H_EMBED_MONKEY_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdint>
+
+// 嵌入API: 只依赖标准库, 宿主程序链接 libmonkey 后包含本头文件即可使用,
+// 解释器内部的头文件和对象类型都不会暴露出来
+#define MONKEY_EMBED_API_VERSION 3
+
+namespace monkey
+{
+    enum class ValueType
+    {
+        Null,
+        Integer,
+        Boolean,
+        String,
+        Array,
+        Hash,
+        Other, // 函数等不能转换为宿主类型的对象, String 保存其 Inspect() 的结果
+
+        // 宿主内存, 不复制地借给脚本: 支持len/下标/first/last/rest, 只在本次Run期间有效
+        Bytes,   // const uint8_t*
+        Int64s,  // const int64_t*
+        Strings, // const std::string*
+    };
+
+    // 宿主与脚本之间传递的值
+    struct Value
+    {
+        ValueType Type = ValueType::Null;
+        int64_t Integer = 0;
+        bool Boolean = false;
+        std::string String;
+        std::vector<Value> Elements; // Array的元素
+        std::vector<Value> Keys;     // Hash的键, 与Values一一对应
+        std::vector<Value> Values;
+        const void *Data = nullptr; // Bytes/Int64s/Strings 指向的宿主内存及元素个数
+        size_t Size = 0;
+
+        static Value Null();
+        static Value Int(int64_t val);
+        static Value Bool(bool val);
+        static Value Str(const std::string &val);
+        static Value List(std::vector<Value> elements); // 按值传入, 调用方可以std::move避免复制嵌套的值
+        static Value Map(std::vector<Value> keys, std::vector<Value> values);
+        static Value Bytes(const uint8_t *data, size_t size);
+        static Value Int64s(const int64_t *data, size_t size);
+        static Value Strings(const std::string *data, size_t size);
+
+        std::string Inspect() const;
+    };
+
+    struct Result
+    {
+        bool Ok = true;
+        Value Output;      // 最后一条表达式语句的值, 宿主内存的视图会被复制为Array
+        std::string Error; // Ok为false时的错误信息
+    };
+
+    struct RuntimeOptions
+    {
+        bool Speculation = true;  // 热点函数推测优化; 同一个Program被多个线程的Runtime共享时必须关闭
+        bool MemoizePure = false; // 自动缓存纯函数的调用结果
+        int64_t MemoryLimit = 0;  // 每个Runtime独立的对象堆上限(字节), 超过时Run失败; 0表示不限制
+        int64_t TimeLimit = 0;    // 每次Run的执行时间上限(毫秒), 超过时Run失败; 0表示不限制
+        bool Link = false;        // 编译后整体链接: 展开import并删掉用不到的函数和常量, 条件分支里的import会编译失败
+    };
+
+    struct ProgramImpl;
+    struct RuntimeImpl;
+
+    // 编译好的程序, 可以反复运行, 也可以交给其它Runtime运行
+    struct Program
+    {
+        std::shared_ptr<ProgramImpl> Impl;
+        std::vector<std::string> Globals; // 运行时由宿主注入的全局变量名
+    };
+
+    // 运行时复用同一个虚拟机的栈和全局变量存储, 同一时刻只能被一个线程使用
+    struct Runtime
+    {
+        Runtime(const RuntimeOptions &options);
+        ~Runtime();
+
+        Runtime(const Runtime &) = delete;
+        Runtime &operator=(const Runtime &) = delete;
+
+        // 编译源码, globals 声明宿主会注入的全局变量; 失败时返回nullptr并设置error
+        std::shared_ptr<Program> Compile(const std::string &source, const std::vector<std::string> &globals, std::string &error);
+        std::shared_ptr<Program> Compile(const std::string &source, std::string &error);
+
+        // 运行程序, 未提供的注入变量为null
+        Result Run(std::shared_ptr<Program> program, const std::map<std::string, Value> &globals);
+        Result Run(std::shared_ptr<Program> program);
+
+        int64_t HeapBytes() const; // 当前存活对象占用的字节数, 未设置MemoryLimit时为0
+
+    private:
+        std::unique_ptr<RuntimeImpl> impl;
+    };
+
+    std::shared_ptr<Runtime> NewRuntime();
+    std::shared_ptr<Runtime> NewRuntime(const RuntimeOptions &options);
+
+    // 加载原生插件(见 embed/plugin.hpp), 其中的函数追加为内置函数; 要在创建Runtime之前调用, 插件不会被卸载
+    bool LoadPlugin(const std::string &path, std::string &error);
+
+    int Version();
+}
+
+#endif // H_EMBED_MONKEY_H
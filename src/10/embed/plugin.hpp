@@ -0,0 +1,71 @@
+#ifndef H_EMBED_PLUGIN_H
+#define H_EMBED_PLUGIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 原生插件接口: 插件是导出 monkey_plugin_init 的动态库, 只依赖本头文件中的C类型,
+// 可以与解释器分开编译. 加载后插件函数和其它内置函数一样按名字调用
+#define MONKEY_PLUGIN_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef enum
+    {
+        MONKEY_NULL = 0,
+        MONKEY_INT,
+        MONKEY_BOOL,
+        MONKEY_STRING, // data指向size个字节
+        MONKEY_INTS,   // data指向size个int64_t; 整数数组、切片和宿主缓冲区都不复制
+    } monkey_type;
+
+    // 参数只在本次调用期间有效
+    typedef struct
+    {
+        monkey_type type;
+        int64_t integer; // INT和BOOL的值
+        const void *data;
+        size_t size;
+    } monkey_value;
+
+    typedef struct monkey_result monkey_result; // 由解释器提供, 插件通过monkey_result_api设置返回值
+
+    typedef struct
+    {
+        void (*set_int)(monkey_result *result, int64_t value);
+        void (*set_bool)(monkey_result *result, int value);
+        char *(*set_string)(monkey_result *result, size_t size);    // 返回由插件填写的size个字节
+        int64_t *(*set_ints)(monkey_result *result, size_t count); // 返回由插件填写的count个整数
+        void (*set_error)(monkey_result *result, const char *message);
+    } monkey_result_api;
+
+    // 没有设置返回值时结果为null
+    typedef void (*monkey_native_fn)(const monkey_value *args, size_t count, monkey_result *result, const monkey_result_api *api);
+
+    typedef struct
+    {
+        const char *name;
+        monkey_native_fn fn;
+        int pure; // 非0表示没有副作用, 结果只取决于参数
+    } monkey_native_def;
+
+    typedef struct
+    {
+        int abi_version; // MONKEY_PLUGIN_ABI_VERSION
+        const monkey_native_def *natives;
+        size_t count;
+    } monkey_plugin;
+
+    // 插件导出的入口, 加载时调用一次, 返回的函数表须一直有效
+    typedef const monkey_plugin *(*monkey_plugin_init_fn)(void);
+
+#define MONKEY_PLUGIN_INIT "monkey_plugin_init"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // H_EMBED_PLUGIN_H
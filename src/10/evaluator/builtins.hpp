@@ -11,14 +11,50 @@
 
 namespace evaluator
 {
-    std::map<std::string, std::shared_ptr<objects::Builtin>> builtins{
+    inline std::map<std::string, std::shared_ptr<objects::Builtin>> builtins{
         {"len", objects::GetBuiltinByName("len")},
         {"puts", objects::GetBuiltinByName("puts")},
         {"first", objects::GetBuiltinByName("first")},
         {"last", objects::GetBuiltinByName("last")},
         {"rest", objects::GetBuiltinByName("rest")},
         {"push", objects::GetBuiltinByName("push")},
-        {"fibonacci", objects::GetBuiltinByName("fibonacci")}
+        {"fibonacci", objects::GetBuiltinByName("fibonacci")},
+        {"memo", objects::GetBuiltinByName("memo")},
+        {"range", objects::GetBuiltinByName("range")},
+        {"sum", objects::GetBuiltinByName("sum")},
+        {"min", objects::GetBuiltinByName("min")},
+        {"max", objects::GetBuiltinByName("max")},
+        {"add", objects::GetBuiltinByName("add")},
+        {"mul", objects::GetBuiltinByName("mul")},
+        {"filter", objects::GetBuiltinByName("filter")},
+        {"dot", objects::GetBuiltinByName("dot")},
+        {"iter", objects::GetBuiltinByName("iter")},
+        {"map", objects::GetBuiltinByName("map")},
+        {"take", objects::GetBuiltinByName("take")},
+        {"zip", objects::GetBuiltinByName("zip")},
+        {"reduce", objects::GetBuiltinByName("reduce")},
+        {"to_array", objects::GetBuiltinByName("to_array")},
+        {"keys", objects::GetBuiltinByName("keys")},
+        {"values", objects::GetBuiltinByName("values")},
+        {"has", objects::GetBuiltinByName("has")},
+        {"set", objects::GetBuiltinByName("set")},
+        {"delete", objects::GetBuiltinByName("delete")},
+        {"merge", objects::GetBuiltinByName("merge")},
+        {"read_csv", objects::GetBuiltinByName("read_csv")},
+        {"open", objects::GetBuiltinByName("open")},
+        {"read_line", objects::GetBuiltinByName("read_line")},
+        {"read_all", objects::GetBuiltinByName("read_all")},
+        {"write", objects::GetBuiltinByName("write")},
+        {"close", objects::GetBuiltinByName("close")},
+        {"lines", objects::GetBuiltinByName("lines")},
+        {"split", objects::GetBuiltinByName("split")},
+        {"join", objects::GetBuiltinByName("join")},
+        {"substr", objects::GetBuiltinByName("substr")},
+        {"find", objects::GetBuiltinByName("find")},
+        {"replace", objects::GetBuiltinByName("replace")},
+        {"upper", objects::GetBuiltinByName("upper")},
+        {"lower", objects::GetBuiltinByName("lower")},
+        {"format", objects::GetBuiltinByName("format")}
     };
 }
 
@@ -20,7 +20,7 @@ namespace evaluator
 {
 	std::shared_ptr<objects::Object> Eval(std::shared_ptr<ast::Node> node, std::shared_ptr<objects::Environment> env);
 
-	std::shared_ptr<objects::Object> unwrapReturnValue(std::shared_ptr<objects::Object> obj)
+	inline std::shared_ptr<objects::Object> unwrapReturnValue(std::shared_ptr<objects::Object> obj)
 	{
 		std::shared_ptr<objects::ReturnValue> returnValue = std::dynamic_pointer_cast<objects::ReturnValue>(obj);
 		if (returnValue != nullptr)
@@ -33,7 +33,7 @@ namespace evaluator
 		}
 	}
 
-	std::shared_ptr<objects::Environment> extendFunctionEnv(std::shared_ptr<objects::Function> fn, std::vector<std::shared_ptr<objects::Object>> &args)
+	inline std::shared_ptr<objects::Environment> extendFunctionEnv(std::shared_ptr<objects::Function> fn, std::vector<std::shared_ptr<objects::Object>> &args)
 	{
 		std::shared_ptr<objects::Environment> env = objects::NewEnclosedEnvironment(fn->Env);
 		for (unsigned long i = 0; i < fn->Parameters.size(); i++)
@@ -43,17 +43,36 @@ namespace evaluator
 		return env;
 	}
 
-	std::shared_ptr<objects::Object> applyFunction(std::shared_ptr<objects::Object> fn, std::vector<std::shared_ptr<objects::Object>> &args)
+	inline std::shared_ptr<objects::Object> applyFunction(std::shared_ptr<objects::Object> fn, std::vector<std::shared_ptr<objects::Object>> &args)
 	{
 		if (std::shared_ptr<objects::Function> function = std::dynamic_pointer_cast<objects::Function>(fn); function != nullptr)
 		{
+			std::vector<objects::HashKey> key;
+			bool cacheable = (function->Memo != nullptr && objects::MemoTable::MakeKey(args, 0, args.size(), key));
+			if (cacheable)
+			{
+				if (auto cached = function->Memo->Get(key, args, 0); cached != nullptr)
+				{
+					return cached;
+				}
+			}
+
 			std::shared_ptr<objects::Environment> extendedEnv = extendFunctionEnv(function, args);
-			std::shared_ptr<objects::Object> evaluated = Eval(function->Body, extendedEnv);
-			return unwrapReturnValue(evaluated);
+			std::shared_ptr<objects::Object> evaluated = unwrapReturnValue(Eval(function->Body, extendedEnv));
+
+			if (cacheable && !objects::isError(evaluated))
+			{
+				function->Memo->Put(key, args, evaluated);
+			}
+			return evaluated;
 		}
 		else if (std::shared_ptr<objects::Builtin> builtin = std::dynamic_pointer_cast<objects::Builtin>(fn); builtin != nullptr)
 		{
-			auto result = builtin->Fn(args);
+			// 内置函数回调的用户函数也由解释器求值
+			objects::CallerScope callerScope([](std::shared_ptr<objects::Object> callee, std::vector<std::shared_ptr<objects::Object>> &calleeArgs) {
+				return applyFunction(callee, calleeArgs);
+			});
+			auto result = builtin->Call(args);
 			if(result != nullptr)
 			{
 				return result;
@@ -67,7 +86,7 @@ namespace evaluator
 		}
 	}
 
-	std::vector<std::shared_ptr<objects::Object>> evalExpressions(std::vector<std::shared_ptr<ast::Expression>> exps, std::shared_ptr<objects::Environment> env)
+	inline std::vector<std::shared_ptr<objects::Object>> evalExpressions(std::vector<std::shared_ptr<ast::Expression>> exps, std::shared_ptr<objects::Environment> env)
 	{
 		std::vector<std::shared_ptr<objects::Object>> result;
 
@@ -86,7 +105,7 @@ namespace evaluator
 		return result;
 	}
 
-	std::shared_ptr<objects::Object> evalIdentifier(std::shared_ptr<ast::Identifier> node, std::shared_ptr<objects::Environment> env)
+	inline std::shared_ptr<objects::Object> evalIdentifier(std::shared_ptr<ast::Identifier> node, std::shared_ptr<objects::Environment> env)
 	{
 #ifdef DEBUG
 		std::cout << "\t\t evalIdentifier get by :" << node->Value << std::endl;
@@ -111,10 +130,101 @@ namespace evaluator
 			return builtin;
 		}
 
+		// 插件加载的函数不在上面的表中
+		if(auto builtin = objects::GetBuiltinByName(node->Value); builtin != nullptr)
+		{
+			return builtin;
+		}
+
 		return objects::newError("identifier not found: " + node->Value);
 	}
 
-	std::shared_ptr<objects::Object> evalIfExpression(std::shared_ptr<ast::IfExpression> ie, std::shared_ptr<objects::Environment> env)
+	inline std::shared_ptr<objects::Object> evalWhileStatement(std::shared_ptr<ast::WhileStatement> ws, std::shared_ptr<objects::Environment> env)
+	{
+		while (true)
+		{
+			std::shared_ptr<objects::Object> condition = Eval(ws->pCondition, env);
+			if (objects::isError(condition))
+			{
+				return condition;
+			}
+			if (!objects::isTruthy(condition))
+			{
+				return nullptr;
+			}
+
+			auto result = Eval(ws->pBody, env);
+			if (result != nullptr && (result->Type() == objects::ObjectType::RETURN_VALUE || result->Type() == objects::ObjectType::ERROR))
+			{
+				return result;
+			}
+		}
+	}
+
+	inline std::shared_ptr<objects::Object> evalForStatement(std::shared_ptr<ast::ForStatement> fs, std::shared_ptr<objects::Environment> env)
+	{
+		auto start = Eval(fs->pStart, env);
+		if (objects::isError(start))
+		{
+			return start;
+		}
+		auto end = Eval(fs->pEnd, env);
+		if (objects::isError(end))
+		{
+			return end;
+		}
+		if (start->Type() != objects::ObjectType::INTEGER || end->Type() != objects::ObjectType::INTEGER)
+		{
+			return objects::newError("for range bounds must be INTEGER, got " + start->TypeStr() + ".." + end->TypeStr());
+		}
+
+		auto last = std::static_pointer_cast<objects::Integer>(end)->Value;
+		env->Set(fs->pVariable->Value, objects::NULL_OBJ);
+		for (auto i = std::static_pointer_cast<objects::Integer>(start)->Value; i < last; i++)
+		{
+			env->Set(fs->pVariable->Value, std::make_shared<objects::Integer>(i));
+
+			auto result = Eval(fs->pBody, env);
+			if (result != nullptr && (result->Type() == objects::ObjectType::RETURN_VALUE || result->Type() == objects::ObjectType::ERROR))
+			{
+				return result;
+			}
+		}
+		return nullptr;
+	}
+
+	// 与编译器一致: 可以给当前函数的局部变量和全局变量赋值, 外层函数的变量(闭包捕获的)不能赋值
+	inline std::shared_ptr<objects::Object> evalAssignStatement(std::shared_ptr<ast::AssignStatement> as, std::shared_ptr<objects::Environment> env)
+	{
+		auto name = as->pName->Value;
+
+		// 依次查找当前环境、外层环境, 直到最外层的全局环境
+		auto target = env;
+		while (target->store.find(name) == target->store.end() && target->outer != nullptr)
+		{
+			target = target->outer;
+		}
+
+		if (target->store.find(name) == target->store.end())
+		{
+			return objects::newError("identifier not found: " + name);
+		}
+		if (target != env && target->outer != nullptr)
+		{
+			return objects::newError("can not assign to captured variable " + name);
+		}
+
+		std::shared_ptr<objects::Object> val = Eval(as->pValue, env);
+		if (objects::isError(val))
+		{
+			return val;
+		}
+
+		target->Set(name, val);
+		return nullptr;
+	}
+
+	inline std::shared_ptr<objects::Object> evalIfExpression(std::shared_ptr<ast::IfExpression> ie, std::shared_ptr<objects::Environment> env)
 	{
 		std::shared_ptr<objects::Object> condition = Eval(ie->pCondition, env);
 		if (objects::isError(condition))
@@ -135,7 +245,7 @@ namespace evaluator
 		}
 	}
 
-	std::shared_ptr<objects::Object> evalIntegerInfixExpression(std::string ops, std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> right)
+	inline std::shared_ptr<objects::Object> evalIntegerInfixExpression(std::string ops, std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> right)
 	{
 		long long int leftValue = std::dynamic_pointer_cast<objects::Integer>(left)->Value;
 		long long int rightValue = std::dynamic_pointer_cast<objects::Integer>(right)->Value;
@@ -185,7 +295,7 @@ namespace evaluator
 	}
 
 
-	std::shared_ptr<objects::Object> evalStringInfixExpression(std::string ops, std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> right)
+	inline std::shared_ptr<objects::Object> evalStringInfixExpression(std::string ops, std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> right)
 	{
 		if(ops != "+")
 		{
@@ -198,7 +308,7 @@ namespace evaluator
 		return result;
 	}
 
-	std::shared_ptr<objects::Object> evalMinusPrefixOperatorExpression(std::shared_ptr<objects::Object> right)
+	inline std::shared_ptr<objects::Object> evalMinusPrefixOperatorExpression(std::shared_ptr<objects::Object> right)
 	{
 		if (right->Type() != objects::ObjectType::INTEGER)
 		{
@@ -209,7 +319,7 @@ namespace evaluator
 		return std::make_shared<objects::Integer>(-value);
 	}
 
-	std::shared_ptr<objects::Object> evalBangOperatorExpression(std::shared_ptr<objects::Object> right)
+	inline std::shared_ptr<objects::Object> evalBangOperatorExpression(std::shared_ptr<objects::Object> right)
 	{
 		if (right == objects::TRUE_OBJ)
 		{
@@ -229,7 +339,7 @@ namespace evaluator
 		}
 	}
 
-	std::shared_ptr<objects::Object> evalPrefixExpression(std::string ops, std::shared_ptr<objects::Object> right)
+	inline std::shared_ptr<objects::Object> evalPrefixExpression(std::string ops, std::shared_ptr<objects::Object> right)
 	{
 		if (ops == "!")
 		{
@@ -245,7 +355,7 @@ namespace evaluator
 		}
 	}
 
-	std::shared_ptr<objects::Object> evalInfixExpression(std::string ops, std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> right)
+	inline std::shared_ptr<objects::Object> evalInfixExpression(std::string ops, std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> right)
 	{
 		if (left->Type() == objects::ObjectType::INTEGER && right->Type() == objects::ObjectType::INTEGER)
 		{
@@ -273,7 +383,55 @@ namespace evaluator
 		}
 	}
 
-	std::shared_ptr<objects::Object> evalIndexExpression(std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> index)
+	// 按顺序比较各分支的模式, 都不匹配且没有默认分支时结果为null
+	inline std::shared_ptr<objects::Object> evalMatchExpression(std::shared_ptr<ast::MatchExpression> matchObj, std::shared_ptr<objects::Environment> env)
+	{
+		auto subject = Eval(matchObj->pSubject, env);
+		if (objects::isError(subject))
+		{
+			return subject;
+		}
+
+		for (auto &arm : matchObj->Arms)
+		{
+			bool matched = (arm.pPattern == nullptr);
+			if (!matched && arm.pPattern->GetNodeType() == ast::NodeType::IntegerLiteral)
+			{
+				matched = (subject->Type() == objects::ObjectType::INTEGER &&
+						   std::static_pointer_cast<objects::Integer>(subject)->Value == std::static_pointer_cast<ast::IntegerLiteral>(arm.pPattern)->Value);
+			}
+			else if (!matched)
+			{
+				matched = (subject->Type() == objects::ObjectType::STRING &&
+						   std::static_pointer_cast<objects::String>(subject)->Value == std::static_pointer_cast<ast::StringLiteral>(arm.pPattern)->Value);
+			}
+
+			if (matched)
+			{
+				return Eval(arm.pBody, env);
+			}
+		}
+		return objects::NULL_OBJ;
+	}
+
+	// 与编译器一致: 左边能决定结果时不求值右边, 结果是true/false
+	inline std::shared_ptr<objects::Object> evalLogicalExpression(std::shared_ptr<ast::InfixExpression> infixObj, std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Environment> env)
+	{
+		auto isAnd = (infixObj->Operator == "&&");
+		if (objects::isTruthy(left) != isAnd)
+		{
+			return objects::nativeBoolToBooleanObject(!isAnd);
+		}
+
+		auto right = Eval(infixObj->pRight, env);
+		if (objects::isError(right))
+		{
+			return right;
+		}
+		return objects::nativeBoolToBooleanObject(objects::isTruthy(right));
+	}
+
+	inline std::shared_ptr<objects::Object> evalIndexExpression(std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> index)
 	{
 		if(left->Type() == objects::ObjectType::ARRAY && index->Type() == objects::ObjectType::INTEGER)
 		{
@@ -282,13 +440,25 @@ namespace evaluator
 		else if(left->Type() == objects::ObjectType::HASH)
 		{
 			return objects::evalHashIndexExpression(left, index);
+		}
+		else if(left->Type() == objects::ObjectType::INT_ARRAY && index->Type() == objects::ObjectType::INTEGER)
+		{
+			return objects::evalIntArrayIndexExpression(left, index);
+		}
+		else if(left->Type() == objects::ObjectType::SLICE && index->Type() == objects::ObjectType::INTEGER)
+		{
+			return objects::evalSliceIndexExpression(left, index);
+		}
+		else if(left->Type() == objects::ObjectType::HOST_BUFFER && index->Type() == objects::ObjectType::INTEGER)
+		{
+			return objects::evalHostIndexExpression(left, index);
 		} else {
 			return objects::newError("index operator not supported: " + left->TypeStr());
 		}
 	}
 
 
-	std::shared_ptr<objects::Object> evalHashLiteral(std::shared_ptr<ast::HashLiteral> hashNode, std::shared_ptr<objects::Environment> env)
+	inline std::shared_ptr<objects::Object> evalHashLiteral(std::shared_ptr<ast::HashLiteral> hashNode, std::shared_ptr<objects::Environment> env)
 	{
 		std::map<objects::HashKey, std::shared_ptr<objects::HashPair>> pairs{};
 
@@ -318,7 +488,7 @@ namespace evaluator
 		return std::make_shared<objects::Hash>(pairs);
 	}
 
-	std::shared_ptr<objects::Object> evalBlockStatement(std::shared_ptr<ast::BlockStatement> block, std::shared_ptr<objects::Environment> env)
+	inline std::shared_ptr<objects::Object> evalBlockStatement(std::shared_ptr<ast::BlockStatement> block, std::shared_ptr<objects::Environment> env)
 	{
 		std::shared_ptr<objects::Object> result;
 
@@ -338,7 +508,7 @@ namespace evaluator
 		return result;
 	}
 
-	std::shared_ptr<objects::Object> evalProgram(std::shared_ptr<ast::Program> program, std::shared_ptr<objects::Environment> env)
+	inline std::shared_ptr<objects::Object> evalProgram(std::shared_ptr<ast::Program> program, std::shared_ptr<objects::Environment> env)
 	{
 #ifdef DEBUG
 		std::cout << "\t evalProgram: [Enter]" << std::endl;
@@ -382,7 +552,7 @@ namespace evaluator
 		return result;
 	}
 
-	std::shared_ptr<objects::Object> Eval(std::shared_ptr<ast::Node> node, std::shared_ptr<objects::Environment> env)
+	inline std::shared_ptr<objects::Object> Eval(std::shared_ptr<ast::Node> node, std::shared_ptr<objects::Environment> env)
 	{
 		// Statements
 		if (node->GetNodeType() == ast::NodeType::Program)
@@ -453,6 +623,18 @@ namespace evaluator
 #endif
 			env->Set(lit->pName->Value, val);
 		}
+		else if (node->GetNodeType() == ast::NodeType::WhileStatement)
+		{
+			return evalWhileStatement(std::dynamic_pointer_cast<ast::WhileStatement>(node), env);
+		}
+		else if (node->GetNodeType() == ast::NodeType::ForStatement)
+		{
+			return evalForStatement(std::dynamic_pointer_cast<ast::ForStatement>(node), env);
+		}
+		else if (node->GetNodeType() == ast::NodeType::AssignStatement)
+		{
+			return evalAssignStatement(std::dynamic_pointer_cast<ast::AssignStatement>(node), env);
+		}
 		// Expressions
 		else if (node->GetNodeType() == ast::NodeType::IntegerLiteral)
 		{
@@ -505,6 +687,11 @@ namespace evaluator
 				return left;
 			}
 
+			if (infixObj->Operator == "&&" || infixObj->Operator == "||")
+			{
+				return evalLogicalExpression(infixObj, left, env);
+			}
+
 			std::shared_ptr<objects::Object> right = Eval(infixObj->pRight, env);
 			if (objects::isError(right))
 			{
@@ -513,6 +700,10 @@ namespace evaluator
 
 			return evalInfixExpression(infixObj->Operator, left, right);
 		}
+		else if (node->GetNodeType() == ast::NodeType::MatchExpression)
+		{
+			return evalMatchExpression(std::dynamic_pointer_cast<ast::MatchExpression>(node), env);
+		}
 		else if (node->GetNodeType() == ast::NodeType::IfExpression)
 		{
 #ifdef DEBUG
@@ -601,6 +792,33 @@ namespace evaluator
 
 			return evalIndexExpression(left, index);
 		}
+		else if(node->GetNodeType() == ast::NodeType::SliceExpression)
+		{
+			std::shared_ptr<ast::SliceExpression> sliceObj = std::dynamic_pointer_cast<ast::SliceExpression>(node);
+
+			auto left = Eval(sliceObj->Left, env);
+			if(objects::isError(left))
+			{
+				return left;
+			}
+
+			std::shared_ptr<objects::Object> bounds[2] = {objects::NULL_OBJ, objects::NULL_OBJ};
+			std::shared_ptr<ast::Expression> exprs[2] = {sliceObj->pStart, sliceObj->pEnd};
+			for(int i = 0; i < 2; i++)
+			{
+				if(exprs[i] == nullptr)
+				{
+					continue;
+				}
+				bounds[i] = Eval(exprs[i], env);
+				if(objects::isError(bounds[i]))
+				{
+					return bounds[i];
+				}
+			}
+
+			return objects::NewSlice(left, bounds[0], bounds[1]);
+		}
 		else if(node->GetNodeType() == ast::NodeType::HashLiteral)
 		{
 			std::shared_ptr<ast::HashLiteral> hashObj = std::dynamic_pointer_cast<ast::HashLiteral>(node);
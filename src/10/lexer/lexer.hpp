@@ -10,17 +10,17 @@
 namespace lexer
 {
 
-    bool isLetter(char ch)
+    inline bool isLetter(char ch)
     {
         return (('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z') || ch == '_');
     }
 
-    bool isDigit(char ch)
+    inline bool isDigit(char ch)
     {
         return ('0' <= ch && ch <= '9');
     }
 
-    token::Token newToken(token::TokenType tokenType, char ch)
+    inline token::Token newToken(token::TokenType tokenType, char ch)
     {
         token::Token tok;
         tok.Type = tokenType;
@@ -88,9 +88,10 @@ namespace lexer
             return input.substr(oldPosition, position - oldPosition);
         }
 
+        // 支持转义 \n \t \r \" \\, 其它反斜杠原样保留
         std::string readString()
         {
-            int oldPosition = position + 1;
+            std::string str;
             while (true)
             {
                 readChar();
@@ -98,9 +99,23 @@ namespace lexer
                 {
                     break;
                 }
+
+                if(ch == '\\')
+                {
+                    switch(peekChar())
+                    {
+                        case 'n': str.push_back('\n'); readChar(); continue;
+                        case 't': str.push_back('\t'); readChar(); continue;
+                        case 'r': str.push_back('\r'); readChar(); continue;
+                        case '"': str.push_back('"'); readChar(); continue;
+                        case '\\': str.push_back('\\'); readChar(); continue;
+                        default: break;
+                    }
+                }
+                str.push_back(ch);
             }
 
-            return input.substr(oldPosition, position - oldPosition);
+            return str;
         }
 
         std::string readNumber()
@@ -132,6 +147,14 @@ namespace lexer
                     tok.Type = token::types::EQ;
                     tok.Literal = literal;
                 }
+                else if (peekChar() == '>')
+                {
+                    char oldChar = ch;
+                    readChar();
+                    std::string literal = std::string(1, oldChar) + std::string(1, ch);
+                    tok.Type = token::types::ARROW;
+                    tok.Literal = literal;
+                }
                 else
                 {
                     tok = newToken(token::types::ASSIGN, ch);
@@ -164,6 +187,23 @@ namespace lexer
                 }
             }
             break;
+            case '&':
+            case '|':
+            {
+                if (peekChar() == ch)
+                {
+                    char oldChar = ch;
+                    readChar();
+                    std::string literal = std::string(1, oldChar) + std::string(1, ch);
+                    tok.Type = (oldChar == '&' ? token::types::AND : token::types::OR);
+                    tok.Literal = literal;
+                }
+                else
+                {
+                    tok = newToken(token::types::ILLEGAL, ch);
+                }
+            }
+            break;
             case '/':
                 tok = newToken(token::types::SLASH, ch);
                 break;
@@ -203,6 +243,20 @@ namespace lexer
             case ':':
                 tok = newToken(token::types::COLON, ch);
                 break;
+            case '.':
+            {
+                if (peekChar() == '.')
+                {
+                    readChar();
+                    tok.Type = token::types::DOTDOT;
+                    tok.Literal = "..";
+                }
+                else
+                {
+                    tok = newToken(token::types::ILLEGAL, ch);
+                }
+            }
+            break;
             case '"':
             {
                 tok.Type = token::types::STRING;
@@ -241,7 +295,7 @@ namespace lexer
         }
     };
 
-    std::unique_ptr<Lexer> New(std::string input)
+    inline std::unique_ptr<Lexer> New(std::string input)
     {
         std::unique_ptr<Lexer> l = std::make_unique<Lexer>(input);
         l->readChar();
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <cstdlib>
+#include <csignal>
+
+#include "embed/monkey.hpp"
+#include "monkeyd/server.hpp"
+
+// 用法: monkeyd [-socket /tmp/monkeyd.sock] [-workers 4] [-cache 1024] [-memory bytes] [-timeout ms] [-read-timeout ms] [-plugin lib.so]...
+int main(int argc, char **argv)
+{
+    monkeyd::ServerOptions options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string flag = argv[i];
+        if (flag == "-socket")
+        {
+            options.SocketPath = argv[i + 1];
+        }
+        else if (flag == "-workers")
+        {
+            options.Workers = std::atoi(argv[i + 1]);
+        }
+        else if (flag == "-cache")
+        {
+            options.CacheCapacity = std::atoi(argv[i + 1]);
+        }
+        else if (flag == "-memory")
+        {
+            options.MemoryLimit = std::atoll(argv[i + 1]);
+        }
+        else if (flag == "-timeout")
+        {
+            options.TimeLimit = std::atoll(argv[i + 1]);
+        }
+        else if (flag == "-read-timeout")
+        {
+            options.ReadTimeout = std::atoll(argv[i + 1]);
+        }
+        else if (flag == "-plugin")
+        {
+            // 在工作线程创建Runtime之前加载
+            std::string error;
+            if (!monkey::LoadPlugin(argv[i + 1], error))
+            {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            std::cerr << "unknown flag: " << flag << std::endl;
+            return 1;
+        }
+    }
+
+    // 信号只由主线程等待, 工作线程不会被打断
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    auto server = monkeyd::New(options);
+
+    std::string error;
+    if (!server->Listen(error))
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    std::cout << "monkeyd listening on " << options.SocketPath << " with " << options.Workers << " workers" << std::endl;
+
+    std::thread acceptor([&server]() { server->Serve(); });
+
+    int sig = 0;
+    sigwait(&signals, &sig);
+
+    server->Stop();
+    acceptor.join();
+
+    return 0;
+}
@@ -0,0 +1,460 @@
+#ifndef H_MONKEYD_PROTOCOL_H
+#define H_MONKEYD_PROTOCOL_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <poll.h>
+
+#include "embed/monkey.hpp"
+
+// monkeyd 的帧协议: 每帧是 4字节小端长度 + 负载, 负载中的整数都是小端定长编码,
+// 字符串是 4字节长度 + 字节
+namespace monkeyd
+{
+    const uint32_t MaxFrameSize = 64 * 1024 * 1024;
+    const int MaxValueDepth = 64; // Array/Hash的最大嵌套层数, 防止深层嵌套的帧在解码时耗尽栈
+
+    enum class RequestKind : uint8_t
+    {
+        Source = 1,  // 携带源码, 编译后放入程序缓存
+        Program = 2, // 携带之前响应中返回的程序ID
+    };
+
+    enum class Status : uint8_t
+    {
+        Ok = 0,
+        Error = 1,
+    };
+
+    struct Request
+    {
+        RequestKind Kind = RequestKind::Source;
+        std::string Source;
+        uint64_t ProgramID = 0;
+        std::map<std::string, monkey::Value> Globals;
+
+        // 解码时Bytes值直接指向这块负载, 不复制
+        std::shared_ptr<std::string> Payload;
+    };
+
+    struct Response
+    {
+        Status Code = Status::Ok;
+        uint64_t ProgramID = 0; // 本次运行的程序ID, 之后可以直接按ID请求
+        monkey::Value Output;
+        std::string Error;
+    };
+
+    struct Encoder
+    {
+        std::string Buffer;
+
+        void PutU8(const uint8_t &val)
+        {
+            Buffer.push_back(static_cast<char>(val));
+        }
+
+        void PutU32(const uint32_t &val)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                Buffer.push_back(static_cast<char>((val >> (8 * i)) & 0xff));
+            }
+        }
+
+        void PutU64(const uint64_t &val)
+        {
+            for (int i = 0; i < 8; i++)
+            {
+                Buffer.push_back(static_cast<char>((val >> (8 * i)) & 0xff));
+            }
+        }
+
+        void PutBytes(const void *data, const size_t &size)
+        {
+            PutU32(static_cast<uint32_t>(size));
+            Buffer.append(static_cast<const char *>(data), size);
+        }
+
+        void PutString(const std::string &val)
+        {
+            PutBytes(val.data(), val.size());
+        }
+
+        // Int64s/Strings 按Array编码, 只有Bytes保持原始字节
+        void PutValue(const monkey::Value &value)
+        {
+            switch (value.Type)
+            {
+            case monkey::ValueType::Int64s:
+                {
+                    auto data = static_cast<const int64_t *>(value.Data);
+                    PutU8(static_cast<uint8_t>(monkey::ValueType::Array));
+                    PutU32(static_cast<uint32_t>(value.Size));
+                    for (size_t i = 0; i < value.Size; i++)
+                    {
+                        PutValue(monkey::Value::Int(data[i]));
+                    }
+                    return;
+                }
+            case monkey::ValueType::Strings:
+                {
+                    auto data = static_cast<const std::string *>(value.Data);
+                    PutU8(static_cast<uint8_t>(monkey::ValueType::Array));
+                    PutU32(static_cast<uint32_t>(value.Size));
+                    for (size_t i = 0; i < value.Size; i++)
+                    {
+                        PutValue(monkey::Value::Str(data[i]));
+                    }
+                    return;
+                }
+            default:
+                break;
+            }
+
+            PutU8(static_cast<uint8_t>(value.Type));
+            switch (value.Type)
+            {
+            case monkey::ValueType::Integer:
+                PutU64(static_cast<uint64_t>(value.Integer));
+                break;
+            case monkey::ValueType::Boolean:
+                PutU8(value.Boolean ? 1 : 0);
+                break;
+            case monkey::ValueType::String:
+            case monkey::ValueType::Other:
+                PutString(value.String);
+                break;
+            case monkey::ValueType::Array:
+                PutU32(static_cast<uint32_t>(value.Elements.size()));
+                for (auto &item : value.Elements)
+                {
+                    PutValue(item);
+                }
+                break;
+            case monkey::ValueType::Hash:
+                PutU32(static_cast<uint32_t>(value.Keys.size()));
+                for (size_t i = 0; i < value.Keys.size(); i++)
+                {
+                    PutValue(value.Keys[i]);
+                    PutValue(value.Values[i]);
+                }
+                break;
+            case monkey::ValueType::Bytes:
+                PutBytes(value.Data, value.Size);
+                break;
+            default:
+                break;
+            }
+        }
+    };
+
+    // 解码失败(截断、未知标签或嵌套过深)时Ok为false, 之后的读取都返回零值
+    struct Decoder
+    {
+        const char *Data;
+        size_t Size;
+        size_t Pos = 0;
+        bool Ok = true;
+
+        Decoder(const std::string &buffer) : Data(buffer.data()), Size(buffer.size()) {}
+
+        bool ensure(const size_t &n)
+        {
+            if (!Ok || Size - Pos < n)
+            {
+                Ok = false;
+                return false;
+            }
+            return true;
+        }
+
+        uint8_t GetU8()
+        {
+            if (!ensure(1))
+            {
+                return 0;
+            }
+            return static_cast<uint8_t>(Data[Pos++]);
+        }
+
+        uint32_t GetU32()
+        {
+            if (!ensure(4))
+            {
+                return 0;
+            }
+            uint32_t val = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                val |= static_cast<uint32_t>(static_cast<uint8_t>(Data[Pos++])) << (8 * i);
+            }
+            return val;
+        }
+
+        uint64_t GetU64()
+        {
+            if (!ensure(8))
+            {
+                return 0;
+            }
+            uint64_t val = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                val |= static_cast<uint64_t>(static_cast<uint8_t>(Data[Pos++])) << (8 * i);
+            }
+            return val;
+        }
+
+        const char *GetBytes(size_t &size)
+        {
+            size = GetU32();
+            if (!ensure(size))
+            {
+                size = 0;
+                return nullptr;
+            }
+            auto ptr = Data + Pos;
+            Pos += size;
+            return ptr;
+        }
+
+        std::string GetString()
+        {
+            size_t size = 0;
+            auto ptr = GetBytes(size);
+            return (ptr == nullptr ? std::string() : std::string(ptr, size));
+        }
+
+        monkey::Value GetValue(const int &depth = 0)
+        {
+            auto type = static_cast<monkey::ValueType>(GetU8());
+            switch (type)
+            {
+            case monkey::ValueType::Null:
+                return monkey::Value::Null();
+            case monkey::ValueType::Integer:
+                return monkey::Value::Int(static_cast<int64_t>(GetU64()));
+            case monkey::ValueType::Boolean:
+                return monkey::Value::Bool(GetU8() != 0);
+            case monkey::ValueType::String:
+                return monkey::Value::Str(GetString());
+            case monkey::ValueType::Other:
+                {
+                    monkey::Value value;
+                    value.Type = monkey::ValueType::Other;
+                    value.String = GetString();
+                    return value;
+                }
+            case monkey::ValueType::Array:
+                {
+                    if (depth >= MaxValueDepth)
+                    {
+                        Ok = false;
+                        return monkey::Value::Null();
+                    }
+                    std::vector<monkey::Value> elements;
+                    auto count = GetU32();
+                    for (uint32_t i = 0; i < count && Ok; i++)
+                    {
+                        elements.push_back(GetValue(depth + 1));
+                    }
+                    return monkey::Value::List(std::move(elements));
+                }
+            case monkey::ValueType::Hash:
+                {
+                    if (depth >= MaxValueDepth)
+                    {
+                        Ok = false;
+                        return monkey::Value::Null();
+                    }
+                    std::vector<monkey::Value> keys, values;
+                    auto count = GetU32();
+                    for (uint32_t i = 0; i < count && Ok; i++)
+                    {
+                        keys.push_back(GetValue(depth + 1));
+                        values.push_back(GetValue(depth + 1));
+                    }
+                    return monkey::Value::Map(std::move(keys), std::move(values));
+                }
+            case monkey::ValueType::Bytes:
+                {
+                    size_t size = 0;
+                    auto ptr = GetBytes(size);
+                    return monkey::Value::Bytes(reinterpret_cast<const uint8_t *>(ptr), size);
+                }
+            default:
+                Ok = false;
+                return monkey::Value::Null();
+            }
+        }
+    };
+
+    inline std::string EncodeRequest(const Request &request)
+    {
+        Encoder encoder;
+        encoder.PutU8(static_cast<uint8_t>(request.Kind));
+        if (request.Kind == RequestKind::Source)
+        {
+            encoder.PutString(request.Source);
+        }
+        else
+        {
+            encoder.PutU64(request.ProgramID);
+        }
+
+        encoder.PutU32(static_cast<uint32_t>(request.Globals.size()));
+        for (auto &[name, value] : request.Globals)
+        {
+            encoder.PutString(name);
+            encoder.PutValue(value);
+        }
+        return encoder.Buffer;
+    }
+
+    inline bool DecodeRequest(std::shared_ptr<std::string> payload, Request &request)
+    {
+        Decoder decoder(*payload);
+        request.Payload = payload;
+        request.Kind = static_cast<RequestKind>(decoder.GetU8());
+        if (request.Kind == RequestKind::Source)
+        {
+            request.Source = decoder.GetString();
+        }
+        else if (request.Kind == RequestKind::Program)
+        {
+            request.ProgramID = decoder.GetU64();
+        }
+        else
+        {
+            return false;
+        }
+
+        auto count = decoder.GetU32();
+        for (uint32_t i = 0; i < count && decoder.Ok; i++)
+        {
+            auto name = decoder.GetString();
+            request.Globals[name] = decoder.GetValue();
+        }
+        return (decoder.Ok && decoder.Pos == decoder.Size);
+    }
+
+    inline std::string EncodeResponse(const Response &response)
+    {
+        Encoder encoder;
+        encoder.PutU8(static_cast<uint8_t>(response.Code));
+        encoder.PutU64(response.ProgramID);
+        if (response.Code == Status::Ok)
+        {
+            encoder.PutValue(response.Output);
+        }
+        else
+        {
+            encoder.PutString(response.Error);
+        }
+        return encoder.Buffer;
+    }
+
+    // 响应中的Bytes指向payload, payload需要比response活得久
+    inline bool DecodeResponse(const std::string &payload, Response &response)
+    {
+        Decoder decoder(payload);
+        response.Code = static_cast<Status>(decoder.GetU8());
+        response.ProgramID = decoder.GetU64();
+        if (response.Code == Status::Ok)
+        {
+            response.Output = decoder.GetValue();
+        }
+        else
+        {
+            response.Error = decoder.GetString();
+        }
+        return (decoder.Ok && decoder.Pos == decoder.Size);
+    }
+
+    // 非阻塞的套接字写满时等待可写, 超过timeout毫秒(-1表示一直等)仍不可写则失败
+    inline bool writeAll(int fd, const char *data, size_t size, const int &timeout = -1)
+    {
+        while (size > 0)
+        {
+            auto n = send(fd, data, size, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                pollfd pfd{fd, POLLOUT, 0};
+                auto ready = poll(&pfd, 1, timeout);
+                if (ready == 0 || (ready < 0 && errno != EINTR))
+                {
+                    return false;
+                }
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    inline bool readAll(int fd, char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            auto n = read(fd, data, size);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    inline bool WriteFrame(int fd, const std::string &payload, const int &timeout = -1)
+    {
+        Encoder header;
+        header.PutU32(static_cast<uint32_t>(payload.size()));
+        return (writeAll(fd, header.Buffer.data(), header.Buffer.size(), timeout) && writeAll(fd, payload.data(), payload.size(), timeout));
+    }
+
+    // 连接关闭或帧超过MaxFrameSize时返回false
+    inline bool ReadFrame(int fd, std::string &payload)
+    {
+        std::string header(4, '\0');
+        if (!readAll(fd, header.data(), header.size()))
+        {
+            return false;
+        }
+
+        auto size = Decoder(header).GetU32();
+        if (size > MaxFrameSize)
+        {
+            return false;
+        }
+
+        payload.assign(size, '\0');
+        return readAll(fd, payload.data(), size);
+    }
+}
+
+#endif // H_MONKEYD_PROTOCOL_H
@@ -0,0 +1,618 @@
+#ifndef H_MONKEYD_SERVER_H
+#define H_MONKEYD_SERVER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "embed/monkey.hpp"
+#include "monkeyd/protocol.hpp"
+
+namespace monkeyd
+{
+    struct ServerOptions
+    {
+        std::string SocketPath = "/tmp/monkeyd.sock";
+        int Workers = 4;           // 工作线程数, 每个线程持有一个预热好的虚拟机, 按请求而不是按连接分配
+        size_t CacheCapacity = 1024; // 程序缓存上限, 超过后淘汰最早编译的程序
+        int64_t MemoryLimit = 0;     // 每个工作线程的对象堆上限(字节), 0表示不限制
+        int64_t TimeLimit = 10000;   // 每个请求的执行时间上限(毫秒), 0表示不限制
+        int64_t ReadTimeout = 5000;  // 收完一帧请求/写完一个响应的时间上限(毫秒), 0表示不限制; 空闲的连接不受限制
+    };
+
+    // 所有工作线程共享的编译结果, 以 注入变量名 + 源码 为键
+    struct ProgramCache
+    {
+        size_t Capacity;
+        std::mutex mutex;
+        uint64_t nextID = 1;
+        std::map<std::string, uint64_t> ids;
+        std::map<uint64_t, std::pair<std::string, std::shared_ptr<monkey::Program>>> programs;
+
+        ProgramCache(const size_t &capacity) : Capacity(capacity) {}
+
+        static std::string cacheKey(const std::string &source, const std::vector<std::string> &globals)
+        {
+            std::string key;
+            for (auto &name : globals)
+            {
+                key += name + ",";
+            }
+            return key + "\n" + source;
+        }
+
+        std::shared_ptr<monkey::Program> Lookup(const uint64_t &id)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = programs.find(id);
+            return (it == programs.end() ? nullptr : it->second.second);
+        }
+
+        // 命中缓存时不重新编译; 编译在锁外进行, 并发编译同一段源码时保留先插入的结果
+        std::shared_ptr<monkey::Program> Compile(monkey::Runtime &runtime, const std::string &source, const std::vector<std::string> &globals, uint64_t &id, std::string &error)
+        {
+            auto key = cacheKey(source, globals);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (auto it = ids.find(key); it != ids.end())
+                {
+                    id = it->second;
+                    return programs[id].second;
+                }
+            }
+
+            auto program = runtime.Compile(source, globals, error);
+            if (program == nullptr)
+            {
+                return nullptr;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (auto it = ids.find(key); it != ids.end())
+            {
+                id = it->second;
+                return programs[id].second;
+            }
+
+            while (Capacity > 0 && programs.size() >= Capacity)
+            {
+                ids.erase(programs.begin()->second.first);
+                programs.erase(programs.begin());
+            }
+
+            id = nextID++;
+            ids[key] = id;
+            programs[id] = std::make_pair(key, program);
+            return program;
+        }
+
+        size_t Size()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return programs.size();
+        }
+    };
+
+    // 轮询线程维护的连接: 缓冲区里是尚未收完的帧; 有请求在工作线程上执行时不再读它, 响应按请求的顺序返回
+    struct Connection
+    {
+        std::string Buffer;
+        std::chrono::steady_clock::time_point Since; // 缓冲区里的半帧从何时开始接收
+        bool Busy = false;
+    };
+
+    // 收完的一帧请求, 交给任意一个空闲的工作线程
+    struct Job
+    {
+        int Fd = -1;
+        std::shared_ptr<std::string> Payload;
+    };
+
+    struct Server
+    {
+        ServerOptions Options;
+        ProgramCache Cache;
+
+        int listenFd = -1;
+        int wakeFds[2] = {-1, -1}; // 工作线程写完响应或Stop()时写入, 唤醒阻塞在poll上的轮询线程
+        std::atomic<bool> stopping{false};
+        std::atomic<bool> stopped{false};
+
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::condition_variable served;
+        bool serving = false;                       // Serve()正在运行, Stop()要等它退出后才能关闭监听套接字
+        std::deque<Job> jobs;                       // 等待工作线程处理的请求
+        std::vector<std::pair<int, bool>> finished; // 处理完请求的连接, 以及是否继续保留
+        std::vector<std::thread> workers;
+
+        std::map<int, Connection> conns; // 只由轮询线程访问
+
+        Server(const ServerOptions &options) : Options(options), Cache(options.CacheCapacity) {}
+
+        ~Server()
+        {
+            Stop();
+        }
+
+        std::shared_ptr<monkey::Runtime> newWorkerRuntime()
+        {
+            // 编译好的程序在线程间共享, 不能被推测优化原地改写
+            monkey::RuntimeOptions options;
+            options.Speculation = false;
+            options.MemoryLimit = Options.MemoryLimit;
+            options.TimeLimit = Options.TimeLimit;
+            auto runtime = monkey::NewRuntime(options);
+
+            // 预热: 提前分配虚拟机的栈和全局变量存储
+            std::string error;
+            runtime->Run(runtime->Compile("null", error));
+            return runtime;
+        }
+
+        Response Handle(monkey::Runtime &runtime, const Request &request)
+        {
+            Response response;
+            std::shared_ptr<monkey::Program> program;
+
+            if (request.Kind == RequestKind::Source)
+            {
+                std::vector<std::string> globals;
+                for (auto &entry : request.Globals)
+                {
+                    globals.push_back(entry.first);
+                }
+
+                std::string error;
+                program = Cache.Compile(runtime, request.Source, globals, response.ProgramID, error);
+                if (program == nullptr)
+                {
+                    response.Code = Status::Error;
+                    response.Error = error;
+                    return response;
+                }
+            }
+            else
+            {
+                response.ProgramID = request.ProgramID;
+                program = Cache.Lookup(request.ProgramID);
+                if (program == nullptr)
+                {
+                    response.Code = Status::Error;
+                    response.Error = "unknown program: " + std::to_string(request.ProgramID);
+                    return response;
+                }
+            }
+
+            auto result = runtime.Run(program, request.Globals);
+            if (!result.Ok)
+            {
+                response.Code = Status::Error;
+                response.Error = result.Error;
+                return response;
+            }
+
+            response.Output = result.Output;
+            return response;
+        }
+
+        static bool setNonBlocking(int fd)
+        {
+            int flags = fcntl(fd, F_GETFL, 0);
+            return (flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0);
+        }
+
+        bool Listen(std::string &error)
+        {
+            sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            if (Options.SocketPath.size() >= sizeof(addr.sun_path))
+            {
+                error = "socket path too long: " + Options.SocketPath;
+                return false;
+            }
+            strncpy(addr.sun_path, Options.SocketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+            if (pipe(wakeFds) < 0 || !setNonBlocking(wakeFds[0]) || !setNonBlocking(wakeFds[1]))
+            {
+                error = std::string("pipe: ") + strerror(errno);
+                return false;
+            }
+
+            listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listenFd < 0)
+            {
+                error = std::string("socket: ") + strerror(errno);
+                return false;
+            }
+
+            unlink(Options.SocketPath.c_str());
+            if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(listenFd, 128) < 0 || !setNonBlocking(listenFd))
+            {
+                error = Options.SocketPath + ": " + strerror(errno);
+                close(listenFd);
+                listenFd = -1;
+                return false;
+            }
+            return true;
+        }
+
+        // 启动工作线程并在当前线程轮询所有连接, 直到Stop()被调用
+        void Serve()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping)
+                {
+                    return;
+                }
+                serving = true;
+            }
+
+            for (int i = 0; i < Options.Workers; i++)
+            {
+                workers.emplace_back([this]() { workerLoop(); });
+            }
+
+            pollLoop();
+
+            // 轮询出错退出时也要让工作线程结束; 等它们写完手上的响应再关闭连接
+            stopping = true;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready.notify_all();
+            }
+            for (auto &worker : workers)
+            {
+                worker.join();
+            }
+            workers.clear();
+
+            for (auto &[fd, conn] : conns)
+            {
+                close(fd);
+            }
+            conns.clear();
+            jobs.clear();
+            finished.clear();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            serving = false;
+            served.notify_all();
+        }
+
+        void Stop()
+        {
+            if (stopped.exchange(true))
+            {
+                return;
+            }
+            stopping = true;
+            wake();
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.notify_all();
+                served.wait(lock, [this]() { return !serving; });
+            }
+
+            if (listenFd >= 0)
+            {
+                close(listenFd);
+                unlink(Options.SocketPath.c_str());
+                listenFd = -1;
+            }
+            for (auto &fd : wakeFds)
+            {
+                if (fd >= 0)
+                {
+                    close(fd);
+                    fd = -1;
+                }
+            }
+        }
+
+        void wake()
+        {
+            // 管道写满时轮询线程已经有未读的唤醒, 写失败可以忽略
+            char byte = 0;
+            if (wakeFds[1] >= 0)
+            {
+                [[maybe_unused]] auto n = write(wakeFds[1], &byte, 1);
+            }
+        }
+
+        // 空闲的连接只占一个文件描述符, 不占工作线程; 半帧超过ReadTimeout还没收完的连接被关闭
+        void pollLoop()
+        {
+            std::vector<pollfd> fds;
+            while (!stopping)
+            {
+                auto now = std::chrono::steady_clock::now();
+                int timeout = -1;
+
+                fds.clear();
+                fds.push_back({listenFd, POLLIN, 0});
+                fds.push_back({wakeFds[0], POLLIN, 0});
+                for (auto &[fd, conn] : conns)
+                {
+                    if (conn.Busy)
+                    {
+                        continue;
+                    }
+                    fds.push_back({fd, POLLIN, 0});
+                    if (Options.ReadTimeout > 0 && !conn.Buffer.empty())
+                    {
+                        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - conn.Since).count();
+                        auto remaining = static_cast<int>(std::max<int64_t>(0, Options.ReadTimeout - elapsed));
+                        timeout = (timeout < 0 ? remaining : std::min(timeout, remaining));
+                    }
+                }
+
+                if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR)
+                {
+                    break;
+                }
+                if (stopping)
+                {
+                    break;
+                }
+
+                if (fds[1].revents & POLLIN)
+                {
+                    char buf[64];
+                    while (read(wakeFds[0], buf, sizeof(buf)) > 0)
+                    {
+                    }
+                }
+
+                std::vector<std::pair<int, bool>> done;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done.swap(finished);
+                }
+                for (auto &[fd, keep] : done)
+                {
+                    conns[fd].Busy = false;
+                    // 客户端可能已经发来了下一帧
+                    if (!keep || !dispatch(fd))
+                    {
+                        closeConnection(fd);
+                    }
+                }
+
+                for (size_t i = 2; i < fds.size(); i++)
+                {
+                    if (fds[i].revents != 0 && !receive(fds[i].fd))
+                    {
+                        closeConnection(fds[i].fd);
+                    }
+                }
+
+                if (fds[0].revents & POLLIN)
+                {
+                    acceptConnections();
+                }
+
+                if (Options.ReadTimeout > 0)
+                {
+                    now = std::chrono::steady_clock::now();
+                    for (auto it = conns.begin(); it != conns.end();)
+                    {
+                        auto &conn = it->second;
+                        if (!conn.Busy && !conn.Buffer.empty() && now - conn.Since >= std::chrono::milliseconds(Options.ReadTimeout))
+                        {
+                            close(it->first);
+                            it = conns.erase(it);
+                        }
+                        else
+                        {
+                            ++it;
+                        }
+                    }
+                }
+            }
+        }
+
+        void acceptConnections()
+        {
+            while (true)
+            {
+                int fd = accept(listenFd, nullptr, nullptr);
+                if (fd < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    return;
+                }
+                if (!setNonBlocking(fd))
+                {
+                    close(fd);
+                    continue;
+                }
+                conns[fd] = Connection();
+            }
+        }
+
+        void closeConnection(int fd)
+        {
+            close(fd);
+            conns.erase(fd);
+        }
+
+        // 读出套接字里现有的数据; 对端关闭或出错时返回false
+        bool receive(int fd)
+        {
+            auto &conn = conns[fd];
+            char chunk[64 * 1024];
+            while (!conn.Busy)
+            {
+                auto n = read(fd, chunk, sizeof(chunk));
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                {
+                    return true;
+                }
+                if (n <= 0)
+                {
+                    return false;
+                }
+
+                if (conn.Buffer.empty())
+                {
+                    conn.Since = std::chrono::steady_clock::now();
+                }
+                conn.Buffer.append(chunk, n);
+                if (!dispatch(fd))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // 缓冲区里有完整的一帧时交给工作线程; 帧超过MaxFrameSize时返回false
+        bool dispatch(int fd)
+        {
+            auto &conn = conns[fd];
+            if (conn.Busy || conn.Buffer.size() < 4)
+            {
+                return true;
+            }
+
+            auto size = Decoder(conn.Buffer.substr(0, 4)).GetU32();
+            if (size > MaxFrameSize)
+            {
+                return false;
+            }
+            if (conn.Buffer.size() - 4 < size)
+            {
+                return true;
+            }
+
+            auto payload = std::make_shared<std::string>(conn.Buffer, 4, size);
+            conn.Buffer.erase(0, 4 + size);
+            conn.Since = std::chrono::steady_clock::now();
+            conn.Busy = true;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(Job{fd, payload});
+            ready.notify_one();
+            return true;
+        }
+
+        // 工作线程每次只处理一个请求, 不会被一个连接长期占用; 格式错误的帧回复错误后断开
+        void workerLoop()
+        {
+            auto runtime = newWorkerRuntime();
+            while (true)
+            {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ready.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                    if (stopping)
+                    {
+                        return;
+                    }
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+
+                Request request;
+                Response response;
+                bool keep = DecodeRequest(job.Payload, request);
+                if (keep)
+                {
+                    response = Handle(*runtime, request);
+                }
+                else
+                {
+                    response.Code = Status::Error;
+                    response.Error = "malformed request";
+                }
+
+                int timeout = (Options.ReadTimeout > 0 ? static_cast<int>(Options.ReadTimeout) : -1);
+                keep = WriteFrame(job.Fd, EncodeResponse(response), timeout) && keep;
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    finished.emplace_back(job.Fd, keep);
+                }
+                wake();
+            }
+        }
+    };
+
+    inline std::shared_ptr<Server> New(const ServerOptions &options)
+    {
+        return std::make_shared<Server>(options);
+    }
+
+    // 客户端: 一个连接上顺序发送请求
+    struct Client
+    {
+        int fd = -1;
+
+        ~Client()
+        {
+            Close();
+        }
+
+        bool Connect(const std::string &path, std::string &error)
+        {
+            sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+            fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+            {
+                error = path + ": " + strerror(errno);
+                Close();
+                return false;
+            }
+            return true;
+        }
+
+        // payload 保存响应的原始字节, 响应中的Bytes值指向它
+        bool Call(const Request &request, Response &response, std::string &payload)
+        {
+            return (WriteFrame(fd, EncodeRequest(request)) && ReadFrame(fd, payload) && DecodeResponse(payload, response));
+        }
+
+        void Close()
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+    };
+}
+
+#endif // H_MONKEYD_SERVER_H
@@ -5,12 +5,21 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <string_view>
+#include <algorithm>
+#include <cctype>
 
 #include "objects/objects.hpp"
+#include "objects/host.hpp"
+#include "objects/intarray.hpp"
+#include "objects/seq.hpp"
+#include "objects/csv.hpp"
+#include "objects/file.hpp"
+#include "objects/text.hpp"
 
 namespace objects
 {
-    int fibonacci(const int& num){
+    inline int fibonacci(const int& num){
         if(num == 0){
             return 0;
         } else if(num == 1){
@@ -21,18 +30,33 @@ namespace objects
     }
 
     using BuiltinFunction = std::shared_ptr<objects::Object> (*)(std::vector<std::shared_ptr<objects::Object>>& args);
+    // 插件函数的调用入口: 参数是连续的count个对象(VM中直接指向栈), native是插件函数的描述
+    using NativeInvoker = std::shared_ptr<objects::Object> (*)(const void *native, std::shared_ptr<objects::Object> *args, const size_t &count);
 
 	struct Builtin: Object
 	{
 		BuiltinFunction Fn;
+		NativeInvoker Invoke = nullptr; // Fn为空时通过Invoke调用插件函数
+		const void *Native = nullptr;
 
 		Builtin(BuiltinFunction fn): Fn(fn){}
+		Builtin(NativeInvoker invoke, const void *native): Fn(nullptr), Invoke(invoke), Native(native){}
+
+		std::shared_ptr<objects::Object> Call(std::vector<std::shared_ptr<objects::Object>>& args)
+		{
+			if(Fn != nullptr)
+			{
+				return Fn(args);
+			}
+			return Invoke(Native, args.data(), args.size());
+		}
+
 		virtual ~Builtin(){}
 		virtual ObjectType Type() { return ObjectType::BUILTIN; }
 		virtual std::string Inspect() { return "builltin function"; }
 	};
 
-    std::shared_ptr<objects::Object> BuiltinFunc_Len([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Len([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
     {
         if(args.size() != 1)
         {
@@ -47,13 +71,25 @@ namespace objects
         {
             return std::make_shared<objects::Integer>(obj->Elements.size());
         }
+        else if(std::shared_ptr<objects::IntArray> obj = std::dynamic_pointer_cast<objects::IntArray>(args[0]); obj != nullptr)
+        {
+            return std::make_shared<objects::Integer>(obj->Values.size());
+        }
+        else if(std::shared_ptr<objects::ArraySlice> obj = std::dynamic_pointer_cast<objects::ArraySlice>(args[0]); obj != nullptr)
+        {
+            return std::make_shared<objects::Integer>(obj->Length);
+        }
+        else if(std::shared_ptr<objects::HostBuffer> obj = std::dynamic_pointer_cast<objects::HostBuffer>(args[0]); obj != nullptr)
+        {
+            return std::make_shared<objects::Integer>(obj->Length);
+        }
         else
         {
             return objects::newError("argument to `len` not supported, got " + args[0]->TypeStr());
         }
     }
 
-    std::shared_ptr<objects::Object> BuiltinFunc_First([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    inline std::shared_ptr<objects::Object> BuiltinFunc_First([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
     {
         if(args.size() != 1)
         {
@@ -69,13 +105,40 @@ namespace objects
                 return nullptr;
             }
         }
+        else if(std::shared_ptr<objects::IntArray> obj = std::dynamic_pointer_cast<objects::IntArray>(args[0]); obj != nullptr)
+        {
+            if(obj->Values.size() > 0)
+            {
+                return obj->At(0);
+            } else {
+                return nullptr;
+            }
+        }
+        else if(std::shared_ptr<objects::ArraySlice> obj = std::dynamic_pointer_cast<objects::ArraySlice>(args[0]); obj != nullptr)
+        {
+            if(obj->Length > 0)
+            {
+                return obj->At(0);
+            } else {
+                return nullptr;
+            }
+        }
+        else if(std::shared_ptr<objects::HostBuffer> obj = std::dynamic_pointer_cast<objects::HostBuffer>(args[0]); obj != nullptr)
+        {
+            if(obj->Length > 0)
+            {
+                return obj->At(0);
+            } else {
+                return nullptr;
+            }
+        }
         else
         {
             return objects::newError("argument to `first` must be ARRAY, got " + args[0]->TypeStr());
         }
     }
 
-    std::shared_ptr<objects::Object> BuiltinFunc_Last([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Last([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
     {
         if(args.size() != 1)
         {
@@ -92,27 +155,82 @@ namespace objects
                 return nullptr;
             }
         }
+        else if(std::shared_ptr<objects::IntArray> obj = std::dynamic_pointer_cast<objects::IntArray>(args[0]); obj != nullptr)
+        {
+            auto len = obj->Values.size();
+            if(len > 0)
+            {
+                return obj->At(len - 1);
+            } else {
+                return nullptr;
+            }
+        }
+        else if(std::shared_ptr<objects::ArraySlice> obj = std::dynamic_pointer_cast<objects::ArraySlice>(args[0]); obj != nullptr)
+        {
+            if(obj->Length > 0)
+            {
+                return obj->At(obj->Length - 1);
+            } else {
+                return nullptr;
+            }
+        }
+        else if(std::shared_ptr<objects::HostBuffer> obj = std::dynamic_pointer_cast<objects::HostBuffer>(args[0]); obj != nullptr)
+        {
+            if(obj->Length > 0)
+            {
+                return obj->At(obj->Length - 1);
+            } else {
+                return nullptr;
+            }
+        }
         else
         {
             return objects::newError("argument to `last` must be ARRAY, got " + args[0]->TypeStr());
         }
     }
 
-    std::shared_ptr<objects::Object> BuiltinFunc_Rest([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Rest([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
     {
         if(args.size() != 1)
         {
             return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
         }
 
+        // 结果是与参数共享存储的切片, 递归处理数组时每一步都是O(1)
         if(std::shared_ptr<objects::Array> obj = std::dynamic_pointer_cast<objects::Array>(args[0]); obj != nullptr)
         {
             auto len = obj->Elements.size();
             if(len > 0)
             {
-                std::vector<std::shared_ptr<objects::Object>> elements;
-                std::copy(obj->Elements.begin()+1, obj->Elements.end(), back_inserter(elements));
-                return std::make_shared<objects::Array>(elements);
+                return std::make_shared<objects::ArraySlice>(obj, 1, len - 1);
+            } else {
+                return nullptr;
+            }
+        }
+        else if(std::shared_ptr<objects::IntArray> obj = std::dynamic_pointer_cast<objects::IntArray>(args[0]); obj != nullptr)
+        {
+            auto len = obj->Values.size();
+            if(len > 0)
+            {
+                return std::make_shared<objects::ArraySlice>(obj, 1, len - 1);
+            } else {
+                return nullptr;
+            }
+        }
+        else if(std::shared_ptr<objects::ArraySlice> obj = std::dynamic_pointer_cast<objects::ArraySlice>(args[0]); obj != nullptr)
+        {
+            if(obj->Length > 0)
+            {
+                return std::make_shared<objects::ArraySlice>(obj->Base, obj->Offset + 1, obj->Length - 1);
+            } else {
+                return nullptr;
+            }
+        }
+        else if(std::shared_ptr<objects::HostBuffer> obj = std::dynamic_pointer_cast<objects::HostBuffer>(args[0]); obj != nullptr)
+        {
+            if(obj->Length > 0)
+            {
+                return obj->Slice(1, obj->Length);
             } else {
                 return nullptr;
             }
@@ -123,7 +241,7 @@ namespace objects
         }
     }
 
-    std::shared_ptr<objects::Object> BuiltinFunc_Push([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Push([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
     {
         if(args.size() != 2)
         {
@@ -132,28 +250,60 @@ namespace objects
 
         if(std::shared_ptr<objects::Array> obj = std::dynamic_pointer_cast<objects::Array>(args[0]); obj != nullptr)
         {
+            // 往空数组里放整数得到IntArray, 循环里累积的数值结果保持紧凑
+            if(obj->Elements.empty() && args[1]->Type() == objects::ObjectType::INTEGER)
+            {
+                return std::make_shared<objects::IntArray>(std::vector<int64_t>{std::static_pointer_cast<objects::Integer>(args[1])->Value});
+            }
+
             std::vector<std::shared_ptr<objects::Object>> elements;
             std::copy(obj->Elements.begin(), obj->Elements.end(), back_inserter(elements));
             elements.push_back(args[1]);
             return std::make_shared<objects::Array>(elements);
         }
+        else if(std::shared_ptr<objects::IntArray> obj = std::dynamic_pointer_cast<objects::IntArray>(args[0]); obj != nullptr)
+        {
+            if(args[1]->Type() == objects::ObjectType::INTEGER)
+            {
+                std::vector<int64_t> values;
+                values.reserve(obj->Values.size() + 1);
+                values.insert(values.end(), obj->Values.begin(), obj->Values.end());
+                values.push_back(std::static_pointer_cast<objects::Integer>(args[1])->Value);
+                return std::make_shared<objects::IntArray>(std::move(values));
+            }
+
+            std::vector<std::shared_ptr<objects::Object>> elements;
+            for(auto &v: obj->Values)
+            {
+                elements.push_back(std::make_shared<objects::Integer>(v));
+            }
+            elements.push_back(args[1]);
+            return std::make_shared<objects::Array>(elements);
+        }
+        else if(args[0]->Type() == objects::ObjectType::SLICE)
+        {
+            // 切片先复制成独立数组再追加
+            std::vector<std::shared_ptr<objects::Object>> pushArgs{std::static_pointer_cast<objects::ArraySlice>(args[0])->Materialize(), args[1]};
+            return BuiltinFunc_Push(pushArgs);
+        }
         else
         {
             return objects::newError("argument to `push` must be ARRAY, got " + args[0]->TypeStr());
         }
     }
 
-    std::shared_ptr<objects::Object> BuiltinFunc_Puts([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Puts([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
     {
         for(const auto& obj: args)
         {
-            std::cout << obj->Inspect() << std::endl;
+            // 不逐次刷新, 输出攒在标准输出的缓冲区里, 读标准输入或程序退出时写出
+            std::cout << obj->Inspect() << '\n';
         }
         
         return nullptr;
     }
 
-    std::shared_ptr<objects::Object> BuiltinFunc_Fibonacci([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Fibonacci([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
     {
         if(args.size() != 1)
         {
@@ -175,29 +325,1130 @@ namespace objects
         }
     }
 
-    struct BuiltinWithName
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Memo([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
     {
-        std::string Name;
-        std::shared_ptr<objects::Builtin> Builtin;
+        if(args.size() != 1 && args.size() != 2)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1 or 2");
+        }
 
-        BuiltinWithName(const std::string name, BuiltinFunction fn)
-            : Name(name)
+        int capacity = objects::MemoCapacity;
+        if(args.size() == 2)
+        {
+            std::shared_ptr<objects::Integer> obj = std::dynamic_pointer_cast<objects::Integer>(args[1]);
+            if(obj == nullptr)
+            {
+                return objects::newError("second argument to `memo` must be INTEGER, got " + args[1]->TypeStr());
+            }
+            capacity = obj->Value;
+        }
+
+        if(std::shared_ptr<objects::Closure> obj = std::dynamic_pointer_cast<objects::Closure>(args[0]); obj != nullptr)
+        {
+            auto memoized = std::make_shared<objects::Closure>(obj->Fn, obj->Free);
+            memoized->Memo = std::make_shared<objects::MemoTable>(capacity);
+            return memoized;
+        }
+        else if(std::shared_ptr<objects::Function> obj = std::dynamic_pointer_cast<objects::Function>(args[0]); obj != nullptr)
+        {
+            auto memoized = std::make_shared<objects::Function>(*obj);
+            memoized->Memo = std::make_shared<objects::MemoTable>(capacity);
+            return memoized;
+        }
+        else
+        {
+            return objects::newError("argument to `memo` must be a function, got " + args[0]->TypeStr());
+        }
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Range([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() < 1 || args.size() > 3)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1, 2 or 3");
+        }
+
+        int64_t bounds[3] = {0, 0, 1};
+        for(unsigned long i = 0; i < args.size(); i++)
+        {
+            if(args[i]->Type() != objects::ObjectType::INTEGER)
+            {
+                return objects::newError("argument to `range` must be INTEGER, got " + args[i]->TypeStr());
+            }
+            bounds[(args.size() == 1 ? 1 : i)] = std::static_pointer_cast<objects::Integer>(args[i])->Value;
+        }
+
+        int64_t start = bounds[0], stop = bounds[1], step = bounds[2];
+        if(step == 0)
+        {
+            return objects::newError("`range` step can not be zero");
+        }
+
+        // 按无符号数计算, 两端相距超过INT64_MAX或step为INT64_MIN时也不会溢出
+        uint64_t distance = 0;
+        uint64_t stride = (step > 0 ? static_cast<uint64_t>(step) : 0 - static_cast<uint64_t>(step));
+        if(step > 0 && stop > start)
+        {
+            distance = static_cast<uint64_t>(stop) - static_cast<uint64_t>(start);
+        }
+        else if(step < 0 && stop < start)
+        {
+            distance = static_cast<uint64_t>(start) - static_cast<uint64_t>(stop);
+        }
+        uint64_t count = distance / stride + (distance % stride != 0 ? 1 : 0);
+
+        if(count > objects::MaxIntArrayLength)
+        {
+            return objects::newError("`range` is too large: " + std::to_string(count) + " elements, at most " + std::to_string(objects::MaxIntArrayLength));
+        }
+        if(!objects::HeapAllows(count * sizeof(int64_t)))
+        {
+            return objects::newError("memory limit exceeded: `range` needs " + std::to_string(count * sizeof(int64_t)) + " bytes, limit is " + std::to_string(objects::currentHeap->Limit));
+        }
+
+        std::vector<int64_t> values(count);
+        for(uint64_t i = 0; i < count; i++)
+        {
+            values[i] = static_cast<int64_t>(static_cast<uint64_t>(start) + i * static_cast<uint64_t>(step));
+        }
+        return std::make_shared<objects::IntArray>(std::move(values));
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Sum([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() != 1)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+        }
+
+        if(args[0]->Type() == objects::ObjectType::SEQ)
+        {
+            int64_t total = 0;
+            auto err = objects::ForEach(std::static_pointer_cast<objects::Seq>(args[0]), [&total](std::shared_ptr<objects::Object> &item) -> std::shared_ptr<objects::Object> {
+                if(item->Type() != objects::ObjectType::INTEGER)
+                {
+                    return objects::newError("elements summed by `sum` must be INTEGER, got " + item->TypeStr());
+                }
+                total += static_cast<objects::Integer*>(item.get())->Value;
+                return nullptr;
+            });
+            return (err != nullptr ? err : std::make_shared<objects::Integer>(total));
+        }
+
+        objects::IntSpan span;
+        if(!objects::AsIntSpan(args[0], span))
+        {
+            return objects::newError("argument to `sum` must be an integer array, got " + args[0]->TypeStr());
+        }
+        return std::make_shared<objects::Integer>(objects::kernelSum(span.Data, span.Length));
+    }
+
+    inline std::shared_ptr<objects::Object> builtinExtremum(std::vector<std::shared_ptr<objects::Object>>& args, const std::string& name)
+    {
+        if(args.size() != 1)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+        }
+
+        objects::IntSpan span;
+        if(!objects::AsIntSpan(args[0], span))
+        {
+            return objects::newError("argument to `" + name + "` must be an integer array, got " + args[0]->TypeStr());
+        }
+        if(span.Length == 0)
+        {
+            return objects::NULL_OBJ;
+        }
+
+        auto value = (name == "min" ? objects::kernelMin(span.Data, span.Length) : objects::kernelMax(span.Data, span.Length));
+        return std::make_shared<objects::Integer>(value);
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Min([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        return builtinExtremum(args, "min");
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Max([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        return builtinExtremum(args, "max");
+    }
+
+    // add/mul: 两个等长整数数组逐元素运算, 或者数组与整数标量运算
+    inline std::shared_ptr<objects::Object> builtinElementwise(std::vector<std::shared_ptr<objects::Object>>& args, const std::string& name)
+    {
+        if(args.size() != 2)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=2");
+        }
+
+        objects::IntSpan left;
+        if(!objects::AsIntSpan(args[0], left))
+        {
+            return objects::newError("first argument to `" + name + "` must be an integer array, got " + args[0]->TypeStr());
+        }
+
+        objects::IntSpan right;
+        int64_t scalar = 0;
+        const int64_t *other = nullptr;
+        if(args[1]->Type() == objects::ObjectType::INTEGER)
+        {
+            scalar = std::static_pointer_cast<objects::Integer>(args[1])->Value;
+        }
+        else if(objects::AsIntSpan(args[1], right))
+        {
+            if(right.Length != left.Length)
+            {
+                return objects::newError("arguments to `" + name + "` must have the same length, got " + std::to_string(left.Length) + " and " + std::to_string(right.Length));
+            }
+            other = right.Data;
+        }
+        else
+        {
+            return objects::newError("second argument to `" + name + "` must be INTEGER or an integer array, got " + args[1]->TypeStr());
+        }
+
+        std::vector<int64_t> values(left.Length);
+        if(name == "add")
+        {
+            objects::kernelAdd(values.data(), left.Data, other, scalar, left.Length);
+        }
+        else
+        {
+            objects::kernelMul(values.data(), left.Data, other, scalar, left.Length);
+        }
+        return std::make_shared<objects::IntArray>(std::move(values));
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Add([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        return builtinElementwise(args, "add");
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Mul([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        return builtinElementwise(args, "mul");
+    }
+
+    // filter(arr, "<", 10): 保留满足比较条件的元素, 比较符支持< <= > >= == !=
+    // 第二个参数是函数时结果是惰性序列; map/filter/take/zip可以接收数组或序列
+    inline std::shared_ptr<objects::Object> builtinSeqStage(std::vector<std::shared_ptr<objects::Object>>& args, const std::string& name)
+    {
+        if(args.size() != 2)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=2");
+        }
+
+        auto source = objects::AsSeq(args[0]);
+        if(source == nullptr)
+        {
+            return objects::newError("first argument to `" + name + "` must be ARRAY or SEQ, got " + args[0]->TypeStr());
+        }
+
+        auto fnType = args[1]->Type();
+        if(name != "take" && name != "zip" && fnType != objects::ObjectType::CLOSURE && fnType != objects::ObjectType::FUNCTION && fnType != objects::ObjectType::BUILTIN)
+        {
+            return objects::newError("second argument to `" + name + "` must be a function, got " + args[1]->TypeStr());
+        }
+
+        if(name == "map")
+        {
+            return std::make_shared<objects::MapSeq>(source, args[1]);
+        }
+        else if(name == "filter")
+        {
+            return std::make_shared<objects::FilterSeq>(source, args[1]);
+        }
+        else if(name == "take")
+        {
+            if(fnType != objects::ObjectType::INTEGER)
+            {
+                return objects::newError("second argument to `take` must be INTEGER, got " + args[1]->TypeStr());
+            }
+            return std::make_shared<objects::TakeSeq>(source, std::static_pointer_cast<objects::Integer>(args[1])->Value);
+        }
+
+        auto other = objects::AsSeq(args[1]);
+        if(other == nullptr)
+        {
+            return objects::newError("second argument to `zip` must be ARRAY or SEQ, got " + args[1]->TypeStr());
+        }
+        return std::make_shared<objects::ZipSeq>(source, other);
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Map([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        return builtinSeqStage(args, "map");
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Take([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        return builtinSeqStage(args, "take");
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Zip([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        return builtinSeqStage(args, "zip");
+    }
+
+    // iter(数组或序列) 或 iter(start, end): [start, end)区间的整数, 不生成数组
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Iter([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() == 2)
+        {
+            if(args[0]->Type() != objects::ObjectType::INTEGER || args[1]->Type() != objects::ObjectType::INTEGER)
+            {
+                return objects::newError("arguments to `iter` must be INTEGER, got " + args[0]->TypeStr() + " and " + args[1]->TypeStr());
+            }
+            return std::make_shared<objects::CountSeq>(std::static_pointer_cast<objects::Integer>(args[0])->Value,
+                                                       std::static_pointer_cast<objects::Integer>(args[1])->Value);
+        }
+        if(args.size() != 1)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1 or 2");
+        }
+
+        auto seq = objects::AsSeq(args[0]);
+        if(seq == nullptr)
+        {
+            return objects::newError("argument to `iter` must be ARRAY or SEQ, got " + args[0]->TypeStr());
+        }
+        return seq;
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Reduce([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() != 3)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=3");
+        }
+
+        auto seq = objects::AsSeq(args[0]);
+        if(seq == nullptr)
+        {
+            return objects::newError("first argument to `reduce` must be ARRAY or SEQ, got " + args[0]->TypeStr());
+        }
+
+        std::vector<std::shared_ptr<objects::Object>> callArgs{args[1], nullptr};
+        auto fn = args[2];
+        auto err = objects::ForEach(seq, [&](std::shared_ptr<objects::Object> &item) -> std::shared_ptr<objects::Object> {
+            callArgs[1] = item;
+            auto acc = objects::CallFunction(fn, callArgs);
+            if(objects::isError(acc))
+            {
+                return acc;
+            }
+            callArgs[0] = acc;
+            return nullptr;
+        });
+        return (err != nullptr ? err : callArgs[0]);
+    }
+
+    // 把序列的元素收集成数组, 全是整数时是IntArray
+    inline std::shared_ptr<objects::Object> BuiltinFunc_ToArray([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() != 1)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+        }
+
+        auto seq = objects::AsSeq(args[0]);
+        if(seq == nullptr)
+        {
+            return objects::newError("argument to `to_array` must be ARRAY or SEQ, got " + args[0]->TypeStr());
+        }
+
+        std::vector<std::shared_ptr<objects::Object>> elements;
+        auto err = objects::ForEach(seq, [&elements](std::shared_ptr<objects::Object> &item) -> std::shared_ptr<objects::Object> {
+            elements.push_back(item);
+            return nullptr;
+        });
+        if(err != nullptr)
+        {
+            return err;
+        }
+
+        if(auto packed = objects::PackIntegers(elements); packed != nullptr)
+        {
+            return packed;
+        }
+        return std::make_shared<objects::Array>(elements);
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Filter([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() == 2)
+        {
+            return builtinSeqStage(args, "filter");
+        }
+        if(args.size() != 3)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=2 or 3");
+        }
+
+        objects::IntSpan span;
+        if(!objects::AsIntSpan(args[0], span))
+        {
+            return objects::newError("first argument to `filter` must be an integer array, got " + args[0]->TypeStr());
+        }
+        if(args[1]->Type() != objects::ObjectType::STRING)
+        {
+            return objects::newError("second argument to `filter` must be STRING, got " + args[1]->TypeStr());
+        }
+        if(args[2]->Type() != objects::ObjectType::INTEGER)
+        {
+            return objects::newError("third argument to `filter` must be INTEGER, got " + args[2]->TypeStr());
+        }
+
+        auto op = std::static_pointer_cast<objects::String>(args[1])->Value;
+        auto rhs = std::static_pointer_cast<objects::Integer>(args[2])->Value;
+
+        std::vector<int64_t> values(span.Length);
+        int64_t kept = 0;
+        if(op == "<")
+        {
+            kept = objects::kernelFilter(values.data(), span.Data, span.Length, [rhs](int64_t v){ return v < rhs; });
+        }
+        else if(op == "<=")
+        {
+            kept = objects::kernelFilter(values.data(), span.Data, span.Length, [rhs](int64_t v){ return v <= rhs; });
+        }
+        else if(op == ">")
+        {
+            kept = objects::kernelFilter(values.data(), span.Data, span.Length, [rhs](int64_t v){ return v > rhs; });
+        }
+        else if(op == ">=")
+        {
+            kept = objects::kernelFilter(values.data(), span.Data, span.Length, [rhs](int64_t v){ return v >= rhs; });
+        }
+        else if(op == "==")
+        {
+            kept = objects::kernelFilter(values.data(), span.Data, span.Length, [rhs](int64_t v){ return v == rhs; });
+        }
+        else if(op == "!=")
+        {
+            kept = objects::kernelFilter(values.data(), span.Data, span.Length, [rhs](int64_t v){ return v != rhs; });
+        }
+        else
+        {
+            return objects::newError("unknown comparison for `filter`: " + op);
+        }
+
+        values.resize(kept);
+        values.shrink_to_fit();
+        return std::make_shared<objects::IntArray>(std::move(values));
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Dot([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() != 2)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=2");
+        }
+
+        objects::IntSpan left, right;
+        if(!objects::AsIntSpan(args[0], left) || !objects::AsIntSpan(args[1], right))
+        {
+            return objects::newError("arguments to `dot` must be integer arrays, got " + args[0]->TypeStr() + " and " + args[1]->TypeStr());
+        }
+        if(left.Length != right.Length)
+        {
+            return objects::newError("arguments to `dot` must have the same length, got " + std::to_string(left.Length) + " and " + std::to_string(right.Length));
+        }
+        return std::make_shared<objects::Integer>(objects::kernelDot(left.Data, right.Data, left.Length));
+    }
+
+    // 哈希表不可变: set/delete/merge返回新表, 键值对(HashPair)在新旧表之间共享, 只复制索引.
+    // 结果与参数相同时(删除不存在的键, 合并空表)直接返回原表
+    inline std::shared_ptr<objects::Hash> hashArgument(std::vector<std::shared_ptr<objects::Object>>& args, const std::string &name, const size_t &want, std::shared_ptr<objects::Object> &err)
+    {
+        if(args.size() != want)
+        {
+            err = objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=" + std::to_string(want));
+            return nullptr;
+        }
+        if(args[0]->Type() != objects::ObjectType::HASH)
+        {
+            err = objects::newError("first argument to `" + name + "` must be HASH, got " + args[0]->TypeStr());
+            return nullptr;
+        }
+        return std::static_pointer_cast<objects::Hash>(args[0]);
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Keys([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        std::shared_ptr<objects::Object> err;
+        auto hash = hashArgument(args, "keys", 1, err);
+        if(hash == nullptr)
+        {
+            return err;
+        }
+
+        std::vector<std::shared_ptr<objects::Object>> keys;
+        keys.reserve(hash->Pairs.size());
+        for(auto &[key, pair]: hash->Pairs)
+        {
+            [[maybe_unused]] auto x = key;
+            keys.push_back(pair->Key);
+        }
+        if(auto packed = objects::PackIntegers(keys); packed != nullptr)
+        {
+            return packed;
+        }
+        return std::make_shared<objects::Array>(keys);
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Values([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        std::shared_ptr<objects::Object> err;
+        auto hash = hashArgument(args, "values", 1, err);
+        if(hash == nullptr)
+        {
+            return err;
+        }
+
+        std::vector<std::shared_ptr<objects::Object>> values;
+        values.reserve(hash->Pairs.size());
+        for(auto &[key, pair]: hash->Pairs)
+        {
+            [[maybe_unused]] auto x = key;
+            values.push_back(pair->Value);
+        }
+        if(auto packed = objects::PackIntegers(values); packed != nullptr)
+        {
+            return packed;
+        }
+        return std::make_shared<objects::Array>(values);
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Has([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        std::shared_ptr<objects::Object> err;
+        auto hash = hashArgument(args, "has", 2, err);
+        if(hash == nullptr)
+        {
+            return err;
+        }
+        if(!args[1]->Hashable())
+        {
+            return objects::newError("unusable as hash key: " + args[1]->TypeStr());
+        }
+        return objects::nativeBoolToBooleanObject(hash->Pairs.count(args[1]->GetHashKey()) > 0);
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Set([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        std::shared_ptr<objects::Object> err;
+        auto hash = hashArgument(args, "set", 3, err);
+        if(hash == nullptr)
+        {
+            return err;
+        }
+        if(!args[1]->Hashable())
+        {
+            return objects::newError("unusable as hash key: " + args[1]->TypeStr());
+        }
+
+        auto hashed = args[1]->GetHashKey();
+        if(auto fit = hash->Pairs.find(hashed); fit != hash->Pairs.end() && fit->second->Value == args[2])
+        {
+            return hash;
+        }
+
+        auto pairs = hash->Pairs;
+        pairs[hashed] = std::make_shared<objects::HashPair>(args[1], args[2]);
+        return std::make_shared<objects::Hash>(pairs);
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Delete([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        std::shared_ptr<objects::Object> err;
+        auto hash = hashArgument(args, "delete", 2, err);
+        if(hash == nullptr)
+        {
+            return err;
+        }
+        if(!args[1]->Hashable())
+        {
+            return objects::newError("unusable as hash key: " + args[1]->TypeStr());
+        }
+
+        auto hashed = args[1]->GetHashKey();
+        if(hash->Pairs.count(hashed) == 0)
+        {
+            return hash;
+        }
+
+        auto pairs = hash->Pairs;
+        pairs.erase(hashed);
+        return std::make_shared<objects::Hash>(pairs);
+    }
+
+    // 键相同时取第二个表的值
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Merge([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        std::shared_ptr<objects::Object> err;
+        auto hash = hashArgument(args, "merge", 2, err);
+        if(hash == nullptr)
+        {
+            return err;
+        }
+        if(args[1]->Type() != objects::ObjectType::HASH)
+        {
+            return objects::newError("second argument to `merge` must be HASH, got " + args[1]->TypeStr());
+        }
+
+        auto other = std::static_pointer_cast<objects::Hash>(args[1]);
+        if(other->Pairs.empty())
+        {
+            return hash;
+        }
+        if(hash->Pairs.empty())
+        {
+            return other;
+        }
+
+        auto pairs = hash->Pairs;
+        for(auto &[key, pair]: other->Pairs)
+        {
+            pairs[key] = pair;
+        }
+        return std::make_shared<objects::Hash>(pairs);
+    }
+
+    // read_csv(path)或read_csv(path, {"delimiter": ";", "header": false, "threads": 4}); .tsv文件默认用制表符分隔
+    inline std::shared_ptr<objects::Object> BuiltinFunc_ReadCsv([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() != 1 && args.size() != 2)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1 or 2");
+        }
+        if(args[0]->Type() != objects::ObjectType::STRING)
+        {
+            return objects::newError("first argument to `read_csv` must be STRING, got " + args[0]->TypeStr());
+        }
+
+        auto path = std::static_pointer_cast<objects::String>(args[0])->Value;
+        objects::CsvOptions options;
+        if(path.size() >= 4 && path.compare(path.size() - 4, 4, ".tsv") == 0)
+        {
+            options.Delimiter = '\t';
+        }
+
+        if(args.size() == 2)
+        {
+            if(args[1]->Type() != objects::ObjectType::HASH)
+            {
+                return objects::newError("second argument to `read_csv` must be HASH, got " + args[1]->TypeStr());
+            }
+
+            auto &pairs = std::static_pointer_cast<objects::Hash>(args[1])->Pairs;
+            auto option = [&pairs](const std::string &name) -> std::shared_ptr<objects::Object> {
+                auto fit = pairs.find(std::make_shared<objects::String>(name)->GetHashKey());
+                return (fit == pairs.end() ? nullptr : fit->second->Value);
+            };
+
+            if(auto delimiter = option("delimiter"); delimiter != nullptr)
+            {
+                if(delimiter->Type() != objects::ObjectType::STRING || std::static_pointer_cast<objects::String>(delimiter)->Value.size() != 1)
+                {
+                    return objects::newError("`read_csv` option delimiter must be a single character, got " + delimiter->Inspect());
+                }
+                options.Delimiter = std::static_pointer_cast<objects::String>(delimiter)->Value[0];
+            }
+            if(auto header = option("header"); header != nullptr)
+            {
+                if(header->Type() != objects::ObjectType::BOOLEAN)
+                {
+                    return objects::newError("`read_csv` option header must be BOOLEAN, got " + header->TypeStr());
+                }
+                options.Header = std::static_pointer_cast<objects::Boolean>(header)->Value;
+            }
+            if(auto threads = option("threads"); threads != nullptr)
+            {
+                if(threads->Type() != objects::ObjectType::INTEGER || std::static_pointer_cast<objects::Integer>(threads)->Value < 1)
+                {
+                    return objects::newError("`read_csv` option threads must be a positive INTEGER, got " + threads->Inspect());
+                }
+                options.Threads = std::static_pointer_cast<objects::Integer>(threads)->Value;
+            }
+        }
+
+        return objects::ReadCsv(path, options);
+    }
+
+    // 文件读写: open(path[, "r"|"w"|"a"])返回文件句柄, read_line读到末尾时返回null, write返回写入的字节数
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Open([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() != 1 && args.size() != 2)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1 or 2");
+        }
+        if(args[0]->Type() != objects::ObjectType::STRING)
+        {
+            return objects::newError("first argument to `open` must be STRING, got " + args[0]->TypeStr());
+        }
+
+        std::string mode = "r";
+        if(args.size() == 2)
+        {
+            if(args[1]->Type() != objects::ObjectType::STRING)
+            {
+                return objects::newError("second argument to `open` must be STRING, got " + args[1]->TypeStr());
+            }
+            mode = std::static_pointer_cast<objects::String>(args[1])->Value;
+            if(mode != "r" && mode != "w" && mode != "a")
+            {
+                return objects::newError("unknown mode for `open`: " + mode);
+            }
+        }
+
+        auto file = std::make_shared<objects::File>();
+        std::string err;
+        if(!file->Stream.Open(std::static_pointer_cast<objects::String>(args[0])->Value, mode, err))
+        {
+            return objects::newError(err);
+        }
+        return file;
+    }
+
+    // 检查第一个参数是打开着的文件; writable表示需要可写的文件, 否则需要可读的文件
+    inline std::shared_ptr<objects::File> fileArgument(std::vector<std::shared_ptr<objects::Object>>& args, const std::string &name, const size_t &want, const bool &writable, std::shared_ptr<objects::Object> &err)
+    {
+        if(args.size() != want)
+        {
+            err = objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=" + std::to_string(want));
+            return nullptr;
+        }
+        if(args[0]->Type() != objects::ObjectType::FILE)
+        {
+            err = objects::newError("first argument to `" + name + "` must be FILE, got " + args[0]->TypeStr());
+            return nullptr;
+        }
+
+        auto file = std::static_pointer_cast<objects::File>(args[0]);
+        if(file->Stream.Fd < 0)
+        {
+            err = objects::newError("`" + name + "` on a closed file: " + file->Stream.Path);
+            return nullptr;
+        }
+        if(file->Stream.Writable != writable)
+        {
+            err = objects::newError("file " + file->Stream.Path + " is not open for " + (writable ? "writing" : "reading"));
+            return nullptr;
+        }
+        return file;
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_ReadLine([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        std::shared_ptr<objects::Object> result;
+        auto file = fileArgument(args, "read_line", 1, false, result);
+        if(file == nullptr)
+        {
+            return result;
+        }
+
+        std::string line, err;
+        if(!file->Stream.ReadLine(line, err))
+        {
+            return (err.empty() ? nullptr : objects::newError(err));
+        }
+        return std::make_shared<objects::String>(line);
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_ReadAll([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        std::shared_ptr<objects::Object> result;
+        auto file = fileArgument(args, "read_all", 1, false, result);
+        if(file == nullptr)
+        {
+            return result;
+        }
+
+        std::string content, err;
+        if(!file->Stream.ReadAll(content, err))
+        {
+            return objects::newError(err);
+        }
+        return std::make_shared<objects::String>(content);
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Write([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        std::shared_ptr<objects::Object> result;
+        auto file = fileArgument(args, "write", 2, true, result);
+        if(file == nullptr)
+        {
+            return result;
+        }
+        if(args[1]->Type() != objects::ObjectType::STRING)
+        {
+            return objects::newError("second argument to `write` must be STRING, got " + args[1]->TypeStr());
+        }
+
+        auto &data = std::static_pointer_cast<objects::String>(args[1])->Value;
+        std::string err;
+        if(!file->Stream.Write(data, err))
+        {
+            return objects::newError(err);
+        }
+        return std::make_shared<objects::Integer>(data.size());
+    }
+
+    // 写出缓冲的数据并关闭, 对已关闭的文件什么也不做
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Close([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() != 1)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+        }
+        if(args[0]->Type() != objects::ObjectType::FILE)
+        {
+            return objects::newError("argument to `close` must be FILE, got " + args[0]->TypeStr());
+        }
+
+        std::string err;
+        if(!std::static_pointer_cast<objects::File>(args[0])->Stream.Close(err))
+        {
+            return objects::newError(err);
+        }
+        return nullptr;
+    }
+
+    // lines(path): 逐行读文件的惰性序列
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Lines([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() != 1)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+        }
+        if(args[0]->Type() != objects::ObjectType::STRING)
+        {
+            return objects::newError("argument to `lines` must be STRING, got " + args[0]->TypeStr());
+        }
+        return std::make_shared<objects::LineSeq>(std::static_pointer_cast<objects::String>(args[0])->Value);
+    }
+
+    // 字符串: 结果按最终长度一次分配, 下标和长度都按字节计算
+    inline std::shared_ptr<objects::Object> stringArgument(std::vector<std::shared_ptr<objects::Object>>& args, const size_t &index, const std::string &name, std::string_view &str)
+    {
+        if(args[index]->Type() != objects::ObjectType::STRING)
+        {
+            static const char *ordinals[] = {"first", "second", "third"};
+            return objects::newError(std::string(ordinals[index]) + " argument to `" + name + "` must be STRING, got " + args[index]->TypeStr());
+        }
+        str = std::static_pointer_cast<objects::String>(args[index])->Value;
+        return nullptr;
+    }
+
+    // split(s, sep); split(s)按空白切分
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Split([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() != 1 && args.size() != 2)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1 or 2");
+        }
+
+        std::string_view str, sep;
+        if(auto err = stringArgument(args, 0, "split", str); err != nullptr)
+        {
+            return err;
+        }
+        if(args.size() == 2)
+        {
+            if(auto err = stringArgument(args, 1, "split", sep); err != nullptr)
+            {
+                return err;
+            }
+            if(sep.empty())
+            {
+                return objects::newError("separator for `split` must not be empty");
+            }
+        }
+
+        std::vector<std::shared_ptr<objects::Object>> elements;
+        for(auto &part: objects::SplitString(str, sep))
+        {
+            elements.push_back(std::make_shared<objects::String>(std::string(part)));
+        }
+        return std::make_shared<objects::Array>(elements);
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Join([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() != 1 && args.size() != 2)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1 or 2");
+        }
+
+        auto seq = objects::AsSeq(args[0]);
+        if(seq == nullptr)
+        {
+            return objects::newError("first argument to `join` must be ARRAY or SEQ, got " + args[0]->TypeStr());
+        }
+        std::string_view sep;
+        if(args.size() == 2)
+        {
+            if(auto err = stringArgument(args, 1, "join", sep); err != nullptr)
+            {
+                return err;
+            }
+        }
+
+        // 先收集各段再按总长度一次分配; 持有元素避免序列产出的临时字符串被释放
+        std::vector<std::shared_ptr<objects::Object>> parts;
+        size_t total = 0;
+        auto err = objects::ForEach(seq, [&](std::shared_ptr<objects::Object> &item) -> std::shared_ptr<objects::Object> {
+            if(item->Type() != objects::ObjectType::STRING)
+            {
+                return objects::newError("elements joined by `join` must be STRING, got " + item->TypeStr());
+            }
+            total += std::static_pointer_cast<objects::String>(item)->Value.size();
+            parts.push_back(item);
+            return nullptr;
+        });
+        if(err != nullptr)
+        {
+            return err;
+        }
+
+        std::string out;
+        out.reserve(total + (parts.empty() ? 0 : (parts.size() - 1) * sep.size()));
+        for(size_t i = 0; i < parts.size(); i++)
+        {
+            if(i > 0)
+            {
+                out.append(sep);
+            }
+            out.append(std::static_pointer_cast<objects::String>(parts[i])->Value);
+        }
+        return std::make_shared<objects::String>(out);
+    }
+
+    // substr(s, start[, length]), 越界时截断
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Substr([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() != 2 && args.size() != 3)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=2 or 3");
+        }
+
+        std::string_view str;
+        if(auto err = stringArgument(args, 0, "substr", str); err != nullptr)
+        {
+            return err;
+        }
+        for(size_t i = 1; i < args.size(); i++)
+        {
+            if(args[i]->Type() != objects::ObjectType::INTEGER)
+            {
+                return objects::newError("arguments to `substr` must be INTEGER, got " + args[i]->TypeStr());
+            }
+        }
+
+        int64_t size = str.size();
+        auto start = std::clamp<int64_t>(std::static_pointer_cast<objects::Integer>(args[1])->Value, 0, size);
+        auto length = size - start;
+        if(args.size() == 3)
+        {
+            length = std::clamp<int64_t>(std::static_pointer_cast<objects::Integer>(args[2])->Value, 0, size - start);
+        }
+        return std::make_shared<objects::String>(std::string(str.substr(start, length)));
+    }
+
+    // find(s, needle[, from]), 找不到时返回-1
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Find([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() != 2 && args.size() != 3)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=2 or 3");
+        }
+
+        std::string_view str, needle;
+        if(auto err = stringArgument(args, 0, "find", str); err != nullptr)
+        {
+            return err;
+        }
+        if(auto err = stringArgument(args, 1, "find", needle); err != nullptr)
+        {
+            return err;
+        }
+
+        int64_t from = 0;
+        if(args.size() == 3)
+        {
+            if(args[2]->Type() != objects::ObjectType::INTEGER)
+            {
+                return objects::newError("third argument to `find` must be INTEGER, got " + args[2]->TypeStr());
+            }
+            from = std::max<int64_t>(std::static_pointer_cast<objects::Integer>(args[2])->Value, 0);
+        }
+
+        auto pos = objects::FindSubstring(str, needle, from);
+        return std::make_shared<objects::Integer>(pos == std::string_view::npos ? -1 : static_cast<int64_t>(pos));
+    }
+
+    // replace(s, old, new)替换所有出现的old
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Replace([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() != 3)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=3");
+        }
+
+        std::string_view str, from, to;
+        for(auto [index, view]: {std::make_pair(0, &str), std::make_pair(1, &from), std::make_pair(2, &to)})
+        {
+            if(auto err = stringArgument(args, index, "replace", *view); err != nullptr)
+            {
+                return err;
+            }
+        }
+        if(from.empty())
+        {
+            return objects::newError("string replaced by `replace` must not be empty");
+        }
+
+        std::vector<size_t> hits;
+        for(auto pos = objects::FindSubstring(str, from); pos != std::string_view::npos; pos = objects::FindSubstring(str, from, pos + from.size()))
+        {
+            hits.push_back(pos);
+        }
+        if(hits.empty())
+        {
+            return args[0];
+        }
+
+        std::string out;
+        out.reserve(str.size() + hits.size() * to.size() - hits.size() * from.size());
+        size_t last = 0;
+        for(auto pos: hits)
+        {
+            out.append(str.substr(last, pos - last)).append(to);
+            last = pos + from.size();
+        }
+        out.append(str.substr(last));
+        return std::make_shared<objects::String>(out);
+    }
+
+    // 只转换ASCII字母
+    inline std::shared_ptr<objects::Object> changeCase(std::vector<std::shared_ptr<objects::Object>>& args, const std::string &name, int (*convert)(int))
+    {
+        if(args.size() != 1)
+        {
+            return objects::newError("wrong number of arguments. got=" + std::to_string(args.size()) + ", want=1");
+        }
+
+        std::string_view str;
+        if(auto err = stringArgument(args, 0, name, str); err != nullptr)
+        {
+            return err;
+        }
+
+        std::string out(str);
+        for(auto &c: out)
+        {
+            if(static_cast<unsigned char>(c) < 0x80)
+            {
+                c = convert(c);
+            }
+        }
+        return std::make_shared<objects::String>(out);
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Upper([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        return changeCase(args, "upper", [](int c) { return toupper(c); });
+    }
+
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Lower([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        return changeCase(args, "lower", [](int c) { return tolower(c); });
+    }
+
+    // format("%s=%05d", name, value)
+    inline std::shared_ptr<objects::Object> BuiltinFunc_Format([[maybe_unused]] std::vector<std::shared_ptr<objects::Object>>& args)
+    {
+        if(args.size() < 1)
+        {
+            return objects::newError("wrong number of arguments. got=0, want at least 1");
+        }
+
+        std::string_view format;
+        if(auto err = stringArgument(args, 0, "format", format); err != nullptr)
+        {
+            return err;
+        }
+        return objects::FormatString(format, args, 1);
+    }
+
+    struct BuiltinWithName
+    {
+        std::string Name;
+        std::shared_ptr<objects::Builtin> Builtin;
+        bool Pure; // 无副作用, 结果只取决于参数
+        bool Foldable; // 参数都是字面量时可以在编译期求值(纯函数且开销很小)
+
+        BuiltinWithName(const std::string name, BuiltinFunction fn, bool pure = false, bool foldable = false)
+            : Name(name), Pure(pure), Foldable(foldable)
+        {
+            Builtin = std::make_shared<objects::Builtin>(fn);
+        }
+
+        BuiltinWithName(const std::string name, std::shared_ptr<objects::Builtin> builtin, bool pure = false)
+            : Name(name), Builtin(builtin), Pure(pure), Foldable(false)
         {
-            Builtin = std::make_shared<objects::Builtin>(fn);
         }
     };
 
-    std::vector<std::shared_ptr<objects::BuiltinWithName>> Builtins{
-        std::make_shared<objects::BuiltinWithName>("len", &BuiltinFunc_Len),
+    inline std::vector<std::shared_ptr<objects::BuiltinWithName>> Builtins{
+        std::make_shared<objects::BuiltinWithName>("len", &BuiltinFunc_Len, true, true),
         std::make_shared<objects::BuiltinWithName>("puts", &BuiltinFunc_Puts),
-        std::make_shared<objects::BuiltinWithName>("first", &BuiltinFunc_First),
-        std::make_shared<objects::BuiltinWithName>("last", &BuiltinFunc_Last),
-        std::make_shared<objects::BuiltinWithName>("rest", &BuiltinFunc_Rest),
-        std::make_shared<objects::BuiltinWithName>("push", &BuiltinFunc_Push),
-        std::make_shared<objects::BuiltinWithName>("fibonacci", &BuiltinFunc_Fibonacci),
+        std::make_shared<objects::BuiltinWithName>("first", &BuiltinFunc_First, true, true),
+        std::make_shared<objects::BuiltinWithName>("last", &BuiltinFunc_Last, true, true),
+        std::make_shared<objects::BuiltinWithName>("rest", &BuiltinFunc_Rest, true, true),
+        std::make_shared<objects::BuiltinWithName>("push", &BuiltinFunc_Push, true, true),
+        std::make_shared<objects::BuiltinWithName>("fibonacci", &BuiltinFunc_Fibonacci, true),
+        std::make_shared<objects::BuiltinWithName>("memo", &BuiltinFunc_Memo),
+        std::make_shared<objects::BuiltinWithName>("range", &BuiltinFunc_Range, true),
+        std::make_shared<objects::BuiltinWithName>("sum", &BuiltinFunc_Sum, false, true),
+        std::make_shared<objects::BuiltinWithName>("min", &BuiltinFunc_Min, true, true),
+        std::make_shared<objects::BuiltinWithName>("max", &BuiltinFunc_Max, true, true),
+        std::make_shared<objects::BuiltinWithName>("add", &BuiltinFunc_Add, true, true),
+        std::make_shared<objects::BuiltinWithName>("mul", &BuiltinFunc_Mul, true, true),
+        std::make_shared<objects::BuiltinWithName>("filter", &BuiltinFunc_Filter, false, true),
+        std::make_shared<objects::BuiltinWithName>("dot", &BuiltinFunc_Dot, true, true),
+        std::make_shared<objects::BuiltinWithName>("iter", &BuiltinFunc_Iter, true),
+        std::make_shared<objects::BuiltinWithName>("map", &BuiltinFunc_Map),
+        std::make_shared<objects::BuiltinWithName>("take", &BuiltinFunc_Take, true),
+        std::make_shared<objects::BuiltinWithName>("zip", &BuiltinFunc_Zip, true),
+        std::make_shared<objects::BuiltinWithName>("reduce", &BuiltinFunc_Reduce),
+        std::make_shared<objects::BuiltinWithName>("to_array", &BuiltinFunc_ToArray),
+        std::make_shared<objects::BuiltinWithName>("keys", &BuiltinFunc_Keys, true),
+        std::make_shared<objects::BuiltinWithName>("values", &BuiltinFunc_Values, true),
+        std::make_shared<objects::BuiltinWithName>("has", &BuiltinFunc_Has, true),
+        std::make_shared<objects::BuiltinWithName>("set", &BuiltinFunc_Set, true),
+        std::make_shared<objects::BuiltinWithName>("delete", &BuiltinFunc_Delete, true),
+        std::make_shared<objects::BuiltinWithName>("merge", &BuiltinFunc_Merge, true),
+        std::make_shared<objects::BuiltinWithName>("read_csv", &BuiltinFunc_ReadCsv),
+        std::make_shared<objects::BuiltinWithName>("open", &BuiltinFunc_Open),
+        std::make_shared<objects::BuiltinWithName>("read_line", &BuiltinFunc_ReadLine),
+        std::make_shared<objects::BuiltinWithName>("read_all", &BuiltinFunc_ReadAll),
+        std::make_shared<objects::BuiltinWithName>("write", &BuiltinFunc_Write),
+        std::make_shared<objects::BuiltinWithName>("close", &BuiltinFunc_Close),
+        std::make_shared<objects::BuiltinWithName>("lines", &BuiltinFunc_Lines),
+        std::make_shared<objects::BuiltinWithName>("split", &BuiltinFunc_Split, true, true),
+        std::make_shared<objects::BuiltinWithName>("join", &BuiltinFunc_Join, false, true),
+        std::make_shared<objects::BuiltinWithName>("substr", &BuiltinFunc_Substr, true, true),
+        std::make_shared<objects::BuiltinWithName>("find", &BuiltinFunc_Find, true, true),
+        std::make_shared<objects::BuiltinWithName>("replace", &BuiltinFunc_Replace, true, true),
+        std::make_shared<objects::BuiltinWithName>("upper", &BuiltinFunc_Upper, true, true),
+        std::make_shared<objects::BuiltinWithName>("lower", &BuiltinFunc_Lower, true, true),
+        std::make_shared<objects::BuiltinWithName>("format", &BuiltinFunc_Format, true, true),
     };
 
-    std::shared_ptr<objects::Builtin> GetBuiltinByName(const std::string& name)
+    inline std::shared_ptr<objects::Builtin> GetBuiltinByName(const std::string& name)
     {
         for(auto &def: Builtins)
         {
@@ -0,0 +1,301 @@
+#ifndef H_CSV_H
+#define H_CSV_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+
+#include "objects/objects.hpp"
+#include "objects/intarray.hpp"
+#include "objects/mapped_file.hpp"
+
+namespace objects
+{
+    const size_t CsvMinChunk = 1 << 20; // 每个线程至少解析1MB, 小文件不开线程
+
+    struct CsvOptions
+    {
+        char Delimiter = ',';
+        bool Header = true; // 第一行是列名, 否则列名为0, 1, 2...
+        int Threads = 0;    // 0表示取CPU核数
+    };
+
+    // 拆分一行[begin, end)的字段. 支持双引号包围的字段和其中的""转义, 不支持引号内换行;
+    // 不含转义的字段直接指向文件映射, 含转义的去掉转义后存入owned
+    inline void SplitCsvLine(const char *begin, const char *end, const char delimiter,
+                             std::vector<std::string_view> &fields, std::deque<std::string> &owned)
+    {
+        fields.clear();
+        const char *p = begin;
+        while (true)
+        {
+            if (p < end && *p == '"')
+            {
+                const char *start = ++p;
+                bool escaped = false;
+                while (p < end && !(*p == '"' && (p + 1 == end || p[1] != '"')))
+                {
+                    if (*p == '"')
+                    {
+                        escaped = true;
+                        p++;
+                    }
+                    p++;
+                }
+
+                std::string_view field(start, p - start);
+                if (escaped)
+                {
+                    std::string value;
+                    for (size_t i = 0; i < field.size(); i++)
+                    {
+                        value.push_back(field[i]);
+                        if (field[i] == '"')
+                        {
+                            i++;
+                        }
+                    }
+                    owned.push_back(std::move(value));
+                    field = owned.back();
+                }
+                fields.push_back(field);
+
+                p = static_cast<const char *>(memchr(p, delimiter, end - p));
+            }
+            else
+            {
+                const char *next = static_cast<const char *>(memchr(p, delimiter, end - p));
+                fields.emplace_back(p, (next == nullptr ? end : next) - p);
+                p = next;
+            }
+
+            if (p == nullptr || p >= end)
+            {
+                return;
+            }
+            p++;
+        }
+    }
+
+    // 一个线程负责的若干整行. 这里只记录字段位置和解析出的整数, 对象在合并时由调用线程创建(堆记账是线程局部的)
+    struct CsvChunk
+    {
+        const char *Begin;
+        const char *End;
+        std::vector<std::vector<std::string_view>> Cells; // 按列存放
+        std::vector<std::vector<int64_t>> Ints;           // 整数列的值, 出现非整数后清空
+        std::vector<bool> Integral;
+        std::deque<std::string> Owned;
+        int64_t Rows = 0;
+        int64_t BadRow = -1; // 第一个字段数不对的行
+        size_t BadFields = 0;
+
+        void Parse(const char delimiter, const size_t columns)
+        {
+            Cells.assign(columns, {});
+            Ints.assign(columns, {});
+            Integral.assign(columns, true);
+
+            std::vector<std::string_view> fields;
+            const char *p = Begin;
+            while (p < End)
+            {
+                const char *eol = static_cast<const char *>(memchr(p, '\n', End - p));
+                const char *next = (eol == nullptr ? End : eol + 1);
+                if (eol == nullptr)
+                {
+                    eol = End;
+                }
+                if (eol > p && eol[-1] == '\r')
+                {
+                    eol--;
+                }
+                if (eol == p)
+                {
+                    p = next;
+                    continue;
+                }
+
+                SplitCsvLine(p, eol, delimiter, fields, Owned);
+                if (fields.size() != columns)
+                {
+                    BadRow = Rows;
+                    BadFields = fields.size();
+                    return;
+                }
+
+                for (size_t c = 0; c < columns; c++)
+                {
+                    auto &field = fields[c];
+                    Cells[c].push_back(field);
+                    if (!Integral[c])
+                    {
+                        continue;
+                    }
+
+                    int64_t value;
+                    auto [ptr, ec] = std::from_chars(field.data(), field.data() + field.size(), value);
+                    if (field.empty() || ec != std::errc() || ptr != field.data() + field.size())
+                    {
+                        Integral[c] = false;
+                        std::vector<int64_t>().swap(Ints[c]);
+                        continue;
+                    }
+                    Ints[c].push_back(value);
+                }
+
+                Rows++;
+                p = next;
+            }
+        }
+    };
+
+    // 映射文件后按行边界切成若干段并行解析, 返回 列名 -> 列 的哈希表:
+    // 全是整数的列为IntArray, 其它列为字符串数组, 同一列中相同的字符串共用一个对象
+    inline std::shared_ptr<Object> ReadCsv(const std::string &path, const CsvOptions &options)
+    {
+        MappedFile file;
+        std::string error;
+        if (!file.Open(path, error))
+        {
+            return newError(error);
+        }
+
+        const char *end = file.Data + file.Size;
+        const char *eol = static_cast<const char *>(memchr(file.Data, '\n', file.Size));
+        const char *body = (eol == nullptr ? end : eol + 1);
+        if (eol == nullptr)
+        {
+            eol = end;
+        }
+        if (eol > file.Data && eol[-1] == '\r')
+        {
+            eol--;
+        }
+
+        std::vector<std::string_view> first;
+        std::deque<std::string> owned;
+        SplitCsvLine(file.Data, eol, options.Delimiter, first, owned);
+        auto columns = first.size();
+
+        // 列名重复时后面的列会覆盖前面的列, 直接报错
+        std::vector<std::shared_ptr<Object>> names;
+        std::unordered_set<std::string_view> seen;
+        for (size_t c = 0; c < columns; c++)
+        {
+            if (options.Header)
+            {
+                if (!seen.insert(first[c]).second)
+                {
+                    return newError(path + ": duplicate column \"" + std::string(first[c]) + "\"");
+                }
+                names.push_back(std::make_shared<String>(std::string(first[c])));
+            }
+            else
+            {
+                names.push_back(std::make_shared<Integer>(c));
+            }
+        }
+        if (!options.Header)
+        {
+            body = file.Data;
+        }
+
+        size_t threads = (options.Threads > 0 ? options.Threads : std::max(1u, std::thread::hardware_concurrency()));
+        threads = std::min(threads, static_cast<size_t>(end - body) / CsvMinChunk + 1);
+
+        std::vector<CsvChunk> chunks(threads);
+        const char *from = body;
+        for (size_t i = 0; i < threads; i++)
+        {
+            const char *to = (i + 1 == threads ? end : body + (end - body) * (i + 1) / threads);
+            if (to < from)
+            {
+                to = from;
+            }
+            if (to < end)
+            {
+                auto nl = static_cast<const char *>(memchr(to, '\n', end - to));
+                to = (nl == nullptr ? end : nl + 1);
+            }
+            chunks[i].Begin = from;
+            chunks[i].End = to;
+            from = to;
+        }
+
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < threads; i++)
+        {
+            workers.emplace_back([&chunks, &options, columns, i]() { chunks[i].Parse(options.Delimiter, columns); });
+        }
+        chunks[0].Parse(options.Delimiter, columns);
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+
+        int64_t rows = 0;
+        for (auto &chunk : chunks)
+        {
+            if (chunk.BadRow >= 0)
+            {
+                return newError(path + ": row " + std::to_string(rows + chunk.BadRow + 1) + " has " + std::to_string(chunk.BadFields) +
+                                " fields, expected " + std::to_string(columns));
+            }
+            rows += chunk.Rows;
+        }
+
+        std::map<HashKey, std::shared_ptr<HashPair>> pairs;
+        for (size_t c = 0; c < columns; c++)
+        {
+            bool integral = std::all_of(chunks.begin(), chunks.end(), [c](CsvChunk &chunk) { return chunk.Integral[c]; });
+
+            std::shared_ptr<Object> column;
+            if (integral)
+            {
+                std::vector<int64_t> values;
+                values.reserve(rows);
+                for (auto &chunk : chunks)
+                {
+                    values.insert(values.end(), chunk.Ints[c].begin(), chunk.Ints[c].end());
+                }
+                column = std::make_shared<IntArray>(std::move(values));
+            }
+            else
+            {
+                std::unordered_map<std::string_view, std::shared_ptr<Object>> interned;
+                std::vector<std::shared_ptr<Object>> elements;
+                elements.reserve(rows);
+                for (auto &chunk : chunks)
+                {
+                    for (auto &cell : chunk.Cells[c])
+                    {
+                        auto &str = interned[cell];
+                        if (str == nullptr)
+                        {
+                            str = std::make_shared<String>(std::string(cell));
+                        }
+                        elements.push_back(str);
+                    }
+                }
+                column = std::make_shared<Array>(elements);
+            }
+
+            pairs[names[c]->GetHashKey()] = std::make_shared<HashPair>(names[c], column);
+        }
+
+        return std::make_shared<Hash>(pairs);
+    }
+}
+
+#endif // H_CSV_H
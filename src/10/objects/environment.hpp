@@ -88,14 +88,14 @@ namespace objects
 		}
 	};
 
-	std::shared_ptr<objects::Environment> NewEnvironment()
+	inline std::shared_ptr<objects::Environment> NewEnvironment()
 	{
 		std::shared_ptr<Environment> env = std::make_shared<Environment>();
 		env->outer = nullptr;
 		return env;
 	}
 
-	std::shared_ptr<objects::Environment> NewEnclosedEnvironment(std::shared_ptr<objects::Environment> outer)
+	inline std::shared_ptr<objects::Environment> NewEnclosedEnvironment(std::shared_ptr<objects::Environment> outer)
 	{
 		std::shared_ptr<objects::Environment> env = NewEnvironment();
 		env->outer = outer;
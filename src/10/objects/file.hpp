@@ -0,0 +1,283 @@
+#ifndef H_FILE_H
+#define H_FILE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "objects/objects.hpp"
+#include "objects/seq.hpp"
+
+namespace objects
+{
+    const size_t FileBufferSize = 1 << 18; // 读写缓冲区大小, 每次系统调用最多搬运这么多字节
+
+    // 带用户态缓冲的文件读写: 读时一次read(2)填满缓冲区再从中切行, 写时攒满缓冲区或关闭时才write(2)
+    struct FileStream
+    {
+        std::string Path;
+        int Fd = -1;
+        bool Writable = false;
+        std::vector<char> Buffer;
+        size_t Pos = 0;  // 读: [Pos, Fill)是还没取走的数据
+        size_t Fill = 0; // 写: [0, Fill)是还没写出的数据
+
+        FileStream() {}
+        FileStream(const FileStream &) = delete;
+        FileStream &operator=(const FileStream &) = delete;
+
+        ~FileStream()
+        {
+            std::string err;
+            Close(err);
+        }
+
+        // mode: "r"读, "w"清空后写, "a"追加
+        bool Open(const std::string &path, const std::string &mode, std::string &err)
+        {
+            int flags = O_RDONLY;
+            if (mode == "w")
+            {
+                flags = O_WRONLY | O_CREAT | O_TRUNC;
+            }
+            else if (mode == "a")
+            {
+                flags = O_WRONLY | O_CREAT | O_APPEND;
+            }
+
+            Fd = open(path.c_str(), flags | O_CLOEXEC, 0644);
+            if (Fd < 0)
+            {
+                err = path + ": " + strerror(errno);
+                return false;
+            }
+            Path = path;
+            Writable = (mode != "r");
+            Buffer.resize(FileBufferSize);
+            return true;
+        }
+
+        // 读入更多数据, 返回读到的字节数, 0表示文件结束, -1表示出错
+        ssize_t readMore(std::string &err)
+        {
+            if (Pos > 0)
+            {
+                memmove(Buffer.data(), Buffer.data() + Pos, Fill - Pos);
+                Fill -= Pos;
+                Pos = 0;
+            }
+
+            ssize_t n;
+            do
+            {
+                n = read(Fd, Buffer.data() + Fill, Buffer.size() - Fill);
+            } while (n < 0 && errno == EINTR);
+
+            if (n < 0)
+            {
+                err = Path + ": " + strerror(errno);
+                return -1;
+            }
+            Fill += n;
+            return n;
+        }
+
+        // 读一行(不含换行符和其前的\r), 返回false表示已到文件末尾或出错(err非空)
+        bool ReadLine(std::string &line, std::string &err)
+        {
+            line.clear();
+            bool any = false;
+            while (true)
+            {
+                if (Pos < Fill)
+                {
+                    any = true;
+                    auto start = Buffer.data() + Pos;
+                    auto nl = static_cast<const char *>(memchr(start, '\n', Fill - Pos));
+                    if (nl != nullptr)
+                    {
+                        line.append(start, nl - start);
+                        Pos += nl - start + 1;
+                        break;
+                    }
+                    line.append(start, Fill - Pos);
+                    Pos = Fill;
+                }
+
+                auto n = readMore(err);
+                if (n < 0)
+                {
+                    return false;
+                }
+                if (n == 0)
+                {
+                    if (!any)
+                    {
+                        return false;
+                    }
+                    break;
+                }
+            }
+
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            return true;
+        }
+
+        bool ReadAll(std::string &out, std::string &err)
+        {
+            out.assign(Buffer.data() + Pos, Fill - Pos);
+            Pos = Fill = 0;
+
+            struct stat st;
+            if (fstat(Fd, &st) == 0 && st.st_size > 0)
+            {
+                out.reserve(st.st_size);
+            }
+
+            while (true)
+            {
+                auto n = readMore(err);
+                if (n < 0)
+                {
+                    return false;
+                }
+                if (n == 0)
+                {
+                    return true;
+                }
+                out.append(Buffer.data(), Fill);
+                Fill = 0;
+            }
+        }
+
+        bool Write(const std::string &data, std::string &err)
+        {
+            if (Fill + data.size() > Buffer.size() && !Flush(err))
+            {
+                return false;
+            }
+            if (data.size() >= Buffer.size())
+            {
+                return writeAll(data.data(), data.size(), err);
+            }
+            memcpy(Buffer.data() + Fill, data.data(), data.size());
+            Fill += data.size();
+            return true;
+        }
+
+        bool Flush(std::string &err)
+        {
+            if (!Writable || Fill == 0)
+            {
+                return true;
+            }
+            auto ok = writeAll(Buffer.data(), Fill, err);
+            Fill = 0;
+            return ok;
+        }
+
+        bool writeAll(const char *data, size_t size, std::string &err)
+        {
+            while (size > 0)
+            {
+                auto n = write(Fd, data, size);
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n < 0)
+                {
+                    err = Path + ": " + strerror(errno);
+                    return false;
+                }
+                data += n;
+                size -= n;
+            }
+            return true;
+        }
+
+        bool Close(std::string &err)
+        {
+            if (Fd < 0)
+            {
+                return true;
+            }
+            auto ok = Flush(err);
+            close(Fd);
+            Fd = -1;
+            std::vector<char>().swap(Buffer);
+            return ok;
+        }
+    };
+
+    // open()返回的文件句柄; 没有close就被回收时在析构中写出缓冲的数据
+    struct File : Object
+    {
+        FileStream Stream;
+
+        File() { Charge(sizeof(File) + FileBufferSize); }
+        virtual ~File() {}
+        virtual ObjectType Type() { return ObjectType::FILE; }
+        virtual std::string Inspect() { return "file(" + Stream.Path + ")"; }
+    };
+
+    // lines(path): 每次遍历重新打开文件, 逐行产出字符串, 缓冲区在整个遍历中复用
+    struct LineSeq : Seq
+    {
+        std::string Path;
+
+        struct Iterator : SeqIterator
+        {
+            std::string Path;
+            FileStream Stream;
+            std::string Line;
+            bool Started = false;
+
+            Iterator(const std::string &path) : Path(path) {}
+            virtual bool Next(std::shared_ptr<Object> &item, std::shared_ptr<Object> &err)
+            {
+                std::string message;
+                if (!Started)
+                {
+                    Started = true;
+                    if (!Stream.Open(Path, "r", message))
+                    {
+                        err = newError(message);
+                        return false;
+                    }
+                }
+                if (Stream.Fd < 0)
+                {
+                    return false;
+                }
+
+                if (!Stream.ReadLine(Line, message))
+                {
+                    if (!message.empty())
+                    {
+                        err = newError(message);
+                    }
+                    Stream.Close(message);
+                    return false;
+                }
+                item = std::make_shared<String>(Line);
+                return true;
+            }
+        };
+
+        LineSeq(const std::string &path) : Path(path) { Charge(sizeof(LineSeq)); }
+        virtual std::string Describe() { return "lines " + Path; }
+        virtual std::unique_ptr<SeqIterator> Iterate() { return std::make_unique<Iterator>(Path); }
+    };
+}
+
+#endif // H_FILE_H
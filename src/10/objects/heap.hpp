@@ -0,0 +1,76 @@
+#ifndef H_HEAP_H
+#define H_HEAP_H
+
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+namespace objects
+{
+    // 一个隔离运行时(isolate)的对象堆记账: 对象构造时记入存活字节数, 析构时退还, 不需要另外扫描
+    struct Heap
+    {
+        int64_t Limit;         // 字节上限, 0表示不限制
+        int64_t Allocated = 0; // 存活对象占用的字节数
+        int64_t Peak = 0;
+        int64_t Objects = 0;   // 存活对象数
+        int64_t Allocations = 0; // 累计创建过的对象数
+
+        Heap(const int64_t &limit = 0) : Limit(limit) {}
+
+        bool Exceeded() const
+        {
+            return (Limit > 0 && Allocated > Limit);
+        }
+
+        void Charge(const int64_t &bytes)
+        {
+            Allocated += bytes;
+            Objects += 1;
+            Allocations += 1;
+            if (Allocated > Peak)
+            {
+                Peak = Allocated;
+            }
+        }
+
+        void Release(const int64_t &bytes)
+        {
+            Allocated -= bytes;
+            Objects -= 1;
+        }
+    };
+
+    // 当前线程上新建的对象记入哪个堆; 为空时不记账
+    inline thread_local Heap *currentHeap = nullptr;
+
+    // 在作用域内把新建对象记入heap, 离开时恢复之前的堆; heap由调用方持有
+    struct HeapScope
+    {
+        Heap *previous;
+
+        HeapScope(const std::shared_ptr<Heap> &heap) : previous(currentHeap)
+        {
+            currentHeap = heap.get();
+        }
+
+        ~HeapScope()
+        {
+            currentHeap = previous;
+        }
+    };
+
+    // 大块分配之前检查: 再分配bytes字节是否仍在当前堆的上限内, 超出时不必先分配再报错
+    inline bool HeapAllows(const uint64_t &bytes)
+    {
+        auto heap = currentHeap;
+        return (heap == nullptr || heap->Limit <= 0 || bytes <= static_cast<uint64_t>(heap->Limit - std::min(heap->Allocated, heap->Limit)));
+    }
+
+    inline std::shared_ptr<Heap> NewHeap(const int64_t &limit)
+    {
+        return std::make_shared<Heap>(limit);
+    }
+}
+
+#endif // H_HEAP_H
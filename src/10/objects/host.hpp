@@ -0,0 +1,98 @@
+#ifndef H_HOST_H
+#define H_HOST_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "objects/objects.hpp"
+
+namespace objects
+{
+    // 宿主出借内存的有效期: 一次运行结束后宿主把Valid置为false, 之后的访问返回错误而不是读悬空指针
+    struct HostLease
+    {
+        bool Valid = true;
+    };
+
+    enum class HostElement
+    {
+        Byte,   // const uint8_t*
+        Int64,  // const int64_t*
+        String, // const std::string*
+    };
+
+    // 直接引用宿主内存的只读数组, 不复制数据; 切片只调整Offset/Length
+    struct HostBuffer : Object
+    {
+        HostElement Element;
+        const void *Data;
+        int64_t Offset;
+        int64_t Length;
+        std::shared_ptr<HostLease> Lease;
+
+        HostBuffer(HostElement element, const void *data, const int64_t &length, std::shared_ptr<HostLease> lease)
+            : Element(element), Data(data), Offset(0), Length(length), Lease(lease) {}
+
+        virtual ~HostBuffer() {}
+        virtual ObjectType Type() { return ObjectType::HOST_BUFFER; }
+        virtual std::string Inspect()
+        {
+            switch (Element)
+            {
+            case HostElement::Byte:
+                return "bytes(" + std::to_string(Length) + ")";
+            case HostElement::Int64:
+                return "int64s(" + std::to_string(Length) + ")";
+            default:
+                return "strings(" + std::to_string(Length) + ")";
+            }
+        }
+
+        bool Available()
+        {
+            return (Lease == nullptr || Lease->Valid);
+        }
+
+        // 越界返回NULL_OBJ, 与数组下标一致
+        std::shared_ptr<Object> At(const int64_t &idx)
+        {
+            if (!Available())
+            {
+                return newError("host buffer is no longer available");
+            }
+
+            if (idx < 0 || idx >= Length)
+            {
+                return NULL_OBJ;
+            }
+
+            switch (Element)
+            {
+            case HostElement::Byte:
+                return std::make_shared<Integer>(static_cast<const uint8_t *>(Data)[Offset + idx]);
+            case HostElement::Int64:
+                return std::make_shared<Integer>(static_cast<const int64_t *>(Data)[Offset + idx]);
+            default:
+                return std::make_shared<String>(static_cast<const std::string *>(Data)[Offset + idx]);
+            }
+        }
+
+        std::shared_ptr<HostBuffer> Slice(const int64_t &start, const int64_t &end)
+        {
+            auto view = std::make_shared<HostBuffer>(Element, Data, end - start, Lease);
+            view->Offset = Offset + start;
+            return view;
+        }
+    };
+
+    inline std::shared_ptr<objects::Object> evalHostIndexExpression(std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> index)
+    {
+        auto idx = std::static_pointer_cast<objects::Integer>(index)->Value;
+        return std::static_pointer_cast<objects::HostBuffer>(left)->At(idx);
+    }
+}
+
+#endif // H_HOST_H
@@ -0,0 +1,347 @@
+#ifndef H_INTARRAY_H
+#define H_INTARRAY_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+#include "objects/objects.hpp"
+#include "objects/host.hpp"
+
+namespace objects
+{
+    // 连续存放int64_t的整数数组: range()、全是整数的数组字面量和数值内置函数的结果.
+    // 每个元素8字节, 不需要为每个元素分配Integer对象; 下标访问时才装箱
+    const uint64_t MaxIntArrayLength = uint64_t(1) << 28; // 由脚本指定长度新建整数数组时的上限(2GB)
+
+    struct IntArray : Object
+    {
+        std::vector<int64_t> Values;
+
+        IntArray(std::vector<int64_t> values) : Values(std::move(values))
+        {
+            Charge(sizeof(IntArray) + Values.capacity() * sizeof(int64_t));
+        }
+        virtual ~IntArray() {}
+        virtual ObjectType Type() { return ObjectType::INT_ARRAY; }
+        virtual std::string Inspect()
+        {
+            std::vector<std::string> items;
+            for (auto &v : Values)
+            {
+                items.push_back(std::to_string(v));
+            }
+            return "[" + ast::Join(items, ", ") + "]";
+        }
+
+        std::shared_ptr<Object> At(const int64_t &idx)
+        {
+            if (idx < 0 || idx >= static_cast<int64_t>(Values.size()))
+            {
+                return NULL_OBJ;
+            }
+            return std::make_shared<Integer>(Values[idx]);
+        }
+    };
+
+    // 数组切片arr[a:b]和rest(arr)的结果: 与原数组共享存储, 只记录Offset/Length.
+    // 数组不可变, 所以切片不会看到修改; push等需要新数组的操作才复制出元素
+    struct ArraySlice : Object
+    {
+        std::shared_ptr<Object> Base; // ARRAY或INT_ARRAY, 不会是另一个切片
+        int64_t Offset;
+        int64_t Length;
+
+        ArraySlice(std::shared_ptr<Object> base, const int64_t &offset, const int64_t &length) : Base(std::move(base)), Offset(offset), Length(length)
+        {
+            Charge(sizeof(ArraySlice));
+        }
+        virtual ~ArraySlice() {}
+        virtual ObjectType Type() { return ObjectType::SLICE; }
+        virtual std::string Inspect()
+        {
+            std::vector<std::string> items;
+            for (int64_t i = 0; i < Length; i++)
+            {
+                items.push_back(At(i)->Inspect());
+            }
+            return "[" + ast::Join(items, ", ") + "]";
+        }
+
+        std::shared_ptr<Object> At(const int64_t &idx)
+        {
+            if (idx < 0 || idx >= Length)
+            {
+                return NULL_OBJ;
+            }
+            if (Base->Type() == ObjectType::INT_ARRAY)
+            {
+                return std::make_shared<Integer>(static_cast<IntArray *>(Base.get())->Values[Offset + idx]);
+            }
+            return static_cast<Array *>(Base.get())->Elements[Offset + idx];
+        }
+
+        // 复制出独立的数组, 整数切片仍是IntArray
+        std::shared_ptr<Object> Materialize()
+        {
+            if (Base->Type() == ObjectType::INT_ARRAY)
+            {
+                auto begin = static_cast<IntArray *>(Base.get())->Values.begin() + Offset;
+                return std::make_shared<IntArray>(std::vector<int64_t>(begin, begin + Length));
+            }
+            auto begin = static_cast<Array *>(Base.get())->Elements.begin() + Offset;
+            std::vector<std::shared_ptr<Object>> elements(begin, begin + Length);
+            return std::make_shared<Array>(elements);
+        }
+    };
+
+    // obj[start:end]: 下标为null时表示从头/到尾, 越界时截断到[0, 长度]; 数组和宿主缓冲区都不复制数据
+    inline std::shared_ptr<Object> NewSlice(std::shared_ptr<Object> obj, std::shared_ptr<Object> start, std::shared_ptr<Object> end)
+    {
+        int64_t length = 0;
+        switch (obj->Type())
+        {
+        case ObjectType::ARRAY:
+            length = static_cast<Array *>(obj.get())->Elements.size();
+            break;
+        case ObjectType::INT_ARRAY:
+            length = static_cast<IntArray *>(obj.get())->Values.size();
+            break;
+        case ObjectType::SLICE:
+            length = static_cast<ArraySlice *>(obj.get())->Length;
+            break;
+        case ObjectType::HOST_BUFFER:
+            length = static_cast<HostBuffer *>(obj.get())->Length;
+            break;
+        default:
+            return newError("slice operator not supported: " + obj->TypeStr());
+        }
+
+        int64_t bounds[2] = {0, length};
+        std::shared_ptr<Object> given[2] = {start, end};
+        for (int i = 0; i < 2; i++)
+        {
+            if (given[i]->Type() == ObjectType::Null)
+            {
+                continue;
+            }
+            if (given[i]->Type() != ObjectType::INTEGER)
+            {
+                return newError("slice bounds must be INTEGER, got " + given[i]->TypeStr());
+            }
+            auto value = static_cast<Integer *>(given[i].get())->Value;
+            bounds[i] = (value < 0 ? 0 : (value > length ? length : value));
+        }
+        auto from = bounds[0], to = (bounds[1] < bounds[0] ? bounds[0] : bounds[1]);
+
+        switch (obj->Type())
+        {
+        case ObjectType::SLICE:
+            {
+                auto slice = static_cast<ArraySlice *>(obj.get());
+                return std::make_shared<ArraySlice>(slice->Base, slice->Offset + from, to - from);
+            }
+        case ObjectType::HOST_BUFFER:
+            return static_cast<HostBuffer *>(obj.get())->Slice(from, to);
+        default:
+            return std::make_shared<ArraySlice>(obj, from, to - from);
+        }
+    }
+
+    inline std::shared_ptr<objects::Object> evalSliceIndexExpression(std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> index)
+    {
+        auto idx = std::static_pointer_cast<objects::Integer>(index)->Value;
+        return std::static_pointer_cast<objects::ArraySlice>(left)->At(idx);
+    }
+
+    // 元素全是整数时打包成IntArray, 否则返回nullptr
+    inline std::shared_ptr<IntArray> PackIntegers(const std::vector<std::shared_ptr<Object>> &elements)
+    {
+        if (elements.empty())
+        {
+            return nullptr;
+        }
+
+        std::vector<int64_t> values(elements.size());
+        for (unsigned long i = 0; i < elements.size(); i++)
+        {
+            if (elements[i] == nullptr || elements[i]->Type() != ObjectType::INTEGER)
+            {
+                return nullptr;
+            }
+            values[i] = std::static_pointer_cast<Integer>(elements[i])->Value;
+        }
+        return std::make_shared<IntArray>(std::move(values));
+    }
+
+    // 数值内置函数的输入: IntArray和int64宿主缓冲区直接引用原数据, 全是整数的Array先复制到Scratch
+    struct IntSpan
+    {
+        const int64_t *Data = nullptr;
+        int64_t Length = 0;
+        std::vector<int64_t> Scratch;
+    };
+
+    inline bool AsIntSpan(std::shared_ptr<Object> obj, IntSpan &span)
+    {
+        switch (obj->Type())
+        {
+        case ObjectType::INT_ARRAY:
+            {
+                auto arr = std::static_pointer_cast<IntArray>(obj);
+                span.Data = arr->Values.data();
+                span.Length = arr->Values.size();
+                return true;
+            }
+        case ObjectType::HOST_BUFFER:
+            {
+                auto buf = std::static_pointer_cast<HostBuffer>(obj);
+                if (buf->Element != HostElement::Int64 || !buf->Available())
+                {
+                    return false;
+                }
+                span.Data = static_cast<const int64_t *>(buf->Data) + buf->Offset;
+                span.Length = buf->Length;
+                return true;
+            }
+        case ObjectType::SLICE:
+            {
+                auto slice = std::static_pointer_cast<ArraySlice>(obj);
+                if (slice->Base->Type() == ObjectType::INT_ARRAY)
+                {
+                    span.Data = static_cast<IntArray *>(slice->Base.get())->Values.data() + slice->Offset;
+                    span.Length = slice->Length;
+                    return true;
+                }
+
+                for (int64_t i = 0; i < slice->Length; i++)
+                {
+                    auto item = slice->At(i);
+                    if (item->Type() != ObjectType::INTEGER)
+                    {
+                        return false;
+                    }
+                    span.Scratch.push_back(std::static_pointer_cast<Integer>(item)->Value);
+                }
+                span.Data = span.Scratch.data();
+                span.Length = span.Scratch.size();
+                return true;
+            }
+        case ObjectType::ARRAY:
+            {
+                for (auto &item : std::static_pointer_cast<Array>(obj)->Elements)
+                {
+                    if (item->Type() != ObjectType::INTEGER)
+                    {
+                        return false;
+                    }
+                    span.Scratch.push_back(std::static_pointer_cast<Integer>(item)->Value);
+                }
+                span.Data = span.Scratch.data();
+                span.Length = span.Scratch.size();
+                return true;
+            }
+        default:
+            return false;
+        }
+    }
+
+    inline std::shared_ptr<objects::Object> evalIntArrayIndexExpression(std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> index)
+    {
+        auto idx = std::static_pointer_cast<objects::Integer>(index)->Value;
+        return std::static_pointer_cast<objects::IntArray>(left)->At(idx);
+    }
+
+    // 以下循环没有分支, 指针用__restrict声明不重叠, sum/min/max/dot/add/mul在-O3下由编译器向量化
+
+    inline int64_t kernelSum(const int64_t *__restrict a, const int64_t &n)
+    {
+        int64_t total = 0;
+        for (int64_t i = 0; i < n; i++)
+        {
+            total += a[i];
+        }
+        return total;
+    }
+
+    inline int64_t kernelMin(const int64_t *__restrict a, const int64_t &n)
+    {
+        int64_t result = a[0];
+        for (int64_t i = 1; i < n; i++)
+        {
+            result = (a[i] < result ? a[i] : result);
+        }
+        return result;
+    }
+
+    inline int64_t kernelMax(const int64_t *__restrict a, const int64_t &n)
+    {
+        int64_t result = a[0];
+        for (int64_t i = 1; i < n; i++)
+        {
+            result = (a[i] > result ? a[i] : result);
+        }
+        return result;
+    }
+
+    inline int64_t kernelDot(const int64_t *__restrict a, const int64_t *__restrict b, const int64_t &n)
+    {
+        int64_t total = 0;
+        for (int64_t i = 0; i < n; i++)
+        {
+            total += a[i] * b[i];
+        }
+        return total;
+    }
+
+    // b为nullptr时第二个操作数是标量s
+    inline void kernelAdd(int64_t *__restrict out, const int64_t *__restrict a, const int64_t *__restrict b, const int64_t &s, const int64_t &n)
+    {
+        if (b == nullptr)
+        {
+            for (int64_t i = 0; i < n; i++)
+            {
+                out[i] = a[i] + s;
+            }
+            return;
+        }
+        for (int64_t i = 0; i < n; i++)
+        {
+            out[i] = a[i] + b[i];
+        }
+    }
+
+    inline void kernelMul(int64_t *__restrict out, const int64_t *__restrict a, const int64_t *__restrict b, const int64_t &s, const int64_t &n)
+    {
+        if (b == nullptr)
+        {
+            for (int64_t i = 0; i < n; i++)
+            {
+                out[i] = a[i] * s;
+            }
+            return;
+        }
+        for (int64_t i = 0; i < n; i++)
+        {
+            out[i] = a[i] * b[i];
+        }
+    }
+
+    // 无分支压缩: 每个元素都写出, 满足条件时才前移输出位置
+    template <typename Pred>
+    inline int64_t kernelFilter(int64_t *__restrict out, const int64_t *__restrict a, const int64_t &n, Pred pred)
+    {
+        int64_t k = 0;
+        for (int64_t i = 0; i < n; i++)
+        {
+            out[k] = a[i];
+            k += (pred(a[i]) ? 1 : 0);
+        }
+        return k;
+    }
+}
+
+#endif // H_INTARRAY_H
@@ -0,0 +1,65 @@
+#ifndef H_MAPPED_FILE_H
+#define H_MAPPED_FILE_H
+
+#include <string>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace objects
+{
+    // 只读映射整个文件, 析构时解除映射
+    struct MappedFile
+    {
+        const char *Data = nullptr;
+        size_t Size = 0;
+
+        MappedFile() {}
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile()
+        {
+            if (Data != nullptr)
+            {
+                munmap(const_cast<char *>(Data), Size);
+            }
+        }
+
+        bool Open(const std::string &path, std::string &error)
+        {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                error = path + ": " + strerror(errno);
+                return false;
+            }
+
+            struct stat st;
+            if (fstat(fd, &st) < 0 || st.st_size == 0)
+            {
+                error = path + ": empty file";
+                close(fd);
+                return false;
+            }
+
+            void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (data == MAP_FAILED)
+            {
+                error = path + ": " + strerror(errno);
+                return false;
+            }
+
+            Data = static_cast<const char *>(data);
+            Size = st.st_size;
+            return true;
+        }
+    };
+}
+
+#endif // H_MAPPED_FILE_H
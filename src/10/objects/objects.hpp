@@ -8,9 +8,12 @@
 #include <fstream>
 #include <sstream>
 #include <memory>
+#include <list>
+#include <set>
 
 #include "ast/ast.hpp"
 #include "code/code.hpp"
+#include "objects/heap.hpp"
 
 namespace objects
 {
@@ -28,6 +31,13 @@ namespace objects
 		BUILTIN,
 		COMPILED_FUNCTION,
 		CLOSURE,
+		HOST_BUFFER,
+		MODULE,
+		INT_ARRAY,
+		RANGE_CURSOR,
+		SEQ,
+		SLICE,
+		FILE,
 	};
 
 	struct HashKey
@@ -49,13 +59,39 @@ namespace objects
 
 		bool operator<(const HashKey &rhs) const
 		{
+			if (Type != rhs.Type)
+			{
+				return (Type < rhs.Type);
+			}
 			return (Value < rhs.Value);
 		}
 	};
 
 	struct Object
 	{
-		virtual ~Object() {}
+		// 构造时所在的堆, 析构时退还记账. 不持有堆: 拥有堆的VM/Runtime保证它比记在上面的对象活得久,
+		// 这样每个对象省下一个shared_ptr和构造/析构时的原子引用计数
+		Heap *heap = currentHeap;
+		int64_t charged = 0;
+
+		virtual ~Object()
+		{
+			if (charged > 0)
+			{
+				heap->Release(charged);
+			}
+		}
+
+		// 由子类构造函数按对象及其数据的大小记账
+		void Charge(const int64_t &bytes)
+		{
+			if (heap != nullptr)
+			{
+				heap->Charge(bytes);
+				charged = bytes;
+			}
+		}
+
 		virtual ObjectType Type() { return ObjectType::Null; }
 		virtual bool Hashable(){ return false; }
 		virtual std::string Inspect() { return ""; }
@@ -90,6 +126,20 @@ namespace objects
 				return "BUILTIN";
 			case ObjectType::COMPILED_FUNCTION:
 				return "COMPILED_FUNCTION";
+			case ObjectType::HOST_BUFFER:
+				return "HOST_BUFFER";
+			case ObjectType::MODULE:
+				return "MODULE";
+			case ObjectType::INT_ARRAY:
+				return "INT_ARRAY";
+			case ObjectType::RANGE_CURSOR:
+				return "RANGE_CURSOR";
+			case ObjectType::SEQ:
+				return "SEQ";
+			case ObjectType::SLICE:
+				return "SLICE";
+			case ObjectType::FILE:
+				return "FILE";
 			default:
 				return "BadType";
 			}
@@ -100,8 +150,8 @@ namespace objects
 	{
 		long long int Value;
 
-		Integer() {}
-		Integer(long long int val) : Value(val) {}
+		Integer() { Charge(sizeof(Integer)); }
+		Integer(long long int val) : Value(val) { Charge(sizeof(Integer)); }
 
 		virtual ~Integer() {}
 		virtual ObjectType Type() { return ObjectType::INTEGER; }
@@ -150,8 +200,8 @@ namespace objects
 	{
 		std::string Value;
 
-		String(): Value(""){}
-		String(std::string val) : Value(val) {}
+		String(): Value(""){ Charge(sizeof(String)); }
+		String(std::string val) : Value(std::move(val)) { Charge(sizeof(String) + Value.capacity()); }
 
 		virtual ~String() {}
 		virtual ObjectType Type() { return ObjectType::STRING; }
@@ -171,8 +221,11 @@ namespace objects
 	{
 		std::vector<std::shared_ptr<Object>> Elements;
 
-		Array(){}
-		Array(std::vector<std::shared_ptr<Object>>& elements): Elements(elements){}
+		Array(){ Charge(sizeof(Array)); }
+		Array(std::vector<std::shared_ptr<Object>>& elements): Elements(elements)
+		{
+			Charge(sizeof(Array) + Elements.capacity() * sizeof(std::shared_ptr<Object>));
+		}
 		virtual ~Array() {}
 		virtual ObjectType Type() { return ObjectType::ARRAY; }
 		virtual std::string Inspect()
@@ -227,7 +280,11 @@ namespace objects
 	{
 		std::map<HashKey, std::shared_ptr<HashPair>> Pairs;
 
-		Hash(std::map<HashKey, std::shared_ptr<HashPair>>& pairs): Pairs(pairs){}
+		// 每个键值对按 map节点 + HashPair 估算
+		Hash(std::map<HashKey, std::shared_ptr<HashPair>>& pairs): Pairs(pairs)
+		{
+			Charge(sizeof(Hash) + Pairs.size() * (64 + sizeof(HashPair)));
+		}
 		virtual ~Hash(){}
 		virtual ObjectType Type() { return ObjectType::HASH; }
 		virtual std::string Inspect() 
@@ -244,6 +301,101 @@ namespace objects
 		}
 	};
 
+	const int MemoCapacity = 4096; // memo表默认容量
+
+	// 函数调用结果缓存: 以参数的HashKey为键, 超过容量时淘汰最久未使用的条目
+	struct MemoTable
+	{
+		struct Entry
+		{
+			std::vector<HashKey> Key;
+			std::vector<std::shared_ptr<Object>> Args;
+			std::shared_ptr<Object> Result;
+		};
+
+		int Capacity;
+		std::list<Entry> Entries; // 最近使用的条目在前
+		std::map<std::vector<HashKey>, std::list<Entry>::iterator> Index;
+		int Hits = 0;
+		int Misses = 0;
+
+		MemoTable(): Capacity(MemoCapacity){}
+		MemoTable(const int &capacity): Capacity(capacity){}
+
+		// 参数都可哈希时才能缓存
+		static bool MakeKey(std::vector<std::shared_ptr<Object>> &args, const int &start, const int &count, std::vector<HashKey> &key)
+		{
+			key.clear();
+			for (int i = start; i < start + count; i++)
+			{
+				if (!args[i]->Hashable())
+				{
+					return false;
+				}
+				key.push_back(args[i]->GetHashKey());
+			}
+			return true;
+		}
+
+		std::shared_ptr<Object> Get(const std::vector<HashKey> &key, std::vector<std::shared_ptr<Object>> &args, const int &start)
+		{
+			auto fit = Index.find(key);
+			if (fit == Index.end() || !sameArgs(fit->second->Args, args, start))
+			{
+				Misses += 1;
+				return nullptr;
+			}
+
+			Hits += 1;
+			Entries.splice(Entries.begin(), Entries, fit->second);
+			return fit->second->Result;
+		}
+
+		void Put(const std::vector<HashKey> &key, const std::vector<std::shared_ptr<Object>> &args, std::shared_ptr<Object> result)
+		{
+			if (Capacity <= 0)
+			{
+				return;
+			}
+
+			auto fit = Index.find(key);
+			if (fit != Index.end())
+			{
+				Entries.erase(fit->second);
+				Index.erase(fit);
+			}
+
+			Entries.push_front(Entry{key, args, result});
+			Index[key] = Entries.begin();
+
+			if (static_cast<int>(Entries.size()) > Capacity)
+			{
+				Index.erase(Entries.back().Key);
+				Entries.pop_back();
+			}
+		}
+
+		int Size()
+		{
+			return Entries.size();
+		}
+
+		// 字符串的HashKey是哈希值, 命中后还要比较原值以排除碰撞
+		static bool sameArgs(std::vector<std::shared_ptr<Object>> &cached, std::vector<std::shared_ptr<Object>> &args, const int &start)
+		{
+			for (unsigned long i = 0; i < cached.size(); i++)
+			{
+				auto &arg = args[start + i];
+				if (arg->Type() == ObjectType::STRING &&
+					static_cast<String *>(cached[i].get())->Value != static_cast<String *>(arg.get())->Value)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
 	struct Environment;
 
 	struct Function : Object
@@ -251,6 +403,7 @@ namespace objects
 		std::vector<std::shared_ptr<ast::Identifier>> Parameters;
 		std::shared_ptr<ast::BlockStatement> Body;
 		std::shared_ptr<Environment> Env;
+		std::shared_ptr<MemoTable> Memo; // memo(fn)返回的函数带有结果缓存
 
 		virtual ~Function() {
 			Parameters.clear();
@@ -275,12 +428,72 @@ namespace objects
 		}
 	};
 
+	// 单个指令位置收集到的类型反馈
+	struct FeedbackSlot
+	{
+		uint32_t SeenTypes = 0; // 操作数类型位图: 1 << ObjectType
+		// 单态调用点的目标函数. 只用来比较是否同一个函数, 所以用弱引用: 自递归函数的反馈不会让函数引用自己而无法释放
+		std::weak_ptr<Object> CallTarget;
+		bool Megamorphic = false;
+
+		bool OnlySeen(ObjectType type)
+		{
+			return (SeenTypes == (1u << static_cast<int>(type)));
+		}
+
+		// 按控制块比较, 不需要lock; 弱引用保留着控制块, 目标释放后它的地址也不会被新函数复用
+		bool SameCallTarget(const std::shared_ptr<Object> &target) const
+		{
+			return (!CallTarget.owner_before(target) && !target.owner_before(CallTarget));
+		}
+	};
+
+	// 函数的反馈向量, 以指令偏移为下标
+	struct FeedbackVector
+	{
+		std::vector<FeedbackSlot> Slots;
+
+		FeedbackVector(const int &size): Slots(size){}
+
+		void RecordOperands(const int &ip, std::shared_ptr<Object> &left, std::shared_ptr<Object> &right)
+		{
+			Slots[ip].SeenTypes |= (1u << static_cast<int>(left->Type())) | (1u << static_cast<int>(right->Type()));
+		}
+
+		void RecordCallTarget(const int &ip, std::shared_ptr<Object> target)
+		{
+			auto &slot = Slots[ip];
+			if(slot.SameCallTarget(target))
+			{
+				return;
+			}
+			if(slot.SameCallTarget(nullptr))
+			{
+				slot.CallTarget = target;
+			}
+			else
+			{
+				slot.Megamorphic = true;
+			}
+		}
+	};
+
 	struct CompiledFunction: Object
 	{
 		bytecode::Instructions Instructions;
 		int NumLocals;
 		int NumParameters;
 
+		// 推测优化状态: 优化后的代码与基线代码布局一致, 去优化时直接换回Baseline
+		std::shared_ptr<FeedbackVector> Feedback;
+		bytecode::Instructions Baseline;
+		int Hotness = 0;
+		int DeoptCount = 0;
+		bool Optimized = false;
+
+		// 编译器判定的纯函数: 不调用puts等有副作用的内置函数, 只调用自身/纯内置函数/纯全局函数
+		bool Pure = false;
+
 		CompiledFunction(bytecode::Instructions &ins, const int &numLocals, const int &numParameters)
 			: Instructions(ins),
 			  NumLocals(numLocals),
@@ -297,13 +510,51 @@ namespace objects
 		}
 	};
 
+	// import()编译出的模块. 缓存中的模块是独立编译的单元, 有自己的常量池和全局变量空间;
+	// 链接进导入方后常量并入导入方的常量池, 全局变量从GlobalBase开始, 只保留顶层代码
+	struct Module: Object
+	{
+		std::string Path;
+		int64_t MTime = 0; // 编译时源文件的修改时间(纳秒)
+		std::vector<std::pair<std::string, int64_t>> Dependencies; // 链接进来的模块(包括间接导入的)及其修改时间
+		bytecode::Instructions Instructions;
+		std::vector<std::shared_ptr<Object>> Constants;
+		int NumGlobals = 0;
+		int GlobalBase = 0;
+		int ConstantBase = 0;
+		std::vector<std::pair<std::string, int>> Exports; // 导出名和模块内的全局变量下标, 按下标排序
+		std::set<int> PureExports; // Exports中绑定到纯函数的位置
+
+		virtual ~Module(){}
+		virtual ObjectType Type() { return ObjectType::MODULE; }
+		virtual std::string Inspect() { return "module(" + Path + ")"; }
+	};
+
+	// for (i in a..b) 循环的状态, 只在操作数栈上: 计数器和上界不装箱; 循环变量没有被别处引用时沿用上一轮的Integer
+	struct RangeCursor: Object
+	{
+		int64_t Current;
+		int64_t End;
+		std::shared_ptr<Integer> Boxed; // 上一轮存入循环变量的值
+
+		RangeCursor(const int64_t &start, const int64_t &end): Current(start), End(end) { Charge(sizeof(RangeCursor)); }
+		virtual ~RangeCursor(){}
+
+		virtual ObjectType Type() { return ObjectType::RANGE_CURSOR; }
+		virtual std::string Inspect() { return std::to_string(Current) + ".." + std::to_string(End); }
+	};
+
 	struct Closure: Object
 	{
 		std::shared_ptr<CompiledFunction> Fn;
 		std::vector<std::shared_ptr<Object>> Free;
+		std::shared_ptr<MemoTable> Memo;
 
-		Closure(std::shared_ptr<CompiledFunction> fn): Fn(fn){}
-		Closure(std::shared_ptr<CompiledFunction> fn, std::vector<std::shared_ptr<Object>> free): Fn(fn), Free(free){}
+		Closure(std::shared_ptr<CompiledFunction> fn): Fn(fn){ Charge(sizeof(Closure)); }
+		Closure(std::shared_ptr<CompiledFunction> fn, std::vector<std::shared_ptr<Object>> free): Fn(fn), Free(free)
+		{
+			Charge(sizeof(Closure) + Free.capacity() * sizeof(std::shared_ptr<Object>));
+		}
 		virtual ~Closure(){}
 
 		virtual ObjectType Type() { return ObjectType::CLOSURE; }
@@ -315,18 +566,18 @@ namespace objects
 		}
 	};
 
-	static std::shared_ptr<objects::Null> NULL_OBJ = std::make_shared<objects::Null>();
-	static std::shared_ptr<objects::Boolean> TRUE_OBJ = std::make_shared<objects::Boolean>(true);
-	static std::shared_ptr<objects::Boolean> FALSE_OBJ = std::make_shared<objects::Boolean>(false);
+	inline std::shared_ptr<objects::Null> NULL_OBJ = std::make_shared<objects::Null>();
+	inline std::shared_ptr<objects::Boolean> TRUE_OBJ = std::make_shared<objects::Boolean>(true);
+	inline std::shared_ptr<objects::Boolean> FALSE_OBJ = std::make_shared<objects::Boolean>(false);
 
-	std::shared_ptr<objects::Error> newError(std::string msg)
+	inline std::shared_ptr<objects::Error> newError(std::string msg)
 	{
 		std::shared_ptr<objects::Error> error = std::make_shared<objects::Error>();
 		error->Message = msg;
 		return error;
 	}
 
-	bool isError(std::shared_ptr<objects::Object> obj)
+	inline bool isError(std::shared_ptr<objects::Object> obj)
 	{
 		if (obj != nullptr)
 		{
@@ -335,7 +586,7 @@ namespace objects
 		return false;
 	}
 
-	bool isTruthy(std::shared_ptr<objects::Object> obj)
+	inline bool isTruthy(std::shared_ptr<objects::Object> obj)
 	{
 		if (obj == objects::NULL_OBJ)
 		{
@@ -356,7 +607,7 @@ namespace objects
 	}
 
 
-	std::shared_ptr<objects::Boolean> nativeBoolToBooleanObject(bool input)
+	inline std::shared_ptr<objects::Boolean> nativeBoolToBooleanObject(bool input)
 	{
 		if (input)
 		{
@@ -368,7 +619,7 @@ namespace objects
 		}
 	}
 
-	std::shared_ptr<objects::Object> evalArrayIndexExpression(std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> index)
+	inline std::shared_ptr<objects::Object> evalArrayIndexExpression(std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> index)
 	{
 		std::shared_ptr<objects::Array> arrayObj = std::dynamic_pointer_cast<objects::Array>(left);
 		auto idx = std::dynamic_pointer_cast<objects::Integer>(index)->Value;
@@ -382,7 +633,7 @@ namespace objects
 		return arrayObj->Elements[idx];
 	}
 
-	std::shared_ptr<objects::Object> evalHashIndexExpression(std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> index)
+	inline std::shared_ptr<objects::Object> evalHashIndexExpression(std::shared_ptr<objects::Object> left, std::shared_ptr<objects::Object> index)
 	{
 		std::shared_ptr<objects::Hash> hashObj = std::dynamic_pointer_cast<objects::Hash>(left);
 
@@ -0,0 +1,192 @@
+#ifndef H_PLUGIN_H
+#define H_PLUGIN_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <memory>
+
+#include <dlfcn.h>
+
+#include "embed/plugin.hpp"
+#include "objects/objects.hpp"
+#include "objects/intarray.hpp"
+#include "objects/builtins.hpp"
+
+// 一次原生调用的返回值
+struct monkey_result
+{
+    std::shared_ptr<objects::Object> Value;
+};
+
+namespace objects
+{
+    const size_t MaxBuiltins = 256; // OpGetBuiltin的操作数只有一个字节
+
+    struct NativeBuiltin
+    {
+        std::string Name;
+        monkey_native_fn Fn;
+    };
+
+    inline std::deque<NativeBuiltin> NativeBuiltins; // 地址不变, Builtin::Native指向其中的元素
+
+    inline void nativeSetInt(monkey_result *result, int64_t value)
+    {
+        result->Value = std::make_shared<Integer>(value);
+    }
+
+    inline void nativeSetBool(monkey_result *result, int value)
+    {
+        result->Value = nativeBoolToBooleanObject(value != 0);
+    }
+
+    // 结果对象按最终大小一次分配, 插件直接写入其存储
+    inline char *nativeSetString(monkey_result *result, size_t size)
+    {
+        auto str = std::make_shared<String>(std::string(size, '\0'));
+        result->Value = str;
+        return str->Value.data();
+    }
+
+    inline int64_t *nativeSetInts(monkey_result *result, size_t count)
+    {
+        auto ints = std::make_shared<IntArray>(std::vector<int64_t>(count));
+        result->Value = ints;
+        return ints->Values.data();
+    }
+
+    inline void nativeSetError(monkey_result *result, const char *message)
+    {
+        result->Value = newError(message);
+    }
+
+    inline const monkey_result_api NativeResultApi{&nativeSetInt, &nativeSetBool, &nativeSetString, &nativeSetInts, &nativeSetError};
+
+    // 插件函数的调用入口: 参数是调用方栈上连续的count个对象, 字符串和整数数组以指针传给插件, 不复制
+    inline std::shared_ptr<Object> invokeNative(const void *native, std::shared_ptr<Object> *args, const size_t &count)
+    {
+        auto def = static_cast<const NativeBuiltin *>(native);
+
+        monkey_value small[8];
+        std::vector<monkey_value> large;
+        monkey_value *values = small;
+        if (count > 8)
+        {
+            large.resize(count);
+            values = large.data();
+        }
+
+        std::vector<std::vector<int64_t>> scratch; // 普通数组中的整数需要拷贝出来
+        for (size_t i = 0; i < count; i++)
+        {
+            auto &arg = args[i];
+            auto &value = values[i];
+            value = monkey_value{MONKEY_NULL, 0, nullptr, 0};
+
+            switch (arg->Type())
+            {
+            case ObjectType::Null:
+                break;
+            case ObjectType::INTEGER:
+                value.type = MONKEY_INT;
+                value.integer = static_cast<Integer *>(arg.get())->Value;
+                break;
+            case ObjectType::BOOLEAN:
+                value.type = MONKEY_BOOL;
+                value.integer = static_cast<Boolean *>(arg.get())->Value ? 1 : 0;
+                break;
+            case ObjectType::STRING:
+                {
+                    auto &str = static_cast<String *>(arg.get())->Value;
+                    value.type = MONKEY_STRING;
+                    value.data = str.data();
+                    value.size = str.size();
+                    break;
+                }
+            default:
+                {
+                    IntSpan span;
+                    if (!AsIntSpan(arg, span))
+                    {
+                        return newError("argument " + std::to_string(i + 1) + " to `" + def->Name + "` must be INTEGER, BOOLEAN, STRING or an integer array, got " + arg->TypeStr());
+                    }
+                    value.type = MONKEY_INTS;
+                    value.data = span.Data;
+                    value.size = span.Length;
+                    if (!span.Scratch.empty())
+                    {
+                        scratch.push_back(std::move(span.Scratch)); // 移动不改变元素的地址
+                    }
+                    break;
+                }
+            }
+        }
+
+        monkey_result result;
+        def->Fn(values, count, &result, &NativeResultApi);
+        return result.Value;
+    }
+
+    // 加载插件并把它的函数追加到Builtins末尾: 已有内置函数的下标不变, 之后新建的编译器和运行时才能看到新函数.
+    // 插件不会被卸载; 要在编译和运行程序之前加载, 不能与正在运行的程序并发
+    inline bool LoadPlugin(const std::string &path, std::string &error)
+    {
+        void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (handle == nullptr)
+        {
+            error = dlerror();
+            return false;
+        }
+
+        auto init = reinterpret_cast<monkey_plugin_init_fn>(dlsym(handle, MONKEY_PLUGIN_INIT));
+        const monkey_plugin *plugin = (init == nullptr ? nullptr : init());
+        if (plugin == nullptr)
+        {
+            error = path + ": no plugin table exported by " MONKEY_PLUGIN_INIT;
+        }
+        else if (plugin->abi_version != MONKEY_PLUGIN_ABI_VERSION)
+        {
+            error = path + ": plugin ABI version " + std::to_string(plugin->abi_version) + ", want " + std::to_string(MONKEY_PLUGIN_ABI_VERSION);
+        }
+        else if (Builtins.size() + plugin->count > MaxBuiltins)
+        {
+            error = path + ": too many builtins, at most " + std::to_string(MaxBuiltins);
+        }
+        else
+        {
+            // 先全部检查再注册, 出错时不留下一半的函数
+            std::set<std::string> names;
+            for (size_t i = 0; i < plugin->count && error.empty(); i++)
+            {
+                auto &def = plugin->natives[i];
+                if (def.name == nullptr || def.fn == nullptr)
+                {
+                    error = path + ": native " + std::to_string(i) + " has no name or function";
+                }
+                else if (GetBuiltinByName(def.name) != nullptr || !names.insert(def.name).second)
+                {
+                    error = path + ": builtin " + def.name + " is already defined";
+                }
+            }
+        }
+
+        if (!error.empty())
+        {
+            dlclose(handle);
+            return false;
+        }
+
+        for (size_t i = 0; i < plugin->count; i++)
+        {
+            auto &def = plugin->natives[i];
+            NativeBuiltins.push_back(NativeBuiltin{def.name, def.fn});
+            auto builtin = std::make_shared<Builtin>(&invokeNative, &NativeBuiltins.back());
+            Builtins.push_back(std::make_shared<BuiltinWithName>(def.name, builtin, def.pure != 0));
+        }
+        return true;
+    }
+}
+
+#endif // H_PLUGIN_H
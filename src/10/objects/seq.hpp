@@ -0,0 +1,288 @@
+#ifndef H_SEQ_H
+#define H_SEQ_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include "objects/objects.hpp"
+#include "objects/intarray.hpp"
+
+namespace objects
+{
+    // 内置函数回调用户函数的入口, 由正在运行的虚拟机或解释器设置
+    using FunctionCaller = std::function<std::shared_ptr<Object>(std::shared_ptr<Object>, std::vector<std::shared_ptr<Object>> &)>;
+
+    inline thread_local FunctionCaller *currentCaller = nullptr;
+
+    // 在作用域内用caller调用用户函数, 离开时恢复之前的入口(嵌套运行时互不影响)
+    struct CallerScope
+    {
+        FunctionCaller caller;
+        FunctionCaller *previous;
+
+        CallerScope(FunctionCaller fn) : caller(std::move(fn)), previous(currentCaller)
+        {
+            currentCaller = &caller;
+        }
+
+        ~CallerScope()
+        {
+            currentCaller = previous;
+        }
+    };
+
+    inline std::shared_ptr<Object> CallFunction(std::shared_ptr<Object> fn, std::vector<std::shared_ptr<Object>> &args)
+    {
+        if (currentCaller == nullptr)
+        {
+            return newError("can not call " + fn->TypeStr() + " outside of a running program");
+        }
+        return (*currentCaller)(fn, args);
+    }
+
+    // 逐个产出元素; 返回false表示结束, 出错时err非空
+    struct SeqIterator
+    {
+        virtual ~SeqIterator() {}
+        virtual bool Next(std::shared_ptr<Object> &item, std::shared_ptr<Object> &err) = 0;
+    };
+
+    // 惰性序列只记录数据来源和各级变换; 终结操作(to_array/reduce/sum)每次新建一条迭代器链,
+    // 每个元素依次穿过所有阶段, 中间不生成数组. 同一个序列可以被多次遍历
+    struct Seq : Object
+    {
+        virtual ~Seq() {}
+        virtual ObjectType Type() { return ObjectType::SEQ; }
+        virtual std::string Inspect() { return "seq(" + Describe() + ")"; }
+
+        virtual std::string Describe() = 0;
+        virtual std::unique_ptr<SeqIterator> Iterate() = 0;
+    };
+
+    // 按下标[Begin, End)遍历数组; 切片直接遍历其底层数组的对应区间
+    struct ArraySeq : Seq
+    {
+        std::shared_ptr<Object> Source; // ARRAY或INT_ARRAY
+        int64_t Begin, End;
+
+        struct Iterator : SeqIterator
+        {
+            std::shared_ptr<Object> Source;
+            int64_t Index, End;
+
+            Iterator(std::shared_ptr<Object> source, const int64_t &begin, const int64_t &end) : Source(std::move(source)), Index(begin), End(end) {}
+            virtual bool Next(std::shared_ptr<Object> &item, [[maybe_unused]] std::shared_ptr<Object> &err)
+            {
+                if (Index >= End)
+                {
+                    return false;
+                }
+                if (Source->Type() == ObjectType::INT_ARRAY)
+                {
+                    item = std::make_shared<Integer>(static_cast<IntArray *>(Source.get())->Values[Index++]);
+                    return true;
+                }
+                item = static_cast<Array *>(Source.get())->Elements[Index++];
+                return true;
+            }
+        };
+
+        ArraySeq(std::shared_ptr<Object> source, const int64_t &begin, const int64_t &end) : Source(std::move(source)), Begin(begin), End(end) { Charge(sizeof(ArraySeq)); }
+        virtual std::string Describe() { return Source->TypeStr(); }
+        virtual std::unique_ptr<SeqIterator> Iterate() { return std::make_unique<Iterator>(Source, Begin, End); }
+    };
+
+    // [Start, End)区间内的整数, 不预先生成数组
+    struct CountSeq : Seq
+    {
+        int64_t Start, End;
+
+        struct Iterator : SeqIterator
+        {
+            int64_t Current, End;
+
+            Iterator(const int64_t &start, const int64_t &end) : Current(start), End(end) {}
+            virtual bool Next(std::shared_ptr<Object> &item, [[maybe_unused]] std::shared_ptr<Object> &err)
+            {
+                if (Current >= End)
+                {
+                    return false;
+                }
+                item = std::make_shared<Integer>(Current++);
+                return true;
+            }
+        };
+
+        CountSeq(const int64_t &start, const int64_t &end) : Start(start), End(end) { Charge(sizeof(CountSeq)); }
+        virtual std::string Describe() { return std::to_string(Start) + ".." + std::to_string(End); }
+        virtual std::unique_ptr<SeqIterator> Iterate() { return std::make_unique<Iterator>(Start, End); }
+    };
+
+    struct MapSeq : Seq
+    {
+        std::shared_ptr<Seq> Source;
+        std::shared_ptr<Object> Fn;
+
+        struct Iterator : SeqIterator
+        {
+            std::unique_ptr<SeqIterator> Source;
+            std::shared_ptr<Object> Fn;
+            std::vector<std::shared_ptr<Object>> Args{nullptr};
+
+            Iterator(std::unique_ptr<SeqIterator> source, std::shared_ptr<Object> fn) : Source(std::move(source)), Fn(std::move(fn)) {}
+            virtual bool Next(std::shared_ptr<Object> &item, std::shared_ptr<Object> &err)
+            {
+                if (!Source->Next(Args[0], err))
+                {
+                    return false;
+                }
+                item = CallFunction(Fn, Args);
+                if (isError(item))
+                {
+                    err = item;
+                    return false;
+                }
+                return true;
+            }
+        };
+
+        MapSeq(std::shared_ptr<Seq> source, std::shared_ptr<Object> fn) : Source(std::move(source)), Fn(std::move(fn)) { Charge(sizeof(MapSeq)); }
+        virtual std::string Describe() { return "map " + Source->Describe(); }
+        virtual std::unique_ptr<SeqIterator> Iterate() { return std::make_unique<Iterator>(Source->Iterate(), Fn); }
+    };
+
+    struct FilterSeq : Seq
+    {
+        std::shared_ptr<Seq> Source;
+        std::shared_ptr<Object> Fn;
+
+        struct Iterator : SeqIterator
+        {
+            std::unique_ptr<SeqIterator> Source;
+            std::shared_ptr<Object> Fn;
+            std::vector<std::shared_ptr<Object>> Args{nullptr};
+
+            Iterator(std::unique_ptr<SeqIterator> source, std::shared_ptr<Object> fn) : Source(std::move(source)), Fn(std::move(fn)) {}
+            virtual bool Next(std::shared_ptr<Object> &item, std::shared_ptr<Object> &err)
+            {
+                while (Source->Next(Args[0], err))
+                {
+                    auto keep = CallFunction(Fn, Args);
+                    if (isError(keep))
+                    {
+                        err = keep;
+                        return false;
+                    }
+                    if (isTruthy(keep))
+                    {
+                        item = Args[0];
+                        return true;
+                    }
+                }
+                return false;
+            }
+        };
+
+        FilterSeq(std::shared_ptr<Seq> source, std::shared_ptr<Object> fn) : Source(std::move(source)), Fn(std::move(fn)) { Charge(sizeof(FilterSeq)); }
+        virtual std::string Describe() { return "filter " + Source->Describe(); }
+        virtual std::unique_ptr<SeqIterator> Iterate() { return std::make_unique<Iterator>(Source->Iterate(), Fn); }
+    };
+
+    // 取前Count个元素后不再向上游拉取
+    struct TakeSeq : Seq
+    {
+        std::shared_ptr<Seq> Source;
+        int64_t Count;
+
+        struct Iterator : SeqIterator
+        {
+            std::unique_ptr<SeqIterator> Source;
+            int64_t Remaining;
+
+            Iterator(std::unique_ptr<SeqIterator> source, const int64_t &count) : Source(std::move(source)), Remaining(count) {}
+            virtual bool Next(std::shared_ptr<Object> &item, std::shared_ptr<Object> &err)
+            {
+                if (Remaining <= 0 || !Source->Next(item, err))
+                {
+                    return false;
+                }
+                Remaining -= 1;
+                return true;
+            }
+        };
+
+        TakeSeq(std::shared_ptr<Seq> source, const int64_t &count) : Source(std::move(source)), Count(count) { Charge(sizeof(TakeSeq)); }
+        virtual std::string Describe() { return "take " + std::to_string(Count) + " " + Source->Describe(); }
+        virtual std::unique_ptr<SeqIterator> Iterate() { return std::make_unique<Iterator>(Source->Iterate(), Count); }
+    };
+
+    // 逐对产出[a, b], 较短的一边结束时结束
+    struct ZipSeq : Seq
+    {
+        std::shared_ptr<Seq> Left, Right;
+
+        struct Iterator : SeqIterator
+        {
+            std::unique_ptr<SeqIterator> Left, Right;
+
+            Iterator(std::unique_ptr<SeqIterator> left, std::unique_ptr<SeqIterator> right) : Left(std::move(left)), Right(std::move(right)) {}
+            virtual bool Next(std::shared_ptr<Object> &item, std::shared_ptr<Object> &err)
+            {
+                std::shared_ptr<Object> a, b;
+                if (!Left->Next(a, err) || !Right->Next(b, err))
+                {
+                    return false;
+                }
+                std::vector<std::shared_ptr<Object>> pair{a, b};
+                item = std::make_shared<Array>(pair);
+                return true;
+            }
+        };
+
+        ZipSeq(std::shared_ptr<Seq> left, std::shared_ptr<Seq> right) : Left(std::move(left)), Right(std::move(right)) { Charge(sizeof(ZipSeq)); }
+        virtual std::string Describe() { return "zip " + Left->Describe() + ", " + Right->Describe(); }
+        virtual std::unique_ptr<SeqIterator> Iterate() { return std::make_unique<Iterator>(Left->Iterate(), Right->Iterate()); }
+    };
+
+    // 数组直接作为序列的来源, 其它类型返回nullptr
+    inline std::shared_ptr<Seq> AsSeq(std::shared_ptr<Object> obj)
+    {
+        switch (obj->Type())
+        {
+        case ObjectType::SEQ:
+            return std::static_pointer_cast<Seq>(obj);
+        case ObjectType::ARRAY:
+            return std::make_shared<ArraySeq>(obj, 0, static_cast<Array *>(obj.get())->Elements.size());
+        case ObjectType::INT_ARRAY:
+            return std::make_shared<ArraySeq>(obj, 0, static_cast<IntArray *>(obj.get())->Values.size());
+        case ObjectType::SLICE:
+        {
+            auto slice = std::static_pointer_cast<ArraySlice>(obj);
+            return std::make_shared<ArraySeq>(slice->Base, slice->Offset, slice->Offset + slice->Length);
+        }
+        default:
+            return nullptr;
+        }
+    }
+
+    // 驱动序列, 对每个元素调用visit; visit返回非空时(出错)提前结束并返回它
+    inline std::shared_ptr<Object> ForEach(std::shared_ptr<Seq> seq, const std::function<std::shared_ptr<Object>(std::shared_ptr<Object> &)> &visit)
+    {
+        auto it = seq->Iterate();
+        std::shared_ptr<Object> item, err;
+        while (it->Next(item, err))
+        {
+            if (auto stop = visit(item); stop != nullptr)
+            {
+                return stop;
+            }
+        }
+        return err;
+    }
+}
+
+#endif // H_SEQ_H
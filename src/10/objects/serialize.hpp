@@ -0,0 +1,548 @@
+#ifndef H_SERIALIZE_H
+#define H_SERIALIZE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "objects/objects.hpp"
+#include "objects/builtins.hpp"
+#include "objects/mapped_file.hpp"
+
+// 快照和模块字节码共用的对象图编码: 本机字节序, 只在同一构建的进程之间交换
+namespace objects
+{
+    // 对象图按后序写入对象表, 每个对象只写一次, 引用用对象编号表示(0表示空指针), 共享关系在读回后保持不变
+    struct ObjectWriter
+    {
+        std::string Buffer;
+        std::string Error;
+
+        std::string table;
+        std::map<Object *, uint32_t> ids;
+        uint32_t count = 0;
+
+        template <typename T>
+        void put(const T &val)
+        {
+            Buffer.append(reinterpret_cast<const char *>(&val), sizeof(T));
+        }
+
+        void putString(const std::string &val)
+        {
+            put<uint32_t>(val.size());
+            Buffer.append(val);
+        }
+
+        void putInstructions(const bytecode::Instructions &ins)
+        {
+            put<uint32_t>(ins.size());
+            Buffer.append(reinterpret_cast<const char *>(ins.data()), ins.size());
+        }
+
+        // 内置函数按下标引用, 内置函数表变化后编码失效
+        void putBuiltinTable()
+        {
+            put<uint32_t>(Builtins.size());
+            for (auto &fn : Builtins)
+            {
+                putString(fn->Name);
+            }
+        }
+
+        // 把obj及其引用的对象加入对象表, 返回其编号
+        uint32_t Add(std::shared_ptr<Object> obj)
+        {
+            if (obj == nullptr)
+            {
+                return 0;
+            }
+
+            if (auto fit = ids.find(obj.get()); fit != ids.end())
+            {
+                return fit->second;
+            }
+
+            // 先写出子对象
+            std::vector<uint32_t> children;
+            auto child = [&](std::shared_ptr<Object> o) { children.push_back(Add(o)); };
+
+            std::string record;
+            std::swap(record, Buffer);
+            put<uint8_t>(static_cast<uint8_t>(obj->Type()));
+
+            switch (obj->Type())
+            {
+            case ObjectType::Null:
+                break;
+            case ObjectType::INTEGER:
+                put<int64_t>(std::static_pointer_cast<Integer>(obj)->Value);
+                break;
+            case ObjectType::BOOLEAN:
+                put<uint8_t>(std::static_pointer_cast<Boolean>(obj)->Value ? 1 : 0);
+                break;
+            case ObjectType::STRING:
+                putString(std::static_pointer_cast<String>(obj)->Value);
+                break;
+            case ObjectType::ERROR:
+                putString(std::static_pointer_cast<objects::Error>(obj)->Message);
+                break;
+            case ObjectType::ARRAY:
+                for (auto &item : std::static_pointer_cast<Array>(obj)->Elements)
+                {
+                    child(item);
+                }
+                break;
+            case ObjectType::INT_ARRAY:
+                {
+                    auto &values = std::static_pointer_cast<IntArray>(obj)->Values;
+                    put<uint32_t>(values.size());
+                    Buffer.append(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(int64_t));
+                    break;
+                }
+            case ObjectType::SLICE:
+                {
+                    // 切片和底层数组分别保存, 读回后仍共享存储
+                    auto slice = std::static_pointer_cast<ArraySlice>(obj);
+                    put<int64_t>(slice->Offset);
+                    put<int64_t>(slice->Length);
+                    child(slice->Base);
+                    break;
+                }
+            case ObjectType::HASH:
+                for (auto &[key, pair] : std::static_pointer_cast<Hash>(obj)->Pairs)
+                {
+                    [[maybe_unused]] auto x = key;
+                    child(pair->Key);
+                    child(pair->Value);
+                }
+                break;
+            case ObjectType::BUILTIN:
+                {
+                    uint32_t index = 0;
+                    while (index < Builtins.size() && Builtins[index]->Builtin != obj)
+                    {
+                        index++;
+                    }
+                    if (index == Builtins.size())
+                    {
+                        Error = "can not serialize an unregistered builtin";
+                    }
+                    put<uint32_t>(index);
+                    break;
+                }
+            case ObjectType::COMPILED_FUNCTION:
+                {
+                    // 推测优化的代码和类型反馈不保存, 读回后从基线代码重新预热
+                    auto fn = std::static_pointer_cast<CompiledFunction>(obj);
+                    putInstructions(fn->Optimized ? fn->Baseline : fn->Instructions);
+                    put<int32_t>(fn->NumLocals);
+                    put<int32_t>(fn->NumParameters);
+                    put<uint8_t>(fn->Pure ? 1 : 0);
+                    break;
+                }
+            case ObjectType::CLOSURE:
+                {
+                    // 缓存表只保留容量, 缓存的结果不保存
+                    auto cl = std::static_pointer_cast<Closure>(obj);
+                    put<int32_t>(cl->Memo == nullptr ? -1 : cl->Memo->Capacity);
+                    child(cl->Fn);
+                    for (auto &free : cl->Free)
+                    {
+                        child(free);
+                    }
+                    break;
+                }
+            case ObjectType::MODULE:
+                {
+                    auto module = std::static_pointer_cast<Module>(obj);
+                    putString(module->Path);
+                    put<int64_t>(module->MTime);
+                    put<uint32_t>(module->Dependencies.size());
+                    for (auto &[dep, mtime] : module->Dependencies)
+                    {
+                        putString(dep);
+                        put<int64_t>(mtime);
+                    }
+                    putInstructions(module->Instructions);
+                    put<int32_t>(module->NumGlobals);
+                    put<int32_t>(module->GlobalBase);
+                    put<int32_t>(module->ConstantBase);
+                    put<uint32_t>(module->Exports.size());
+                    for (auto &[name, index] : module->Exports)
+                    {
+                        putString(name);
+                        put<int32_t>(index);
+                    }
+                    put<uint32_t>(module->PureExports.size());
+                    for (auto &index : module->PureExports)
+                    {
+                        put<int32_t>(index);
+                    }
+                    for (auto &constant : module->Constants)
+                    {
+                        child(constant);
+                    }
+                    break;
+                }
+            default:
+                Error = "can not serialize object of type " + obj->TypeStr();
+                break;
+            }
+
+            put<uint32_t>(children.size());
+            for (auto &id : children)
+            {
+                put<uint32_t>(id);
+            }
+
+            std::swap(record, Buffer);
+            table += record;
+
+            count += 1;
+            ids[obj.get()] = count;
+            return count;
+        }
+
+        void putObjectTable()
+        {
+            put<uint32_t>(count);
+            Buffer += table;
+        }
+
+        bool WriteFile(const std::string &path, std::string &error)
+        {
+            FILE *fp = fopen(path.c_str(), "wb");
+            if (fp == nullptr)
+            {
+                error = path + ": " + strerror(errno);
+                return false;
+            }
+
+            bool ok = (fwrite(Buffer.data(), 1, Buffer.size(), fp) == Buffer.size());
+            ok = (fclose(fp) == 0 && ok);
+            if (!ok)
+            {
+                error = path + ": write failed";
+            }
+            return ok;
+        }
+    };
+
+    struct ObjectReader
+    {
+        const char *Data;
+        size_t Size;
+        size_t Pos = 0;
+        bool Ok = true;
+        std::string Error;
+
+        std::vector<std::shared_ptr<Object>> Table;
+
+        ObjectReader(const char *data, const size_t &size) : Data(data), Size(size) {}
+
+        template <typename T>
+        T get()
+        {
+            T val{};
+            if (!Ok || Size - Pos < sizeof(T))
+            {
+                Ok = false;
+                return val;
+            }
+            memcpy(&val, Data + Pos, sizeof(T));
+            Pos += sizeof(T);
+            return val;
+        }
+
+        std::string getString()
+        {
+            auto size = get<uint32_t>();
+            if (!Ok || Size - Pos < size)
+            {
+                Ok = false;
+                return "";
+            }
+            std::string val(Data + Pos, size);
+            Pos += size;
+            return val;
+        }
+
+        bool expectMagic(const std::string &magic)
+        {
+            if (Size < magic.size() || std::string(Data, magic.size()) != magic)
+            {
+                Ok = false;
+                return false;
+            }
+            Pos = magic.size();
+            return true;
+        }
+
+        bool sameBuiltinTable()
+        {
+            auto numBuiltins = get<uint32_t>();
+            bool same = (numBuiltins == Builtins.size());
+            for (uint32_t i = 0; i < numBuiltins && Ok; i++)
+            {
+                auto name = getString();
+                same = same && (Builtins[i]->Name == name);
+            }
+            return (Ok && same);
+        }
+
+        std::shared_ptr<Object> ref()
+        {
+            auto id = get<uint32_t>();
+            if (id > Table.size())
+            {
+                Ok = false;
+                return nullptr;
+            }
+            return (id == 0 ? nullptr : Table[id - 1]);
+        }
+
+        std::vector<std::shared_ptr<Object>> refs()
+        {
+            std::vector<std::shared_ptr<Object>> result;
+            auto size = get<uint32_t>();
+            for (uint32_t i = 0; i < size && Ok; i++)
+            {
+                result.push_back(ref());
+            }
+            return result;
+        }
+
+        // 失败时Ok为false, Error说明原因
+        bool readObjectTable()
+        {
+            auto numObjects = get<uint32_t>();
+            for (uint32_t i = 0; i < numObjects && Ok; i++)
+            {
+                auto obj = readObject();
+                if (obj == nullptr)
+                {
+                    Ok = false;
+                    break;
+                }
+                Table.push_back(obj);
+            }
+            return Ok;
+        }
+
+        std::shared_ptr<Object> corrupted()
+        {
+            Ok = false;
+            if (Error.empty())
+            {
+                Error = "corrupted data";
+            }
+            return nullptr;
+        }
+
+        std::shared_ptr<Module> readModule()
+        {
+            auto module = std::make_shared<Module>();
+            module->Path = getString();
+            module->MTime = get<int64_t>();
+
+            auto numDependencies = get<uint32_t>();
+            for (uint32_t i = 0; i < numDependencies && Ok; i++)
+            {
+                auto dep = getString();
+                module->Dependencies.push_back(std::make_pair(dep, get<int64_t>()));
+            }
+
+            auto ins = getString();
+            module->Instructions.assign(ins.begin(), ins.end());
+            module->NumGlobals = get<int32_t>();
+            module->GlobalBase = get<int32_t>();
+            module->ConstantBase = get<int32_t>();
+
+            auto numExports = get<uint32_t>();
+            for (uint32_t i = 0; i < numExports && Ok; i++)
+            {
+                auto name = getString();
+                module->Exports.push_back(std::make_pair(name, get<int32_t>()));
+            }
+
+            auto numPure = get<uint32_t>();
+            for (uint32_t i = 0; i < numPure && Ok; i++)
+            {
+                module->PureExports.insert(get<int32_t>());
+            }
+            return module;
+        }
+
+        std::shared_ptr<Object> readObject()
+        {
+            auto type = static_cast<ObjectType>(get<uint8_t>());
+
+            int64_t integer = 0, length = 0;
+            std::string str;
+            uint32_t builtin = 0;
+            bytecode::Instructions ins;
+            int32_t numLocals = 0, numParameters = 0, memoCapacity = -1;
+            bool flag = false;
+            std::shared_ptr<Module> module;
+            std::vector<int64_t> ints;
+
+            switch (type)
+            {
+            case ObjectType::Null:
+            case ObjectType::ARRAY:
+            case ObjectType::HASH:
+                break;
+            case ObjectType::INTEGER:
+                integer = get<int64_t>();
+                break;
+            case ObjectType::BOOLEAN:
+                flag = (get<uint8_t>() != 0);
+                break;
+            case ObjectType::STRING:
+            case ObjectType::ERROR:
+                str = getString();
+                break;
+            case ObjectType::INT_ARRAY:
+                {
+                    auto n = get<uint32_t>();
+                    for (uint32_t i = 0; i < n && Ok; i++)
+                    {
+                        ints.push_back(get<int64_t>());
+                    }
+                    break;
+                }
+            case ObjectType::SLICE:
+                integer = get<int64_t>();
+                length = get<int64_t>();
+                break;
+            case ObjectType::MODULE:
+                module = readModule();
+                break;
+            case ObjectType::BUILTIN:
+                builtin = get<uint32_t>();
+                break;
+            case ObjectType::COMPILED_FUNCTION:
+                str = getString();
+                ins.assign(str.begin(), str.end());
+                numLocals = get<int32_t>();
+                numParameters = get<int32_t>();
+                flag = (get<uint8_t>() != 0);
+                break;
+            case ObjectType::CLOSURE:
+                memoCapacity = get<int32_t>();
+                break;
+            default:
+                return corrupted();
+            }
+
+            std::vector<std::shared_ptr<Object>> children;
+            auto numChildren = get<uint32_t>();
+            for (uint32_t i = 0; i < numChildren && Ok; i++)
+            {
+                children.push_back(ref());
+            }
+
+            if (!Ok)
+            {
+                return corrupted();
+            }
+
+            switch (type)
+            {
+            case ObjectType::Null:
+                return NULL_OBJ;
+            case ObjectType::INTEGER:
+                return std::make_shared<Integer>(integer);
+            case ObjectType::BOOLEAN:
+                return nativeBoolToBooleanObject(flag);
+            case ObjectType::STRING:
+                return std::make_shared<String>(str);
+            case ObjectType::ERROR:
+                return newError(str);
+            case ObjectType::ARRAY:
+                return std::make_shared<Array>(children);
+            case ObjectType::INT_ARRAY:
+                return std::make_shared<IntArray>(std::move(ints));
+            case ObjectType::SLICE:
+                {
+                    if (children.size() != 1 || children[0] == nullptr)
+                    {
+                        return corrupted();
+                    }
+                    int64_t size = -1;
+                    if (children[0]->Type() == ObjectType::ARRAY)
+                    {
+                        size = std::static_pointer_cast<Array>(children[0])->Elements.size();
+                    }
+                    else if (children[0]->Type() == ObjectType::INT_ARRAY)
+                    {
+                        size = std::static_pointer_cast<IntArray>(children[0])->Values.size();
+                    }
+                    if (integer < 0 || length < 0 || integer + length > size)
+                    {
+                        return corrupted();
+                    }
+                    return std::make_shared<ArraySlice>(children[0], integer, length);
+                }
+            case ObjectType::HASH:
+                {
+                    std::map<HashKey, std::shared_ptr<HashPair>> pairs;
+                    for (unsigned long i = 0; i + 1 < children.size(); i += 2)
+                    {
+                        if (children[i] == nullptr || !children[i]->Hashable())
+                        {
+                            return corrupted();
+                        }
+                        pairs[children[i]->GetHashKey()] = std::make_shared<HashPair>(children[i], children[i + 1]);
+                    }
+                    return std::make_shared<Hash>(pairs);
+                }
+            case ObjectType::BUILTIN:
+                if (builtin >= Builtins.size())
+                {
+                    return corrupted();
+                }
+                return Builtins[builtin]->Builtin;
+            case ObjectType::COMPILED_FUNCTION:
+                {
+                    auto fn = std::make_shared<CompiledFunction>(ins, numLocals, numParameters);
+                    fn->Pure = flag;
+                    return fn;
+                }
+            case ObjectType::MODULE:
+                module->Constants = children;
+                return module;
+            default:
+                {
+                    if (children.empty() || children[0] == nullptr || children[0]->Type() != ObjectType::COMPILED_FUNCTION)
+                    {
+                        return corrupted();
+                    }
+
+                    auto fn = std::static_pointer_cast<CompiledFunction>(children[0]);
+                    std::vector<std::shared_ptr<Object>> free(children.begin() + 1, children.end());
+                    auto cl = std::make_shared<Closure>(fn, free);
+                    if (memoCapacity >= 0)
+                    {
+                        cl->Memo = std::make_shared<MemoTable>(memoCapacity);
+                    }
+                    return cl;
+                }
+            }
+        }
+    };
+}
+
+#endif // H_SERIALIZE_H
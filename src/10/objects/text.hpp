@@ -0,0 +1,185 @@
+#ifndef H_TEXT_H
+#define H_TEXT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cctype>
+#include <cstdint>
+
+#include "objects/objects.hpp"
+
+namespace objects
+{
+    const size_t MaxFormatWidth = 4096; // format的最大宽度, 防止%99999999999d一次申请巨大的字符串
+
+    // 从from开始查找needle, 没有时返回npos. 用memchr定位首字节(glibc按SIMD实现)再用memcmp比较其余字节
+    inline size_t FindSubstring(std::string_view haystack, std::string_view needle, size_t from = 0)
+    {
+        if (needle.empty())
+        {
+            return (from <= haystack.size() ? from : std::string_view::npos);
+        }
+        if (from >= haystack.size() || needle.size() > haystack.size() - from)
+        {
+            return std::string_view::npos;
+        }
+
+        const char *p = haystack.data() + from;
+        const char *last = haystack.data() + haystack.size() - needle.size();
+        while (p <= last)
+        {
+            p = static_cast<const char *>(memchr(p, needle[0], last - p + 1));
+            if (p == nullptr)
+            {
+                return std::string_view::npos;
+            }
+            if (memcmp(p + 1, needle.data() + 1, needle.size() - 1) == 0)
+            {
+                return p - haystack.data();
+            }
+            p++;
+        }
+        return std::string_view::npos;
+    }
+
+    // 按sep切分, sep为空时按空白切分并丢弃空段
+    inline std::vector<std::string_view> SplitString(std::string_view str, std::string_view sep)
+    {
+        std::vector<std::string_view> parts;
+        if (sep.empty())
+        {
+            size_t i = 0;
+            while (i < str.size())
+            {
+                while (i < str.size() && isspace(static_cast<unsigned char>(str[i])))
+                {
+                    i++;
+                }
+                size_t start = i;
+                while (i < str.size() && !isspace(static_cast<unsigned char>(str[i])))
+                {
+                    i++;
+                }
+                if (i > start)
+                {
+                    parts.push_back(str.substr(start, i - start));
+                }
+            }
+            return parts;
+        }
+
+        size_t start = 0;
+        while (true)
+        {
+            auto pos = FindSubstring(str, sep, start);
+            if (pos == std::string_view::npos)
+            {
+                parts.push_back(str.substr(start));
+                return parts;
+            }
+            parts.push_back(str.substr(start, pos - start));
+            start = pos + sep.size();
+        }
+    }
+
+    // printf风格的格式化: %d整数, %s任意值(字符串取原值, 其它取Inspect), %%; 可带-和0标志及宽度, 如%-8s, %05d
+    inline std::shared_ptr<Object> FormatString(std::string_view format, std::vector<std::shared_ptr<Object>> &args, size_t next)
+    {
+        std::string out;
+        out.reserve(format.size());
+        size_t i = 0;
+        while (i < format.size())
+        {
+            auto pct = static_cast<const char *>(memchr(format.data() + i, '%', format.size() - i));
+            if (pct == nullptr)
+            {
+                out.append(format.substr(i));
+                break;
+            }
+            auto at = pct - format.data();
+            out.append(format.substr(i, at - i));
+            i = at + 1;
+
+            bool left = false, zero = false;
+            size_t width = 0;
+            while (i < format.size() && (format[i] == '-' || format[i] == '0'))
+            {
+                (format[i] == '-' ? left : zero) = true;
+                i++;
+            }
+            while (i < format.size() && isdigit(static_cast<unsigned char>(format[i])))
+            {
+                width = width * 10 + (format[i] - '0');
+                if (width > MaxFormatWidth)
+                {
+                    return newError("format width too large");
+                }
+                i++;
+            }
+            if (i >= format.size())
+            {
+                return newError("format string ends in the middle of a verb");
+            }
+
+            auto verb = format[i++];
+            if (verb == '%')
+            {
+                out.push_back('%');
+                continue;
+            }
+            if (verb != 'd' && verb != 's')
+            {
+                return newError("unknown format verb %" + std::string(1, verb));
+            }
+            if (next >= args.size())
+            {
+                return newError("missing argument for %" + std::string(1, verb));
+            }
+
+            auto &arg = args[next++];
+            std::string text;
+            if (verb == 'd')
+            {
+                if (arg->Type() != ObjectType::INTEGER)
+                {
+                    return newError("%d expects INTEGER, got " + arg->TypeStr());
+                }
+                text = std::to_string(static_cast<Integer *>(arg.get())->Value);
+            }
+            else
+            {
+                text = (arg->Type() == ObjectType::STRING ? static_cast<String *>(arg.get())->Value : arg->Inspect());
+            }
+
+            if (text.size() >= width)
+            {
+                out.append(text);
+            }
+            else if (left)
+            {
+                out.append(text).append(width - text.size(), ' ');
+            }
+            else if (zero && verb == 'd')
+            {
+                // 负号留在补的0前面
+                size_t sign = (text[0] == '-' ? 1 : 0);
+                out.append(text, 0, sign).append(width - text.size(), '0').append(text, sign, std::string::npos);
+            }
+            else
+            {
+                out.append(width - text.size(), ' ').append(text);
+            }
+        }
+
+        if (next < args.size())
+        {
+            return newError("too many arguments for format: " + std::to_string(args.size() - next) + " unused");
+        }
+        return std::make_shared<String>(out);
+    }
+}
+
+#endif // H_TEXT_H
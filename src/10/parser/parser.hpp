@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <memory>
 
 #include "lexer/lexer.hpp"
@@ -17,6 +18,8 @@ namespace parser
     enum class Priority
     {
         LOWEST = 1,
+        OR,          // ||
+        AND,         // &&
         EQUALS,      // ==
         LESSGREATER, // > or <
         SUM,         // +
@@ -26,7 +29,9 @@ namespace parser
         INDEX        // array[index]
     };
 
-    std::map<token::TokenType, Priority> precedences{{token::types::EQ, Priority::EQUALS},
+    inline std::map<token::TokenType, Priority> precedences{{token::types::OR, Priority::OR},
+                                                {token::types::AND, Priority::AND},
+                                                {token::types::EQ, Priority::EQUALS},
                                                 {token::types::NOT_EQ, Priority::EQUALS},
                                                 {token::types::LT, Priority::LESSGREATER},
                                                 {token::types::GT, Priority::LESSGREATER},
@@ -138,6 +143,18 @@ namespace parser
             {
                 return parseReturnStatement();
             }
+            else if (curToken.Type == token::types::WHILE)
+            {
+                return parseWhileStatement();
+            }
+            else if (curToken.Type == token::types::FOR)
+            {
+                return parseForStatement();
+            }
+            else if (curToken.Type == token::types::IDENT && peekTokenIs(token::types::ASSIGN))
+            {
+                return parseAssignStatement();
+            }
             else
             {
                 return parseExpressionStatement();
@@ -190,6 +207,88 @@ namespace parser
             return pStmt;
         }
 
+        std::shared_ptr<ast::WhileStatement> parseWhileStatement()
+        {
+            std::shared_ptr<ast::WhileStatement> pStmt = std::make_shared<ast::WhileStatement>(curToken);
+            if (!expectPeek(token::types::LPAREN))
+            {
+                return nullptr;
+            }
+            nextToken();
+            pStmt->pCondition = parseExpression(Priority::LOWEST);
+            if (!expectPeek(token::types::RPAREN))
+            {
+                return nullptr;
+            }
+            if (!expectPeek(token::types::LBRACE))
+            {
+                return nullptr;
+            }
+            pStmt->pBody = parseBlockStatement();
+
+            if (peekTokenIs(token::types::SEMICOLON))
+            {
+                nextToken();
+            }
+            return pStmt;
+        }
+
+        std::shared_ptr<ast::ForStatement> parseForStatement()
+        {
+            std::shared_ptr<ast::ForStatement> pStmt = std::make_shared<ast::ForStatement>(curToken);
+            if (!expectPeek(token::types::LPAREN) || !expectPeek(token::types::IDENT))
+            {
+                return nullptr;
+            }
+            pStmt->pVariable = std::make_shared<ast::Identifier>(curToken, curToken.Literal);
+
+            if (!expectPeek(token::types::IN))
+            {
+                return nullptr;
+            }
+            nextToken();
+            pStmt->pStart = parseExpression(Priority::LOWEST);
+
+            if (!expectPeek(token::types::DOTDOT))
+            {
+                return nullptr;
+            }
+            nextToken();
+            pStmt->pEnd = parseExpression(Priority::LOWEST);
+
+            if (!expectPeek(token::types::RPAREN) || !expectPeek(token::types::LBRACE))
+            {
+                return nullptr;
+            }
+            pStmt->pBody = parseBlockStatement();
+
+            if (peekTokenIs(token::types::SEMICOLON))
+            {
+                nextToken();
+            }
+            return pStmt;
+        }
+
+        std::shared_ptr<ast::AssignStatement> parseAssignStatement()
+        {
+            auto pName = std::make_shared<ast::Identifier>(curToken, curToken.Literal);
+            nextToken();
+
+            std::shared_ptr<ast::AssignStatement> pStmt = std::make_shared<ast::AssignStatement>(curToken, pName);
+            nextToken();
+            pStmt->pValue = parseExpression(Priority::LOWEST);
+            if (pStmt->pValue == nullptr)
+            {
+                return nullptr;
+            }
+
+            if (peekTokenIs(token::types::SEMICOLON))
+            {
+                nextToken();
+            }
+            return pStmt;
+        }
+
         std::shared_ptr<ast::ExpressionStatement> parseExpressionStatement()
         {
             std::shared_ptr<ast::ExpressionStatement> pStmt = std::make_shared<ast::ExpressionStatement>(curToken);
@@ -412,6 +511,108 @@ namespace parser
             return pExpression;
         }
 
+        // match (x) { 1 => a, -2 => b, "s" => c, _ => d }, 最后一个分支后的逗号可选
+        std::shared_ptr<ast::Expression> parseMatchExpression()
+        {
+            std::shared_ptr<ast::MatchExpression> pExpression = std::make_shared<ast::MatchExpression>(curToken);
+            if (!expectPeek(token::types::LPAREN))
+            {
+                return nullptr;
+            }
+            nextToken();
+            pExpression->pSubject = parseExpression(Priority::LOWEST);
+            if (!expectPeek(token::types::RPAREN))
+            {
+                return nullptr;
+            }
+            if (!expectPeek(token::types::LBRACE))
+            {
+                return nullptr;
+            }
+
+            std::set<std::string> patterns; // 重复的模式在编译器和解释器中都当作错误, 而不是取第一个
+            while (!peekTokenIs(token::types::RBRACE))
+            {
+                nextToken();
+
+                ast::MatchArm arm;
+                if (!parseMatchPattern(arm))
+                {
+                    return nullptr;
+                }
+                if (!pExpression->Arms.empty() && pExpression->Arms.back().pPattern == nullptr)
+                {
+                    errors.push_back("match arm after the default arm _ is unreachable");
+                    return nullptr;
+                }
+                if (arm.pPattern != nullptr && !patterns.insert((arm.pPattern->GetNodeType() == ast::NodeType::StringLiteral ? "s:" : "i:") + arm.pPattern->String()).second)
+                {
+                    errors.push_back("duplicate match pattern " + arm.pPattern->String());
+                    return nullptr;
+                }
+                if (!expectPeek(token::types::ARROW))
+                {
+                    return nullptr;
+                }
+                nextToken();
+                arm.pBody = parseExpression(Priority::LOWEST);
+                if (arm.pBody == nullptr)
+                {
+                    return nullptr;
+                }
+                pExpression->Arms.push_back(arm);
+
+                if (!peekTokenIs(token::types::RBRACE) && !expectPeek(token::types::COMMA))
+                {
+                    return nullptr;
+                }
+            }
+
+            if (!expectPeek(token::types::RBRACE))
+            {
+                return nullptr;
+            }
+            return pExpression;
+        }
+
+        bool parseMatchPattern(ast::MatchArm &arm)
+        {
+            if (curTokenIs(token::types::IDENT) && curToken.Literal == "_")
+            {
+                arm.pPattern = nullptr;
+                return true;
+            }
+
+            if (curTokenIs(token::types::MINUS) && peekTokenIs(token::types::INT))
+            {
+                nextToken();
+                auto pLiteral = std::dynamic_pointer_cast<ast::IntegerLiteral>(parseIntegerLiteral());
+                if (pLiteral == nullptr)
+                {
+                    return false;
+                }
+                pLiteral->Token.Literal = "-" + pLiteral->Token.Literal;
+                pLiteral->Value = -pLiteral->Value;
+                arm.pPattern = pLiteral;
+                return true;
+            }
+
+            if (curTokenIs(token::types::INT))
+            {
+                arm.pPattern = parseIntegerLiteral();
+                return arm.pPattern != nullptr;
+            }
+
+            if (curTokenIs(token::types::STRING))
+            {
+                arm.pPattern = parseStringLiteral();
+                return true;
+            }
+
+            errors.push_back("invalid match pattern " + curToken.Literal + ", expected an integer, a string or _");
+            return false;
+        }
+
         std::shared_ptr<ast::BlockStatement> parseBlockStatement()
         {
             std::shared_ptr<ast::BlockStatement> pBlock = std::make_shared<ast::BlockStatement>(curToken);
@@ -485,16 +686,42 @@ namespace parser
 
         std::shared_ptr<ast::Expression> parseIndexExpression(std::shared_ptr<ast::Expression> left)
         {
-            std::shared_ptr<ast::IndexExpression> pExp = std::make_shared<ast::IndexExpression>(curToken, left);
+            auto tok = curToken;
             nextToken();
-            pExp->Index = parseExpression(Priority::LOWEST);
+
+            std::shared_ptr<ast::Expression> index;
+            if(!curTokenIs(token::types::COLON))
+            {
+                index = parseExpression(Priority::LOWEST);
+                if(!peekTokenIs(token::types::COLON))
+                {
+                    if(!expectPeek(token::types::RBRACKET))
+                    {
+                        return nullptr;
+                    }
+
+                    std::shared_ptr<ast::IndexExpression> pExp = std::make_shared<ast::IndexExpression>(tok, left);
+                    pExp->Index = index;
+                    return pExp;
+                }
+                nextToken();
+            }
+
+            // 当前是':', 后面可以省略结束下标
+            std::shared_ptr<ast::SliceExpression> pSlice = std::make_shared<ast::SliceExpression>(tok, left);
+            pSlice->pStart = index;
+            if(!peekTokenIs(token::types::RBRACKET))
+            {
+                nextToken();
+                pSlice->pEnd = parseExpression(Priority::LOWEST);
+            }
 
             if(!expectPeek(token::types::RBRACKET))
             {
                 return nullptr;
             }
 
-            return pExp;
+            return pSlice;
         }
 
         std::vector<std::shared_ptr<ast::Expression>> parseCallArguments()
@@ -531,7 +758,7 @@ namespace parser
         }
     };
 
-    std::unique_ptr<Parser> New(std::unique_ptr<lexer::Lexer> pLexer)
+    inline std::unique_ptr<Parser> New(std::unique_ptr<lexer::Lexer> pLexer)
     {
         std::unique_ptr<Parser> pParser = std::make_unique<Parser>();
         pParser->pLexer = std::move(pLexer);
@@ -549,6 +776,7 @@ namespace parser
         pParser->registerPrefix(token::types::FALSE, &Parser::parseBoolean);
         pParser->registerPrefix(token::types::LPAREN, &Parser::parseGroupedExpression);
         pParser->registerPrefix(token::types::IF, &Parser::parseIfExpression);
+        pParser->registerPrefix(token::types::MATCH, &Parser::parseMatchExpression);
         pParser->registerPrefix(token::types::FUNCTION, &Parser::parseFunctionLiteral);
 
         pParser->infixParseFns.clear();
@@ -560,6 +788,8 @@ namespace parser
         pParser->registerInfix(token::types::NOT_EQ, &Parser::parseInfixExpression);
         pParser->registerInfix(token::types::LT, &Parser::parseInfixExpression);
         pParser->registerInfix(token::types::GT, &Parser::parseInfixExpression);
+        pParser->registerInfix(token::types::AND, &Parser::parseInfixExpression);
+        pParser->registerInfix(token::types::OR, &Parser::parseInfixExpression);
         pParser->registerInfix(token::types::LPAREN, &Parser::parseCallExpression);
         pParser->registerInfix(token::types::LBRACKET, &Parser::parseIndexExpression);
 
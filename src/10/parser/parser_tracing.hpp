@@ -8,10 +8,10 @@
 
 namespace parser
 {
-	static int traceLevel = 0;
+	inline int traceLevel = 0;
 	const std::string traceIdentPlaceholder = "\t";
 
-	std::string identLevel()
+	inline std::string identLevel()
 	{
 		std::stringstream oss;
 		for (int i = 1; i < traceLevel; i++)
@@ -22,29 +22,29 @@ namespace parser
 		return oss.str();
 	}
 
-	void tracePrint(const std::string &str)
+	inline void tracePrint(const std::string &str)
 	{
 		std::cout << identLevel() << str << std::endl;
 	}
 
-	void incIdent()
+	inline void incIdent()
 	{
 		traceLevel += 1;
 	}
 
-	void decIdent()
+	inline void decIdent()
 	{
 		traceLevel -= 1;
 	}
 
-	std::string trace(const std::string &msg)
+	inline std::string trace(const std::string &msg)
 	{
 		incIdent();
 		tracePrint("BEGIN " + msg);
 		return msg;
 	}
 
-	void untrace(const std::string &msg)
+	inline void untrace(const std::string &msg)
 	{
 		tracePrint("END " + msg);
 		decIdent();
@@ -29,7 +29,7 @@ namespace repl
            '-----'
                               )"";
 
-    void printParserErrors(std::vector<std::string> errors)
+    inline void printParserErrors(std::vector<std::string> errors)
     {
         std::cout << MONKEY_FACE << std::endl;
         std::cout << "Woops! We ran into some monkey business here!" << std::endl;
@@ -40,27 +40,71 @@ namespace repl
         }
     }
 
-    void Start()
+    // 交互会话: 编译器(符号表/常量池)和虚拟机(全局变量)在整个会话中只有一份,
+    // 每一行只编译和执行这一行的指令, 新增的常量追加到已有常量之后, 代价与会话历史长短无关
+    struct Session
     {
-        //auto env = objects::NewEnvironment();
+        std::shared_ptr<compiler::Compiler> comp;
+        std::shared_ptr<vm::VM> machine;
 
-        std::vector<std::shared_ptr<objects::Object>> constants{};
-        std::vector<std::shared_ptr<objects::Object>> globals(vm::GlobalsSize);
-        auto symbolTable = compiler::NewSymbolTable();
+        Session()
+        {
+            comp = compiler::New();
+            machine = vm::New(comp->Bytecode());
+        }
 
-        int i = -1;
-        for(auto &fn: objects::Builtins)
+        // 编译失败时丢弃这一行的指令, 恢复到顶层作用域, 已经定义的符号和常量保留
+        std::shared_ptr<objects::Error> Compile(std::shared_ptr<ast::Node> node)
         {
-            i += 1;
-            symbolTable->DefineBuiltin(i, fn->Name);
+            auto global = comp->symbolTable;
+            comp->scopes.resize(1);
+            comp->scopeIndex = 0;
+            comp->scopes[0] = std::make_shared<compiler::CompilationScope>();
+
+            auto result = comp->Compile(node);
+            if(objects::isError(result))
+            {
+                comp->symbolTable = global;
+                comp->scopes.resize(1);
+                comp->scopeIndex = 0;
+                comp->scopes[0] = std::make_shared<compiler::CompilationScope>();
+            }
+            return result;
+        }
+
+        // 执行最近一次编译的代码, 返回最后弹出栈的值或错误
+        std::shared_ptr<objects::Object> Run()
+        {
+            machine->Continue(comp->scopes[0]->instructions, comp->constants);
+
+            auto result = machine->Run();
+            if(objects::isError(result))
+            {
+                return result;
+            }
+            auto top = machine->LastPoppedStackElem();
+            return (top == nullptr ? objects::NULL_OBJ : top);
         }
+    };
+
+    inline std::shared_ptr<Session> NewSession()
+    {
+        return std::make_shared<Session>();
+    }
+
+    inline void Start()
+    {
+        auto session = NewSession();
 
         std::string line;
         while (true)
         {
             std::cout << PROMPT;
 
-            getline(std::cin, line);
+            if (!getline(std::cin, line))
+            {
+                break;
+            }
 
             if (line.size() == 0)
             {
@@ -80,39 +124,21 @@ namespace repl
 
             std::shared_ptr<ast::Node> astNode(reinterpret_cast<ast::Node *>(pProgram.release()));
 
-            /* auto evaluated = evaluator::Eval(astNode, env);
-
-            if (evaluated != nullptr)
-            {
-                std::cout << evaluated->Inspect() << std::endl;
-            } */
-
-            //auto comp = compiler::New();
-            auto comp = compiler::NewWithState(symbolTable, constants);
-            auto result = comp->Compile(astNode);
+            auto result = session->Compile(astNode);
             if(objects::isError(result))
             {
                 std::cout << "Woops! Compilation failed: \n" + result->Inspect() << std::endl;
                 continue;
             }
 
-            //auto machine = vm::New(comp->Bytecode());
-            auto code = comp->Bytecode();
-            auto machine = vm::NewWithGlobalsStore(code, globals);
-
-            auto runResult = machine->Run();
+            auto runResult = session->Run();
             if(objects::isError(runResult))
             {
                 std::cout << "Woops! Executing bytecode failed: \n" + runResult->Inspect() << std::endl;
                 continue;
             }
 
-            // auto stackTop = machine->StackTop();
-            auto stackTop = machine->LastPoppedStackElem();
-            std::cout << stackTop->Inspect() << std::endl;
-
-            constants = code->Constants;
-            globals = machine->globals;
+            std::cout << runResult->Inspect() << std::endl;
         }
     }
 }
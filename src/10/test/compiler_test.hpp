@@ -1191,25 +1191,32 @@ TEST(TestCompileBuiltins, BasicAssertions)
     std::vector<std::vector<bytecode::Instructions>> ins{
         {
             {bytecode::Make(bytecode::OpcodeType::OpGetBuiltin, {0})},
-            {bytecode::Make(bytecode::OpcodeType::OpArray, {0})},
+            {bytecode::Make(bytecode::OpcodeType::OpGetLocal, {0})},
             {bytecode::Make(bytecode::OpcodeType::OpCall, {1})},
             {bytecode::Make(bytecode::OpcodeType::OpReturnValue)},
         }
     };
 
+    // 参数不是字面量, 编译为运行时调用(字面量参数见 TestCompileBuiltinFolding)
     std::vector<CompilerTestCase>  tests
     {
         {
-            "len([]); push([], 1);",
+            "let a = []; len(a); push(a, 1);",
             {
                 1
             },
             {
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpArray, {0})
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpSetGlobal, {0})
+                },
                 {
                     bytecode::Make(bytecode::OpcodeType::OpGetBuiltin, {0})
                 },
                 {
-                    bytecode::Make(bytecode::OpcodeType::OpArray, {0})
+                    bytecode::Make(bytecode::OpcodeType::OpGetGlobal, {0})
                 },
                 {
                     bytecode::Make(bytecode::OpcodeType::OpCall, {1})
@@ -1221,7 +1228,7 @@ TEST(TestCompileBuiltins, BasicAssertions)
                     bytecode::Make(bytecode::OpcodeType::OpGetBuiltin, {5})
                 },
                 {
-                    bytecode::Make(bytecode::OpcodeType::OpArray, {0})
+                    bytecode::Make(bytecode::OpcodeType::OpGetGlobal, {0})
                 },
                 {
                     bytecode::Make(bytecode::OpcodeType::OpConstant, {0})
@@ -1235,7 +1242,7 @@ TEST(TestCompileBuiltins, BasicAssertions)
             }
         },
         {
-            "fn(){ len([]) };",
+            "fn(a){ len(a) };",
             {
                 ins[0],
             },
@@ -1254,6 +1261,111 @@ TEST(TestCompileBuiltins, BasicAssertions)
 } 
 
 
+TEST(TestCompileBuiltinFolding, BasicAssertions)
+{
+    std::vector<std::vector<bytecode::Instructions>> ins{
+        {
+            {bytecode::Make(bytecode::OpcodeType::OpConstant, {0})},
+            {bytecode::Make(bytecode::OpcodeType::OpReturnValue)},
+        }
+    };
+
+    std::vector<CompilerTestCase>  tests
+    {
+        {
+            "len(\"abc\"); first([1, 2, 3]); len(rest([1, 2, 3]));",
+            {
+                3,
+                1,
+                2
+            },
+            {
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpConstant, {0})
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpPop)
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpConstant, {1})
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpPop)
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpConstant, {2})
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpPop)
+                },
+            }
+        },
+        {
+            "first([]); first([true]); len(1);",
+            {
+                1
+            },
+            {
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpNull)
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpPop)
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpTrue)
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpPop)
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpGetBuiltin, {0})
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpConstant, {0})
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpCall, {1})
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpPop)
+                },
+            }
+        },
+        {
+            "let len = fn(x){ 0 }; len(\"abc\");",
+            {
+                0,
+                ins[0],
+                "abc"
+            },
+            {
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpClosure, {1, 0})
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpSetGlobal, {0})
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpGetGlobal, {0})
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpConstant, {2})
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpCall, {1})
+                },
+                {
+                    bytecode::Make(bytecode::OpcodeType::OpPop)
+                },
+            }
+        },
+    };
+
+    runCompilerTests(tests);
+}
+
+
 TEST(TestCompileClosure, BasicAssertions)
 {
     std::vector<std::vector<bytecode::Instructions>> ins{
@@ -1515,3 +1627,43 @@ TEST(TestCompileRecursiveFunctions, BasicAssertions)
 
     runCompilerTests(tests);
 } 
+
+
+TEST(TestCompilePureFunctions, BasicAssertions)
+{
+    std::vector<std::pair<std::string, bool>> tests{
+        {"let f = fn(x){ x * 2 };", true},
+        {"let f = fn(x){ len(x) + first(x) };", true},
+        {"let f = fn(x){ if(x < 2){ return x; } f(x - 1) + f(x - 2) };", true},
+        {"let g = fn(x){ x + 1 }; let f = fn(x){ g(x) * 2 };", true},
+        {"let f = fn(x){ puts(x); x };", false},
+        {"let f = fn(x){ let p = puts; x };", false},
+        {"let f = fn(g){ g(1) };", false},
+        {"let g = fn(x){ puts(x) }; let f = fn(x){ g(x) };", false},
+        {"let f = fn(x){ fn(y){ x + y }(1) };", false},
+        {"let f = fn(x){ let y = x; y = y * 2; y };", true},
+        {"let c = 0; let f = fn(x){ c = x; x };", false},
+        {"let k = 1; let f = fn(x){ x + k }; k = 2;", false},
+        {"let k = 1; k = 2; let f = fn(x){ x + k };", false},
+    };
+
+    for(auto &[input, pure]: tests)
+    {
+        auto compiler = compiler::New();
+        EXPECT_EQ(compiler->Compile(TestHelper(input)), nullptr);
+
+        // 最后一个编译出的函数常量就是 f
+        auto bytecodeObj = compiler->Bytecode();
+        std::shared_ptr<objects::CompiledFunction> fn;
+        for(auto &constant: bytecodeObj->Constants)
+        {
+            if(auto obj = std::dynamic_pointer_cast<objects::CompiledFunction>(constant); obj != nullptr)
+            {
+                fn = obj;
+            }
+        }
+
+        ASSERT_NE(fn, nullptr);
+        EXPECT_EQ(fn->Pure, pure) << input;
+    }
+}
@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+#include "embed/monkey.hpp"
+
+TEST(testEmbedCompileAndRun, basicTest)
+{
+    auto runtime = monkey::NewRuntime();
+
+    std::string error;
+    auto program = runtime->Compile("let double = fn(x){ x * 2 }; [double(n), name + \"!\", n > 10]", {"n", "name"}, error);
+    ASSERT_NE(program, nullptr) << error;
+
+    // 同一个程序用不同的注入变量反复运行
+    for(int n = 0; n < 20; n++)
+    {
+        auto result = runtime->Run(program, {{"n", monkey::Value::Int(n)}, {"name", monkey::Value::Str("monkey")}});
+        ASSERT_TRUE(result.Ok) << result.Error;
+        ASSERT_EQ(result.Output.Type, monkey::ValueType::Array);
+        ASSERT_EQ(result.Output.Elements.size(), 3);
+        EXPECT_EQ(result.Output.Elements[0].Integer, n * 2);
+        EXPECT_EQ(result.Output.Elements[1].String, "monkey!");
+        EXPECT_EQ(result.Output.Elements[2].Boolean, n > 10);
+    }
+
+    auto hash = runtime->Compile("{\"sum\": first(xs) + last(xs), \"config\": config}", {"xs", "config"}, error);
+    ASSERT_NE(hash, nullptr) << error;
+
+    auto config = monkey::Value::Map({monkey::Value::Str("debug")}, {monkey::Value::Bool(true)});
+    auto result = runtime->Run(hash, {{"xs", monkey::Value::List({monkey::Value::Int(1), monkey::Value::Int(41)})}, {"config", config}});
+    ASSERT_TRUE(result.Ok) << result.Error;
+    EXPECT_EQ(result.Output.Inspect(), "{\"config\": {\"debug\": true}, \"sum\": 42}");
+
+    // 未注入的变量为null, 上一次运行的全局变量不会残留
+    result = runtime->Run(program);
+    EXPECT_FALSE(result.Ok);
+    EXPECT_EQ(result.Error, "unsupported types for binary operaction: Null INTEGER");
+
+    EXPECT_EQ(monkey::Version(), MONKEY_EMBED_API_VERSION);
+}
+
+TEST(testEmbedErrors, basicTest)
+{
+    auto runtime = monkey::NewRuntime();
+    std::string error;
+
+    EXPECT_EQ(runtime->Compile("let = 1;", error), nullptr);
+    EXPECT_EQ(error.find("parser errors: "), 0);
+
+    EXPECT_EQ(runtime->Compile("missing + 1", error), nullptr);
+    EXPECT_EQ(error, "compile error: undefined variable missing");
+
+    auto program = runtime->Compile("len(x)", {"x"}, error);
+    ASSERT_NE(program, nullptr);
+
+    auto result = runtime->Run(program, {{"y", monkey::Value::Int(1)}});
+    EXPECT_FALSE(result.Ok);
+    EXPECT_EQ(result.Error, "unknown global: y");
+
+    result = runtime->Run(program, {{"x", monkey::Value::Int(1)}});
+    EXPECT_FALSE(result.Ok);
+    EXPECT_EQ(result.Error, "argument to `len` not supported, got INTEGER");
+
+    result = runtime->Run(program, {{"x", monkey::Value::Str("four")}});
+    ASSERT_TRUE(result.Ok);
+    EXPECT_EQ(result.Output.Integer, 4);
+
+    auto fn = runtime->Compile("fn(){ 1 }", error);
+    result = runtime->Run(fn);
+    ASSERT_TRUE(result.Ok);
+    EXPECT_EQ(result.Output.Type, monkey::ValueType::Other);
+}
+
+TEST(testEmbedHostBuffers, basicTest)
+{
+    auto runtime = monkey::NewRuntime();
+    std::string error;
+
+    // 脚本直接读宿主内存: 下标/len/first/rest, rest是不复制的视图
+    auto program = runtime->Compile(R"(
+        let sum = fn(xs){ if (len(xs) == 0) { 0 } else { first(xs) + sum(rest(xs)) } };
+        [sum(nums), bytes[1], last(names), len(rest(bytes)), rest(nums)]
+    )", {"nums", "bytes", "names"}, error);
+    ASSERT_NE(program, nullptr) << error;
+
+    std::vector<int64_t> nums{1, 2, 3, 4};
+    std::vector<uint8_t> bytes{7, 255, 9};
+    std::vector<std::string> names{"a", "b"};
+
+    auto result = runtime->Run(program, {{"nums", monkey::Value::Int64s(nums.data(), nums.size())},
+                                         {"bytes", monkey::Value::Bytes(bytes.data(), bytes.size())},
+                                         {"names", monkey::Value::Strings(names.data(), names.size())}});
+    ASSERT_TRUE(result.Ok) << result.Error;
+    EXPECT_EQ(result.Output.Inspect(), "[10, 255, \"b\", 2, [2, 3, 4]]");
+
+    // 同一个程序换一块内存再运行
+    std::vector<int64_t> more{100, 200};
+    result = runtime->Run(program, {{"nums", monkey::Value::Int64s(more.data(), more.size())},
+                                    {"bytes", monkey::Value::Bytes(bytes.data(), bytes.size())},
+                                    {"names", monkey::Value::Strings(names.data(), names.size())}});
+    ASSERT_TRUE(result.Ok) << result.Error;
+    EXPECT_EQ(result.Output.Elements[0].Integer, 300);
+    EXPECT_EQ(result.Output.Elements[4].Inspect(), "[200]");
+}
+
+TEST(testEmbedMemoryLimit, basicTest)
+{
+    monkey::RuntimeOptions options;
+    options.MemoryLimit = 64 * 1024;
+    auto runtime = monkey::NewRuntime(options);
+    std::string error;
+
+    auto runaway = runtime->Compile("let grow = fn(arr){ grow(push(arr, 0)) }; grow(seed);", {"seed"}, error);
+    ASSERT_NE(runaway, nullptr) << error;
+
+    auto result = runtime->Run(runaway, {{"seed", monkey::Value::List({monkey::Value::Int(1)})}});
+    EXPECT_FALSE(result.Ok);
+    EXPECT_EQ(result.Error.find("memory limit exceeded: "), 0);
+
+    // 同一个Runtime之后仍然可以正常运行, 上次运行的对象已被释放
+    auto small = runtime->Compile("len([1, 2, 3])", error);
+    result = runtime->Run(small);
+    ASSERT_TRUE(result.Ok) << result.Error;
+    EXPECT_EQ(result.Output.Integer, 3);
+    EXPECT_LT(runtime->HeapBytes(), 1024);
+
+    // 其它Runtime不受影响
+    auto unlimited = monkey::NewRuntime();
+    EXPECT_EQ(unlimited->HeapBytes(), 0);
+}
+
+TEST(testEmbedTimeLimit, basicTest)
+{
+    monkey::RuntimeOptions options;
+    options.TimeLimit = 50;
+    auto runtime = monkey::NewRuntime(options);
+    std::string error;
+
+    auto forever = runtime->Compile("let i = 0; while (true) { i = i + 1; }", error);
+    ASSERT_NE(forever, nullptr) << error;
+
+    auto result = runtime->Run(forever);
+    EXPECT_FALSE(result.Ok);
+    EXPECT_EQ(result.Error, "time limit exceeded");
+
+    // 截止时间按每次Run重新计算
+    auto quick = runtime->Compile("1 + 2", error);
+    result = runtime->Run(quick);
+    ASSERT_TRUE(result.Ok) << result.Error;
+    EXPECT_EQ(result.Output.Integer, 3);
+}
+
+TEST(testEmbedImportRelocation, basicTest)
+{
+    std::string dir = "/tmp/monkey_embed_import_test_" + std::to_string(getpid());
+    mkdir(dir.c_str(), 0755);
+    writeModuleFile(dir + "/n.monkey", "let nv = 42; let nw = 0;");
+    writeModuleFile(dir + "/m.monkey", "import(\"n.monkey\"); let mv = fn(){ nv + 1 };");
+
+    auto runtime = monkey::NewRuntime();
+    std::string error;
+
+    // 两个程序中m的链接位置相同, 但第一个程序里m间接导入的n复用了直接导入的那份全局变量
+    auto diamond = runtime->Compile("import(\"" + dir + "/n.monkey\"); import(\"" + dir + "/m.monkey\"); mv()", error);
+    ASSERT_NE(diamond, nullptr) << error;
+    auto result = runtime->Run(diamond);
+    ASSERT_TRUE(result.Ok) << result.Error;
+    EXPECT_EQ(result.Output.Integer, 43);
+
+    auto direct = runtime->Compile("let a = 1; let b = 2 + 3; import(\"" + dir + "/m.monkey\"); mv()", error);
+    ASSERT_NE(direct, nullptr) << error;
+    result = runtime->Run(direct);
+    ASSERT_TRUE(result.Ok) << result.Error;
+    EXPECT_EQ(result.Output.Integer, 43);
+
+    result = runtime->Run(diamond);
+    ASSERT_TRUE(result.Ok) << result.Error;
+    EXPECT_EQ(result.Output.Integer, 43);
+}
@@ -123,6 +123,12 @@ TEST(TestEvalBooleanExpression, BasicAssertions)
             {"true != false", true},
             {"false != true", true},
             {"(1 < 2) == true", true},
+            {"1 < 2 && 2 < 3", true},
+            {"1 < 2 && 2 > 3", false},
+            {"false || 1", true},
+            {"0 && false || !true", false},
+            {"false && 1 + \"a\"", false},
+            {"true || 1 + \"a\"", true},
             {"(1 < 2) == false", false},
             {"(1 > 2) == true", false},
             {"(1 > 2) == false", true},
@@ -397,6 +403,82 @@ TEST(TestEvalLetStatements, BasicAssertions)
     }
 }
 
+TEST(TestEvalWhileAndAssign, BasicAssertions)
+{
+    struct Input
+    {
+        std::string input;
+        int64_t expected;
+    };
+
+    struct Input inputs[]
+    {
+        {"let i = 0; let s = 0; while (i < 10) { s = s + i; i = i + 1; }; s;", 45},
+        {"let f = fn(n){ let i = 0; while (true) { if (i == n) { return i * 2; }; i = i + 1; } }; f(4);", 8},
+        {"let n = 0; let bump = fn(){ n = n + 1; }; bump(); bump(); n;", 2},
+        {"let s = 0; for (i in 0..10) { s = s + i; }; s;", 45},
+        {"let f = fn(){ for (i in 0..100) { if (i * i > 50) { return i; } } }; f();", 8},
+    };
+
+    for (const auto &item : inputs)
+    {
+        std::shared_ptr<objects::Object> evaluatedObj = testEval(item.input);
+        testIntegerObject(evaluatedObj, item.expected);
+    }
+
+    auto errObj = std::dynamic_pointer_cast<objects::Error>(testEval("let f = fn(){ let a = 1; fn(){ a = 2; }() }; f();"));
+    ASSERT_NE(errObj, nullptr);
+    EXPECT_EQ(errObj->Message, "can not assign to captured variable a");
+}
+
+TEST(TestEvalMatchExpression, BasicAssertions)
+{
+    struct Input
+    {
+        std::string input;
+        int64_t expected;
+    };
+
+    struct Input inputs[]
+    {
+        {"let f = fn(s){ match (s) { 0 => 10, 1 => 11, -3 => 7, _ => -1 } }; f(1) + f(-3);", 18},
+        {"let f = fn(s){ match (s) { 0 => 10, 1 => 11, -3 => 7, _ => -1 } }; f(2) + f(\"0\");", -2},
+        {"match (\"mul\") { \"add\" => 1, \"mul\" => 3 };", 3},
+    };
+
+    for (const auto &item : inputs)
+    {
+        std::shared_ptr<objects::Object> evaluatedObj = testEval(item.input);
+        testIntegerObject(evaluatedObj, item.expected);
+    }
+
+    testNullObject(testEval("match (5) { 1 => 2 }"));
+}
+
+TEST(TestEvalLazySequences, BasicAssertions)
+{
+    struct Input
+    {
+        std::string input;
+        int64_t expected;
+    };
+
+    struct Input inputs[]
+    {
+        {"sum(map(filter(iter(0, 10), fn(x){ x > 6 }), fn(x){ x * 2 }));", 48},
+        {"reduce(zip([1, 2, 3], iter(10, 20)), 0, fn(acc, p){ acc + p[0] * p[1] });", 68},
+        {"let n = 0; let f = fn(x){ n = n + 1; x }; sum(take(map(iter(0, 1000000), f), 3)) + n * 100;", 303},
+        {"let xs = [1, 2, 3, 4, 5][1:]; sum(map(xs[:3], fn(x){ x * x })) + len(rest(xs));", 32},
+        {"let h = merge(set({\"a\": 1}, \"b\", 2), {\"c\": 3}); sum(values(delete(h, \"a\"))) + len(keys(h));", 8},
+    };
+
+    for (const auto &item : inputs)
+    {
+        std::shared_ptr<objects::Object> evaluatedObj = testEval(item.input);
+        testIntegerObject(evaluatedObj, item.expected);
+    }
+}
+
 TEST(TestEvalFunctionObject, BasicAssertions)
 {
     std::string input = "fn(x) { x + 2; };";
@@ -547,6 +629,14 @@ sum([1, 2, 3, 4, 5]);
                 EXPECT_NE(arrObj, nullptr);
                 EXPECT_STREQ(arrObj->Inspect().c_str(), strVal.c_str());
             }
+            else if(std::shared_ptr<objects::IntArray> intArrObj = std::dynamic_pointer_cast<objects::IntArray>(evaluatedObj); intArrObj != nullptr)
+            {
+                EXPECT_STREQ(intArrObj->Inspect().c_str(), strVal.c_str());
+            }
+            else if(std::shared_ptr<objects::ArraySlice> sliceObj = std::dynamic_pointer_cast<objects::ArraySlice>(evaluatedObj); sliceObj != nullptr)
+            {
+                EXPECT_STREQ(sliceObj->Inspect().c_str(), strVal.c_str());
+            }
             else if(std::shared_ptr<objects::Error> errObj = std::dynamic_pointer_cast<objects::Error>(evaluatedObj); errObj != nullptr)
             {
                 EXPECT_NE(errObj, nullptr);
@@ -563,6 +653,27 @@ sum([1, 2, 3, 4, 5]);
 }
 
 
+TEST(TestEvalMemo, BasicAssertions)
+{
+    // 不缓存时 fib(50) 需要指数次调用
+    auto evaluated = testEval(R""(
+let fib = memo(fn(x){
+    if(x < 2){ return x; }
+    fib(x - 1) + fib(x - 2);
+});
+fib(50);
+    )"");
+    testIntegerObject(evaluated, 12586269025);
+
+    testStringObject(testEval("let greet = memo(fn(name){ \"hi \" + name }); greet(\"a\"); greet(\"b\"); greet(\"a\");"), "hi a");
+    testIntegerObject(testEval("let f = memo(fn(arr){ len(arr) }, 1); f([1, 2]) + f([1, 2, 3]);"), 5);
+
+    auto errObj = std::dynamic_pointer_cast<objects::Error>(testEval("memo(1)"));
+    ASSERT_NE(errObj, nullptr);
+    EXPECT_STREQ(errObj->Message.c_str(), "argument to `memo` must be a function, got INTEGER");
+}
+
+
 TEST(TestEvalArrayLiteral, BasicAssertions)
 {
 	std::string input = "[1, 2 * 2, 3 + 3]";
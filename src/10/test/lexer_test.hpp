@@ -132,3 +132,12 @@ TEST(TestNextToken, BasicAssertions)
         EXPECT_EQ(tok.Literal, test.Literal);
     }
 }
+
+TEST(TestStringEscapes, BasicAssertions)
+{
+    auto lexer = lexer::New(R""("a\nb\t\"c\"\\ \d")"");
+    token::Token tok = lexer->NextToken();
+    EXPECT_EQ(tok.Type, token::types::STRING);
+    EXPECT_EQ(tok.Literal, "a\nb\t\"c\"\\ \\d");
+    EXPECT_EQ(lexer->NextToken().Type, token::types::EndOF);
+}
@@ -9,6 +9,9 @@
 #include "test/compiler_test.hpp"
 #include "test/symbol_table_test.hpp"
 #include "test/vm_test.hpp"
+#include "test/register_vm_test.hpp"
+#include "test/embed_test.hpp"
+#include "test/monkeyd_test.hpp"
 
 int main(int argc, char **argv)
 {
@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <memory>
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "monkeyd/protocol.hpp"
+#include "monkeyd/server.hpp"
+
+TEST(testMonkeydProtocol, basicTest)
+{
+    std::vector<uint8_t> bytes{1, 2, 3};
+
+    monkeyd::Request request;
+    request.Source = "len(data)";
+    request.Globals["data"] = monkey::Value::Bytes(bytes.data(), bytes.size());
+    request.Globals["opts"] = monkey::Value::Map({monkey::Value::Str("n")}, {monkey::Value::List({monkey::Value::Int(-1), monkey::Value::Bool(true), monkey::Value::Null()})});
+
+    monkeyd::Request decoded;
+    auto payload = std::make_shared<std::string>(monkeyd::EncodeRequest(request));
+    ASSERT_TRUE(monkeyd::DecodeRequest(payload, decoded));
+    EXPECT_EQ(decoded.Kind, monkeyd::RequestKind::Source);
+    EXPECT_EQ(decoded.Source, "len(data)");
+    EXPECT_EQ(decoded.Globals["opts"].Inspect(), "{\"n\": [-1, true, null]}");
+
+    // Bytes直接指向请求负载
+    auto &data = decoded.Globals["data"];
+    ASSERT_EQ(data.Type, monkey::ValueType::Bytes);
+    ASSERT_EQ(data.Size, 3);
+    EXPECT_GE(static_cast<const char *>(data.Data), payload->data());
+    EXPECT_EQ(static_cast<const uint8_t *>(data.Data)[2], 3);
+
+    // 截断的负载解码失败
+    auto truncated = std::make_shared<std::string>(payload->substr(0, payload->size() - 1));
+    EXPECT_FALSE(monkeyd::DecodeRequest(truncated, decoded));
+
+    // 嵌套超过MaxValueDepth层的数组解码失败, 而不是递归耗尽栈
+    auto nested = [](int depth) {
+        monkeyd::Encoder encoder;
+        encoder.PutU8(static_cast<uint8_t>(monkeyd::RequestKind::Source));
+        encoder.PutString("x");
+        encoder.PutU32(1);
+        encoder.PutString("x");
+        for (int i = 0; i < depth; i++)
+        {
+            encoder.PutU8(static_cast<uint8_t>(monkey::ValueType::Array));
+            encoder.PutU32(1);
+        }
+        encoder.PutU8(static_cast<uint8_t>(monkey::ValueType::Null));
+        return std::make_shared<std::string>(encoder.Buffer);
+    };
+    EXPECT_TRUE(monkeyd::DecodeRequest(nested(monkeyd::MaxValueDepth), decoded));
+    EXPECT_FALSE(monkeyd::DecodeRequest(nested(monkeyd::MaxValueDepth + 1), decoded));
+    EXPECT_FALSE(monkeyd::DecodeRequest(nested(1000000), decoded));
+
+    monkeyd::Response response;
+    response.Code = monkeyd::Status::Error;
+    response.ProgramID = 7;
+    response.Error = "boom";
+
+    monkeyd::Response decodedResponse;
+    ASSERT_TRUE(monkeyd::DecodeResponse(monkeyd::EncodeResponse(response), decodedResponse));
+    EXPECT_EQ(decodedResponse.Code, monkeyd::Status::Error);
+    EXPECT_EQ(decodedResponse.ProgramID, 7);
+    EXPECT_EQ(decodedResponse.Error, "boom");
+}
+
+TEST(testMonkeydServer, basicTest)
+{
+    monkeyd::ServerOptions options;
+    options.SocketPath = "/tmp/monkeyd_test_" + std::to_string(getpid()) + ".sock";
+    options.Workers = 2;
+
+    auto server = monkeyd::New(options);
+    std::string error;
+    ASSERT_TRUE(server->Listen(error)) << error;
+    std::thread acceptor([&server]() { server->Serve(); });
+
+    monkeyd::Client client;
+    ASSERT_TRUE(client.Connect(options.SocketPath, error)) << error;
+
+    monkeyd::Request request;
+    request.Source = "let f = fn(x){ x * 2 }; f(n)";
+    request.Globals["n"] = monkey::Value::Int(21);
+
+    monkeyd::Response response;
+    std::string payload;
+    ASSERT_TRUE(client.Call(request, response, payload));
+    ASSERT_EQ(response.Code, monkeyd::Status::Ok) << response.Error;
+    EXPECT_EQ(response.Output.Integer, 42);
+
+    // 按程序ID请求, 不再发送源码
+    monkeyd::Request byID;
+    byID.Kind = monkeyd::RequestKind::Program;
+    byID.ProgramID = response.ProgramID;
+    byID.Globals["n"] = monkey::Value::Int(5);
+    ASSERT_TRUE(client.Call(byID, response, payload));
+    ASSERT_EQ(response.Code, monkeyd::Status::Ok) << response.Error;
+    EXPECT_EQ(response.Output.Integer, 10);
+
+    // 另一个连接上相同的源码命中缓存
+    monkeyd::Client other;
+    ASSERT_TRUE(other.Connect(options.SocketPath, error)) << error;
+    ASSERT_TRUE(other.Call(request, response, payload));
+    EXPECT_EQ(response.ProgramID, byID.ProgramID);
+    EXPECT_EQ(server->Cache.Size(), 1);
+
+    byID.ProgramID = 999;
+    ASSERT_TRUE(client.Call(byID, response, payload));
+    EXPECT_EQ(response.Code, monkeyd::Status::Error);
+    EXPECT_EQ(response.Error, "unknown program: 999");
+
+    request.Source = "n +";
+    ASSERT_TRUE(client.Call(request, response, payload));
+    EXPECT_EQ(response.Code, monkeyd::Status::Error);
+    EXPECT_EQ(response.Error.find("parser errors: "), 0);
+
+    server->Stop();
+    acceptor.join();
+}
+
+TEST(testMonkeydServerDispatch, basicTest)
+{
+    monkeyd::ServerOptions options;
+    options.SocketPath = "/tmp/monkeyd_dispatch_test_" + std::to_string(getpid()) + ".sock";
+    options.Workers = 1;
+    options.TimeLimit = 100;
+    options.ReadTimeout = 200;
+
+    auto server = monkeyd::New(options);
+    std::string error;
+    ASSERT_TRUE(server->Listen(error)) << error;
+    std::thread acceptor([&server]() { server->Serve(); });
+
+    // 多于工作线程数的空闲连接, 以及一个只发了半个帧头的连接, 都不占用工作线程
+    std::vector<std::unique_ptr<monkeyd::Client>> idle;
+    for (int i = 0; i < 5; i++)
+    {
+        idle.push_back(std::make_unique<monkeyd::Client>());
+        ASSERT_TRUE(idle.back()->Connect(options.SocketPath, error)) << error;
+    }
+
+    monkeyd::Client partial;
+    ASSERT_TRUE(partial.Connect(options.SocketPath, error)) << error;
+    ASSERT_TRUE(monkeyd::writeAll(partial.fd, "\x10\x00", 2));
+
+    monkeyd::Request request;
+    request.Source = "n + 1";
+    request.Globals["n"] = monkey::Value::Int(41);
+
+    monkeyd::Response response;
+    std::string payload;
+    for (auto &client : idle)
+    {
+        ASSERT_TRUE(client->Call(request, response, payload));
+        ASSERT_EQ(response.Code, monkeyd::Status::Ok) << response.Error;
+        EXPECT_EQ(response.Output.Integer, 42);
+    }
+
+    // 死循环的请求超时失败, 工作线程随后继续服务其它请求
+    monkeyd::Request forever;
+    forever.Source = "while (true) { }";
+    ASSERT_TRUE(idle[0]->Call(forever, response, payload));
+    EXPECT_EQ(response.Code, monkeyd::Status::Error);
+    EXPECT_EQ(response.Error, "time limit exceeded");
+
+    ASSERT_TRUE(idle[1]->Call(request, response, payload));
+    EXPECT_EQ(response.Output.Integer, 42);
+
+    // 半帧在ReadTimeout后被关闭
+    timeval wait{2, 0};
+    setsockopt(partial.fd, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait));
+    char byte;
+    EXPECT_EQ(read(partial.fd, &byte, 1), 0);
+
+    server->Stop();
+    acceptor.join();
+}
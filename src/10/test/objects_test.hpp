@@ -4,6 +4,7 @@
 #include <memory>
 
 #include "objects/objects.hpp"
+#include "objects/host.hpp"
 
 TEST(TestStringHashKey, BasicAssertions)
 {
@@ -18,3 +19,95 @@ TEST(TestStringHashKey, BasicAssertions)
 
     EXPECT_NE(hello1.GetHashKey(), diff1.GetHashKey());
 }
+
+TEST(TestHashKeyOrdering, BasicAssertions)
+{
+    // 不同类型的对象可能有相同的Value, 作为map的键时不能相互覆盖
+    std::map<objects::HashKey, int> keys;
+    keys[objects::Integer(1).GetHashKey()] = 1;
+    keys[objects::Boolean(true).GetHashKey()] = 2;
+
+    EXPECT_EQ(keys.size(), 2);
+    EXPECT_EQ(keys[objects::Integer(1).GetHashKey()], 1);
+}
+
+TEST(TestMemoTable, BasicAssertions)
+{
+    objects::MemoTable memo(2);
+
+    std::vector<std::shared_ptr<objects::Object>> args{
+        std::make_shared<objects::Integer>(1),
+        std::make_shared<objects::Integer>(2),
+        std::make_shared<objects::Integer>(3),
+        std::make_shared<objects::Array>(),
+    };
+
+    std::vector<objects::HashKey> key1, key2, key3, unhashable;
+    EXPECT_TRUE(objects::MemoTable::MakeKey(args, 0, 1, key1));
+    EXPECT_TRUE(objects::MemoTable::MakeKey(args, 1, 1, key2));
+    EXPECT_TRUE(objects::MemoTable::MakeKey(args, 2, 1, key3));
+    EXPECT_FALSE(objects::MemoTable::MakeKey(args, 2, 2, unhashable));
+
+    memo.Put(key1, {args[0]}, std::make_shared<objects::Integer>(10));
+    memo.Put(key2, {args[1]}, std::make_shared<objects::Integer>(20));
+    EXPECT_NE(memo.Get(key1, args, 0), nullptr);
+
+    // key2 最久未使用, 被淘汰
+    memo.Put(key3, {args[2]}, std::make_shared<objects::Integer>(30));
+    EXPECT_EQ(memo.Size(), 2);
+    EXPECT_EQ(memo.Get(key2, args, 1), nullptr);
+    EXPECT_EQ(std::dynamic_pointer_cast<objects::Integer>(memo.Get(key1, args, 0))->Value, 10);
+    EXPECT_EQ(std::dynamic_pointer_cast<objects::Integer>(memo.Get(key3, args, 2))->Value, 30);
+    EXPECT_EQ(memo.Hits, 3);
+    EXPECT_EQ(memo.Misses, 1);
+}
+
+TEST(TestHostBuffer, BasicAssertions)
+{
+    int64_t data[] = {10, 20, 30, 40};
+    auto lease = std::make_shared<objects::HostLease>();
+    auto buffer = std::make_shared<objects::HostBuffer>(objects::HostElement::Int64, data, 4, lease);
+
+    EXPECT_EQ(buffer->Inspect(), "int64s(4)");
+    EXPECT_EQ(buffer->At(1)->Inspect(), "20");
+    EXPECT_EQ(buffer->At(4), objects::NULL_OBJ);
+
+    // 切片共享宿主内存
+    auto view = buffer->Slice(1, 4);
+    EXPECT_EQ(view->Length, 3);
+    EXPECT_EQ(view->At(0)->Inspect(), "20");
+    data[1] = 21;
+    EXPECT_EQ(view->At(0)->Inspect(), "21");
+
+    lease->Valid = false;
+    EXPECT_EQ(view->At(0)->Inspect(), "ERROR: host buffer is no longer available");
+}
+
+TEST(TestHeapAccounting, BasicAssertions)
+{
+    auto heap = objects::NewHeap(0);
+    auto outside = std::make_shared<objects::Integer>(1);
+
+    {
+        objects::HeapScope scope(heap);
+        auto num = std::make_shared<objects::Integer>(1);
+        auto str = std::make_shared<objects::String>("monkey");
+        std::vector<std::shared_ptr<objects::Object>> elements{num, str, outside};
+        auto arr = std::make_shared<objects::Array>(elements);
+
+        EXPECT_EQ(heap->Objects, 3);
+        EXPECT_GE(heap->Allocated, static_cast<int64_t>(sizeof(objects::Integer) + sizeof(objects::String) + sizeof(objects::Array) + 3 * sizeof(std::shared_ptr<objects::Object>)));
+        EXPECT_EQ(heap->Peak, heap->Allocated);
+    }
+
+    // 离开作用域后对象析构, 记账随之退还; 作用域外新建的对象不记账
+    EXPECT_EQ(heap->Objects, 0);
+    EXPECT_EQ(heap->Allocated, 0);
+    EXPECT_GT(heap->Peak, 0);
+    EXPECT_EQ(objects::currentHeap, nullptr);
+
+    heap->Limit = 1;
+    objects::HeapScope scope(heap);
+    auto num = std::make_shared<objects::Integer>(2);
+    EXPECT_TRUE(heap->Exceeded());
+}
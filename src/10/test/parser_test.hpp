@@ -617,6 +617,18 @@ TEST(TestOperatorPrecedenceParsing, BasicAssertions)
 		{
 			"add(a * b[2], b[1], 2 * [1,2][1])",
 			"add((a * (b[2])), (b[1]), (2 * ([1, 2][1])))"
+		},
+		{
+			"a || b && c == d",
+			"(a || (b && (c == d)))"
+		},
+		{
+			"a < b && !c || d",
+			"(((a < b) && (!c)) || d)"
+		},
+		{
+			"a[1:b + 1][:2] + a[i:]",
+			"(((a[1:(b + 1)])[:2]) + (a[i:]))"
 		}
 	};
 
@@ -745,6 +757,80 @@ TEST(TestIfElseExpression, BasicAssertions)
 	testIdentifier(exprStmtAlt->pExpression, "y"s);
 }
 
+TEST(TestWhileStatement, BasicAssertions)
+{
+	std::string input = "while (x < y) { x = x + 1; }";
+
+	std::unique_ptr<lexer::Lexer> pLexer = lexer::New(input);
+	std::unique_ptr<parser::Parser> pParser = parser::New(std::move(pLexer));
+	std::unique_ptr<ast::Program> pProgram{pParser->ParseProgram()};
+	printParserErrors(pParser->Errors());
+
+	ASSERT_EQ(pProgram->v_pStatements.size(), 1u);
+
+	std::shared_ptr<ast::WhileStatement> whileStmt = std::dynamic_pointer_cast<ast::WhileStatement>(pProgram->v_pStatements[0]);
+	ASSERT_NE(whileStmt, nullptr);
+
+	testInfixExpression(whileStmt->pCondition, "x"s, "<", "y"s);
+
+	ASSERT_EQ(whileStmt->pBody->v_pStatements.size(), 1u);
+
+	std::shared_ptr<ast::AssignStatement> assignStmt = std::dynamic_pointer_cast<ast::AssignStatement>(whileStmt->pBody->v_pStatements[0]);
+	ASSERT_NE(assignStmt, nullptr);
+	EXPECT_EQ(assignStmt->pName->Value, "x");
+	testInfixExpression(assignStmt->pValue, "x"s, "+", 1);
+}
+
+TEST(TestForStatement, BasicAssertions)
+{
+	std::string input = "for (i in 0..n + 1) { i }";
+
+	std::unique_ptr<lexer::Lexer> pLexer = lexer::New(input);
+	std::unique_ptr<parser::Parser> pParser = parser::New(std::move(pLexer));
+	std::unique_ptr<ast::Program> pProgram{pParser->ParseProgram()};
+	printParserErrors(pParser->Errors());
+
+	ASSERT_EQ(pProgram->v_pStatements.size(), 1u);
+
+	std::shared_ptr<ast::ForStatement> forStmt = std::dynamic_pointer_cast<ast::ForStatement>(pProgram->v_pStatements[0]);
+	ASSERT_NE(forStmt, nullptr);
+
+	EXPECT_EQ(forStmt->pVariable->Value, "i");
+	testIntegerLiteral(forStmt->pStart, 0);
+	testInfixExpression(forStmt->pEnd, "n"s, "+", 1);
+	EXPECT_EQ(forStmt->pBody->v_pStatements.size(), 1u);
+}
+
+TEST(TestMatchExpression, BasicAssertions)
+{
+	std::string input = "match (x + 1) { 1 => a, -2 => b * 2, \"s\" => c, _ => 0, }";
+
+	std::unique_ptr<lexer::Lexer> pLexer = lexer::New(input);
+	std::unique_ptr<parser::Parser> pParser = parser::New(std::move(pLexer));
+	std::unique_ptr<ast::Program> pProgram{pParser->ParseProgram()};
+	printParserErrors(pParser->Errors());
+
+	ASSERT_EQ(pProgram->v_pStatements.size(), 1u);
+	EXPECT_EQ(pProgram->String(), "match((x + 1)) {1 => a, -2 => (b * 2), s => c, _ => 0}");
+
+	for (auto bad : {"match (x) { y => 1 }", "match (x) { _ => 1, 2 => 3 }", "match (x) { 1 => 2, \"a\" => 3, 1 => 4 }"})
+	{
+		std::unique_ptr<parser::Parser> pBad = parser::New(lexer::New(bad));
+		pBad->ParseProgram();
+		EXPECT_FALSE(pBad->Errors().empty()) << bad;
+	}
+
+	// 同值的整数和字符串模式不算重复
+	std::unique_ptr<parser::Parser> pMixed = parser::New(lexer::New("match (x) { 1 => 2, \"1\" => 3 }"));
+	pMixed->ParseProgram();
+	EXPECT_TRUE(pMixed->Errors().empty());
+
+	std::unique_ptr<parser::Parser> pDuplicate = parser::New(lexer::New("match (x) { 1 => 2, 1 => 3 }"));
+	pDuplicate->ParseProgram();
+	ASSERT_FALSE(pDuplicate->Errors().empty());
+	EXPECT_EQ(pDuplicate->Errors()[0], "duplicate match pattern 1");
+}
+
 TEST(TestFunctionLiteralParsing, BasicAssertions)
 {
 	std::string input = "fn(x, y) { x + y; }";
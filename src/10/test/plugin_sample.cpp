@@ -0,0 +1,79 @@
+#include <cstring>
+#include <cctype>
+
+#include "embed/plugin.hpp"
+
+// 测试用插件: 只使用 embed/plugin.hpp 中的C接口
+
+// sum_squares(ints)
+static void sumSquares(const monkey_value *args, size_t count, monkey_result *result, const monkey_result_api *api)
+{
+    if (count != 1 || args[0].type != MONKEY_INTS)
+    {
+        api->set_error(result, "sum_squares expects an integer array");
+        return;
+    }
+    auto values = static_cast<const int64_t *>(args[0].data);
+    int64_t total = 0;
+    for (size_t i = 0; i < args[0].size; i++)
+    {
+        total += values[i] * values[i];
+    }
+    api->set_int(result, total);
+}
+
+// scale(ints, k)
+static void scale(const monkey_value *args, size_t count, monkey_result *result, const monkey_result_api *api)
+{
+    if (count != 2 || args[0].type != MONKEY_INTS || args[1].type != MONKEY_INT)
+    {
+        api->set_error(result, "scale expects an integer array and an integer");
+        return;
+    }
+    auto values = static_cast<const int64_t *>(args[0].data);
+    auto out = api->set_ints(result, args[0].size);
+    for (size_t i = 0; i < args[0].size; i++)
+    {
+        out[i] = values[i] * args[1].integer;
+    }
+}
+
+// shout(str)
+static void shout(const monkey_value *args, size_t count, monkey_result *result, const monkey_result_api *api)
+{
+    if (count != 1 || args[0].type != MONKEY_STRING)
+    {
+        api->set_error(result, "shout expects a string");
+        return;
+    }
+    auto in = static_cast<const char *>(args[0].data);
+    auto out = api->set_string(result, args[0].size + 1);
+    for (size_t i = 0; i < args[0].size; i++)
+    {
+        out[i] = toupper(static_cast<unsigned char>(in[i]));
+    }
+    out[args[0].size] = '!';
+}
+
+// is_even(n)
+static void isEven(const monkey_value *args, size_t count, monkey_result *result, const monkey_result_api *api)
+{
+    if (count == 1 && args[0].type == MONKEY_INT)
+    {
+        api->set_bool(result, args[0].integer % 2 == 0);
+    }
+}
+
+static const monkey_native_def natives[] = {
+    {"sum_squares", &sumSquares, 1},
+    {"scale", &scale, 1},
+    {"shout", &shout, 1},
+    {"is_even", &isEven, 1},
+};
+
+static const monkey_plugin plugin = {MONKEY_PLUGIN_ABI_VERSION, natives, sizeof(natives) / sizeof(natives[0])};
+
+extern "C" const monkey_plugin *monkey_plugin_init(void)
+{
+    return &plugin;
+}
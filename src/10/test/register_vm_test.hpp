@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <variant>
+
+#include "lexer/lexer.hpp"
+#include "ast/ast.hpp"
+#include "objects/objects.hpp"
+#include "parser/parser.hpp"
+#include "code/register_code.hpp"
+#include "compiler/register_compiler.hpp"
+#include "vm/register_vm.hpp"
+
+extern std::unique_ptr<ast::Node> TestHelper(const std::string& input);
+extern void testExpectedObject(std::variant<int, bool, std::string, std::shared_ptr<objects::Object>, void*> expected, std::shared_ptr<objects::Object> actual);
+
+void runRegisterVmTests(std::vector<vmTestCases>& tests)
+{
+    for(auto &test: tests)
+    {
+        std::unique_ptr<ast::Node> astNode = TestHelper(test.input);
+        std::shared_ptr<compiler::RegisterCompiler> compiler = compiler::NewRegisterCompiler();
+
+        auto resultObj = compiler->Compile(std::move(astNode));
+        EXPECT_EQ(resultObj, nullptr);
+
+        auto vm = vm::NewRegisterVM(compiler->Bytecode());
+        auto vmresult = vm->Run();
+        EXPECT_EQ(vmresult, nullptr);
+
+        testExpectedObject(test.expected, vm->LastResult());
+    }
+}
+
+TEST(testRegisterCompilerThreeAddress, basicTest)
+{
+    std::unique_ptr<ast::Node> astNode = TestHelper("let add = fn(a, b){ let c = a + b; c * 2 }; add(1, 2);");
+    auto compiler = compiler::NewRegisterCompiler();
+    EXPECT_EQ(compiler->Compile(std::move(astNode)), nullptr);
+
+    auto bytecodeObj = compiler->Bytecode();
+    auto fn = std::dynamic_pointer_cast<objects::CompiledFunction>(bytecodeObj->Constants[1]);
+    ASSERT_NE(fn, nullptr);
+
+    // 参数与局部变量直接作为寄存器操作数, 不再需要OpGetLocal/OpSetLocal
+    std::vector<bytecode::Instructions> expected{
+        bytecode::MakeRegister(bytecode::RegisterOpcodeType::OpAdd, {2, 0, 1}),
+        bytecode::MakeRegister(bytecode::RegisterOpcodeType::OpLoadConstant, {3, 0}),
+        bytecode::MakeRegister(bytecode::RegisterOpcodeType::OpMul, {4, 2, 3}),
+        bytecode::MakeRegister(bytecode::RegisterOpcodeType::OpReturnValue, {4}),
+    };
+    testInstructions(expected, fn->Instructions);
+    EXPECT_EQ(fn->NumLocals, 5);
+    EXPECT_EQ(fn->NumParameters, 2);
+
+    EXPECT_STREQ(bytecode::RegisterInstructionsString(fn->Instructions).c_str(),
+                 "0000 OpAdd 2 0 1\n0004 OpLoadConstant 3 0\n0008 OpMul 4 2 3\n0012 OpReturnValue 4\n");
+}
+
+TEST(testRegisterVMExpressions, basicTest)
+{
+    std::vector<vmTestCases> tests{
+        {"1", 1},
+        {"50 / 2 * 2 + 10 - 5", 55},
+        {"(5 + 10 * 2 + 15 / 3) * 2 + -10", 50},
+        {"1 < 2", true},
+        {"(1 > 2) == false", true},
+        {"!!5", true},
+        {"true != false", true},
+        {"if(1 > 2){ 10 } else { 20 }", 20},
+        {"if( false ){ 10 }", nullptr},
+        {"if((if (false) { 10 })){ 10 } else { 20 }", 20},
+        {"let one = 1; let two = one + one; one + two", 3},
+        {"\"mon\" + \"key\" + \"banana\"", "monkeybanana"},
+        {"[1 + 2, 3 * 4, 5 + 6]", "[3, 12, 11]"},
+        {"{1: 2 + 3, 4: 5 * 6}", "{1: 5, 4: 30}"},
+        {"[1, 2, 3][1]", 2},
+        {"{1: 1, 2: 2}[2]", 2},
+        {"[][0]", nullptr},
+        };
+
+    runRegisterVmTests(tests);
+}
+
+TEST(testRegisterVMFunctions, basicTest)
+{
+    std::vector<vmTestCases> tests{
+        {"let fivePlusTen = fn(){ 5 + 10; }; fivePlusTen();", 15},
+        {"let earlyExit = fn(){ return 99; 100; }; earlyExit();", 99},
+        {"let noReturn = fn(){ }; noReturn();", nullptr},
+        {"let sum = fn(a, b){ let c = a + b; c; }; let outer = fn(){ sum(1, 2) + sum(3, 4); }; outer();", 10},
+        {"let globalNum = 10; let sum = fn(a, b){ let c = a + b; c + globalNum; }; sum(1, 2) + globalNum;", 23},
+        {"len(\"hello world\")", 11},
+        {"push([], 1)", "[1]"},
+        {"rest([1, 2, 3])", "[2, 3]"},
+        {"let newAdder = fn(a, b){ let c = a + b; fn(d){ c + d; } }; let adder = newAdder(1, 2); adder(8);", 11},
+        {"let a = 1; let f = fn(b){ fn(c){ fn(d){ a + b + c + d; } } }; f(2)(3)(8);", 14},
+        {"let wrapper = fn(){ let countDown = fn(x){ if(x == 0){ return 0; } else { countDown(x - 1); } }; countDown(1); }; wrapper();", 0},
+        {
+            R""(
+                let fibonacci = fn(x){
+                    if(x == 0){
+                        return 0;
+                    } else {
+                        if(x == 1){
+                            return 1;
+                        } else {
+                            return fibonacci(x - 1) + fibonacci(x - 2);
+                        }
+                    }
+                };
+
+                fibonacci(15);
+            )"",
+            610
+        },
+        };
+
+    runRegisterVmTests(tests);
+}
+
+TEST(testRegisterVMCallbacks, basicTest)
+{
+    // map/filter/reduce在寄存器虚拟机上回调用户函数
+    std::vector<vmTestCases> tests{
+        {"to_array(map(filter([1, 2, 3, 4, 5, 6], fn(x){ x > 2 }), fn(x){ x * 10 }))", "[30, 40, 50, 60]"},
+        {"let k = 3; reduce(map([1, 2, 3], fn(x){ x * k }), 0, fn(acc, x){ acc + x })", 18},
+        {"let f = fn(xs){ let n = 2; sum(map(xs, fn(x){ x + n })) + n }; f([1, 2]) + 1", 10},
+        {"to_array(map([[1], [2, 3]], len))", "[1, 2]"},
+        };
+
+    runRegisterVmTests(tests);
+
+    auto compiler = compiler::NewRegisterCompiler();
+    EXPECT_EQ(compiler->Compile(TestHelper("to_array(map([1], fn(a, b){ a }))")), nullptr);
+    auto vm = vm::NewRegisterVM(compiler->Bytecode());
+    auto result = vm->Run();
+    auto err = std::dynamic_pointer_cast<objects::Error>(objects::isError(result) ? result : vm->LastResult());
+    ASSERT_NE(err, nullptr);
+    EXPECT_EQ(err->Message, "wrong number of arguments: want=2, got=1");
+}
+
+TEST(testRegisterVMErrors, basicTest)
+{
+    std::vector<std::pair<std::string, std::string>> tests{
+        {"fn(){ 1; }(1);", "wrong number of arguments: want=0, got=1"},
+        {"fn(a){ a; }();", "wrong number of arguments: want=1, got=0"},
+        {"1 + true", "unsupported types for binary operaction: INTEGER BOOLEAN"},
+    };
+
+    for(auto &[input, message]: tests)
+    {
+        auto compiler = compiler::NewRegisterCompiler();
+        EXPECT_EQ(compiler->Compile(TestHelper(input)), nullptr);
+
+        auto vm = vm::NewRegisterVM(compiler->Bytecode());
+        auto result = vm->Run();
+        ASSERT_TRUE(objects::isError(result));
+        EXPECT_STREQ(std::dynamic_pointer_cast<objects::Error>(result)->Message.c_str(), message.c_str());
+    }
+}
@@ -5,12 +5,22 @@
 #include <vector>
 #include <memory>
 #include <variant>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "lexer/lexer.hpp"
 #include "ast/ast.hpp"
 #include "objects/objects.hpp"
 #include "parser/parser.hpp"
 #include "vm/vm.hpp"
+#include "vm/snapshot.hpp"
+#include "compiler/link.hpp"
+#include "repl/repl.hpp"
+#include "vm/batch.hpp"
+#include "objects/plugin.hpp"
 
 extern void printParserErrors(std::vector<std::string> errors);
 extern void testIntegerObject(std::shared_ptr<objects::Object> obj, int64_t expected);
@@ -44,6 +54,14 @@ void testExpectedObject(std::variant<int, bool, std::string, std::shared_ptr<obj
             EXPECT_NE(arrObj, nullptr);
             EXPECT_STREQ(arrObj->Inspect().c_str(), val.c_str());
         } 
+        else if(std::shared_ptr<objects::IntArray> intArrObj = std::dynamic_pointer_cast<objects::IntArray>(actual); intArrObj != nullptr)
+        {
+            EXPECT_STREQ(intArrObj->Inspect().c_str(), val.c_str());
+        }
+        else if(std::shared_ptr<objects::ArraySlice> sliceObj = std::dynamic_pointer_cast<objects::ArraySlice>(actual); sliceObj != nullptr)
+        {
+            EXPECT_STREQ(sliceObj->Inspect().c_str(), val.c_str());
+        }
         else if(std::shared_ptr<objects::Hash> hashObj = std::dynamic_pointer_cast<objects::Hash>(actual); hashObj != nullptr)
         {
             EXPECT_NE(hashObj, nullptr);
@@ -67,9 +85,10 @@ void testExpectedObject(std::variant<int, bool, std::string, std::shared_ptr<obj
         } 
         else if(std::shared_ptr<objects::Array> arrayObj = std::dynamic_pointer_cast<objects::Array>(obj); arrayObj != nullptr)
         {
-            std::shared_ptr<objects::Array> actualArray = std::dynamic_pointer_cast<objects::Array>(actual);
-            EXPECT_NE(actualArray, nullptr);
-            EXPECT_STREQ(actualArray->Inspect().c_str(), arrayObj->Inspect().c_str());
+            // 全是整数的数组以IntArray表示, 按内容比较
+            ASSERT_NE(actual, nullptr);
+            EXPECT_TRUE(actual->Type() == objects::ObjectType::ARRAY || actual->Type() == objects::ObjectType::INT_ARRAY || actual->Type() == objects::ObjectType::SLICE);
+            EXPECT_STREQ(actual->Inspect().c_str(), arrayObj->Inspect().c_str());
         }
         else {
             testNullObject(actual);
@@ -820,3 +839,998 @@ TEST(testVMRecursiveFebonacci, basicTest)
 
     runVmTests(tests);
 } 
+
+
+TEST(testVMSpeculativeOptimization, basicTest)
+{
+    auto runSpeculative = [](const std::string &input) {
+        auto compiler = compiler::New();
+        EXPECT_EQ(compiler->Compile(TestHelper(input)), nullptr);
+
+        auto bytecodeObj = compiler->Bytecode();
+        auto vm = vm::New(bytecodeObj);
+        vm->warmupThreshold = 5;
+        vm->optimizeThreshold = 10;
+        EXPECT_EQ(vm->Run(), nullptr);
+
+        return std::make_pair(bytecodeObj, vm);
+    };
+
+    auto findAdd = [](std::shared_ptr<compiler::ByteCode> bytecodeObj) {
+        // add 是第一个编译出的函数常量
+        for(auto &constant: bytecodeObj->Constants)
+        {
+            if(constant->Type() == objects::ObjectType::COMPILED_FUNCTION)
+            {
+                return std::dynamic_pointer_cast<objects::CompiledFunction>(constant);
+            }
+        }
+        return std::shared_ptr<objects::CompiledFunction>(nullptr);
+    };
+
+    std::string hotLoop = R""(
+        let add = fn(a, b){ a + b };
+        let loop = fn(n){ if(n == 0){ 0 } else { add(n, 1); loop(n - 1) } };
+        loop(20);
+        add(20, 22);
+    )"";
+
+    {
+        auto [bytecodeObj, vm] = runSpeculative(hotLoop);
+        testExpectedObject(42, vm->LastPoppedStackElem());
+
+        auto add = findAdd(bytecodeObj);
+        ASSERT_NE(add, nullptr);
+        EXPECT_TRUE(add->Optimized);
+        EXPECT_EQ(add->Instructions.size(), add->Baseline.size());
+        EXPECT_NE(bytecode::InstructionsString(add->Instructions).find("OpAddInt"), std::string::npos);
+        EXPECT_EQ(vm->deopts.size(), 0);
+    }
+
+    {
+        // 整数反馈下优化后再传入字符串: 守卫失败, 回退到基线代码得到正确结果
+        auto [bytecodeObj, vm] = runSpeculative(hotLoop + "add(\"mon\", \"key\");");
+        testExpectedObject("monkey", vm->LastPoppedStackElem());
+
+        auto add = findAdd(bytecodeObj);
+        ASSERT_NE(add, nullptr);
+        EXPECT_FALSE(add->Optimized);
+        EXPECT_EQ(add->DeoptCount, 1);
+        EXPECT_EQ(add->Feedback, nullptr);
+        EXPECT_EQ(bytecode::InstructionsString(add->Instructions).find("OpAddInt"), std::string::npos);
+
+        ASSERT_EQ(vm->deopts.size(), 1);
+        EXPECT_EQ(vm->deopts[0].Fn, add);
+        EXPECT_STREQ(vm->deopts[0].Reason.c_str(), "expected INTEGER operands, got STRING STRING");
+    }
+
+    {
+        // 调用点记录被调用函数
+        auto [bytecodeObj, vm] = runSpeculative(R""(
+            let add = fn(a, b){ a + b };
+            let loop = fn(n){ if(n == 0){ 0 } else { add(n, 1); loop(n - 1) } };
+            loop(7);
+        )"");
+
+        auto add = findAdd(bytecodeObj);
+        std::shared_ptr<objects::CompiledFunction> loop;
+        for(auto &constant: bytecodeObj->Constants)
+        {
+            if(constant->Type() == objects::ObjectType::COMPILED_FUNCTION && constant != add)
+            {
+                loop = std::dynamic_pointer_cast<objects::CompiledFunction>(constant);
+            }
+        }
+        ASSERT_NE(loop, nullptr);
+        ASSERT_NE(loop->Feedback, nullptr);
+
+        int targets = 0;
+        for(auto &slot: loop->Feedback->Slots)
+        {
+            if(slot.CallTarget.lock() == add)
+            {
+                targets += 1;
+                EXPECT_FALSE(slot.Megamorphic);
+            }
+        }
+        EXPECT_EQ(targets, 1);
+    }
+
+    {
+        // 自递归函数的调用点记录的是它自己, 程序和虚拟机释放后函数也随之释放
+        std::weak_ptr<objects::CompiledFunction> fib;
+        {
+            auto [bytecodeObj, vm] = runSpeculative(R""(
+                let fib = fn(n){ if(n < 2){ n } else { fib(n - 1) + fib(n - 2) } };
+                fib(15);
+            )"");
+            testExpectedObject(610, vm->LastPoppedStackElem());
+
+            auto fn = findAdd(bytecodeObj);
+            ASSERT_NE(fn, nullptr);
+            ASSERT_TRUE(fn->Optimized);
+            fib = fn;
+        }
+        EXPECT_TRUE(fib.expired());
+    }
+}
+
+
+TEST(testVMMemoization, basicTest)
+{
+    std::string fibonacci = R""(
+        let fibonacci = fn(x){
+            if(x < 2){ return x; }
+            fibonacci(x - 1) + fibonacci(x - 2);
+        };
+    )"";
+
+    // 不缓存时 fibonacci(40) 需要数亿次调用
+    std::vector<vmTestCases> tests{
+        {"let fib = memo(fn(x){ if(x < 2){ return x; } fib(x - 1) + fib(x - 2); }); fib(40);", 102334155},
+        {"let greet = memo(fn(name){ \"hi \" + name }); greet(\"a\"); greet(\"b\"); greet(\"a\");", "hi a"},
+        {"let f = memo(fn(arr){ len(arr) }, 1); f([1, 2]) + f([1, 2, 3]);", 5},
+        {"let f = memo(fn(){ }); f(); f();", nullptr},
+    };
+    runVmTests(tests);
+
+    // 编译器判定的纯函数自动缓存
+    auto compiler = compiler::New();
+    EXPECT_EQ(compiler->Compile(TestHelper(fibonacci + "fibonacci(40);")), nullptr);
+
+    auto vm = vm::New(compiler->Bytecode());
+    vm->memoizePure = true;
+    EXPECT_EQ(vm->Run(), nullptr);
+    testExpectedObject(102334155, vm->LastPoppedStackElem());
+
+    auto closure = std::dynamic_pointer_cast<objects::Closure>(vm->globals[0]);
+    ASSERT_NE(closure, nullptr);
+    ASSERT_NE(closure->Memo, nullptr);
+    EXPECT_EQ(closure->Memo->Size(), 41);
+    EXPECT_EQ(closure->Memo->Hits, 38);
+}
+
+
+TEST(testVMBuiltinFolding, basicTest)
+{
+    // 编译期折叠后的结果与运行时调用一致
+    std::vector<vmTestCases> tests{
+        {"len(\"abc\")", 3},
+        {"first([1, 2, 3]) + last([1, 2, 3])", 4},
+        {"rest([1, 2, 3])", "[2, 3]"},
+        {"push([1, 2, 3], 4)", "[1, 2, 3, 4]"},
+        {"push(rest([-1, 2]), \"x\")", "[2, \"x\"]"},
+        {"len(rest(push([], 1)))", 0},
+        {"first([])", nullptr},
+        {"let f = fn(){ len([1, 2]) }; f() + f()", 4},
+    };
+
+    runVmTests(tests);
+}
+
+TEST(testVMSnapshot, basicTest)
+{
+    std::string init = R""(
+        let table = [1, 2, 3];
+        let alias = table;
+        let config = {"name": "monkey", "table": table};
+        let makeAdder = fn(x){ fn(y){ x + y } };
+        let addTen = makeAdder(10);
+        let square = fn(x){ x * x };
+        let fib = memo(fn(x){ if(x < 2){ return x; } fib(x - 1) + fib(x - 2); });
+        square(3);
+    )"";
+
+    auto compiler = compiler::New();
+    ASSERT_EQ(compiler->Compile(TestHelper(init)), nullptr);
+    auto machine = vm::New(compiler->Bytecode());
+    ASSERT_EQ(machine->Run(), nullptr);
+
+    std::string path = "/tmp/monkey_snapshot_test_" + std::to_string(getpid());
+    std::string error;
+    ASSERT_TRUE(vm::SaveSnapshot(vm::NewSnapshot(compiler, machine), path, error)) << error;
+
+    auto snapshot = vm::LoadSnapshot(path, error);
+    unlink(path.c_str());
+    ASSERT_NE(snapshot, nullptr) << error;
+
+    // 恢复后接着初始化脚本继续运行, 新的全局变量排在快照之后
+    std::vector<vmTestCases> tests{
+        {"addTen(32)", 42},
+        {"len(table) + len(config[\"table\"])", 6},
+        {"config[\"name\"]", "monkey"},
+        {"fib(40)", 102334155},
+        {"let more = push(table, square(4)); more", "[1, 2, 3, 16]"},
+    };
+
+    for (auto &tt : tests)
+    {
+        auto comp = snapshot->NewCompiler();
+        ASSERT_EQ(comp->Compile(TestHelper(tt.input)), nullptr);
+
+        auto restored = snapshot->NewVM(comp->Bytecode());
+        ASSERT_EQ(restored->Run(), nullptr);
+        testExpectedObject(tt.expected, restored->LastPoppedStackElem());
+    }
+
+    // 共享的对象恢复后仍然是同一个对象; 纯函数标记也保留
+    auto comp = snapshot->NewCompiler();
+    EXPECT_EQ(snapshot->Globals[0], snapshot->Globals[1]);
+    EXPECT_EQ(comp->pureGlobals.count(comp->symbolTable->Resolve("square")->Index), 1);
+
+    EXPECT_EQ(vm::LoadSnapshot("/tmp/monkey_snapshot_missing", error), nullptr);
+
+    // 被重新定义的全局变量的旧槽位仍被闭包引用, 恢复后新的全局变量不能占用它
+    auto shadowing = compiler::New();
+    ASSERT_EQ(shadowing->Compile(TestHelper("let a = 1; let f = fn(){ a }; let a = 2;")), nullptr);
+    auto shadowingVM = vm::New(shadowing->Bytecode());
+    ASSERT_EQ(shadowingVM->Run(), nullptr);
+    ASSERT_TRUE(vm::SaveSnapshot(vm::NewSnapshot(shadowing, shadowingVM), path, error)) << error;
+    auto shadowed = vm::LoadSnapshot(path, error);
+    unlink(path.c_str());
+    ASSERT_NE(shadowed, nullptr) << error;
+
+    auto shadowedComp = shadowed->NewCompiler();
+    ASSERT_EQ(shadowedComp->Compile(TestHelper("let b = 100; [a, f(), b]")), nullptr);
+    auto shadowedVM = shadowed->NewVM(shadowedComp->Bytecode());
+    ASSERT_EQ(shadowedVM->Run(), nullptr);
+    testExpectedObject("[2, 1, 100]", shadowedVM->LastPoppedStackElem());
+
+    // 恢复后给全局变量赋值, 读取它的函数不再是纯函数, 不能返回缓存的旧结果
+    auto reading = compiler::New();
+    ASSERT_EQ(reading->Compile(TestHelper("let k = 1; let f = fn(x){ x + k };")), nullptr);
+    auto readingVM = vm::New(reading->Bytecode());
+    ASSERT_EQ(readingVM->Run(), nullptr);
+    ASSERT_TRUE(vm::SaveSnapshot(vm::NewSnapshot(reading, readingVM), path, error)) << error;
+    auto read = vm::LoadSnapshot(path, error);
+    unlink(path.c_str());
+    ASSERT_NE(read, nullptr) << error;
+
+    auto readComp = read->NewCompiler();
+    ASSERT_EQ(readComp->Compile(TestHelper("let a = f(1); k = 100; let b = f(1); [a, b]")), nullptr);
+    auto readVM = read->NewVM(readComp->Bytecode());
+    readVM->memoizePure = true;
+    ASSERT_EQ(readVM->Run(), nullptr);
+    testExpectedObject("[2, 101]", readVM->LastPoppedStackElem());
+
+    std::vector<std::shared_ptr<objects::Object>> globals{std::make_shared<objects::HostBuffer>(objects::HostElement::Byte, nullptr, 0, nullptr)};
+    auto hostSnapshot = std::make_shared<vm::Snapshot>();
+    hostSnapshot->Globals = globals;
+    EXPECT_FALSE(vm::SaveSnapshot(hostSnapshot, path, error));
+    EXPECT_EQ(error, "can not serialize object of type HOST_BUFFER");
+
+    // 全局变量个数超出虚拟机的全局变量表, 或变量名的下标越界, 都是损坏的快照
+    auto small = compiler::New();
+    ASSERT_EQ(small->Compile(TestHelper("let a = 1;")), nullptr);
+    auto smallVM = vm::New(small->Bytecode());
+    ASSERT_EQ(smallVM->Run(), nullptr);
+    ASSERT_TRUE(vm::SaveSnapshot(vm::NewSnapshot(small, smallVM), path, error)) << error;
+
+    std::ifstream in(path, std::ios::binary);
+    std::string saved((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    size_t numGlobalsPos = vm::SnapshotMagic.size() + 2 * sizeof(uint32_t);
+    for (auto &fn : objects::Builtins)
+    {
+        numGlobalsPos += sizeof(uint32_t) + fn->Name.size();
+    }
+    size_t nameIndexPos = numGlobalsPos + 3 * sizeof(uint32_t) + 1;
+    int32_t numGlobals = 0, nameIndex = -1;
+    std::memcpy(&numGlobals, &saved[numGlobalsPos], sizeof(numGlobals));
+    std::memcpy(&nameIndex, &saved[nameIndexPos], sizeof(nameIndex));
+    ASSERT_EQ(numGlobals, 1);
+    ASSERT_EQ(nameIndex, 0);
+
+    for (auto [pos, value] : std::vector<std::pair<size_t, int32_t>>{{numGlobalsPos, vm::GlobalsSize + 1}, {numGlobalsPos, -1}, {nameIndexPos, 1}, {nameIndexPos, -1}})
+    {
+        std::string corrupted = saved;
+        std::memcpy(&corrupted[pos], &value, sizeof(value));
+        std::ofstream(path, std::ios::binary) << corrupted;
+
+        EXPECT_EQ(vm::LoadSnapshot(path, error), nullptr);
+        EXPECT_EQ(error, path + ": corrupted snapshot");
+    }
+    unlink(path.c_str());
+}
+
+TEST(testVMMemoryLimit, basicTest)
+{
+    // 每层递归都保留一个更长的数组, 没有上限时会一直增长
+    std::string input = "let grow = fn(arr){ grow(push(arr, len(arr))) }; grow([]);";
+
+    auto compiler = compiler::New();
+    ASSERT_EQ(compiler->Compile(TestHelper(input)), nullptr);
+
+    auto machine = vm::New(compiler->Bytecode());
+    machine->heap = objects::NewHeap(100 * 1024);
+
+    auto result = machine->Run();
+    ASSERT_TRUE(objects::isError(result));
+    EXPECT_EQ(std::dynamic_pointer_cast<objects::Error>(result)->Message.find("memory limit exceeded: "), 0);
+    EXPECT_GT(machine->heap->Peak, 100 * 1024);
+    EXPECT_LT(machine->heap->Peak, 200 * 1024);
+
+    // 一次申请超过上限的数组在分配之前就报错
+    auto rangeCompiler = compiler::New();
+    ASSERT_EQ(rangeCompiler->Compile(TestHelper("range(1000000)")), nullptr);
+    auto rangeMachine = vm::New(rangeCompiler->Bytecode());
+    rangeMachine->heap = objects::NewHeap(100 * 1024);
+    ASSERT_EQ(rangeMachine->Run(), nullptr);
+    testExpectedObject(objects::newError("memory limit exceeded: `range` needs 8000000 bytes, limit is 102400"), rangeMachine->LastPoppedStackElem());
+
+    // 释放虚拟机持有的对象后记账归零
+    auto heap = machine->heap;
+    machine.reset();
+    EXPECT_EQ(heap->Allocated, 0);
+}
+
+void writeModuleFile(const std::string &path, const std::string &source)
+{
+    std::ofstream out(path);
+    out << source;
+}
+
+std::shared_ptr<vm::VM> runImportTest(std::shared_ptr<compiler::ModuleCache> cache, const std::string &input, std::variant<int, bool, std::string, std::shared_ptr<objects::Object>, void*> expected)
+{
+    auto comp = compiler::New();
+    comp->modules = cache;
+    auto err = comp->Compile(TestHelper(input));
+    EXPECT_EQ(err, nullptr) << err->Message;
+
+    auto machine = vm::New(comp->Bytecode());
+    auto result = machine->Run();
+    EXPECT_EQ(result, nullptr) << result->Inspect();
+    testExpectedObject(expected, machine->LastPoppedStackElem());
+    return machine;
+}
+
+TEST(testVMImport, basicTest)
+{
+    std::string dir = "/tmp/monkey_import_test_" + std::to_string(getpid());
+    mkdir(dir.c_str(), 0755);
+    writeModuleFile(dir + "/util.monkey", "let double = fn(x){ x * 2 };");
+    writeModuleFile(dir + "/lib.monkey", "import(\"util.monkey\"); let square = fn(x){ x * x }; let table = [double(1), double(2)];");
+
+    auto cache = compiler::NewModuleCache();
+    std::string lib = "import(\"" + dir + "/lib.monkey\");";
+
+    // 导出的全局变量(包括模块自己导入的)直接可用, import()的值是导出表
+    runImportTest(cache, lib + "square(3) + double(table[1])", 17);
+    runImportTest(cache, "let m = " + lib + " m[\"square\"](5)", 25);
+    EXPECT_EQ(cache->Compiled, 2);
+
+    // 同一个程序中重复导入的模块(包括间接导入的)只链接和执行一次
+    auto machine = runImportTest(cache, "import(\"" + dir + "/util.monkey\");" + lib + lib + "len(table)", 2);
+    EXPECT_EQ(machine->modules->size(), 2);
+    EXPECT_EQ(cache->Compiled, 2);
+
+    // 纯函数的标记随导出传递
+    auto comp = compiler::New();
+    comp->modules = cache;
+    ASSERT_EQ(comp->Compile(TestHelper(lib)), nullptr);
+    EXPECT_EQ(comp->pureGlobals.count(comp->symbolTable->Resolve("square")->Index), 1);
+
+    // 源文件修改后重新编译
+    writeModuleFile(dir + "/lib.monkey", "import(\"util.monkey\"); let square = fn(x){ x * x * 1 }; let table = [];");
+    struct timespec times[2] = {{0, UTIME_NOW}, {1, 0}};
+    utimensat(AT_FDCWD, (dir + "/lib.monkey").c_str(), times, 0);
+    runImportTest(cache, lib + "len(table)", 0);
+    EXPECT_EQ(cache->Compiled, 3);
+
+    // 磁盘上的字节码可以被新的缓存直接加载
+    auto writer = compiler::NewModuleCache();
+    writer->WriteBytecode = true;
+    runImportTest(writer, lib + "square(4)", 16);
+
+    auto reader = compiler::NewModuleCache();
+    runImportTest(reader, lib + "double(square(4))", 32);
+    EXPECT_EQ(reader->Compiled, 0);
+    EXPECT_EQ(reader->LoadedBytecode, 1); // util已经链接在lib的字节码中
+
+    // 被导入的模块修改后, 导入它的模块也要重新编译
+    writeModuleFile(dir + "/util.monkey", "let double = fn(x){ x * 3 };");
+    struct timespec later[2] = {{0, UTIME_NOW}, {2, 0}};
+    utimensat(AT_FDCWD, (dir + "/util.monkey").c_str(), later, 0);
+    runImportTest(reader, lib + "double(square(4))", 48);
+    EXPECT_EQ(reader->Compiled, 2);
+
+    writeModuleFile(dir + "/a.monkey", "import(\"b.monkey\");");
+    writeModuleFile(dir + "/b.monkey", "import(\"a.monkey\");");
+
+    std::vector<std::pair<std::string, std::string>> errors{
+        {"let f = fn(){ import(\"lib.monkey\") };", "import is only allowed at the top level"},
+        {"let p = \"lib.monkey\"; import(p);", "import path must be a string literal"},
+        {"import(\"" + dir + "/missing.monkey\");", "import " + dir + "/missing.monkey: can not find module " + dir + "/missing.monkey"},
+    };
+    for (auto &[input, expected] : errors)
+    {
+        auto c = compiler::New();
+        c->modules = cache;
+        auto err = c->Compile(TestHelper(input));
+        ASSERT_NE(err, nullptr) << input;
+        EXPECT_EQ(err->Message, expected);
+    }
+
+    auto c = compiler::New();
+    c->modules = cache;
+    auto err = c->Compile(TestHelper("import(\"" + dir + "/a.monkey\");"));
+    ASSERT_NE(err, nullptr);
+    EXPECT_NE(err->Message.find("import cycle at " + dir + "/a.monkey"), std::string::npos);
+
+    for (auto name : {"util.monkey", "lib.monkey", "a.monkey", "b.monkey", "util.monkey.mbc", "lib.monkey.mbc"})
+    {
+        unlink((dir + "/" + name).c_str());
+    }
+    rmdir(dir.c_str());
+}
+
+std::shared_ptr<objects::Object> runLinkTest(std::shared_ptr<compiler::ModuleCache> cache, const std::string &input, compiler::LinkedProgram &linked)
+{
+    auto comp = compiler::New();
+    comp->modules = cache;
+    auto err = comp->Compile(TestHelper(input));
+    EXPECT_EQ(err, nullptr) << err->Message;
+
+    err = compiler::Link(comp, linked);
+    EXPECT_EQ(err, nullptr) << err->Message;
+
+    auto machine = vm::New(linked.Bytecode);
+    auto result = machine->Run();
+    EXPECT_EQ(result, nullptr) << result->Inspect();
+    return machine->LastPoppedStackElem();
+}
+
+TEST(testVMLink, basicTest)
+{
+    std::string dir = "/tmp/monkey_link_test_" + std::to_string(getpid());
+    mkdir(dir.c_str(), 0755);
+    writeModuleFile(dir + "/base.monkey", "let clamp = fn(x){ if (x > 100) { 100 } else { x } }; let unusedBase = fn(){ \"unused\" };");
+    writeModuleFile(dir + "/rules.monkey", "import(\"base.monkey\"); let score = fn(x){ clamp(x * 10) }; "
+                                           "let bonus = fn(x){ score(x) + 1000 }; let table = [1, 2, 3]; let limit = 7;");
+
+    auto cache = compiler::NewModuleCache();
+    std::string rules = "import(\"" + dir + "/rules.monkey\");";
+
+    // 只保留顶层代码可达的函数, 全局变量和常量池重新紧凑编号
+    compiler::LinkedProgram linked;
+    testExpectedObject(-17, runLinkTest(cache, rules + "score(limit) - score(9) + len(table)", linked));
+    for (auto name : {"score", "clamp", "limit", "table"})
+    {
+        EXPECT_EQ(linked.Globals.count(name), 1) << name;
+    }
+    for (auto name : {"bonus", "unusedBase"})
+    {
+        EXPECT_EQ(linked.Globals.count(name), 0) << name;
+    }
+    EXPECT_EQ(linked.NumGlobals, 4);
+    EXPECT_EQ(linked.RemovedGlobals, 2);
+    EXPECT_GT(linked.RemovedConstants, 0);
+    for (auto &obj : linked.Bytecode->Constants)
+    {
+        EXPECT_NE(obj->Type(), objects::ObjectType::MODULE);
+    }
+
+    // 用到import的值时所有导出都保留
+    compiler::LinkedProgram all;
+    testExpectedObject(1070, runLinkTest(cache, "let r = " + rules + " r[\"bonus\"](7)", all));
+    EXPECT_EQ(all.Globals.count("unusedBase"), 1);
+
+    auto comp = compiler::New();
+    comp->modules = cache;
+    ASSERT_EQ(comp->Compile(TestHelper("if (true) { " + rules + " }")), nullptr);
+    auto err = compiler::Link(comp, linked);
+    ASSERT_NE(err, nullptr);
+    EXPECT_EQ(err->Message, "can not link an import inside a conditional or a loop");
+
+    for (auto name : {"base.monkey", "rules.monkey"})
+    {
+        unlink((dir + "/" + name).c_str());
+    }
+    rmdir(dir.c_str());
+}
+
+TEST(testREPLSession, basicTest)
+{
+    auto session = repl::NewSession();
+    auto eval = [&](const std::string &input) -> std::shared_ptr<objects::Object> {
+        auto err = session->Compile(TestHelper(input));
+        if (err != nullptr)
+        {
+            return err;
+        }
+        return session->Run();
+    };
+
+    testExpectedObject(1, eval("let a = 1;"));
+    eval("let f = fn(x){ x + a };");
+    testExpectedObject(3, eval("f(2)"));
+
+    // 编译失败(包括在函数体内失败)后会话仍然可用
+    auto err = eval("let g = fn(){ missing };");
+    ASSERT_TRUE(objects::isError(err));
+    EXPECT_EQ(session->comp->scopeIndex, 0);
+    testExpectedObject(2, eval("f(a)"));
+
+    auto runtimeErr = eval("f(\"x\")");
+    ASSERT_TRUE(objects::isError(runtimeErr));
+    testExpectedObject(2, eval("let a = 4; f(a) - 3")); // 重新定义的a是新的全局变量, f仍然引用原来的a
+
+    // 每一行只执行新编译的指令, 常量池只追加
+    EXPECT_EQ(session->machine->constants.size(), session->comp->constants.size());
+    testExpectedObject(2, eval("len([1, 2])"));
+    EXPECT_EQ(session->comp->scopes[0]->instructions.size(), bytecode::Make(bytecode::OpcodeType::OpConstant, {0}).size() + bytecode::Make(bytecode::OpcodeType::OpPop).size());
+}
+
+TEST(testVMBatch, basicTest)
+{
+    auto comp = compiler::New();
+    ASSERT_EQ(comp->Compile(TestHelper("let k = 1; let scale = fn(x){ x * 3 + k }; "
+                                       "let rule = fn(row){ if (row[\"amount\"] > 100) { row[\"amount\"] * 2 } else { 0 } }; "
+                                       "let size = fn(x){ len(x) };")), nullptr);
+    auto machine = vm::New(comp->Bytecode());
+    ASSERT_EQ(machine->Run(), nullptr);
+
+    auto global = [&](const std::string &name) {
+        return std::static_pointer_cast<objects::Closure>(machine->globals[comp->symbolTable->Resolve(name)->Index]);
+    };
+
+    // 整数列: 所有批次都按列执行
+    std::vector<std::shared_ptr<objects::Object>> ints;
+    for (int i = 0; i < 3000; i++)
+    {
+        ints.push_back(std::make_shared<objects::Integer>(i));
+    }
+    auto result = vm::RunBatch(machine, global("scale"), {ints});
+    EXPECT_EQ(result.BatchedRows, 3000);
+    EXPECT_EQ(result.FallbackRows, 0);
+    testExpectedObject(1, result.Values[0]);
+    testExpectedObject(8998, result.Values[2999]);
+
+    // 哈希数组: 第一批条件一致按列执行, 第二批出现分歧时逐行执行
+    std::vector<std::shared_ptr<objects::Object>> rows;
+    for (int i = 0; i < vm::BatchSize + 10; i++)
+    {
+        auto key = std::make_shared<objects::String>("amount");
+        auto amount = std::make_shared<objects::Integer>(i < vm::BatchSize ? 200 + i : 95 + i - vm::BatchSize);
+        std::map<objects::HashKey, std::shared_ptr<objects::HashPair>> pairs{{key->GetHashKey(), std::make_shared<objects::HashPair>(key, amount)}};
+        rows.push_back(std::make_shared<objects::Hash>(pairs));
+    }
+    result = vm::RunBatch(machine, global("rule"), {rows});
+    EXPECT_EQ(result.BatchedRows, vm::BatchSize);
+    EXPECT_EQ(result.FallbackRows, 10);
+    testExpectedObject(400, result.Values[0]);
+    testExpectedObject(0, result.Values[vm::BatchSize + 5]);
+    testExpectedObject(202, result.Values[vm::BatchSize + 6]);
+
+    // 有调用的函数逐行执行, 出错的行得到错误对象
+    std::vector<std::shared_ptr<objects::Object>> strs{std::make_shared<objects::String>("ab"), std::make_shared<objects::Integer>(1)};
+    result = vm::RunBatch(machine, global("size"), {strs});
+    EXPECT_EQ(result.FallbackRows, 2);
+    testExpectedObject(2, result.Values[0]);
+    ASSERT_TRUE(objects::isError(result.Values[1]));
+
+    result = vm::RunBatch(machine, global("scale"), {strs});
+    EXPECT_EQ(result.FallbackRows, 2);
+    ASSERT_TRUE(objects::isError(result.Values[0]));
+    testExpectedObject(4, result.Values[1]);
+}
+
+TEST(testVMIntArray, basicTest)
+{
+    std::vector<vmTestCases> tests{
+        {"range(5)", "[0, 1, 2, 3, 4]"},
+        {"range(10, 0, -3)", "[10, 7, 4, 1]"},
+        {"range(3, 3)", "[]"},
+        {"range(1, 2, 0)", objects::newError("`range` step can not be zero")},
+        {"range(9223372036854775807 - 2, 9223372036854775807, 2)", "[9223372036854775805]"},
+        {"range(100000000000)", objects::newError("`range` is too large: 100000000000 elements, at most 268435456")},
+        {"range(0 - 9000000000000000000, 9000000000000000000)", objects::newError("`range` is too large: 18000000000000000000 elements, at most 268435456")},
+        {"len(range(0 - 9000000000000000000, 9000000000000000000, 9000000000000000000))", 2},
+        {"sum(range(1001))", 500500},
+        {"min([4, -2, 9]) + max([4, -2, 9])", 7},
+        {"max([])", nullptr},
+        {"add(range(3), [10, 20, 30])", "[10, 21, 32]"},
+        {"mul(range(4), 3)", "[0, 3, 6, 9]"},
+        {"add([1, 2], [1])", objects::newError("arguments to `add` must have the same length, got 2 and 1")},
+        {"filter(range(10), \">=\", 7)", "[7, 8, 9]"},
+        {"filter([1, 2], \"~\", 1)", objects::newError("unknown comparison for `filter`: ~")},
+        {"dot(range(1, 4), [4, 5, 6])", 32},
+        {"let a = range(100); a[42] + len(a) + last(a)", 241},
+        {"range(3)[3]", nullptr},
+        {"push(push([], 1), 2)", "[1, 2]"},
+        {"push(range(2), true)", "[0, 1, true]"},
+        {"sum([1, \"a\"])", objects::newError("argument to `sum` must be an integer array, got ARRAY")},
+    };
+
+    runVmTests(tests);
+
+    // 全是整数的数组字面量打包成IntArray
+    auto comp = compiler::New();
+    ASSERT_EQ(comp->Compile(TestHelper("let n = 2; [1, n, 3]")), nullptr);
+    auto machine = vm::New(comp->Bytecode());
+    ASSERT_EQ(machine->Run(), nullptr);
+    EXPECT_EQ(machine->LastPoppedStackElem()->Type(), objects::ObjectType::INT_ARRAY);
+}
+
+TEST(testVMWhileLoops, basicTest)
+{
+    std::vector<vmTestCases> tests{
+        {"let i = 0; let s = 0; while (i < 10) { s = s + i; i = i + 1; }; s", 45},
+        {"let f = fn(n){ let i = 0; let acc = 1; while (i < n) { acc = acc * 2; i = i + 1 }; acc }; f(10)", 1024},
+        {"let f = fn(){ let i = 0; while (true) { if (i == 3) { return i; }; i = i + 1; } }; f()", 3},
+        {"let x = 1; if (true) { x = 5 }; x", 5},
+        {"let x = 1; if (false) { x = 5 }", nullptr},
+        {"let n = 0; let bump = fn(){ n = n + 1 }; bump(); bump(); n", 2},
+        {"let f = fn(){ while (false) { 1 } }; f()", nullptr},
+    };
+
+    runVmTests(tests);
+
+    // 赋值目标必须是当前函数的局部变量或全局变量
+    std::vector<std::pair<std::string, std::string>> errors{
+        {"y = 1;", "undefined variable y"},
+        {"let f = fn(){ let a = 1; fn(){ a = 2 } };", "can not assign to captured variable a"},
+        {"len = 1;", "can not assign to len"},
+    };
+    for(auto &[input, message]: errors)
+    {
+        auto comp = compiler::New();
+        auto err = comp->Compile(TestHelper(input));
+        ASSERT_NE(err, nullptr) << input;
+        EXPECT_EQ(err->Message, message);
+    }
+
+    // 只调用一次的函数靠循环回边计数进入优化代码
+    auto comp = compiler::New();
+    ASSERT_EQ(comp->Compile(TestHelper("let f = fn(n){ let i = 0; let s = 0; while (i < n) { s = s + i; i = i + 1 }; s }; f(5000)")), nullptr);
+    auto machine = vm::New(comp->Bytecode());
+    ASSERT_EQ(machine->Run(), nullptr);
+    testExpectedObject(12497500, machine->LastPoppedStackElem());
+
+    auto f = std::static_pointer_cast<objects::Closure>(machine->globals[comp->symbolTable->Resolve("f")->Index]);
+    EXPECT_TRUE(f->Fn->Optimized);
+    EXPECT_TRUE(machine->deopts.empty());
+}
+
+TEST(testVMForLoops, basicTest)
+{
+    std::vector<vmTestCases> tests{
+        {"let s = 0; for (i in 0..10) { s = s + i; }; s", 45},
+        {"let f = fn(n){ let s = 0; for (i in 1..n + 1) { s = s + i * i }; s }; f(10)", 385},
+        {"let f = fn(){ for (i in 0..100) { if (i * i > 50) { return i; } } }; f()", 8},
+        {"let s = 0; for (i in 0..3) { for (j in 0..i) { s = s + 1 } }; s", 3},
+        {"for (i in 5..5) { 1 }; i", nullptr},
+        {"let last = 0; for (i in -3..0) { last = i }; last", -1},
+        {"let a = []; for (i in 0..3) { a = push(a, fn(){ i }) }; a[0]() + a[2]()", 4},
+        {"let a = []; for (i in 0..4) { a = push(a, i) }; a", "[0, 1, 2, 3]"},
+        {"let a = []; for (i in 0..3) { a = push(a, i); i = 7 }; a", "[0, 1, 2]"},
+        {"let f = fn(){ let a = []; for (i in 0..3) { let j = i; a = push(a, j) }; a }; f()", "[0, 1, 2]"},
+        {"for (i in 0..3) { }; i", 2},
+    };
+
+    runVmTests(tests);
+
+    // 循环体没有保留循环变量时整个循环只分配一个Integer
+    for (auto input : {"for (i in 0..1000000) { }; i", "let f = fn(){ for (i in 0..1000000) { if (i > 1000000) { return 0; } }; 999999 }; f()"})
+    {
+        auto heapComp = compiler::New();
+        ASSERT_EQ(heapComp->Compile(TestHelper(input)), nullptr);
+        auto heapVM = vm::New(heapComp->Bytecode());
+        heapVM->heap = objects::NewHeap(0);
+        ASSERT_EQ(heapVM->Run(), nullptr);
+        testExpectedObject(999999, heapVM->LastPoppedStackElem());
+        EXPECT_LT(heapVM->heap->Allocations, 100) << input;
+    }
+
+    // 循环体读取循环变量求和时, 每轮只分配和的Integer
+    auto sumComp = compiler::New();
+    ASSERT_EQ(sumComp->Compile(TestHelper("let f = fn(){ let s = 0; for (i in 0..1000000) { s = s + i }; s }; f()")), nullptr);
+    auto sumVM = vm::New(sumComp->Bytecode());
+    sumVM->heap = objects::NewHeap(0);
+    ASSERT_EQ(sumVM->Run(), nullptr);
+    testIntegerObject(sumVM->LastPoppedStackElem(), 499999500000);
+    EXPECT_LT(sumVM->heap->Allocations, 1000000 + 100);
+
+    // 循环变量和计数器不在字节码里比较/相加: 每轮只有OpForIter, 存循环变量, 循环体和回边
+    auto comp = compiler::New();
+    ASSERT_EQ(comp->Compile(TestHelper("let f = fn(n){ let s = 0; for (i in 0..n) { s = s + i }; s }; f(3000)")), nullptr);
+    auto machine = vm::New(comp->Bytecode());
+    ASSERT_EQ(machine->Run(), nullptr);
+    testExpectedObject(4498500, machine->LastPoppedStackElem());
+    auto f = std::static_pointer_cast<objects::Closure>(machine->globals[comp->symbolTable->Resolve("f")->Index]);
+    EXPECT_TRUE(f->Fn->Optimized);
+
+    comp = compiler::New();
+    ASSERT_EQ(comp->Compile(TestHelper("for (i in 0..\"3\") { 1 }")), nullptr);
+    machine = vm::New(comp->Bytecode());
+    auto err = std::dynamic_pointer_cast<objects::Error>(machine->Run());
+    ASSERT_NE(err, nullptr);
+    EXPECT_EQ(err->Message, "for range bounds must be INTEGER, got INTEGER..STRING");
+}
+
+TEST(testVMLogicalOperators, basicTest)
+{
+    std::vector<vmTestCases> tests{
+        {"true && true", true},
+        {"true && false", false},
+        {"false || true", true},
+        {"false || false", false},
+        {"1 && \"a\"", true},
+        {"1 < 2 && 3 > 4 || 5 == 5", true},
+        {"if (1 > 2 || 2 > 1) { 10 } else { 20 }", 10},
+        {"let n = 0; let bump = fn(){ n = n + 1; true }; false && bump(); true || bump(); n", 0},
+        {"let n = 0; let bump = fn(){ n = n + 1; false }; true && bump(); false || bump(); n", 2},
+        {"let f = fn(a){ a != 0 && 10 / a > 2 }; !f(0) && f(2) && !f(4)", true},
+    };
+
+    runVmTests(tests);
+}
+
+TEST(testVMMatchExpressions, basicTest)
+{
+    std::string state = "let step = fn(s){ match (s) { 0 => 10, 1 => 11, 2 => 12, 4 => 14, _ => -1 } }; ";
+    std::string sparse = "let code = fn(s){ match (s) { -100 => \"low\", 7 => \"seven\", 100000 => \"high\" } }; ";
+    std::string named = "let op = fn(s){ match (s) { \"add\" => 1, \"sub\" => 2, \"mul\" => 3, _ => 0, } }; ";
+
+    std::vector<vmTestCases> tests{
+        {state + "step(0) + step(2) + step(4)", 36},
+        {state + "step(3)", -1},
+        {state + "step(5) + step(-1)", -2},
+        {state + "step(\"1\")", -1},
+        {sparse + "code(7)", "seven"},
+        {sparse + "code(-100)", "low"},
+        {sparse + "code(100000)", "high"},
+        {sparse + "code(8)", nullptr},
+        {named + "op(\"mul\") * 10 + op(\"add\")", 31},
+        {named + "op(\"div\") + op(2)", 0},
+        {"match (1 + 1) { 1 => \"a\", 2 => \"b\" }", "b"},
+        {"match (\"x\") { 1 => 10, \"x\" => 20 }", 20},
+        {"match (3) { _ => 42 }", 42},
+        {"let s = 0; for (i in 0..6) { s = s + match (i - i / 3 * 3) { 0 => 1, 1 => 10, _ => 100 } }; s", 222},
+        {"match (1) { -9223372036854775807 => 1, 9223372036854775807 => 2, _ => 3 }", 3},
+        {"match (9223372036854775807) { 9223372036854775806 => 1, 9223372036854775807 => 2 }", 2},
+        {"match (0 - 9223372036854775807) { 9223372036854775806 => 1, 9223372036854775807 => 2, _ => 3 }", 3},
+    };
+
+    runVmTests(tests);
+
+    // 链接时删掉未用的常量, 分派表的常量下标跟着重新编号
+    compiler::LinkedProgram linked;
+    testExpectedObject(21, runLinkTest(nullptr, "let unused = fn(){ [1, 2, 3] }; " + state + named + "step(1) + op(\"sub\") * 5", linked));
+    EXPECT_GT(linked.RemovedConstants, 0);
+}
+
+TEST(testVMLazySequences, basicTest)
+{
+    std::vector<vmTestCases> tests{
+        {"to_array(map(filter([1, 2, 3, 4, 5, 6], fn(x){ x > 2 }), fn(x){ x * 10 }))", "[30, 40, 50, 60]"},
+        {"sum(map(iter(0, 5), fn(x){ x * x }))", 30},
+        {"reduce(filter(iter(1, 11), fn(x){ x / 2 * 2 == x }), 1, fn(acc, x){ acc * x })", 3840},
+        {"to_array(zip([1, 2, 3], [\"a\", \"b\"]))[1][1]", "b"},
+        {"to_array(take(iter(5, 1000000000000), 3))", "[5, 6, 7]"},
+        {"let s = map([1, 2], fn(x){ x + 1 }); sum(s) + sum(s)", 10},
+        {"to_array(map([1, 2], len))", objects::newError("argument to `len` not supported, got INTEGER")},
+        {"map(1, fn(x){ x })", objects::newError("first argument to `map` must be ARRAY or SEQ, got INTEGER")},
+        {"sum(map([\"a\"], fn(x){ x }))", objects::newError("elements summed by `sum` must be INTEGER, got STRING")},
+        {"filter(range(10), \">=\", 8)", "[8, 9]"},
+    };
+
+    runVmTests(tests);
+
+    // 终结操作逐个拉取元素: take够数后上游的map不再执行
+    auto comp = compiler::New();
+    ASSERT_EQ(comp->Compile(TestHelper("let n = 0; let f = fn(x){ n = n + 1; x * 2 }; let s = take(map(iter(0, 1000000000), f), 4); [sum(s), n]")), nullptr);
+    auto machine = vm::New(comp->Bytecode());
+    ASSERT_EQ(machine->Run(), nullptr);
+    EXPECT_EQ(machine->LastPoppedStackElem()->Inspect(), "[12, 4]");
+}
+
+TEST(testVMSlices, basicTest)
+{
+    std::vector<vmTestCases> tests{
+        {"[1, 2, 3, 4][1:3]", "[2, 3]"},
+        {"[1, 2, 3, 4][:2]", "[1, 2]"},
+        {"[1, \"a\", 3][1:]", "[\"a\", 3]"},
+        {"[1, 2, 3][-5:10]", "[1, 2, 3]"},
+        {"len([1, 2, 3][2:1])", 0},
+        {"let xs = range(10)[2:8]; xs[1:3][0] + xs[0] + last(xs)", 12},
+        {"sum(range(10)[5:])", 35},
+        {"push([1, 2, 3][1:], 4)", "[2, 3, 4]"},
+        {"rest(rest([1, 2, 3, 4]))", "[3, 4]"},
+        {"let total = fn(xs){ if(len(xs) == 0){ return 0; } first(xs) + total(rest(xs)) }; total(range(100))", 4950},
+        {R""(
+            let merge = fn(a, b, acc){
+                if(len(a) == 0){ if(len(b) == 0){ return acc; } return merge(a, rest(b), push(acc, first(b))); }
+                if(len(b) == 0 || first(a) < first(b)){ return merge(rest(a), b, push(acc, first(a))); }
+                merge(a, rest(b), push(acc, first(b)));
+            };
+            let sort = fn(xs){ if(len(xs) < 2){ return xs; } let mid = len(xs) / 2; merge(sort(xs[:mid]), sort(xs[mid:]), []) };
+            sort([5, 3, 9, 1, 4, 8, 2])
+        )"", "[1, 2, 3, 4, 5, 8, 9]"},
+    };
+
+    runVmTests(tests);
+
+    std::vector<std::pair<std::string, std::string>> failures{
+        {"1[0:1]", "slice operator not supported: INTEGER"},
+        {"[1, 2][\"a\":]", "slice bounds must be INTEGER, got STRING"},
+    };
+    for(auto &[input, message]: failures)
+    {
+        auto comp = compiler::New();
+        ASSERT_EQ(comp->Compile(TestHelper(input)), nullptr);
+        auto machine = vm::New(comp->Bytecode());
+        auto err = machine->Run();
+        ASSERT_NE(err, nullptr);
+        EXPECT_EQ(std::dynamic_pointer_cast<objects::Error>(err)->Message, message);
+    }
+}
+
+TEST(testVMHashBuiltins, basicTest)
+{
+    std::vector<vmTestCases> tests{
+        {"keys({1: \"a\", 2: \"b\"})", "[1, 2]"},
+        {"values({\"a\": 1})", "[1]"},
+        {"len(keys({}))", 0},
+        {"has({\"a\": 1}, \"a\")", true},
+        {"has({\"a\": 1}, \"b\")", false},
+        {"let h = {\"a\": 1}; let g = set(h, \"b\", 2); [len(keys(h)), g[\"b\"], g[\"a\"]]", "[1, 2, 1]"},
+        {"set({\"a\": 1}, \"a\", 5)[\"a\"]", 5},
+        {"let h = {\"a\": 1, \"b\": 2}; let g = delete(h, \"a\"); [has(g, \"a\"), has(h, \"a\")]", "[false, true]"},
+        {"let m = merge({\"a\": 1, \"b\": 2}, {\"b\": 3, \"c\": 4}); [m[\"a\"], m[\"b\"], m[\"c\"]]", "[1, 3, 4]"},
+        {"reduce(keys({1: 10, 2: 20, 3: 30}), 0, fn(acc, k){ acc + k })", 6},
+        {"keys([\"a\"])", objects::newError("first argument to `keys` must be HASH, got ARRAY")},
+        {"has({}, [\"a\"])", objects::newError("unusable as hash key: ARRAY")},
+        {"merge({}, 1)", objects::newError("second argument to `merge` must be HASH, got INTEGER")},
+        {"set({}, 1)", objects::newError("wrong number of arguments. got=2, want=3")},
+    };
+
+    runVmTests(tests);
+}
+
+TEST(testVMReadCsv, basicTest)
+{
+    std::string path = "/tmp/monkey_csv_test_" + std::to_string(getpid()) + ".csv";
+    {
+        std::ofstream out(path);
+        out << "id,city,note\r\n1,paris,plain\r\n2,rome,\"a, \"\"quoted\"\" one\"\r\n\r\n3,paris,\n";
+    }
+
+    // 大文件按行边界分给多个线程, 结果与单线程一致
+    std::string big = "/tmp/monkey_csv_test_" + std::to_string(getpid()) + ".tsv";
+    {
+        std::ofstream out(big);
+        out << "n\tparity\n";
+        for(int i = 0; i < 300000; i++)
+        {
+            out << i << "\t" << (i - i / 2 * 2 == 0 ? "even" : "odd") << "\n";
+        }
+    }
+
+    std::vector<vmTestCases> tests{
+        {"read_csv(\"" + path + "\")[\"id\"]", "[1, 2, 3]"},
+        {"read_csv(\"" + path + "\")[\"city\"]", "[\"paris\", \"rome\", \"paris\"]"},
+        {"read_csv(\"" + path + "\")[\"note\"][1]", "a, \"quoted\" one"},
+        {"len(read_csv(\"" + path + "\")[\"note\"][2])", 0},
+        {"read_csv(\"" + path + "\", {\"header\": false})[0]", "[\"id\", \"1\", \"2\", \"3\"]"},
+        {"let t = read_csv(\"" + big + "\", {\"threads\": 4}); [len(t[\"n\"]), sum(t[\"n\"]), t[\"parity\"][299999]]", "[300000, 44999850000, \"odd\"]"},
+        {"read_csv(\"" + path + "\", {\"delimiter\": \";;\"})", objects::newError("`read_csv` option delimiter must be a single character, got \";;\"")},
+        {"read_csv(\"" + path + "\", {\"delimiter\": \";\"})[\"id,city,note\"][1]", "2,rome,\"a, \"\"quoted\"\" one\""},
+    };
+
+    runVmTests(tests);
+
+    // 同一列中相同的字符串共用一个对象
+    auto csv = objects::ReadCsv(path, objects::CsvOptions{});
+    auto city = objects::evalHashIndexExpression(csv, std::make_shared<objects::String>("city"));
+    auto cells = std::dynamic_pointer_cast<objects::Array>(city);
+    ASSERT_NE(cells, nullptr);
+    EXPECT_EQ(cells->Elements[0], cells->Elements[2]);
+
+    std::ofstream(path) << "a,b\n1,2\n3\n";
+    auto err = objects::ReadCsv(path, objects::CsvOptions{});
+    ASSERT_TRUE(objects::isError(err));
+    EXPECT_EQ(std::dynamic_pointer_cast<objects::Error>(err)->Message, path + ": row 2 has 1 fields, expected 2");
+
+    std::ofstream(path) << "a,a,b\nx,y,2\n";
+    err = objects::ReadCsv(path, objects::CsvOptions{});
+    ASSERT_TRUE(objects::isError(err));
+    EXPECT_EQ(std::dynamic_pointer_cast<objects::Error>(err)->Message, path + ": duplicate column \"a\"");
+
+    unlink(path.c_str());
+    unlink(big.c_str());
+}
+
+TEST(testVMFileIO, basicTest)
+{
+    std::string path = "/tmp/monkey_file_test_" + std::to_string(getpid()) + ".log";
+    std::string quoted = "\"" + path + "\"";
+    std::string write = "let f = open(" + quoted + ", \"w\"); let i = 0; while(i < 1000){ write(f, \"INFO line\\n\"); if(i / 100 * 100 == i){ write(f, \"ERROR x\\n\"); } i = i + 1; }; close(f); ";
+
+    std::vector<vmTestCases> tests{
+        {write + "len(to_array(lines(" + quoted + ")))", 1010},
+        {"len(to_array(filter(lines(" + quoted + "), fn(l){ len(l) == 7 })))", 10},
+        {"let f = open(" + quoted + "); let a = read_line(f); let b = read_line(f); [a, b]", "[\"INFO line\", \"ERROR x\"]"},
+        {"let f = open(" + quoted + "); read_line(f); len(read_all(f))", 10070},
+        {"let f = open(" + quoted + ", \"w\"); write(f, \"last\"); close(f); let g = open(" + quoted + "); [read_line(g), read_line(g)]", "[\"last\", null]"},
+        {"let f = open(" + quoted + ", \"a\"); write(f, \"\\r\\nmore\"); close(f); to_array(lines(" + quoted + "))", "[\"last\", \"more\"]"},
+        {"read_line(open(" + quoted + ", \"a\"))", objects::newError("file " + path + " is not open for reading")},
+        {"let f = open(" + quoted + "); close(f); read_all(f)", objects::newError("`read_all` on a closed file: " + path)},
+        {"open(" + quoted + ", \"x\")", objects::newError("unknown mode for `open`: x")},
+        {"open(\"/nonexistent/monkey\")", objects::newError("/nonexistent/monkey: No such file or directory")},
+        {"to_array(lines(\"/nonexistent/monkey\"))", objects::newError("/nonexistent/monkey: No such file or directory")},
+    };
+
+    runVmTests(tests);
+    unlink(path.c_str());
+}
+
+TEST(testVMStringBuiltins, basicTest)
+{
+    std::vector<vmTestCases> tests{
+        {"split(\"a,b,,c\", \",\")", "[\"a\", \"b\", \"\", \"c\"]"},
+        {"split(\"  GET /index.html\\t200 \")", "[\"GET\", \"/index.html\", \"200\"]"},
+        {"split(\"a::b\", \"::\")", "[\"a\", \"b\"]"},
+        {"join([\"a\", \"b\", \"c\"], \", \")", "a, b, c"},
+        {"join(map(iter(1, 4), fn(x){ format(\"%d\", x) }))", "123"},
+        {"substr(\"hello world\", 6)", "world"},
+        {"substr(\"hello\", 1, 3)", "ell"},
+        {"substr(\"hello\", 3, 100)", "lo"},
+        {"find(\"hello world\", \"o\")", 4},
+        {"find(\"hello world\", \"o\", 5)", 7},
+        {"find(\"hello\", \"xyz\")", -1},
+        {"replace(\"a-b-c\", \"-\", \"+\")", "a+b+c"},
+        {"replace(\"aaa\", \"aa\", \"b\")", "ba"},
+        {"upper(\"Hello, World\")", "HELLO, WORLD"},
+        {"lower(\"MiXeD\")", "mixed"},
+        {"format(\"%s=%05d|%-4s|%3d|%%|%s\", \"id\", -42, \"ab\", 7, [1])", "id=-0042|ab  |  7|%|[1]"},
+        {"len(split(join(map(iter(0, 1000), fn(x){ \"x\" }), \"\\n\"), \"\\n\"))", 1000},
+        {"format(\"%d\", \"a\")", objects::newError("%d expects INTEGER, got STRING")},
+        {"format(\"%d %d\", 1)", objects::newError("missing argument for %d")},
+        {"format(\"%d\", 1, 2)", objects::newError("too many arguments for format: 1 unused")},
+        {"format(\"%x\", 1)", objects::newError("unknown format verb %x")},
+        {"format(\"%99999999999999d\", 1)", objects::newError("format width too large")},
+        {"let w = \"%4097s\"; format(w, \"a\")", objects::newError("format width too large")},
+        {"len(format(\"%4096s\", \"a\"))", 4096},
+        {"split(\"a\", \"\")", objects::newError("separator for `split` must not be empty")},
+        {"find(1, \"a\")", objects::newError("first argument to `find` must be STRING, got INTEGER")},
+        {"join([\"a\", 1])", objects::newError("elements joined by `join` must be STRING, got INTEGER")},
+    };
+
+    runVmTests(tests);
+}
+
+TEST(testVMPlugins, basicTest)
+{
+    auto before = objects::Builtins.size();
+    std::string error;
+    ASSERT_TRUE(objects::LoadPlugin(MONKEY_TEST_PLUGIN, error)) << error;
+    EXPECT_EQ(objects::Builtins.size(), before + 4);
+    EXPECT_EQ(objects::Builtins[before]->Name, "sum_squares");
+    EXPECT_EQ(objects::Builtins[0]->Name, "len");
+
+    std::vector<vmTestCases> tests{
+        {"sum_squares([1, 2, 3])", 14},
+        {"sum_squares(rest([1, 2, 3]))", 13},
+        {"sum_squares([])", 0},
+        {"scale([1, 2, 3], 10)", "[10, 20, 30]"},
+        {"let n = 3; sum_squares(scale([1, 2], n))", 45},
+        {"shout(\"hi\")", "HI!"},
+        {"is_even(4)", true},
+        {"is_even(\"x\")", nullptr},
+        {"let f = fn(g){ g([2, 2]) }; f(sum_squares)", 8},
+        {"sum_squares(1)", objects::newError("sum_squares expects an integer array")},
+        {"sum_squares({})", objects::newError("argument 1 to `sum_squares` must be INTEGER, BOOLEAN, STRING or an integer array, got HASH")},
+    };
+
+    runVmTests(tests);
+
+    EXPECT_FALSE(objects::LoadPlugin(MONKEY_TEST_PLUGIN, error));
+    EXPECT_EQ(error, std::string(MONKEY_TEST_PLUGIN) + ": builtin sum_squares is already defined");
+    EXPECT_EQ(objects::Builtins.size(), before + 4);
+
+    error.clear();
+    EXPECT_FALSE(objects::LoadPlugin("/nonexistent/monkey_plugin.so", error));
+    EXPECT_FALSE(error.empty());
+}
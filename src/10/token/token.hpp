@@ -43,10 +43,15 @@ namespace token
         const TokenType EQ = "==";
         const TokenType NOT_EQ = "!=";
 
+        const TokenType AND = "&&";
+        const TokenType OR = "||";
+
         // Delimiters
         const TokenType COMMA = ",";
         const TokenType SEMICOLON = ";";
         const TokenType COLON = ":";
+        const TokenType DOTDOT = "..";
+        const TokenType ARROW = "=>";
 
         const TokenType LPAREN = "(";
         const TokenType RPAREN = ")";
@@ -64,25 +69,33 @@ namespace token
         const TokenType IF = "IF";
         const TokenType ELSE = "ELSE";
         const TokenType RETURN = "RETURN";
+        const TokenType WHILE = "WHILE";
+        const TokenType FOR = "FOR";
+        const TokenType IN = "IN";
+        const TokenType MATCH = "MATCH";
     }
 
 
 
-    std::ostream &operator<<(std::ostream &out, Token &tok)
+    inline std::ostream &operator<<(std::ostream &out, Token &tok)
     {
         out << "{Type:" << tok.Type << " Literal:" << tok.Literal << "}";
         return out;
     }
 
-    std::map<std::string, TokenType> keywords = {{"fn", token::types::FUNCTION},
+    inline std::map<std::string, TokenType> keywords = {{"fn", token::types::FUNCTION},
                                                  {"let", token::types::LET},
                                                  {"true", token::types::TRUE},
                                                  {"false", token::types::FALSE},
                                                  {"if", token::types::IF},
                                                  {"else", token::types::ELSE},
-                                                 {"return", token::types::RETURN}};
+                                                 {"return", token::types::RETURN},
+                                                 {"while", token::types::WHILE},
+                                                 {"for", token::types::FOR},
+                                                 {"in", token::types::IN},
+                                                 {"match", token::types::MATCH}};
 
-    TokenType LookupIdent(std::string ident)
+    inline TokenType LookupIdent(std::string ident)
     {
         auto fit = keywords.find(ident);
 
@@ -0,0 +1,482 @@
+#ifndef H_BATCH_H
+#define H_BATCH_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+#include "code/code.hpp"
+#include "objects/objects.hpp"
+#include "vm/vm.hpp"
+
+// 批量执行: 同一个函数作用在N行输入上时, 每条指令对整批数据只分派一次;
+// 控制流在各行之间出现分歧或遇到不支持的指令时, 这一批退回到逐行调用
+namespace vm
+{
+    const int BatchSize = 1024; // 每批的行数, 限制中间列占用的内存
+
+    // 一列值: 全是整数/布尔值时用定长数组保存, 否则保存对象
+    struct Column
+    {
+        enum class Kind
+        {
+            Int,
+            Bool,
+            Object,
+        };
+
+        Kind Type = Kind::Object;
+        std::vector<int64_t> Ints;
+        std::vector<uint8_t> Bools;
+        std::vector<std::shared_ptr<objects::Object>> Objects;
+
+        size_t Size() const
+        {
+            return (Type == Kind::Int ? Ints.size() : (Type == Kind::Bool ? Bools.size() : Objects.size()));
+        }
+
+        std::shared_ptr<objects::Object> At(const size_t &i) const
+        {
+            switch(Type)
+            {
+                case Kind::Int:
+                    return std::make_shared<objects::Integer>(Ints[i]);
+                case Kind::Bool:
+                    return objects::nativeBoolToBooleanObject(Bools[i] != 0);
+                default:
+                    return Objects[i];
+            }
+        }
+
+        static Column Broadcast(std::shared_ptr<objects::Object> obj, const size_t &n)
+        {
+            Column col;
+            if(obj != nullptr && obj->Type() == objects::ObjectType::INTEGER)
+            {
+                col.Type = Kind::Int;
+                col.Ints.assign(n, std::static_pointer_cast<objects::Integer>(obj)->Value);
+            }
+            else if(obj != nullptr && obj->Type() == objects::ObjectType::BOOLEAN)
+            {
+                col.Type = Kind::Bool;
+                col.Bools.assign(n, std::static_pointer_cast<objects::Boolean>(obj)->Value ? 1 : 0);
+            }
+            else
+            {
+                col.Objects.assign(n, obj);
+            }
+            return col;
+        }
+
+        // 对象列中的值类型一致时转成定长数组
+        static Column FromObjects(std::vector<std::shared_ptr<objects::Object>> objs)
+        {
+            Column col;
+            bool ints = !objs.empty(), bools = !objs.empty();
+            for(auto &obj : objs)
+            {
+                ints = ints && obj != nullptr && obj->Type() == objects::ObjectType::INTEGER;
+                bools = bools && obj != nullptr && obj->Type() == objects::ObjectType::BOOLEAN;
+            }
+
+            if(ints)
+            {
+                col.Type = Kind::Int;
+                for(auto &obj : objs)
+                {
+                    col.Ints.push_back(std::static_pointer_cast<objects::Integer>(obj)->Value);
+                }
+            }
+            else if(bools)
+            {
+                col.Type = Kind::Bool;
+                for(auto &obj : objs)
+                {
+                    col.Bools.push_back(std::static_pointer_cast<objects::Boolean>(obj)->Value ? 1 : 0);
+                }
+            }
+            else
+            {
+                col.Objects = std::move(objs);
+            }
+            return col;
+        }
+    };
+
+    struct BatchResult
+    {
+        std::vector<std::shared_ptr<objects::Object>> Values; // 每行的返回值, 逐行执行出错的行是Error对象
+        int BatchedRows = 0;
+        int FallbackRows = 0;
+    };
+
+    // 对一批行解释执行函数体; 返回false表示需要退回逐行执行
+    struct BatchFrame
+    {
+        std::shared_ptr<VM> machine;
+        std::shared_ptr<objects::Closure> cl;
+        size_t n = 0;
+
+        std::vector<Column> stack;
+        std::vector<Column> locals;
+
+        Column pop()
+        {
+            auto col = std::move(stack.back());
+            stack.pop_back();
+            return col;
+        }
+
+        bool binary(const bytecode::OpcodeType &op)
+        {
+            auto right = pop();
+            auto left = pop();
+            if(left.Type != Column::Kind::Int || right.Type != Column::Kind::Int)
+            {
+                return false;
+            }
+
+            Column col;
+            col.Type = Column::Kind::Int;
+            col.Ints.resize(n);
+            auto *a = left.Ints.data(), *b = right.Ints.data(), *c = col.Ints.data();
+            switch(op)
+            {
+                case bytecode::OpcodeType::OpAdd:
+                    for(size_t i = 0; i < n; i++) { c[i] = a[i] + b[i]; }
+                    break;
+                case bytecode::OpcodeType::OpSub:
+                    for(size_t i = 0; i < n; i++) { c[i] = a[i] - b[i]; }
+                    break;
+                case bytecode::OpcodeType::OpMul:
+                    for(size_t i = 0; i < n; i++) { c[i] = a[i] * b[i]; }
+                    break;
+                default:
+                    if(std::find(b, b + n, 0) != b + n)
+                    {
+                        return false;
+                    }
+                    for(size_t i = 0; i < n; i++) { c[i] = a[i] / b[i]; }
+                    break;
+            }
+            stack.push_back(std::move(col));
+            return true;
+        }
+
+        bool comparison(const bytecode::OpcodeType &op)
+        {
+            auto right = pop();
+            auto left = pop();
+
+            Column col;
+            col.Type = Column::Kind::Bool;
+            col.Bools.resize(n);
+            if(left.Type == Column::Kind::Int && right.Type == Column::Kind::Int)
+            {
+                auto *a = left.Ints.data(), *b = right.Ints.data();
+                auto *c = col.Bools.data();
+                switch(op)
+                {
+                    case bytecode::OpcodeType::OpEqual:
+                        for(size_t i = 0; i < n; i++) { c[i] = (a[i] == b[i]); }
+                        break;
+                    case bytecode::OpcodeType::OpNotEqual:
+                        for(size_t i = 0; i < n; i++) { c[i] = (a[i] != b[i]); }
+                        break;
+                    default:
+                        for(size_t i = 0; i < n; i++) { c[i] = (a[i] > b[i]); }
+                        break;
+                }
+            }
+            else if(op != bytecode::OpcodeType::OpGreaterThan)
+            {
+                // 与虚拟机一致: 非整数按对象是否相同比较(布尔值和null是单例)
+                for(size_t i = 0; i < n; i++)
+                {
+                    auto a = left.At(i), b = right.At(i);
+                    bool equal = (a->Type() == objects::ObjectType::INTEGER && b->Type() == objects::ObjectType::INTEGER)
+                                     ? std::static_pointer_cast<objects::Integer>(a)->Value == std::static_pointer_cast<objects::Integer>(b)->Value
+                                     : a == b;
+                    col.Bools[i] = (op == bytecode::OpcodeType::OpEqual ? equal : !equal);
+                }
+            }
+            else
+            {
+                return false;
+            }
+            stack.push_back(std::move(col));
+            return true;
+        }
+
+        bool index()
+        {
+            auto idx = pop();
+            auto left = pop();
+            if(left.Type != Column::Kind::Object)
+            {
+                return false;
+            }
+
+            std::vector<std::shared_ptr<objects::Object>> result(n);
+            for(size_t i = 0; i < n; i++)
+            {
+                auto obj = left.Objects[i];
+                auto key = idx.At(i);
+                if(obj->Type() == objects::ObjectType::ARRAY && key->Type() == objects::ObjectType::INTEGER)
+                {
+                    result[i] = objects::evalArrayIndexExpression(obj, key);
+                }
+                else if(obj->Type() == objects::ObjectType::INT_ARRAY && key->Type() == objects::ObjectType::INTEGER)
+                {
+                    result[i] = objects::evalIntArrayIndexExpression(obj, key);
+                }
+                else if(obj->Type() == objects::ObjectType::SLICE && key->Type() == objects::ObjectType::INTEGER)
+                {
+                    result[i] = objects::evalSliceIndexExpression(obj, key);
+                }
+                else if(obj->Type() == objects::ObjectType::HASH)
+                {
+                    result[i] = objects::evalHashIndexExpression(obj, key);
+                }
+                else
+                {
+                    return false;
+                }
+
+                if(objects::isError(result[i]))
+                {
+                    return false;
+                }
+            }
+            stack.push_back(Column::FromObjects(std::move(result)));
+            return true;
+        }
+
+        // 整批都为真返回1, 都为假返回0, 有分歧返回-1
+        int truthy(const Column &col)
+        {
+            switch(col.Type)
+            {
+                case Column::Kind::Int:
+                    return 1;
+                case Column::Kind::Bool:
+                    {
+                        auto trues = std::count(col.Bools.begin(), col.Bools.end(), 1);
+                        return (trues == static_cast<long>(n) ? 1 : (trues == 0 ? 0 : -1));
+                    }
+                default:
+                    {
+                        size_t trues = 0;
+                        for(auto &obj : col.Objects)
+                        {
+                            trues += (objects::isTruthy(obj) ? 1 : 0);
+                        }
+                        return (trues == n ? 1 : (trues == 0 ? 0 : -1));
+                    }
+            }
+        }
+
+        bool Run(bytecode::Instructions &ins, Column &result)
+        {
+            auto &constants = machine->constants;
+            int size = ins.size();
+            int ip = 0;
+            while(ip < size)
+            {
+                auto op = static_cast<bytecode::OpcodeType>(ins[ip]);
+                uint16_t operand = 0;
+                switch(op)
+                {
+                    case bytecode::OpcodeType::OpConstant:
+                        bytecode::ReadUint16(ins, ip + 1, operand);
+                        stack.push_back(Column::Broadcast(constants[operand], n));
+                        ip += 3;
+                        break;
+                    case bytecode::OpcodeType::OpTrue:
+                    case bytecode::OpcodeType::OpFalse:
+                        stack.push_back(Column::Broadcast(objects::nativeBoolToBooleanObject(op == bytecode::OpcodeType::OpTrue), n));
+                        ip += 1;
+                        break;
+                    case bytecode::OpcodeType::OpNull:
+                        stack.push_back(Column::Broadcast(objects::NULL_OBJ, n));
+                        ip += 1;
+                        break;
+                    case bytecode::OpcodeType::OpPop:
+                        stack.pop_back();
+                        ip += 1;
+                        break;
+                    case bytecode::OpcodeType::OpAdd:
+                    case bytecode::OpcodeType::OpSub:
+                    case bytecode::OpcodeType::OpMul:
+                    case bytecode::OpcodeType::OpDiv:
+                        if(!binary(op))
+                        {
+                            return false;
+                        }
+                        ip += 1;
+                        break;
+                    case bytecode::OpcodeType::OpEqual:
+                    case bytecode::OpcodeType::OpNotEqual:
+                    case bytecode::OpcodeType::OpGreaterThan:
+                        if(!comparison(op))
+                        {
+                            return false;
+                        }
+                        ip += 1;
+                        break;
+                    case bytecode::OpcodeType::OpMinus:
+                        {
+                            auto &col = stack.back();
+                            if(col.Type != Column::Kind::Int)
+                            {
+                                return false;
+                            }
+                            for(auto &v : col.Ints)
+                            {
+                                v = -v;
+                            }
+                            ip += 1;
+                        }
+                        break;
+                    case bytecode::OpcodeType::OpBang:
+                        {
+                            auto col = pop();
+                            Column negated = Column::Broadcast(objects::FALSE_OBJ, n);
+                            for(size_t i = 0; i < n; i++)
+                            {
+                                if(col.Type == Column::Kind::Bool)
+                                {
+                                    negated.Bools[i] = !col.Bools[i];
+                                }
+                                else if(col.Type == Column::Kind::Object)
+                                {
+                                    negated.Bools[i] = (col.Objects[i] == objects::FALSE_OBJ);
+                                }
+                            }
+                            stack.push_back(std::move(negated));
+                            ip += 1;
+                        }
+                        break;
+                    case bytecode::OpcodeType::OpIndex:
+                        if(!index())
+                        {
+                            return false;
+                        }
+                        ip += 1;
+                        break;
+                    case bytecode::OpcodeType::OpJumpNotTruthy:
+                        {
+                            bytecode::ReadUint16(ins, ip + 1, operand);
+                            auto cond = truthy(pop());
+                            if(cond < 0)
+                            {
+                                return false;
+                            }
+                            ip = (cond == 0 ? operand : ip + 3);
+                        }
+                        break;
+                    case bytecode::OpcodeType::OpJumpTruthy:
+                        {
+                            bytecode::ReadUint16(ins, ip + 1, operand);
+                            auto cond = truthy(pop());
+                            if(cond < 0)
+                            {
+                                return false;
+                            }
+                            ip = (cond == 1 ? operand : ip + 3);
+                        }
+                        break;
+                    case bytecode::OpcodeType::OpJump:
+                        bytecode::ReadUint16(ins, ip + 1, operand);
+                        ip = operand;
+                        break;
+                    case bytecode::OpcodeType::OpGetGlobal:
+                        bytecode::ReadUint16(ins, ip + 1, operand);
+                        stack.push_back(Column::Broadcast(machine->globals[operand], n));
+                        ip += 3;
+                        break;
+                    case bytecode::OpcodeType::OpGetLocal:
+                        stack.push_back(locals[ins[ip + 1]]);
+                        ip += 2;
+                        break;
+                    case bytecode::OpcodeType::OpSetLocal:
+                        locals[ins[ip + 1]] = pop();
+                        ip += 2;
+                        break;
+                    case bytecode::OpcodeType::OpGetFree:
+                        stack.push_back(Column::Broadcast(cl->Free[ins[ip + 1]], n));
+                        ip += 2;
+                        break;
+                    case bytecode::OpcodeType::OpReturnValue:
+                        result = pop();
+                        return true;
+                    case bytecode::OpcodeType::OpReturn:
+                        result = Column::Broadcast(objects::NULL_OBJ, n);
+                        return true;
+                    default:
+                        // 调用/构造数组哈希等指令逐行执行
+                        return false;
+                }
+            }
+            return false;
+        }
+    };
+
+    // 用同一个函数处理N行输入: columns[k][i]是第i行的第k个参数. 函数中引用的全局变量取machine当前的值
+    inline BatchResult RunBatch(std::shared_ptr<VM> machine, std::shared_ptr<objects::Closure> cl, const std::vector<std::vector<std::shared_ptr<objects::Object>>> &columns)
+    {
+        BatchResult result;
+        size_t rows = (columns.empty() ? 0 : columns[0].size());
+        result.Values.resize(rows);
+
+        auto fn = cl->Fn;
+        auto &ins = (fn->Optimized ? fn->Baseline : fn->Instructions);
+        bool batchable = (static_cast<int>(columns.size()) == fn->NumParameters);
+
+        for(size_t start = 0; start < rows; start += BatchSize)
+        {
+            size_t n = std::min<size_t>(BatchSize, rows - start);
+
+            if(batchable)
+            {
+                BatchFrame frame;
+                frame.machine = machine;
+                frame.cl = cl;
+                frame.n = n;
+                frame.locals.resize(fn->NumLocals);
+                for(size_t k = 0; k < columns.size(); k++)
+                {
+                    frame.locals[k] = Column::FromObjects(std::vector<std::shared_ptr<objects::Object>>(columns[k].begin() + start, columns[k].begin() + start + n));
+                }
+
+                Column out;
+                if(frame.Run(ins, out))
+                {
+                    for(size_t i = 0; i < n; i++)
+                    {
+                        result.Values[start + i] = out.At(i);
+                    }
+                    result.BatchedRows += n;
+                    continue;
+                }
+            }
+
+            std::vector<std::shared_ptr<objects::Object>> args(columns.size());
+            for(size_t i = start; i < start + n; i++)
+            {
+                for(size_t k = 0; k < columns.size(); k++)
+                {
+                    args[k] = columns[k][i];
+                }
+                result.Values[i] = machine->Call(cl, args);
+            }
+            result.FallbackRows += n;
+        }
+        return result;
+    }
+}
+
+#endif // H_BATCH_H
@@ -16,15 +16,20 @@ namespace vm
         int ip;
         int basePointer;
 
+        // 未命中memo表的调用, 返回时把结果写回缓存
+        std::shared_ptr<objects::MemoTable> memo;
+        std::vector<objects::HashKey> memoKey;
+        std::vector<std::shared_ptr<objects::Object>> memoArgs;
+
         Frame(std::shared_ptr<objects::Closure> cl, const int i, const int bp): cl(cl), ip(i), basePointer(bp){}
 
-        bytecode::Instructions Instruction()
+        bytecode::Instructions& Instruction()
         {
             return cl->Fn->Instructions;
         }
     };
 
-    std::shared_ptr<Frame> NewFrame(std::shared_ptr<objects::Closure> cl, int basePointer)
+    inline std::shared_ptr<Frame> NewFrame(std::shared_ptr<objects::Closure> cl, int basePointer)
     {
         return std::make_shared<Frame>(cl, -1, basePointer);
     }
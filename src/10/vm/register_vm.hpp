@@ -0,0 +1,558 @@
+#ifndef H_REGISTER_VM_H
+#define H_REGISTER_VM_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+#include "objects/objects.hpp"
+#include "objects/builtins.hpp"
+#include "objects/seq.hpp"
+#include "code/register_code.hpp"
+#include "compiler/register_compiler.hpp"
+#include "vm/vm.hpp"
+
+namespace vm
+{
+    struct RegisterFrame{
+        std::shared_ptr<objects::Closure> cl;
+        int ip;
+        int basePointer;    // 帧的第一个寄存器在寄存器文件中的位置
+        int returnRegister; // 返回值写入调用者帧的寄存器
+
+        RegisterFrame(): ip(0), basePointer(0), returnRegister(0){}
+        RegisterFrame(std::shared_ptr<objects::Closure> cl, const int bp, const int ret): cl(cl), ip(0), basePointer(bp), returnRegister(ret){}
+    };
+
+    // 寄存器虚拟机: 局部变量与临时值保存在帧的寄存器中, 指令直接读写寄存器而不经过操作数栈
+    struct RegisterVM{
+        std::vector<std::shared_ptr<objects::Object>> constants;
+        std::vector<std::shared_ptr<objects::Object>> globals;
+
+        std::vector<std::shared_ptr<objects::Object>> registers;
+
+        std::vector<RegisterFrame> frames;
+        int frameIndex;
+
+        std::shared_ptr<objects::Object> lastResult;
+
+        int entryFrame = 1; // 从这一层帧返回时Run结束; 内置函数回调用户函数时是回调函数的帧
+
+        RegisterVM(std::vector<std::shared_ptr<objects::Object>>& objs, std::shared_ptr<objects::Closure> mainClosure):
+        constants(objs)
+        {
+            globals.resize(GlobalsSize);
+            registers.resize(StackSize);
+            frames.resize(FrameSize);
+            frames[0] = RegisterFrame(mainClosure, 0, 0);
+            frameIndex = 1;
+        }
+
+        std::shared_ptr<objects::Object> LastResult()
+        {
+            return lastResult;
+        }
+
+        std::shared_ptr<objects::Object> Run()
+        {
+            RegisterFrame *frame = &frames[frameIndex - 1];
+            const bytecode::Opcode *ins = frame->cl->Fn->Instructions.data();
+            int size = frame->cl->Fn->Instructions.size();
+            int ip = frame->ip;
+            std::shared_ptr<objects::Object> *R = &registers[frame->basePointer];
+
+            // 内置函数(惰性序列的map/filter/reduce等)回调用户函数时在本虚拟机上执行
+            objects::CallerScope callerScope([this](std::shared_ptr<objects::Object> fn, std::vector<std::shared_ptr<objects::Object>> &args) {
+                return Call(fn, args);
+            });
+
+            while(ip < size)
+            {
+                auto op = static_cast<bytecode::RegisterOpcodeType>(ins[ip]);
+
+                switch(op)
+                {
+                    case bytecode::RegisterOpcodeType::OpLoadConstant:
+                        {
+                            R[ins[ip+1]] = constants[readUint16(ins, ip+2)];
+                            ip += 4;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpLoadTrue:
+                        {
+                            R[ins[ip+1]] = objects::TRUE_OBJ;
+                            ip += 2;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpLoadFalse:
+                        {
+                            R[ins[ip+1]] = objects::FALSE_OBJ;
+                            ip += 2;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpLoadNull:
+                        {
+                            R[ins[ip+1]] = objects::NULL_OBJ;
+                            ip += 2;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpMove:
+                        {
+                            R[ins[ip+1]] = R[ins[ip+2]];
+                            ip += 3;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpAdd:
+                    case bytecode::RegisterOpcodeType::OpSub:
+                    case bytecode::RegisterOpcodeType::OpMul:
+                    case bytecode::RegisterOpcodeType::OpDiv:
+                        {
+                            auto result = executeBinaryOperaction(op, R[ins[ip+2]], R[ins[ip+3]]);
+                            if(objects::isError(result))
+                            {
+                                return result;
+                            }
+                            R[ins[ip+1]] = result;
+                            ip += 4;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpEqual:
+                    case bytecode::RegisterOpcodeType::OpNotEqual:
+                    case bytecode::RegisterOpcodeType::OpGreaterThan:
+                        {
+                            auto result = executeComparison(op, R[ins[ip+2]], R[ins[ip+3]]);
+                            if(objects::isError(result))
+                            {
+                                return result;
+                            }
+                            R[ins[ip+1]] = result;
+                            ip += 4;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpMinus:
+                        {
+                            auto &operand = R[ins[ip+2]];
+                            if(operand->Type() != objects::ObjectType::INTEGER)
+                            {
+                                return objects::newError("unsupported type for negation: " + operand->TypeStr());
+                            }
+                            auto value = static_cast<objects::Integer*>(operand.get())->Value;
+                            R[ins[ip+1]] = std::make_shared<objects::Integer>(-value);
+                            ip += 3;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpBang:
+                        {
+                            auto &operand = R[ins[ip+2]];
+                            if(operand == objects::FALSE_OBJ)
+                            {
+                                R[ins[ip+1]] = objects::TRUE_OBJ;
+                            }
+                            else
+                            {
+                                R[ins[ip+1]] = objects::FALSE_OBJ;
+                            }
+                            ip += 3;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpJump:
+                        {
+                            ip = readUint16(ins, ip+1);
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpJumpNotTruthy:
+                        {
+                            if(!objects::isTruthy(R[ins[ip+1]]))
+                            {
+                                ip = readUint16(ins, ip+2);
+                            }
+                            else
+                            {
+                                ip += 4;
+                            }
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpGetGlobal:
+                        {
+                            R[ins[ip+1]] = globals[readUint16(ins, ip+2)];
+                            ip += 4;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpSetGlobal:
+                        {
+                            globals[readUint16(ins, ip+1)] = R[ins[ip+3]];
+                            ip += 4;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpArray:
+                        {
+                            int start = ins[ip+2];
+                            int count = ins[ip+3];
+                            std::vector<std::shared_ptr<objects::Object>> elements(R + start, R + start + count);
+                            R[ins[ip+1]] = std::make_shared<objects::Array>(elements);
+                            ip += 4;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpHash:
+                        {
+                            auto hashObj = buildHash(R + ins[ip+2], ins[ip+3]);
+                            if(objects::isError(hashObj))
+                            {
+                                return hashObj;
+                            }
+                            R[ins[ip+1]] = hashObj;
+                            ip += 4;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpIndex:
+                        {
+                            auto result = executeIndexExpression(R[ins[ip+2]], R[ins[ip+3]]);
+                            if(objects::isError(result))
+                            {
+                                return result;
+                            }
+                            R[ins[ip+1]] = result;
+                            ip += 4;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpCall:
+                        {
+                            int dst = ins[ip+1];
+                            auto &fnObj = R[ins[ip+2]];
+                            int start = ins[ip+3];
+                            int numArgs = ins[ip+4];
+                            ip += 5;
+
+                            if(fnObj->Type() == objects::ObjectType::CLOSURE)
+                            {
+                                auto closureFn = std::static_pointer_cast<objects::Closure>(fnObj);
+                                if(closureFn->Fn->NumParameters != numArgs)
+                                {
+                                    std::string str1 = std::to_string(closureFn->Fn->NumParameters);
+                                    std::string str2 = std::to_string(numArgs);
+                                    return objects::newError("wrong number of arguments: want=" + str1 + ", got=" + str2);
+                                }
+
+                                int basePointer = frame->basePointer + frame->cl->Fn->NumLocals;
+                                if(frameIndex >= FrameSize || basePointer + closureFn->Fn->NumLocals > StackSize)
+                                {
+                                    return objects::newError("stack overflow");
+                                }
+
+                                for(int i = 0; i < numArgs; i++)
+                                {
+                                    registers[basePointer + i] = R[start + i];
+                                }
+
+                                frame->ip = ip;
+                                frames[frameIndex] = RegisterFrame(closureFn, basePointer, dst);
+                                frameIndex += 1;
+
+                                frame = &frames[frameIndex - 1];
+                                ins = frame->cl->Fn->Instructions.data();
+                                size = frame->cl->Fn->Instructions.size();
+                                ip = 0;
+                                R = &registers[basePointer];
+                            }
+                            else if(fnObj->Type() == objects::ObjectType::BUILTIN)
+                            {
+                                auto builtinFnObj = std::static_pointer_cast<objects::Builtin>(fnObj);
+                                std::vector<std::shared_ptr<objects::Object>> args(R + start, R + start + numArgs);
+
+                                auto result = builtinFnObj->Call(args);
+                                if(result != nullptr)
+                                {
+                                    R[dst] = result;
+                                } else {
+                                    R[dst] = objects::NULL_OBJ;
+                                }
+                            }
+                            else
+                            {
+                                return objects::newError("calling non-function and non-built-in");
+                            }
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpReturnValue:
+                    case bytecode::RegisterOpcodeType::OpReturn:
+                        {
+                            std::shared_ptr<objects::Object> returnValue = objects::NULL_OBJ;
+                            if(op == bytecode::RegisterOpcodeType::OpReturnValue)
+                            {
+                                returnValue = R[ins[ip+1]];
+                            }
+
+                            if(frameIndex == entryFrame)
+                            {
+                                lastResult = returnValue;
+                                frame->ip = size;
+                                return nullptr;
+                            }
+
+                            int returnRegister = frame->returnRegister;
+                            frameIndex -= 1;
+
+                            frame = &frames[frameIndex - 1];
+                            ins = frame->cl->Fn->Instructions.data();
+                            size = frame->cl->Fn->Instructions.size();
+                            ip = frame->ip;
+                            R = &registers[frame->basePointer];
+
+                            R[returnRegister] = returnValue;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpGetBuiltin:
+                        {
+                            auto definition = objects::Builtins[ins[ip+2]];
+                            R[ins[ip+1]] = definition->Builtin;
+                            ip += 3;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpClosure:
+                        {
+                            int dst = ins[ip+1];
+                            int constIndex = readUint16(ins, ip+2);
+                            int start = ins[ip+4];
+                            int numFree = ins[ip+5];
+                            ip += 6;
+
+                            auto constant = constants[constIndex];
+                            auto compiledFn = std::dynamic_pointer_cast<objects::CompiledFunction>(constant);
+                            if(compiledFn == nullptr)
+                            {
+                                return objects::newError("not a function: " + constant->Inspect());
+                            }
+
+                            std::vector<std::shared_ptr<objects::Object>> free(R + start, R + start + numFree);
+                            R[dst] = std::make_shared<objects::Closure>(compiledFn, free);
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpGetFree:
+                        {
+                            R[ins[ip+1]] = frame->cl->Free[ins[ip+2]];
+                            ip += 3;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpCurrentClosure:
+                        {
+                            R[ins[ip+1]] = frame->cl;
+                            ip += 2;
+                        }
+                        break;
+                    case bytecode::RegisterOpcodeType::OpResult:
+                        {
+                            lastResult = R[ins[ip+1]];
+                            ip += 2;
+                        }
+                        break;
+                    default:
+                        return objects::newError("unknow register opcode: " + std::to_string(static_cast<int>(op)));
+                }
+            }
+
+            frame->ip = ip;
+            return nullptr;
+        }
+
+        // 在当前最上层的帧之上调用fn, 返回它的返回值; 供内置函数在Run期间回调用户函数
+        std::shared_ptr<objects::Object> Call(std::shared_ptr<objects::Object> fn, std::vector<std::shared_ptr<objects::Object>> &args)
+        {
+            if(fn->Type() == objects::ObjectType::BUILTIN)
+            {
+                auto result = std::static_pointer_cast<objects::Builtin>(fn)->Call(args);
+                return (result != nullptr ? result : objects::NULL_OBJ);
+            }
+            if(fn->Type() != objects::ObjectType::CLOSURE)
+            {
+                return objects::newError("calling non-function and non-built-in");
+            }
+
+            auto closureFn = std::static_pointer_cast<objects::Closure>(fn);
+            if(closureFn->Fn->NumParameters != static_cast<int>(args.size()))
+            {
+                std::string str1 = std::to_string(closureFn->Fn->NumParameters);
+                std::string str2 = std::to_string(args.size());
+                return objects::newError("wrong number of arguments: want=" + str1 + ", got=" + str2);
+            }
+
+            auto &top = frames[frameIndex - 1];
+            int basePointer = top.basePointer + top.cl->Fn->NumLocals;
+            if(frameIndex >= FrameSize || basePointer + closureFn->Fn->NumLocals > StackSize)
+            {
+                return objects::newError("stack overflow");
+            }
+
+            for(unsigned long i = 0; i < args.size(); i++)
+            {
+                registers[basePointer + i] = args[i];
+            }
+
+            int savedFrameIndex = frameIndex, savedEntryFrame = entryFrame;
+            auto savedResult = lastResult;
+
+            frames[frameIndex] = RegisterFrame(closureFn, basePointer, 0);
+            frameIndex += 1;
+            entryFrame = frameIndex;
+
+            auto result = Run();
+            if(!objects::isError(result))
+            {
+                result = lastResult;
+            }
+
+            frameIndex = savedFrameIndex;
+            entryFrame = savedEntryFrame;
+            lastResult = savedResult;
+            return result;
+        }
+
+        static int readUint16(const bytecode::Opcode *ins, int pos)
+        {
+            return (static_cast<int>(ins[pos]) << 8) | static_cast<int>(ins[pos + 1]);
+        }
+
+        std::shared_ptr<objects::Object> executeBinaryOperaction(bytecode::RegisterOpcodeType op,
+                                                                 std::shared_ptr<objects::Object> &left,
+                                                                 std::shared_ptr<objects::Object> &right)
+        {
+            if(left->Type() == objects::ObjectType::INTEGER && right->Type() == objects::ObjectType::INTEGER)
+            {
+                auto leftValue = static_cast<objects::Integer*>(left.get())->Value;
+                auto rightValue = static_cast<objects::Integer*>(right.get())->Value;
+
+                int64_t result = 0;
+                switch (op)
+                {
+                case bytecode::RegisterOpcodeType::OpAdd:
+                    result = leftValue + rightValue;
+                    break;
+                case bytecode::RegisterOpcodeType::OpSub:
+                    result = leftValue - rightValue;
+                    break;
+                case bytecode::RegisterOpcodeType::OpMul:
+                    result = leftValue * rightValue;
+                    break;
+                case bytecode::RegisterOpcodeType::OpDiv:
+                    if(rightValue == 0)
+                    {
+                        return objects::newError("division by zero");
+                    }
+                    result = leftValue / rightValue;
+                    break;
+                default:
+                    return objects::newError("unknow integer operator: " + std::to_string(static_cast<int>(op)));
+                }
+
+                return std::make_shared<objects::Integer>(result);
+            }
+            else if(left->Type() == objects::ObjectType::STRING && right->Type() == objects::ObjectType::STRING)
+            {
+                if(op != bytecode::RegisterOpcodeType::OpAdd)
+                {
+                    return objects::newError("unknow string operator: " + std::to_string(static_cast<int>(op)));
+                }
+
+                auto leftValue = static_cast<objects::String*>(left.get())->Value;
+                auto rightValue = static_cast<objects::String*>(right.get())->Value;
+                return std::make_shared<objects::String>(leftValue + rightValue);
+            }
+            else {
+                return objects::newError("unsupported types for binary operaction: " + left->TypeStr() + " " + right->TypeStr());
+            }
+        }
+
+        std::shared_ptr<objects::Object> executeComparison(bytecode::RegisterOpcodeType op,
+                                                           std::shared_ptr<objects::Object> &left,
+                                                           std::shared_ptr<objects::Object> &right)
+        {
+            if(left->Type() == objects::ObjectType::INTEGER && right->Type() == objects::ObjectType::INTEGER)
+            {
+                auto leftValue = static_cast<objects::Integer*>(left.get())->Value;
+                auto rightValue = static_cast<objects::Integer*>(right.get())->Value;
+
+                switch (op)
+                {
+                case bytecode::RegisterOpcodeType::OpEqual:
+                    return objects::nativeBoolToBooleanObject(leftValue == rightValue);
+                case bytecode::RegisterOpcodeType::OpNotEqual:
+                    return objects::nativeBoolToBooleanObject(leftValue != rightValue);
+                case bytecode::RegisterOpcodeType::OpGreaterThan:
+                    return objects::nativeBoolToBooleanObject(leftValue > rightValue);
+                default:
+                    return objects::newError("unknow operator: " + std::to_string(static_cast<int>(op)));
+                }
+            }
+
+            switch (op)
+            {
+            case bytecode::RegisterOpcodeType::OpEqual:
+                return objects::nativeBoolToBooleanObject(right == left);
+            case bytecode::RegisterOpcodeType::OpNotEqual:
+                return objects::nativeBoolToBooleanObject(right != left);
+            default:
+                return objects::newError("unknow operator: " + std::to_string(static_cast<int>(op)) + " (" + left->TypeStr() + " " + right->TypeStr() + ")");
+            }
+        }
+
+        std::shared_ptr<objects::Object> executeIndexExpression(std::shared_ptr<objects::Object> &left,
+                                                                std::shared_ptr<objects::Object> &index)
+        {
+            if(left->Type() == objects::ObjectType::ARRAY && index->Type() == objects::ObjectType::INTEGER)
+            {
+                return objects::evalArrayIndexExpression(left, index);
+            }
+            else if(left->Type() == objects::ObjectType::HASH)
+            {
+                return objects::evalHashIndexExpression(left, index);
+            }
+            else if(left->Type() == objects::ObjectType::INT_ARRAY && index->Type() == objects::ObjectType::INTEGER)
+            {
+                return objects::evalIntArrayIndexExpression(left, index);
+            }
+            else if(left->Type() == objects::ObjectType::SLICE && index->Type() == objects::ObjectType::INTEGER)
+            {
+                return objects::evalSliceIndexExpression(left, index);
+            }
+            else if(left->Type() == objects::ObjectType::HOST_BUFFER && index->Type() == objects::ObjectType::INTEGER)
+            {
+                return objects::evalHostIndexExpression(left, index);
+            }
+            else
+            {
+                return objects::newError("index operator not supported: " + left->TypeStr());
+            }
+        }
+
+        std::shared_ptr<objects::Object> buildHash(std::shared_ptr<objects::Object> *start, int count)
+        {
+            std::map<objects::HashKey, std::shared_ptr<objects::HashPair>> hashPairs;
+
+            for(int i = 0; i < count; i += 2)
+            {
+                auto key = start[i];
+                auto value = start[i+1];
+
+                if(!key->Hashable())
+                {
+                    return objects::newError("unusable as hash type: " + key->TypeStr());
+                }
+
+                hashPairs[key->GetHashKey()] = std::make_shared<objects::HashPair>(key, value);
+            }
+
+            return std::make_shared<objects::Hash>(hashPairs);
+        }
+    };
+
+    inline std::shared_ptr<RegisterVM> NewRegisterVM(std::shared_ptr<compiler::RegisterByteCode> bytecode)
+    {
+        auto mainFn = std::make_shared<objects::CompiledFunction>(bytecode->Instructions, bytecode->NumRegisters, 0);
+        auto mainClosure = std::make_shared<objects::Closure>(mainFn);
+
+        return std::make_shared<RegisterVM>(bytecode->Constants, mainClosure);
+    }
+}
+
+#endif // H_REGISTER_VM_H
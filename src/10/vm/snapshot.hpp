@@ -0,0 +1,293 @@
+#ifndef H_SNAPSHOT_H
+#define H_SNAPSHOT_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+
+#include "objects/objects.hpp"
+#include "objects/builtins.hpp"
+#include "objects/serialize.hpp"
+#include "compiler/compiler.hpp"
+#include "vm/vm.hpp"
+
+namespace vm
+{
+    const std::string SnapshotMagic = "MONKEYSNAP";
+    const uint32_t SnapshotVersion = 3;
+
+    // 初始化完成后的运行时状态: 全局变量名/常量池/全局变量及其引用的对象图.
+    // 恢复后可以继续编译和运行新代码, 就像初始化脚本刚刚执行完一样
+    struct Snapshot
+    {
+        std::map<std::string, int> GlobalNames;
+        std::set<int> PureGlobals;
+        std::set<int> AssignedGlobals; // 以下三项是赋值语句使纯函数失效时要用的编译器状态
+        std::map<int, std::vector<std::shared_ptr<objects::CompiledFunction>>> GlobalReaders;
+        std::map<int, std::shared_ptr<objects::CompiledFunction>> PureBindings;
+        std::vector<std::shared_ptr<objects::Object>> Constants;
+        std::vector<std::shared_ptr<objects::Object>> Globals; // 只保存用到的前 NumGlobals 个
+        int NumGlobals = 0; // 下一个全局变量的下标; 被重新定义的变量的旧槽位没有名字但仍可能被闭包引用, 所以不等于 GlobalNames.size()
+
+        // 编译器沿用快照的符号表/常量池, 新定义的全局变量接在快照之后
+        std::shared_ptr<compiler::Compiler> NewCompiler()
+        {
+            auto symbolTable = compiler::NewSymbolTable();
+
+            int i = -1;
+            for (auto &fn : objects::Builtins)
+            {
+                i += 1;
+                symbolTable->DefineBuiltin(i, fn->Name);
+            }
+
+            for (auto &[name, index] : GlobalNames)
+            {
+                symbolTable->store[name] = std::make_shared<compiler::Symbol>(name, compiler::SymbolScopeType::GlobalScope, index);
+            }
+            symbolTable->numDefinitions = NumGlobals;
+
+            auto comp = compiler::NewWithState(symbolTable, Constants);
+            comp->pureGlobals = PureGlobals;
+            comp->assignedGlobals = AssignedGlobals;
+            comp->globalReaders = GlobalReaders;
+            comp->pureBindings = PureBindings;
+            return comp;
+        }
+
+        std::shared_ptr<VM> NewVM(std::shared_ptr<compiler::ByteCode> bytecode)
+        {
+            auto machine = vm::New(bytecode);
+            // 快照的全局变量不会超过虚拟机的全局变量表; 手工构造的快照超出部分丢弃, 不越界写
+            std::copy_n(Globals.begin(), std::min(Globals.size(), machine->globals.size()), machine->globals.begin());
+            return machine;
+        }
+    };
+
+    // 从编译器和执行完初始化脚本的虚拟机中截取快照
+    inline std::shared_ptr<Snapshot> NewSnapshot(std::shared_ptr<compiler::Compiler> comp, std::shared_ptr<VM> machine)
+    {
+        auto snapshot = std::make_shared<Snapshot>();
+        for (auto &[name, symbol] : comp->symbolTable->store)
+        {
+            if (symbol->Scope == compiler::SymbolScopeType::GlobalScope)
+            {
+                snapshot->GlobalNames[name] = symbol->Index;
+            }
+        }
+        snapshot->PureGlobals = comp->pureGlobals;
+        snapshot->AssignedGlobals = comp->assignedGlobals;
+        snapshot->GlobalReaders = comp->globalReaders;
+        snapshot->PureBindings = comp->pureBindings;
+        snapshot->Constants = comp->constants;
+
+        snapshot->NumGlobals = comp->symbolTable->numDefinitions;
+        snapshot->Globals.assign(machine->globals.begin(), machine->globals.begin() + snapshot->NumGlobals);
+        return snapshot;
+    }
+
+    inline bool SaveSnapshot(std::shared_ptr<Snapshot> snapshot, const std::string &path, std::string &error)
+    {
+        objects::ObjectWriter writer;
+
+        std::vector<uint32_t> constants, globals;
+        for (auto &obj : snapshot->Constants)
+        {
+            constants.push_back(writer.Add(obj));
+        }
+        for (auto &obj : snapshot->Globals)
+        {
+            globals.push_back(writer.Add(obj));
+        }
+
+        // 读取全局变量的函数和纯函数绑定按对象编号保存, 恢复后指向同一批函数对象
+        std::map<int, std::vector<uint32_t>> readers;
+        for (auto &[index, fns] : snapshot->GlobalReaders)
+        {
+            for (auto &fn : fns)
+            {
+                readers[index].push_back(writer.Add(fn));
+            }
+        }
+        std::map<int, uint32_t> bindings;
+        for (auto &[index, fn] : snapshot->PureBindings)
+        {
+            bindings[index] = writer.Add(fn);
+        }
+
+        if (!writer.Error.empty())
+        {
+            error = writer.Error;
+            return false;
+        }
+
+        writer.Buffer = SnapshotMagic;
+        writer.put<uint32_t>(SnapshotVersion);
+        writer.putBuiltinTable();
+
+        writer.put<int32_t>(snapshot->NumGlobals);
+        writer.put<uint32_t>(snapshot->GlobalNames.size());
+        for (auto &[name, index] : snapshot->GlobalNames)
+        {
+            writer.putString(name);
+            writer.put<int32_t>(index);
+        }
+
+        writer.put<uint32_t>(snapshot->PureGlobals.size());
+        for (auto &index : snapshot->PureGlobals)
+        {
+            writer.put<int32_t>(index);
+        }
+
+        writer.put<uint32_t>(snapshot->AssignedGlobals.size());
+        for (auto &index : snapshot->AssignedGlobals)
+        {
+            writer.put<int32_t>(index);
+        }
+
+        writer.putObjectTable();
+
+        writer.put<uint32_t>(constants.size());
+        for (auto &id : constants)
+        {
+            writer.put<uint32_t>(id);
+        }
+
+        writer.put<uint32_t>(globals.size());
+        for (auto &id : globals)
+        {
+            writer.put<uint32_t>(id);
+        }
+
+        writer.put<uint32_t>(readers.size());
+        for (auto &[index, ids] : readers)
+        {
+            writer.put<int32_t>(index);
+            writer.put<uint32_t>(ids.size());
+            for (auto &id : ids)
+            {
+                writer.put<uint32_t>(id);
+            }
+        }
+
+        writer.put<uint32_t>(bindings.size());
+        for (auto &[index, id] : bindings)
+        {
+            writer.put<int32_t>(index);
+            writer.put<uint32_t>(id);
+        }
+
+        return writer.WriteFile(path, error);
+    }
+
+    // 把快照文件映射进内存后一次性重建对象图; 失败时返回nullptr并设置error
+    inline std::shared_ptr<Snapshot> LoadSnapshot(const std::string &path, std::string &error)
+    {
+        objects::MappedFile file;
+        if (!file.Open(path, error))
+        {
+            return nullptr;
+        }
+
+        objects::ObjectReader reader(file.Data, file.Size);
+        auto fail = [&](const std::string &msg) -> std::shared_ptr<Snapshot> {
+            error = path + ": " + msg;
+            return nullptr;
+        };
+
+        if (!reader.expectMagic(SnapshotMagic))
+        {
+            return fail("not a snapshot");
+        }
+
+        if (reader.get<uint32_t>() != SnapshotVersion)
+        {
+            return fail("unsupported snapshot version");
+        }
+
+        if (!reader.sameBuiltinTable())
+        {
+            return fail(reader.Ok ? "snapshot was taken with different builtins" : "corrupted snapshot");
+        }
+
+        auto snapshot = std::make_shared<Snapshot>();
+        snapshot->NumGlobals = reader.get<int32_t>();
+        if (!reader.Ok || snapshot->NumGlobals < 0 || snapshot->NumGlobals > GlobalsSize)
+        {
+            return fail("corrupted snapshot");
+        }
+
+        auto numNames = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < numNames && reader.Ok; i++)
+        {
+            auto name = reader.getString();
+            auto index = reader.get<int32_t>();
+            if (index < 0 || index >= snapshot->NumGlobals)
+            {
+                return fail("corrupted snapshot");
+            }
+            snapshot->GlobalNames[name] = index;
+        }
+
+        auto numPure = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < numPure && reader.Ok; i++)
+        {
+            snapshot->PureGlobals.insert(reader.get<int32_t>());
+        }
+
+        auto numAssigned = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < numAssigned && reader.Ok; i++)
+        {
+            snapshot->AssignedGlobals.insert(reader.get<int32_t>());
+        }
+
+        if (!reader.readObjectTable())
+        {
+            return fail(reader.Error.empty() ? "corrupted snapshot" : reader.Error);
+        }
+
+        snapshot->Constants = reader.refs();
+        snapshot->Globals = reader.refs();
+
+        auto function = [&]() -> std::shared_ptr<objects::CompiledFunction> {
+            auto obj = reader.ref();
+            if (obj == nullptr || obj->Type() != objects::ObjectType::COMPILED_FUNCTION)
+            {
+                reader.Ok = false;
+                return nullptr;
+            }
+            return std::static_pointer_cast<objects::CompiledFunction>(obj);
+        };
+
+        auto numReaders = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < numReaders && reader.Ok; i++)
+        {
+            auto &fns = snapshot->GlobalReaders[reader.get<int32_t>()];
+            auto numFns = reader.get<uint32_t>();
+            for (uint32_t k = 0; k < numFns && reader.Ok; k++)
+            {
+                fns.push_back(function());
+            }
+        }
+
+        auto numBindings = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < numBindings && reader.Ok; i++)
+        {
+            auto index = reader.get<int32_t>();
+            snapshot->PureBindings[index] = function();
+        }
+
+        if (!reader.Ok || reader.Pos != reader.Size || snapshot->Globals.size() != static_cast<size_t>(snapshot->NumGlobals))
+        {
+            return fail("corrupted snapshot");
+        }
+        return snapshot;
+    }
+}
+
+#endif // H_SNAPSHOT_H
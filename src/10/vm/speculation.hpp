@@ -0,0 +1,106 @@
+#ifndef H_SPECULATION_H
+#define H_SPECULATION_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+#include "code/code.hpp"
+#include "objects/objects.hpp"
+
+namespace vm
+{
+    const int WarmupThreshold = 100;   // 调用次数达到后开始收集类型反馈
+    const int OptimizeThreshold = 1000; // 调用次数达到后根据反馈生成推测优化代码
+    const int MaxDeopts = 3;            // 去优化次数过多的函数不再优化
+
+    struct DeoptEvent
+    {
+        std::shared_ptr<objects::CompiledFunction> Fn;
+        int Position;
+        std::string Reason;
+
+        DeoptEvent(std::shared_ptr<objects::CompiledFunction> fn, const int &pos, const std::string &reason)
+            : Fn(fn), Position(pos), Reason(reason) {}
+    };
+
+    inline const std::map<bytecode::OpcodeType, bytecode::OpcodeType> speculativeOpcodes{
+        {bytecode::OpcodeType::OpAdd, bytecode::OpcodeType::OpAddInt},
+        {bytecode::OpcodeType::OpSub, bytecode::OpcodeType::OpSubInt},
+        {bytecode::OpcodeType::OpMul, bytecode::OpcodeType::OpMulInt},
+        {bytecode::OpcodeType::OpEqual, bytecode::OpcodeType::OpEqualInt},
+        {bytecode::OpcodeType::OpNotEqual, bytecode::OpcodeType::OpNotEqualInt},
+        {bytecode::OpcodeType::OpGreaterThan, bytecode::OpcodeType::OpGreaterThanInt},
+    };
+
+    inline bool CanOptimize(std::shared_ptr<objects::CompiledFunction> fn)
+    {
+        return (!fn->Optimized && fn->DeoptCount < MaxDeopts);
+    }
+
+    // 把只观察到整数操作数的运算替换为带类型守卫的整数指令, 返回替换的指令数量
+    inline int Optimize(std::shared_ptr<objects::CompiledFunction> fn)
+    {
+        if(fn->Feedback == nullptr || !CanOptimize(fn))
+        {
+            return 0;
+        }
+
+        int rewritten = 0;
+        bytecode::Instructions optimized = fn->Instructions;
+
+        int i = 0, size = optimized.size();
+        while(i < size)
+        {
+            auto op = static_cast<bytecode::OpcodeType>(optimized[i]);
+            auto def = bytecode::Lookup(op);
+            if(def == nullptr)
+            {
+                return 0;
+            }
+
+            auto fit = speculativeOpcodes.find(op);
+            if(fit != speculativeOpcodes.end() && fn->Feedback->Slots[i].OnlySeen(objects::ObjectType::INTEGER))
+            {
+                optimized[i] = static_cast<bytecode::Opcode>(fit->second);
+                rewritten += 1;
+            }
+
+            i += 1;
+            for(auto &w: def->OperandWidths)
+            {
+                i += w;
+            }
+        }
+
+        if(rewritten > 0)
+        {
+            fn->Baseline = fn->Instructions;
+            fn->Instructions = optimized;
+            fn->Optimized = true;
+        }
+
+        return rewritten;
+    }
+
+    // 优化代码与基线代码的指令偏移和栈布局一一对应, 所以正在执行该函数的帧(ip, 栈槽)
+    // 无需转换即可在基线代码上继续执行; 反馈清空后重新收集
+    inline void Deoptimize(std::shared_ptr<objects::CompiledFunction> fn)
+    {
+        if(!fn->Optimized)
+        {
+            return;
+        }
+
+        fn->Instructions = fn->Baseline;
+        fn->Baseline.clear();
+        fn->Optimized = false;
+        fn->DeoptCount += 1;
+        fn->Hotness = 0;
+        fn->Feedback.reset();
+    }
+}
+
+#endif // H_SPECULATION_H
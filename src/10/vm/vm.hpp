@@ -6,19 +6,37 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <algorithm>
+#include <chrono>
 
 #include "objects/objects.hpp"
 #include "compiler/compiler.hpp"
 #include "code/code.hpp"
 #include "vm/frame.hpp"
+#include "vm/speculation.hpp"
 
 namespace vm
 {
     const int FrameSize = 1024;
     const int StackSize = 2048;
     const int GlobalsSize = 65536;
+    const int DeadlineCheckInterval = 4096; // 设置了截止时间时每执行这么多条指令看一次时钟
+
+    // 一个运行时中已经执行过的模块, 以链接位置为键(见moduleKey)
+    struct ModuleInstance
+    {
+        bool Loading = true;
+        std::vector<std::shared_ptr<objects::Object>> Values; // 模块的全部全局变量, 其它程序导入同一位置的模块时直接填回
+        std::shared_ptr<objects::Object> Exports;             // import()表达式的值: 导出名 -> 值
+    };
+
+    using ModuleRegistry = std::map<std::string, ModuleInstance>;
 
     struct VM{
+        // 隔离运行时的堆: Run期间新建的对象都记在这里, 超过上限时Run返回错误.
+        // 对象不持有堆, 所以它声明在最前面, 在虚拟机持有的所有对象析构之后才释放
+        std::shared_ptr<objects::Heap> heap;
+
         std::vector<std::shared_ptr<objects::Object>> constants;
         std::vector<std::shared_ptr<objects::Object>> globals;
 
@@ -28,6 +46,21 @@ namespace vm
         std::vector<std::shared_ptr<Frame>> frames;
         int frameIndex;
 
+        bool speculation = true; // 是否收集类型反馈并生成推测优化代码
+        int warmupThreshold = WarmupThreshold;
+        int optimizeThreshold = OptimizeThreshold;
+        std::vector<DeoptEvent> deopts;
+
+        bool memoizePure = false; // 自动缓存编译器判定为纯函数的闭包调用结果
+
+        int usedGlobals = GlobalsSize; // Reset时需要清空的全局变量数量
+
+        // 不为默认值时, Run超过这个时刻就返回错误(嵌入API的TimeLimit)
+        std::chrono::steady_clock::time_point deadline{};
+
+        // 本运行时执行过的模块, Reset时保留
+        std::shared_ptr<ModuleRegistry> modules = std::make_shared<ModuleRegistry>();
+
         VM(std::vector<std::shared_ptr<objects::Object>>& objs, std::vector<std::shared_ptr<Frame>>& f):
         constants(objs),
         frames(f)
@@ -38,6 +71,38 @@ namespace vm
             frameIndex = 1;
         }
 
+        // 复用已经分配好的栈/帧/全局变量存储执行新的字节码(嵌入API的运行时会反复调用);
+        // 清空上次运行留下的引用, 全局变量只需清空前后两个程序用到的部分
+        void Reset(std::shared_ptr<compiler::ByteCode> bytecode, const int &numGlobals)
+        {
+            constants = bytecode->Constants;
+
+            std::fill(stack.begin(), stack.end(), nullptr);
+            std::fill(frames.begin(), frames.end(), nullptr);
+            std::fill(globals.begin(), globals.begin() + std::min(std::max(usedGlobals, numGlobals), GlobalsSize), nullptr);
+            usedGlobals = numGlobals;
+
+            auto mainFn = std::make_shared<objects::CompiledFunction>(bytecode->Instructions, 0, 0);
+            frames[0] = NewFrame(std::make_shared<objects::Closure>(mainFn), 0);
+            frameIndex = 1;
+            sp = 0;
+            deopts.clear();
+        }
+
+        // 保留全局变量和已有的常量执行一段新的顶层代码(REPL逐行执行): pool是编译器只追加的常量池, 只复制其中新增的部分
+        void Continue(bytecode::Instructions &instructions, const std::vector<std::shared_ptr<objects::Object>> &pool)
+        {
+            if(pool.size() > constants.size())
+            {
+                constants.insert(constants.end(), pool.begin() + constants.size(), pool.end());
+            }
+
+            auto mainFn = std::make_shared<objects::CompiledFunction>(instructions, 0, 0);
+            frames[0] = NewFrame(std::make_shared<objects::Closure>(mainFn), 0);
+            frameIndex = 1;
+            sp = 0;
+        }
+
         std::shared_ptr<objects::Object> LastPoppedStackElem()
         {
             return stack[sp];
@@ -88,12 +153,12 @@ namespace vm
             return Push(closure);
         }
 
+        // 弹出的值移出栈槽, 栈上不留多余的引用(for循环据此判断循环变量能否原地改写);
+        // 只有OpPop和存变量的指令把值留在原处供LastPoppedStackElem读取
         std::shared_ptr<objects::Object> Pop()
         {
-            auto obj = stack[sp - 1];
             sp -= 1;
-
-            return obj;
+            return std::move(stack[sp]);
         }
 
         std::shared_ptr<objects::Object> Run()
@@ -102,22 +167,46 @@ namespace vm
 
             int ip;
             bytecode::OpcodeType op;
-            bytecode::Instructions instructions = currentFrame()->Instruction();
-            int ins_size = instructions.size();
+            bytecode::Instructions *instructions = &frame->Instruction();
+            int ins_size = instructions->size();
+            objects::FeedbackVector *feedback = frame->cl->Fn->Feedback.get();
+
+            objects::HeapScope heapScope(heap);
+            objects::Heap *accounting = heap.get();
+            bool timed = (deadline != std::chrono::steady_clock::time_point{});
+            int ticks = 0;
+
+            // 内置函数(惰性序列的map/filter/reduce等)回调用户函数时在本虚拟机上执行
+            objects::CallerScope callerScope([this](std::shared_ptr<objects::Object> fn, std::vector<std::shared_ptr<objects::Object>> &args) {
+                return Call(fn, args);
+            });
 
             while(frame->ip < ins_size - 1) // frame->ip start with -1
             {
+                if(accounting != nullptr && accounting->Exceeded())
+                {
+                    return objects::newError("memory limit exceeded: " + std::to_string(accounting->Allocated) + " bytes allocated, limit is " + std::to_string(accounting->Limit));
+                }
+                if(timed && ++ticks == DeadlineCheckInterval)
+                {
+                    ticks = 0;
+                    if(std::chrono::steady_clock::now() > deadline)
+                    {
+                        return objects::newError("time limit exceeded");
+                    }
+                }
+
                 frame->ip += 1;
 
                 ip = frame->ip;
-                op = static_cast<bytecode::OpcodeType>(instructions[ip]);
+                op = static_cast<bytecode::OpcodeType>((*instructions)[ip]);
 
                 switch(op)
                 {
                     case bytecode::OpcodeType::OpConstant:
                         {
                             uint16_t constIndex;
-                            bytecode::ReadUint16(instructions, ip+1, constIndex);
+                            bytecode::ReadUint16(*instructions, ip+1, constIndex);
                             frame->ip += 2;
                             auto result = Push(constants[constIndex]);
                             if(objects::isError(result))
@@ -131,6 +220,11 @@ namespace vm
                     case bytecode::OpcodeType::OpMul:
                     case bytecode::OpcodeType::OpDiv:
                         {
+                            if(feedback != nullptr)
+                            {
+                                feedback->RecordOperands(ip, stack[sp - 2], stack[sp - 1]);
+                            }
+
                             auto result = executeBinaryOperaction(op);
                             if(objects::isError(result))
                             {
@@ -140,7 +234,7 @@ namespace vm
                         break;
                     case bytecode::OpcodeType::OpPop:
                         {
-                            Pop();
+                            sp -= 1;
                         }
                         break;
                     case bytecode::OpcodeType::OpTrue:
@@ -165,6 +259,11 @@ namespace vm
                     case bytecode::OpcodeType::OpNotEqual:
                     case bytecode::OpcodeType::OpGreaterThan:
                         {
+                            if(feedback != nullptr)
+                            {
+                                feedback->RecordOperands(ip, stack[sp - 2], stack[sp - 1]);
+                            }
+
                             auto result = executeComparison(op);
                             if(objects::isError(result))
                             {
@@ -193,14 +292,21 @@ namespace vm
                     case bytecode::OpcodeType::OpJump:
                         {
                             uint16_t pos;
-                            bytecode::ReadUint16(instructions, ip+1, pos);
+                            bytecode::ReadUint16(*instructions, ip+1, pos);
                             frame->ip = pos - 1;
+
+                            // 循环回边和函数调用一样计入热度: 优化代码与基线代码布局一致, 正在执行的循环下一轮直接进入优化代码
+                            if(pos <= ip && speculation && vm::CanOptimize(frame->cl->Fn))
+                            {
+                                tierUp(frame->cl->Fn);
+                                feedback = frame->cl->Fn->Feedback.get();
+                            }
                         }
                         break;
                     case bytecode::OpcodeType::OpJumpNotTruthy:
                         {
                             uint16_t pos;
-                            bytecode::ReadUint16(instructions, ip+1, pos);
+                            bytecode::ReadUint16(*instructions, ip+1, pos);
                             frame->ip += 2;
                             
                             auto condition = Pop();
@@ -210,6 +316,133 @@ namespace vm
                             }
                         }
                         break;
+                    case bytecode::OpcodeType::OpJumpTruthy:
+                        {
+                            uint16_t pos;
+                            bytecode::ReadUint16(*instructions, ip+1, pos);
+                            frame->ip += 2;
+
+                            auto condition = Pop();
+                            if(objects::isTruthy(condition))
+                            {
+                                frame->ip = pos - 1;
+                            }
+                        }
+                        break;
+                    case bytecode::OpcodeType::OpJumpTable:
+                    case bytecode::OpcodeType::OpJumpMap:
+                        {
+                            uint16_t constIndex, count;
+                            bytecode::ReadUint16(*instructions, ip+1, constIndex);
+                            bytecode::ReadUint16(*instructions, ip+3, count);
+
+                            auto subject = Pop();
+                            int entry = count;
+                            if(op == bytecode::OpcodeType::OpJumpTable)
+                            {
+                                if(subject->Type() == objects::ObjectType::INTEGER)
+                                {
+                                    // 无符号相减: 小于最小值的值回绕成很大的数, 和超出上界一样落到默认分支
+                                    uint64_t offset = static_cast<uint64_t>(static_cast<objects::Integer*>(subject.get())->Value) - static_cast<uint64_t>(static_cast<objects::Integer*>(constants[constIndex].get())->Value);
+                                    entry = (offset < count ? offset : count);
+                                }
+                            }
+                            else if(subject->Hashable())
+                            {
+                                auto &pairs = static_cast<objects::Hash*>(constants[constIndex].get())->Pairs;
+                                auto fit = pairs.find(subject->GetHashKey());
+                                if(fit != pairs.end())
+                                {
+                                    entry = static_cast<objects::Integer*>(fit->second->Value.get())->Value;
+                                }
+                            }
+
+                            // 表项是紧跟在后面的OpJump, 直接取它的目标
+                            uint16_t pos;
+                            bytecode::ReadUint16(*instructions, ip + 5 + entry * 3 + 1, pos);
+                            frame->ip = pos - 1;
+                        }
+                        break;
+                    case bytecode::OpcodeType::OpForPrep:
+                        {
+                            auto end = Pop();
+                            auto start = Pop();
+                            if(start->Type() != objects::ObjectType::INTEGER || end->Type() != objects::ObjectType::INTEGER)
+                            {
+                                return objects::newError("for range bounds must be INTEGER, got " + start->TypeStr() + ".." + end->TypeStr());
+                            }
+
+                            auto result = Push(std::make_shared<objects::RangeCursor>(static_cast<objects::Integer*>(start.get())->Value,
+                                                                                       static_cast<objects::Integer*>(end.get())->Value));
+                            if(objects::isError(result))
+                            {
+                                return result;
+                            }
+                        }
+                        break;
+                    case bytecode::OpcodeType::OpForIter:
+                        {
+                            uint16_t pos;
+                            bytecode::ReadUint16(*instructions, ip+1, pos);
+                            frame->ip += 2;
+
+                            auto cursor = static_cast<objects::RangeCursor*>(stack[sp - 1].get());
+                            if(cursor->Current >= cursor->End)
+                            {
+                                stack[sp - 1] = objects::NULL_OBJ;
+                                sp -= 1;
+                                frame->ip = pos - 1;
+                                break;
+                            }
+
+                            // 紧跟着的OpSetLocal/OpSetGlobal把值存入循环变量: 直接写入变量并跳过这条存储.
+                            // 上一轮的Integer只被游标和循环变量引用时原地改写它的值, 循环体没有保留循环变量时整个循环只分配一个Integer
+                            std::shared_ptr<objects::Object> *slot = nullptr;
+                            int storeWidth = 0;
+                            if(ip + 3 < ins_size)
+                            {
+                                auto next = static_cast<bytecode::OpcodeType>((*instructions)[ip+3]);
+                                if(next == bytecode::OpcodeType::OpSetLocal)
+                                {
+                                    uint8_t localIndex;
+                                    bytecode::ReadUint8(*instructions, ip+4, localIndex);
+                                    slot = &stack[frame->basePointer + int(localIndex)];
+                                    storeWidth = 2;
+                                }
+                                else if(next == bytecode::OpcodeType::OpSetGlobal)
+                                {
+                                    uint16_t globalIndex;
+                                    bytecode::ReadUint16(*instructions, ip+4, globalIndex);
+                                    slot = &globals[globalIndex];
+                                    storeWidth = 3;
+                                }
+                            }
+
+                            if(slot != nullptr)
+                            {
+                                if(cursor->Boxed != nullptr && slot->get() == cursor->Boxed.get() && cursor->Boxed.use_count() == 2)
+                                {
+                                    cursor->Boxed->Value = cursor->Current;
+                                }
+                                else
+                                {
+                                    cursor->Boxed = std::make_shared<objects::Integer>(cursor->Current);
+                                    *slot = cursor->Boxed;
+                                }
+                                frame->ip += storeWidth;
+                            }
+                            else
+                            {
+                                cursor->Boxed = std::make_shared<objects::Integer>(cursor->Current);
+                                auto result = Push(cursor->Boxed);
+                                if(objects::isError(result))
+                                {
+                                    return result;
+                                }
+                            }
+                            cursor->Current += 1;
+                        }
+                        break;
                     case bytecode::OpcodeType::OpNull:
                         {
                             auto result = Push(objects::NULL_OBJ);
@@ -222,15 +455,16 @@ namespace vm
                     case bytecode::OpcodeType::OpSetGlobal:
                         {
                             uint16_t globalIndex;
-                            bytecode::ReadUint16(instructions, ip+1, globalIndex);
+                            bytecode::ReadUint16(*instructions, ip+1, globalIndex);
                             frame->ip += 2;
-                            globals[globalIndex] = Pop();
+                            sp -= 1;
+                            globals[globalIndex] = stack[sp]; // 值留在栈槽里, REPL显示let语句的值
                         }
                         break;
                     case bytecode::OpcodeType::OpGetGlobal:
                         {
                             uint16_t globalIndex;
-                            bytecode::ReadUint16(instructions, ip+1, globalIndex);
+                            bytecode::ReadUint16(*instructions, ip+1, globalIndex);
                             frame->ip += 2;
                             auto result = Push(globals[globalIndex]);
                             if(objects::isError(result))
@@ -242,16 +476,17 @@ namespace vm
                     case bytecode::OpcodeType::OpSetLocal:
                         {
                             uint8_t localIndex;
-                            bytecode::ReadUint8(instructions, ip+1, localIndex);
+                            bytecode::ReadUint8(*instructions, ip+1, localIndex);
                             frame->ip += 1;
 
-                            stack[frame->basePointer + int(localIndex)] = Pop();
+                            sp -= 1;
+                            stack[frame->basePointer + int(localIndex)] = stack[sp];
                         }
                         break;
                     case bytecode::OpcodeType::OpGetLocal:
                         {
                             uint8_t localIndex;
-                            bytecode::ReadUint8(instructions, ip+1, localIndex);
+                            bytecode::ReadUint8(*instructions, ip+1, localIndex);
                             frame->ip += 1;
 
                             auto result = Push(stack[frame->basePointer + int(localIndex)]);
@@ -264,7 +499,7 @@ namespace vm
                     case bytecode::OpcodeType::OpArray:
                         {
                             uint16_t numElements;
-                            bytecode::ReadUint16(instructions, ip+1, numElements);
+                            bytecode::ReadUint16(*instructions, ip+1, numElements);
                             frame->ip += 2;
 
                             auto arrayObj = buildArray(sp - numElements, sp);
@@ -285,7 +520,7 @@ namespace vm
                     case bytecode::OpcodeType::OpHash:
                         {
                             uint16_t numElements;
-                            bytecode::ReadUint16(instructions, ip+1, numElements);
+                            bytecode::ReadUint16(*instructions, ip+1, numElements);
                             frame->ip += 2;
 
                             auto hashObj = buildHash(sp - numElements, sp);
@@ -315,12 +550,36 @@ namespace vm
                             }
                         }
                         break;
+                    case bytecode::OpcodeType::OpSlice:
+                        {
+                            auto end = Pop();
+                            auto start = Pop();
+                            auto left = Pop();
+
+                            auto result = objects::NewSlice(left, start, end);
+                            if(objects::isError(result))
+                            {
+                               return result;
+                            }
+
+                            result = Push(result);
+                            if(objects::isError(result))
+                            {
+                               return result;
+                            }
+                        }
+                        break;
                     case bytecode::OpcodeType::OpCall:
                         {
                             uint8_t numArgs;
-                            bytecode::ReadUint8(instructions, ip+1, numArgs);
+                            bytecode::ReadUint8(*instructions, ip+1, numArgs);
                             frame->ip += 1;
 
+                            if(feedback != nullptr)
+                            {
+                                recordCallTarget(feedback, ip, stack[sp - 1 - numArgs]);
+                            }
+
                             auto result = executeCall((int)numArgs);
                             if(objects::isError(result))
                             {
@@ -328,8 +587,9 @@ namespace vm
                             }
 
                             frame = currentFrame();
-                            instructions = frame->Instruction();
-                            ins_size = instructions.size();
+                            instructions = &frame->Instruction();
+                            ins_size = instructions->size();
+                            feedback = frame->cl->Fn->Feedback.get();
                         }
                         break;
                     case bytecode::OpcodeType::OpReturnValue:
@@ -339,9 +599,15 @@ namespace vm
                             auto callFrame = popFrame();
                             sp = callFrame->basePointer - 1;
 
+                            if(callFrame->memo != nullptr)
+                            {
+                                callFrame->memo->Put(callFrame->memoKey, callFrame->memoArgs, returnValue);
+                            }
+
                             frame = currentFrame();
-                            instructions = frame->Instruction();
-                            ins_size = instructions.size();
+                            instructions = &frame->Instruction();
+                            ins_size = instructions->size();
+                            feedback = frame->cl->Fn->Feedback.get();
 
                             //Pop(); // 函数本体出栈
 
@@ -357,9 +623,15 @@ namespace vm
                             auto callFrame = popFrame();
                             sp = callFrame->basePointer - 1;
 
+                            if(callFrame->memo != nullptr)
+                            {
+                                callFrame->memo->Put(callFrame->memoKey, callFrame->memoArgs, objects::NULL_OBJ);
+                            }
+
                             frame = currentFrame();
-                            instructions = frame->Instruction();
-                            ins_size = instructions.size();
+                            instructions = &frame->Instruction();
+                            ins_size = instructions->size();
+                            feedback = frame->cl->Fn->Feedback.get();
 
                             //Pop(); // 函数本体出栈
 
@@ -373,7 +645,7 @@ namespace vm
                     case bytecode::OpcodeType::OpGetBuiltin:
                         {
                             uint8_t builtinIndex;
-                            bytecode::ReadUint8(instructions, ip+1, builtinIndex);
+                            bytecode::ReadUint8(*instructions, ip+1, builtinIndex);
                             frame->ip += 1;
 
                             auto definition = objects::Builtins[builtinIndex];
@@ -387,11 +659,11 @@ namespace vm
                     case bytecode::OpcodeType::OpClosure:
                         {
                             uint16_t constIndex;
-                            bytecode::ReadUint16(instructions, ip+1, constIndex);
+                            bytecode::ReadUint16(*instructions, ip+1, constIndex);
                             frame->ip += 2;
 
                             uint8_t numFree;
-                            bytecode::ReadUint8(instructions, ip+3, numFree);
+                            bytecode::ReadUint8(*instructions, ip+3, numFree);
                             frame->ip += 1;
 
                             auto result = PushClosure((int)constIndex, (int)numFree);
@@ -404,7 +676,7 @@ namespace vm
                     case bytecode::OpcodeType::OpGetFree:
                         {
                             uint8_t freeIndex;
-                            bytecode::ReadUint8(instructions, ip+1, freeIndex);
+                            bytecode::ReadUint8(*instructions, ip+1, freeIndex);
                             frame->ip += 1;
 
                             auto currentClosure = frame->cl;
@@ -425,6 +697,72 @@ namespace vm
                             }
                         }
                         break;
+                    case bytecode::OpcodeType::OpImport:
+                        {
+                            uint16_t constIndex;
+                            bytecode::ReadUint16(*instructions, ip+1, constIndex);
+                            frame->ip += 2;
+
+                            auto exports = importModule(std::static_pointer_cast<objects::Module>(constants[constIndex]));
+                            if(objects::isError(exports))
+                            {
+                                return exports;
+                            }
+
+                            auto result = Push(exports);
+                            if(objects::isError(result))
+                            {
+                                return result;
+                            }
+                        }
+                        break;
+                    case bytecode::OpcodeType::OpAddInt:
+                    case bytecode::OpcodeType::OpSubInt:
+                    case bytecode::OpcodeType::OpMulInt:
+                    case bytecode::OpcodeType::OpEqualInt:
+                    case bytecode::OpcodeType::OpNotEqualInt:
+                    case bytecode::OpcodeType::OpGreaterThanInt:
+                        {
+                            auto &right = stack[sp - 1];
+                            auto &left = stack[sp - 2];
+
+                            // 类型守卫失败: 去优化后在基线代码上重新执行当前指令
+                            if(left->Type() != objects::ObjectType::INTEGER || right->Type() != objects::ObjectType::INTEGER)
+                            {
+                                deoptimize(frame, ip, "expected INTEGER operands, got " + left->TypeStr() + " " + right->TypeStr());
+                                feedback = frame->cl->Fn->Feedback.get();
+                                frame->ip = ip - 1;
+                                break;
+                            }
+
+                            auto leftValue = static_cast<objects::Integer*>(left.get())->Value;
+                            auto rightValue = static_cast<objects::Integer*>(right.get())->Value;
+                            right.reset(); // 和Pop一样不在栈上留下引用
+                            sp -= 1;
+
+                            switch(op)
+                            {
+                                case bytecode::OpcodeType::OpAddInt:
+                                    stack[sp - 1] = std::make_shared<objects::Integer>(leftValue + rightValue);
+                                    break;
+                                case bytecode::OpcodeType::OpSubInt:
+                                    stack[sp - 1] = std::make_shared<objects::Integer>(leftValue - rightValue);
+                                    break;
+                                case bytecode::OpcodeType::OpMulInt:
+                                    stack[sp - 1] = std::make_shared<objects::Integer>(leftValue * rightValue);
+                                    break;
+                                case bytecode::OpcodeType::OpEqualInt:
+                                    stack[sp - 1] = objects::nativeBoolToBooleanObject(leftValue == rightValue);
+                                    break;
+                                case bytecode::OpcodeType::OpNotEqualInt:
+                                    stack[sp - 1] = objects::nativeBoolToBooleanObject(leftValue != rightValue);
+                                    break;
+                                default:
+                                    stack[sp - 1] = objects::nativeBoolToBooleanObject(leftValue > rightValue);
+                                    break;
+                            }
+                        }
+                        break;
                 }
             }
 
@@ -606,6 +944,24 @@ namespace vm
 
                 return Push(result);
             }
+            else if(left->Type() == objects::ObjectType::INT_ARRAY && index->Type() == objects::ObjectType::INTEGER)
+            {
+                return Push(objects::evalIntArrayIndexExpression(left, index));
+            }
+            else if(left->Type() == objects::ObjectType::SLICE && index->Type() == objects::ObjectType::INTEGER)
+            {
+                return Push(objects::evalSliceIndexExpression(left, index));
+            }
+            else if(left->Type() == objects::ObjectType::HOST_BUFFER && index->Type() == objects::ObjectType::INTEGER)
+            {
+                auto result = objects::evalHostIndexExpression(left, index);
+                if (objects::isError(result))
+                {
+                    return result;
+                }
+
+                return Push(result);
+            }
             else 
             {
                 return objects::newError("index operator not supported: " + left->TypeStr());
@@ -620,6 +976,11 @@ namespace vm
                 elements[i - startIndex] = stack[i];
             }
 
+            // 全是整数的数组字面量直接打包, 之后的数值内置函数不用再拆箱
+            if(auto packed = objects::PackIntegers(elements); packed != nullptr)
+            {
+                return packed;
+            }
             return std::make_shared<objects::Array>(elements);
         }
 
@@ -676,7 +1037,34 @@ namespace vm
                 return objects::newError("wrong number of arguments: want=" + str1 + ", got=" + str2);
             }
 
+            if(closureFn->Memo == nullptr && memoizePure && closureFn->Fn->Pure)
+            {
+                closureFn->Memo = std::make_shared<objects::MemoTable>();
+            }
+
+            std::vector<objects::HashKey> memoKey;
+            bool cacheable = (closureFn->Memo != nullptr && objects::MemoTable::MakeKey(stack, sp - numArgs, numArgs, memoKey));
+            if(cacheable)
+            {
+                if(auto cached = closureFn->Memo->Get(memoKey, stack, sp - numArgs); cached != nullptr)
+                {
+                    sp = sp - numArgs - 1;
+                    return Push(cached);
+                }
+            }
+
+            if(speculation && vm::CanOptimize(closureFn->Fn))
+            {
+                tierUp(closureFn->Fn);
+            }
+
             auto funcFrame = NewFrame(closureFn, sp - numArgs);
+            if(cacheable)
+            {
+                funcFrame->memo = closureFn->Memo;
+                funcFrame->memoKey = std::move(memoKey);
+                funcFrame->memoArgs.assign(stack.begin() + sp - numArgs, stack.begin() + sp);
+            }
 
             pushFrame(funcFrame);
 
@@ -685,12 +1073,128 @@ namespace vm
             return nullptr;
         }
 
-        std::shared_ptr<objects::Object> callBuiltin(std::shared_ptr<objects::Builtin> builtinFnObj,int numArgs)
+        // 在当前虚拟机上调用函数(可以在Run之后, 复用全局变量): 借助一个只有OpCall的跳板帧, 函数返回到跳板帧后Run结束
+        std::shared_ptr<objects::Object> Call(std::shared_ptr<objects::Object> fn, const std::vector<std::shared_ptr<objects::Object>> &args)
+        {
+            int savedSp = sp, savedFrameIndex = frameIndex;
+
+            auto ins = bytecode::Make(bytecode::OpcodeType::OpCall, {static_cast<int>(args.size())});
+            auto trampoline = std::make_shared<objects::CompiledFunction>(ins, 0, 0);
+            pushFrame(NewFrame(std::make_shared<objects::Closure>(trampoline), sp));
+
+            auto result = Push(fn);
+            for(unsigned long i = 0; i < args.size() && result == nullptr; i++)
+            {
+                result = Push(args[i]);
+            }
+
+            if(result == nullptr)
+            {
+                result = Run();
+            }
+            if(!objects::isError(result))
+            {
+                result = stack[sp - 1];
+            }
+
+            frameIndex = savedFrameIndex;
+            sp = savedSp;
+            return result;
+        }
+
+        // 链接位置相同的模块在不同程序中的代码和全局变量布局也相同, 可以共用一次初始化的结果.
+        // 菱形依赖去重后间接导入的模块可能链接在别处, 所以键里还要带上顶层代码导入的每个模块的键
+        std::string moduleKey(std::shared_ptr<objects::Module> module)
         {
-            std::vector<std::shared_ptr<objects::Object>> args;
-            args.assign(stack.begin() + sp - numArgs, stack.begin() + sp);
+            auto key = module->Path + "@" + std::to_string(module->MTime) + "@" + std::to_string(module->GlobalBase) + "@" + std::to_string(module->ConstantBase);
 
-            auto result = builtinFnObj->Fn(args);
+            auto &ins = module->Instructions;
+            unsigned long ip = 0;
+            while(ip < ins.size())
+            {
+                auto op = static_cast<bytecode::OpcodeType>(ins[ip]);
+                auto def = bytecode::Lookup(op);
+                if(def == nullptr)
+                {
+                    break;
+                }
+
+                if(op == bytecode::OpcodeType::OpImport)
+                {
+                    uint16_t constIndex;
+                    bytecode::ReadUint16(ins, ip+1, constIndex);
+                    key += "(" + moduleKey(std::static_pointer_cast<objects::Module>(constants[constIndex])) + ")";
+                }
+
+                ip += 1;
+                for(auto &width : def->OperandWidths)
+                {
+                    ip += width;
+                }
+            }
+            return key;
+        }
+
+        // 在当前虚拟机上执行模块的顶层代码, 同一个运行时中每个模块只执行一次; 返回导出表
+        std::shared_ptr<objects::Object> importModule(std::shared_ptr<objects::Module> module)
+        {
+            auto key = moduleKey(module);
+            if(auto fit = modules->find(key); fit != modules->end())
+            {
+                if(fit->second.Loading)
+                {
+                    return objects::newError("import cycle at " + module->Path);
+                }
+
+                std::copy(fit->second.Values.begin(), fit->second.Values.end(), globals.begin() + module->GlobalBase);
+                return fit->second.Exports;
+            }
+
+            (*modules)[key] = ModuleInstance();
+
+            auto initFn = std::make_shared<objects::CompiledFunction>(module->Instructions, 0, 0);
+            int savedSp = sp, savedFrameIndex = frameIndex;
+            pushFrame(NewFrame(std::make_shared<objects::Closure>(initFn), sp));
+
+            auto result = Run();
+            frameIndex = savedFrameIndex;
+            sp = savedSp;
+
+            if(objects::isError(result))
+            {
+                modules->erase(key);
+                return objects::newError("import " + module->Path + ": " + std::static_pointer_cast<objects::Error>(result)->Message);
+            }
+
+            auto &instance = (*modules)[key];
+            instance.Values.assign(globals.begin() + module->GlobalBase, globals.begin() + module->GlobalBase + module->NumGlobals);
+
+            std::map<objects::HashKey, std::shared_ptr<objects::HashPair>> pairs;
+            for(auto &[name, index] : module->Exports)
+            {
+                auto key = std::make_shared<objects::String>(name);
+                pairs[key->GetHashKey()] = std::make_shared<objects::HashPair>(key, globals[module->GlobalBase + index]);
+            }
+            instance.Exports = std::make_shared<objects::Hash>(pairs);
+            instance.Loading = false;
+
+            return instance.Exports;
+        }
+
+        std::shared_ptr<objects::Object> callBuiltin(std::shared_ptr<objects::Builtin> builtinFnObj,int numArgs)
+        {
+            std::shared_ptr<objects::Object> result;
+            if(builtinFnObj->Fn == nullptr)
+            {
+                // 插件函数直接读取栈上的参数, 不复制
+                result = builtinFnObj->Invoke(builtinFnObj->Native, &stack[sp - numArgs], numArgs);
+            }
+            else
+            {
+                std::vector<std::shared_ptr<objects::Object>> args;
+                args.assign(stack.begin() + sp - numArgs, stack.begin() + sp);
+                result = builtinFnObj->Fn(args);
+            }
 
             sp = sp - numArgs - 1;
 
@@ -704,6 +1208,45 @@ namespace vm
             return nullptr;
         }
 
+        void recordCallTarget(objects::FeedbackVector *feedback, const int &ip, std::shared_ptr<objects::Object> &fnObj)
+        {
+            if(fnObj->Type() == objects::ObjectType::CLOSURE)
+            {
+                feedback->RecordCallTarget(ip, std::static_pointer_cast<objects::Closure>(fnObj)->Fn);
+            }
+            else
+            {
+                feedback->RecordCallTarget(ip, fnObj);
+            }
+        }
+
+        void tierUp(std::shared_ptr<objects::CompiledFunction> fn)
+        {
+            if(fn->Hotness >= optimizeThreshold)
+            {
+                return;
+            }
+
+            fn->Hotness += 1;
+
+            if(fn->Hotness == warmupThreshold && fn->Feedback == nullptr)
+            {
+                fn->Feedback = std::make_shared<objects::FeedbackVector>(fn->Instructions.size());
+            }
+
+            if(fn->Hotness == optimizeThreshold)
+            {
+                vm::Optimize(fn);
+            }
+        }
+
+        void deoptimize(std::shared_ptr<Frame> frame, const int &ip, const std::string &reason)
+        {
+            auto fn = frame->cl->Fn;
+            vm::Deoptimize(fn);
+            deopts.push_back(DeoptEvent(fn, ip, reason));
+        }
+
         std::shared_ptr<Frame> currentFrame()
         {
             return frames[frameIndex - 1];
@@ -722,7 +1265,7 @@ namespace vm
         }
     };
 
-    std::shared_ptr<VM> New(std::shared_ptr<compiler::ByteCode> bytecode)
+    inline std::shared_ptr<VM> New(std::shared_ptr<compiler::ByteCode> bytecode)
     {
         auto mainFn = std::make_shared<objects::CompiledFunction>(bytecode->Instructions, 0, 0);
         auto mainClosure = std::make_shared<objects::Closure>(mainFn);
@@ -734,7 +1277,7 @@ namespace vm
         return std::make_shared<VM>(bytecode->Constants, frames);
     }
 
-    std::shared_ptr<VM> NewWithGlobalsStore(std::shared_ptr<compiler::ByteCode> bytecode,
+    inline std::shared_ptr<VM> NewWithGlobalsStore(std::shared_ptr<compiler::ByteCode> bytecode,
                                             std::vector<std::shared_ptr<objects::Object>>& s)
     {
         std::shared_ptr<VM> vm = New(bytecode);